@@ -0,0 +1,26 @@
+# Copies a shader header into the build tree and rewrites the HLSL constructs which have no C++ macro
+# equivalent:
+#   in T x                    -> T x
+#   out T x                   -> T& x
+#   inout T x                 -> T& x
+#   NodeOutput<R> x           -> NodeOutput<R>& x       (node objects are handles, see WorkGraph.h)
+#   NodeOutputArray<R> x      -> NodeOutputArray<R>& x
+#   (T)0;                     -> T{};                   (zero-initialized struct)
+#   T x : SV_DispatchGrid;    -> T x;
+#   T F(...) at line start    -> inline T F(...)        (headers are included by several translation units)
+#
+# Usage: cmake -D INPUT=<shader header> -D OUTPUT=<translated header> -P HlslToCpp.cmake
+
+file(READ "${INPUT}" source)
+
+set(parameterStart "([(,][ \t\r\n]*)")
+set(typeName       "([A-Za-z_][A-Za-z0-9_:]*)")
+
+string(REGEX REPLACE "${parameterStart}(inout|out)[ \t]+(const[ \t]+)?${typeName}[ \t]+" "\\1\\4& " source "${source}")
+string(REGEX REPLACE "${parameterStart}in[ \t]+" "\\1" source "${source}")
+string(REGEX REPLACE "${parameterStart}(NodeOutput(Array)?<${typeName}>)[ \t]+" "\\1\\2& " source "${source}")
+string(REGEX REPLACE "[ \t]*:[ \t]*SV_DispatchGrid[ \t]*;" ";" source "${source}")
+string(REGEX REPLACE "\\(([A-Z][A-Za-z0-9_]*)\\)0;" "\\1{};" source "${source}")
+string(REGEX REPLACE "\n([A-Za-z_][A-Za-z0-9_<>:, ]*[ \t]+[A-Za-z_][A-Za-z0-9_]*[ \t]*\\()" "\ninline \\1" source "${source}")
+
+file(WRITE "${OUTPUT}" "// Generated from ${INPUT} by HlslToCpp.cmake, do not edit.\n#line 1 \"${INPUT}\"\n${source}")
@@ -0,0 +1,165 @@
+#pragma once
+
+// ============================ Host Common.h ====================
+// Stand-in for the Common.h header of the Work Graph Playground, which the shader headers
+// expect to be included first. Provides the playground globals (scratch buffer, time, render
+// size, ...) and the random:: helpers.
+//
+// Note: random:: follows the interface of the playground, but not its hash: the playground's Common.h is not part of
+// this repository, so Random hashes its seeds with PcgHash and CombineSeed below. Every seed yields the same tree in
+// every host run, but not the tree the playground draws for it.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Hlsl.h"
+// Node outputs, coalescing inputs and wave intrinsics of the node functions
+#include "WorkGraph.h"
+
+static const float PI = 3.14159265358979323846f;
+
+// The host executor always emulates a hardware adapter with wave size 32.
+#define USING_SOFTWARE_ADAPTER 0
+
+inline uint DivideAndRoundUp(uint dividend, uint divisor)
+{
+    return (dividend + divisor - 1) / divisor;
+}
+
+// ============================ Buffers ====================
+
+class RWByteAddressBuffer {
+public:
+    explicit RWByteAddressBuffer(size_t sizeInBytes) : data_(sizeInBytes / sizeof(uint), 0u) {}
+
+    template <typename T>
+    T Load(uint address) const
+    {
+        T value;
+        std::memcpy(static_cast<void*>(&value), reinterpret_cast<const char*>(data_.data()) + address, sizeof(T));
+        return value;
+    }
+
+    uint Load(uint address) const { return Load<uint>(address); }
+
+    template <typename T>
+    void Store(uint address, const T& value)
+    {
+        std::memcpy(reinterpret_cast<char*>(data_.data()) + address, &value, sizeof(T));
+    }
+
+    void InterlockedAdd(uint address, uint value)
+    {
+        Atomic(address).fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void InterlockedAdd(uint address, uint value, uint& originalValue)
+    {
+        originalValue = Atomic(address).fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void InterlockedMax(uint address, uint value)
+    {
+        std::atomic_ref<uint> atomic = Atomic(address);
+        uint current = atomic.load(std::memory_order_relaxed);
+        while (current < value && !atomic.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void InterlockedMin(uint address, uint value)
+    {
+        std::atomic_ref<uint> atomic = Atomic(address);
+        uint current = atomic.load(std::memory_order_relaxed);
+        while (current > value && !atomic.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void Clear() { std::fill(data_.begin(), data_.end(), 0u); }
+
+    size_t GetSize() const { return data_.size() * sizeof(uint); }
+
+private:
+    std::atomic_ref<uint> Atomic(uint address) { return std::atomic_ref<uint>(data_[address / sizeof(uint)]); }
+
+    std::vector<uint> data_;
+};
+
+// Same size as the persistent scratch buffer of the playground.
+inline RWByteAddressBuffer PersistentScratchBuffer(64 * 1024 * 1024);
+
+// ============================ Globals ====================
+
+inline float Time          = 0.f;
+inline uint2 RenderSize    = uint2(1920, 1080);
+inline int2  MousePosition = int2(0, 0);
+
+// ============================ Random ====================
+
+// POSIX declares a random() function, which would clash with the random:: namespace of the
+// shader headers. Include standard headers before this header.
+#define random playground_random
+
+namespace random {
+
+    inline uint PcgHash(uint input)
+    {
+        const uint state = input * 747796405u + 2891336453u;
+        const uint word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    inline uint CombineSeed(uint a, uint b)
+    {
+        return PcgHash(a ^ (b + 0x9e3779b9u + (a << 6u) + (a >> 2u)));
+    }
+
+    inline uint CombineSeed(uint a, uint b, uint c)
+    {
+        return CombineSeed(CombineSeed(a, b), c);
+    }
+
+    inline uint CombineSeed(uint a, uint b, uint c, uint d)
+    {
+        return CombineSeed(CombineSeed(a, b, c), d);
+    }
+
+    // Uniform random value in [0, 1)
+    template <typename... Seeds>
+    float Random(uint seed, Seeds... seeds)
+    {
+        uint hash = PcgHash(seed);
+        ((hash = CombineSeed(hash, uint(seeds))), ...);
+        return float(hash >> 8u) / float(1u << 24u);
+    }
+
+    // Uniform random value in [-1, 1)
+    template <typename... Seeds>
+    float SignedRandom(uint seed, Seeds... seeds)
+    {
+        return Random(seed, seeds...) * 2.f - 1.f;
+    }
+
+    inline float2 PerlinNoiseDir2D(int2 position)
+    {
+        const float angle = Random(uint(position.x), uint(position.y), 0x5EEDu) * 2.f * PI;
+        return float2(std::cos(angle), std::sin(angle));
+    }
+
+    inline float PerlinNoise2D(float2 position)
+    {
+        const int2   grid = floor(position);
+        const float2 uv   = position - float2(grid);
+
+        const float d00 = dot(PerlinNoiseDir2D(grid + int2(0, 0)), uv - float2(0, 0));
+        const float d01 = dot(PerlinNoiseDir2D(grid + int2(0, 1)), uv - float2(0, 1));
+        const float d10 = dot(PerlinNoiseDir2D(grid + int2(1, 0)), uv - float2(1, 0));
+        const float d11 = dot(PerlinNoiseDir2D(grid + int2(1, 1)), uv - float2(1, 1));
+
+        const float2 t = uv * uv * (3.f - 2.f * uv);
+
+        return lerp(lerp(d00, d10, t.x), lerp(d01, d11, t.x), t.y);
+    }
+
+} // namespace random
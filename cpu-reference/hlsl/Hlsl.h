@@ -0,0 +1,758 @@
+#pragma once
+
+// ============================ HLSL Types and Intrinsics ====================
+// Host-side subset of HLSL, just large enough to compile the generation headers of
+// procedural-tree-generation (Records.h, TreeModel.h, LeafDensity.h, ...) as C++20.
+// Function parameter qualifiers (in, out, inout) are not handled here; they are rewritten
+// when the shader headers are copied into the build tree (see cmake/HlslToCpp.cmake).
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+typedef unsigned int uint;
+
+template <typename T, int N>
+struct vec;
+
+template <typename T, int R, int C>
+struct mat;
+
+template <typename T, int N, int... I>
+struct Swizzle;
+
+// ============================ Traits ====================
+
+template <typename T>
+struct HlslTraits {
+    static constexpr bool isVector = false;
+    static constexpr int  size     = 1;
+    using Scalar                   = T;
+};
+
+template <typename T, int N>
+struct HlslTraits<vec<T, N>> {
+    static constexpr bool isVector = true;
+    static constexpr int  size     = N;
+    using Scalar                   = T;
+};
+
+template <typename T, int N, int... I>
+struct HlslTraits<Swizzle<T, N, I...>> {
+    static constexpr bool isVector = true;
+    static constexpr int  size     = sizeof...(I);
+    using Scalar                   = T;
+};
+
+template <typename T>
+using Bare = std::remove_cvref_t<T>;
+
+template <typename T>
+concept ScalarType = std::is_arithmetic_v<Bare<T>>;
+
+template <typename T>
+concept VectorType = HlslTraits<Bare<T>>::isVector;
+
+template <typename T>
+concept Numeric = ScalarType<T> || VectorType<T>;
+
+template <typename T>
+using ScalarOf = typename HlslTraits<Bare<T>>::Scalar;
+
+template <typename T>
+inline constexpr int SizeOf = HlslTraits<Bare<T>>::size;
+
+// HLSL literals are 32 bit, so any floating point operand promotes to float (and never to double).
+template <typename A, typename B>
+using Promote = std::conditional_t<std::is_floating_point_v<A> || std::is_floating_point_v<B>,
+                                   float,
+                                   std::common_type_t<A, B>>;
+
+// ============================ Swizzles ====================
+
+// Swizzle members share the storage of their vector through a union.
+// Reading converts to a vector, writing scatters the components back.
+template <typename T, int N, int... I>
+struct Swizzle {
+    using Vector = vec<T, sizeof...(I)>;
+
+    T data[N];
+
+    operator Vector() const
+    {
+        Vector result;
+        int    i = 0;
+        ((result.data[i++] = data[I]), ...);
+        return result;
+    }
+
+    Swizzle& operator=(const Vector& v)
+    {
+        int i = 0;
+        ((data[I] = v.data[i++]), ...);
+        return *this;
+    }
+
+    // a.xy = b.xy must not copy the whole storage
+    Swizzle& operator=(const Swizzle& other) { return *this = Vector(other); }
+
+    template <Numeric V>
+    Swizzle& operator=(const V& v) { return *this = Vector(v); }
+
+    static constexpr int indices[] = { I... };
+
+    T Get(int i) const { return data[indices[i]]; }
+    T operator[](int i) const { return Get(i); }
+
+    template <Numeric V> Swizzle& operator+=(const V& v) { return *this = Vector(Vector(*this) + v); }
+    template <Numeric V> Swizzle& operator-=(const V& v) { return *this = Vector(Vector(*this) - v); }
+    template <Numeric V> Swizzle& operator*=(const V& v) { return *this = Vector(Vector(*this) * v); }
+    template <Numeric V> Swizzle& operator/=(const V& v) { return *this = Vector(Vector(*this) / v); }
+};
+
+#include "Swizzles.inl"
+
+// ============================ Vectors ====================
+
+template <typename T, int N>
+struct VectorStorage;
+
+template <typename T>
+struct VectorStorage<T, 2> {
+    union {
+        T data[2];
+        struct { T x, y; };
+        struct { T r, g; };
+        HLSL_SWIZZLES_2(T)
+    };
+};
+
+template <typename T>
+struct VectorStorage<T, 3> {
+    union {
+        T data[3];
+        struct { T x, y, z; };
+        struct { T r, g, b; };
+        HLSL_SWIZZLES_3(T)
+    };
+};
+
+template <typename T>
+struct VectorStorage<T, 4> {
+    union {
+        T data[4];
+        struct { T x, y, z, w; };
+        struct { T r, g, b, a; };
+        HLSL_SWIZZLES_4(T)
+    };
+};
+
+template <typename T>
+auto ToVector(const T& v)
+{
+    if constexpr (VectorType<T>) {
+        return vec<ScalarOf<T>, SizeOf<T>>(v);
+    } else {
+        return v;
+    }
+}
+
+template <typename T>
+auto Component(const T& v, int i)
+{
+    if constexpr (VectorType<T>) {
+        return v.Get(i);
+    } else {
+        return v;
+    }
+}
+
+template <typename T, int N>
+struct vec : VectorStorage<T, N> {
+    using VectorStorage<T, N>::data;
+
+    vec() = default;
+    vec(const vec&) = default;
+
+    vec& operator=(const vec& other)
+    {
+        std::memcpy(data, other.data, sizeof(data));
+        return *this;
+    }
+
+    // Scalar splat, e.g. float3 v = 0;
+    template <ScalarType S>
+    vec(S s)
+    {
+        for (int i = 0; i < N; ++i) {
+            data[i] = T(s);
+        }
+    }
+
+    // Conversion between vectors of the same size, e.g. int2 i = floor(f);
+    template <VectorType V>
+        requires(SizeOf<V> == N)
+    vec(const V& v)
+    {
+        for (int i = 0; i < N; ++i) {
+            data[i] = T(v.Get(i));
+        }
+    }
+
+    // Component-wise construction, e.g. float4(float3, float)
+    template <Numeric... Args>
+        requires(sizeof...(Args) > 1 && (SizeOf<Args> + ...) == N)
+    vec(const Args&... args)
+    {
+        int i = 0;
+        (Fill(i, args), ...);
+    }
+
+    T        Get(int i) const { return data[i]; }
+    T&       operator[](int i) { return data[i]; }
+    const T& operator[](int i) const { return data[i]; }
+
+    template <Numeric V> vec& operator+=(const V& v) { return *this = vec(*this + v); }
+    template <Numeric V> vec& operator-=(const V& v) { return *this = vec(*this - v); }
+    template <Numeric V> vec& operator*=(const V& v) { return *this = vec(*this * v); }
+    template <Numeric V> vec& operator/=(const V& v) { return *this = vec(*this / v); }
+    template <Numeric V> vec& operator%=(const V& v) { return *this = vec(*this % v); }
+    template <Numeric V> vec& operator&=(const V& v) { return *this = vec(*this & v); }
+    template <Numeric V> vec& operator|=(const V& v) { return *this = vec(*this | v); }
+    template <Numeric V> vec& operator^=(const V& v) { return *this = vec(*this ^ v); }
+    template <Numeric V> vec& operator<<=(const V& v) { return *this = vec(*this << v); }
+    template <Numeric V> vec& operator>>=(const V& v) { return *this = vec(*this >> v); }
+
+private:
+    template <typename A>
+    void Fill(int& i, const A& a)
+    {
+        if constexpr (VectorType<A>) {
+            for (int k = 0; k < SizeOf<A>; ++k) {
+                data[i++] = T(a.Get(k));
+            }
+        } else {
+            data[i++] = T(a);
+        }
+    }
+};
+
+typedef vec<float, 2> float2;
+typedef vec<float, 3> float3;
+typedef vec<float, 4> float4;
+typedef vec<int, 2>   int2;
+typedef vec<int, 3>   int3;
+typedef vec<int, 4>   int4;
+typedef vec<uint, 2>  uint2;
+typedef vec<uint, 3>  uint3;
+typedef vec<uint, 4>  uint4;
+typedef vec<bool, 2>  bool2;
+typedef vec<bool, 3>  bool3;
+typedef vec<bool, 4>  bool4;
+
+// ============================ Component-wise Evaluation ====================
+
+template <typename... Args>
+inline constexpr int ComponentCount = std::max({SizeOf<Args>...});
+
+// Applies f to each component; scalars are broadcast, scalar-only calls return a scalar.
+template <typename F, typename... Args>
+auto ComponentWise(F f, const Args&... args)
+{
+    constexpr int n = ComponentCount<Args...>;
+    static_assert(((SizeOf<Args> == 1 || SizeOf<Args> == n) && ...), "HLSL vector size mismatch");
+
+    if constexpr (n == 1) {
+        return f(args...);
+    } else {
+        using R = decltype(f(ScalarOf<Args>()...));
+        vec<R, n> result;
+        [&](const auto&... vs) {
+            for (int i = 0; i < n; ++i) {
+                result.data[i] = f(Component(vs, i)...);
+            }
+        }(ToVector(args)...);
+        return result;
+    }
+}
+
+#include "HlslSimd.h"
+
+#define HLSL_BINARY_OPERATOR(OP, SIMD_OP)                                                 \
+    template <Numeric A, Numeric B>                                                       \
+        requires(VectorType<A> || VectorType<B>)                                          \
+    auto operator OP(const A& a, const B& b)                                              \
+    {                                                                                     \
+        if constexpr (SimdOperands<A, B>) {                                               \
+            return simd::Binary<simd::Op::SIMD_OP>(a, b);                                 \
+        } else {                                                                          \
+            return ComponentWise([](auto x, auto y) {                                     \
+                using P = Promote<decltype(x), decltype(y)>;                              \
+                return P(x) OP P(y);                                                      \
+            }, a, b);                                                                     \
+        }                                                                                 \
+    }
+
+#define HLSL_INTEGER_OPERATOR(OP)                                                         \
+    template <Numeric A, Numeric B>                                                       \
+        requires(VectorType<A> || VectorType<B>)                                          \
+    auto operator OP(const A& a, const B& b)                                              \
+    {                                                                                     \
+        return ComponentWise([](auto x, auto y) { return decltype(x)(x OP y); }, a, b);   \
+    }
+
+#define HLSL_COMPARISON_OPERATOR(OP)                                                      \
+    template <Numeric A, Numeric B>                                                       \
+        requires(VectorType<A> || VectorType<B>)                                          \
+    auto operator OP(const A& a, const B& b)                                              \
+    {                                                                                     \
+        return ComponentWise([](auto x, auto y) {                                         \
+            using P = Promote<decltype(x), decltype(y)>;                                  \
+            return bool(P(x) OP P(y));                                                    \
+        }, a, b);                                                                         \
+    }
+
+HLSL_BINARY_OPERATOR(+, Add)
+HLSL_BINARY_OPERATOR(-, Sub)
+HLSL_BINARY_OPERATOR(*, Mul)
+HLSL_BINARY_OPERATOR(/, Div)
+HLSL_INTEGER_OPERATOR(%)
+HLSL_INTEGER_OPERATOR(&)
+HLSL_INTEGER_OPERATOR(|)
+HLSL_INTEGER_OPERATOR(^)
+HLSL_INTEGER_OPERATOR(<<)
+HLSL_INTEGER_OPERATOR(>>)
+HLSL_COMPARISON_OPERATOR(==)
+HLSL_COMPARISON_OPERATOR(!=)
+HLSL_COMPARISON_OPERATOR(<)
+HLSL_COMPARISON_OPERATOR(<=)
+HLSL_COMPARISON_OPERATOR(>)
+HLSL_COMPARISON_OPERATOR(>=)
+
+#undef HLSL_BINARY_OPERATOR
+#undef HLSL_INTEGER_OPERATOR
+#undef HLSL_COMPARISON_OPERATOR
+
+template <VectorType A>
+auto operator-(const A& a)
+{
+    return ComponentWise([](auto x) { return decltype(x)(-x); }, a);
+}
+
+template <VectorType A>
+auto operator+(const A& a)
+{
+    return ToVector(a);
+}
+
+template <VectorType A>
+auto operator!(const A& a)
+{
+    return ComponentWise([](auto x) { return !x; }, a);
+}
+
+template <VectorType A>
+auto operator~(const A& a)
+{
+    return ComponentWise([](auto x) { return decltype(x)(~x); }, a);
+}
+
+// ============================ Intrinsics ====================
+
+#define HLSL_FLOAT_FUNCTION(NAME, EXPR)                                                   \
+    template <Numeric A>                                                                  \
+    auto NAME(const A& a)                                                                 \
+    {                                                                                     \
+        return ComponentWise([](auto v) { const float x = float(v); return float(EXPR); }, a); \
+    }
+
+HLSL_FLOAT_FUNCTION(sin, std::sin(x))
+HLSL_FLOAT_FUNCTION(cos, std::cos(x))
+HLSL_FLOAT_FUNCTION(tan, std::tan(x))
+HLSL_FLOAT_FUNCTION(asin, std::asin(x))
+HLSL_FLOAT_FUNCTION(acos, std::acos(x))
+HLSL_FLOAT_FUNCTION(atan, std::atan(x))
+HLSL_FLOAT_FUNCTION(sqrt, std::sqrt(x))
+HLSL_FLOAT_FUNCTION(rsqrt, 1.f / std::sqrt(x))
+HLSL_FLOAT_FUNCTION(exp, std::exp(x))
+HLSL_FLOAT_FUNCTION(exp2, std::exp2(x))
+HLSL_FLOAT_FUNCTION(log, std::log(x))
+HLSL_FLOAT_FUNCTION(log2, std::log2(x))
+HLSL_FLOAT_FUNCTION(floor, std::floor(x))
+HLSL_FLOAT_FUNCTION(ceil, std::ceil(x))
+HLSL_FLOAT_FUNCTION(trunc, std::trunc(x))
+// HLSL rounds halfway cases to even
+HLSL_FLOAT_FUNCTION(round, std::nearbyint(x))
+HLSL_FLOAT_FUNCTION(frac, x - std::floor(x))
+HLSL_FLOAT_FUNCTION(saturate, std::clamp(x, 0.f, 1.f))
+HLSL_FLOAT_FUNCTION(radians, x * 0.017453292519943295f)
+HLSL_FLOAT_FUNCTION(degrees, x * 57.29577951308232f)
+
+#undef HLSL_FLOAT_FUNCTION
+
+template <Numeric A>
+auto abs(const A& a)
+{
+    return ComponentWise([](auto x) {
+        if constexpr (std::is_floating_point_v<decltype(x)>) {
+            return float(std::fabs(x));
+        } else if constexpr (std::is_signed_v<decltype(x)>) {
+            return x < 0 ? decltype(x)(-x) : x;
+        } else {
+            return x;
+        }
+    }, a);
+}
+
+template <Numeric A>
+auto sign(const A& a)
+{
+    return ComponentWise([](auto x) { return int((x > 0) - (x < 0)); }, a);
+}
+
+// Like D3D, float min and max return the other operand if one of them is NaN
+template <typename T>
+T MinScalar(T x, T y)
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        return std::fmin(x, y);
+    }
+    return std::min(x, y);
+}
+
+template <typename T>
+T MaxScalar(T x, T y)
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        return std::fmax(x, y);
+    }
+    return std::max(x, y);
+}
+
+template <Numeric A, Numeric B>
+auto min(const A& a, const B& b)
+{
+    return ComponentWise([](auto x, auto y) {
+        using P = Promote<decltype(x), decltype(y)>;
+        return MinScalar(P(x), P(y));
+    }, a, b);
+}
+
+template <Numeric A, Numeric B>
+auto max(const A& a, const B& b)
+{
+    return ComponentWise([](auto x, auto y) {
+        using P = Promote<decltype(x), decltype(y)>;
+        return MaxScalar(P(x), P(y));
+    }, a, b);
+}
+
+template <Numeric A, Numeric B>
+auto pow(const A& a, const B& b)
+{
+    return ComponentWise([](auto x, auto y) { return std::pow(float(x), float(y)); }, a, b);
+}
+
+template <Numeric A, Numeric B>
+auto atan2(const A& a, const B& b)
+{
+    return ComponentWise([](auto y, auto x) { return std::atan2(float(y), float(x)); }, a, b);
+}
+
+template <Numeric A, Numeric B>
+auto fmod(const A& a, const B& b)
+{
+    return ComponentWise([](auto x, auto y) { return std::fmod(float(x), float(y)); }, a, b);
+}
+
+template <Numeric A, Numeric B>
+auto step(const A& edge, const B& x)
+{
+    return ComponentWise([](auto e, auto v) { return float(v >= e); }, edge, x);
+}
+
+template <Numeric A, Numeric B, Numeric C>
+auto clamp(const A& x, const B& lo, const C& hi)
+{
+    return ComponentWise([](auto v, auto l, auto h) {
+        using P = Promote<Promote<decltype(v), decltype(l)>, decltype(h)>;
+        return MinScalar(MaxScalar(P(v), P(l)), P(h));
+    }, x, lo, hi);
+}
+
+template <Numeric A, Numeric B, Numeric C>
+auto lerp(const A& a, const B& b, const C& t)
+{
+    if constexpr (SimdOperands<A, B> && SimdOperands<A, C> && (SimdFloatVector<A> || SimdFloatVector<B>)) {
+        return simd::Lerp(a, b, t);
+    }
+    return ComponentWise([](auto x, auto y, auto s) { return float(x) + float(s) * (float(y) - float(x)); }, a, b, t);
+}
+
+template <Numeric A, Numeric B, Numeric C>
+auto mad(const A& a, const B& b, const C& c)
+{
+    return a * b + c;
+}
+
+template <Numeric A, Numeric B, Numeric C>
+auto smoothstep(const A& lo, const B& hi, const C& x)
+{
+    return ComponentWise([](auto l, auto h, auto v) {
+        const float t = std::clamp((float(v) - float(l)) / (float(h) - float(l)), 0.f, 1.f);
+        return t * t * (3.f - 2.f * t);
+    }, lo, hi, x);
+}
+
+template <Numeric A>
+bool any(const A& a)
+{
+    const auto v = ToVector(a);
+    if constexpr (VectorType<A>) {
+        for (int i = 0; i < SizeOf<A>; ++i) {
+            if (v.data[i]) return true;
+        }
+        return false;
+    } else {
+        return bool(v);
+    }
+}
+
+template <Numeric A>
+bool all(const A& a)
+{
+    const auto v = ToVector(a);
+    if constexpr (VectorType<A>) {
+        for (int i = 0; i < SizeOf<A>; ++i) {
+            if (!v.data[i]) return false;
+        }
+        return true;
+    } else {
+        return bool(v);
+    }
+}
+
+template <VectorType A, VectorType B>
+float dot(const A& a, const B& b)
+{
+    static_assert(SizeOf<A> == SizeOf<B>, "HLSL vector size mismatch");
+    if constexpr (SimdOperands<A, B>) {
+        return simd::DotProduct(a, b);
+    }
+    const auto va = ToVector(a);
+    const auto vb = ToVector(b);
+    float result = 0;
+    for (int i = 0; i < SizeOf<A>; ++i) {
+        result += float(va.data[i]) * float(vb.data[i]);
+    }
+    return result;
+}
+
+template <VectorType A>
+float length(const A& a)
+{
+    return std::sqrt(dot(a, a));
+}
+
+template <VectorType A, VectorType B>
+float distance(const A& a, const B& b)
+{
+    return length(a - b);
+}
+
+template <VectorType A>
+auto normalize(const A& a)
+{
+    if constexpr (SimdFloatVector<A>) {
+        return simd::Normalize(a);
+    } else {
+        return a * (1.f / length(a));
+    }
+}
+
+template <VectorType A, VectorType B>
+float3 cross(const A& a, const B& b)
+{
+    if constexpr (SimdOperands<A, B>) {
+        return simd::CrossProduct(a, b);
+    }
+    const float3 u = a;
+    const float3 v = b;
+    return float3(u.y * v.z - u.z * v.y,
+                  u.z * v.x - u.x * v.z,
+                  u.x * v.y - u.y * v.x);
+}
+
+// ============================ Bit Casts ====================
+
+inline uint  asuint(float x) { return std::bit_cast<uint>(x); }
+inline uint  asuint(double x) { return asuint(float(x)); }
+inline uint  asuint(int x) { return uint(x); }
+inline uint  asuint(uint x) { return x; }
+inline int   asint(float x) { return std::bit_cast<int>(x); }
+inline int   asint(uint x) { return int(x); }
+inline float asfloat(uint x) { return std::bit_cast<float>(x); }
+inline float asfloat(int x) { return std::bit_cast<float>(x); }
+inline float asfloat(float x) { return x; }
+
+// f32tof16 returns the half in the low 16 bits and rounds to nearest even
+inline uint f32tof16(float x)
+{
+    const uint bits     = asuint(x);
+    const uint sign     = (bits >> 16) & 0x8000u;
+    const int  exponent = int((bits >> 23) & 0xFFu) - 127 + 15;
+    uint       mantissa = bits & 0x7FFFFFu;
+
+    if (((bits >> 23) & 0xFFu) == 0xFFu) {
+        return sign | 0x7C00u | (mantissa != 0 ? 0x200u : 0u);
+    }
+    if (exponent >= 31) {
+        return sign | 0x7C00u;
+    }
+
+    // Subnormal halves shift the implicit one into the mantissa
+    uint shift = 13;
+    uint half  = uint(std::max(exponent, 0)) << 10;
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000u;
+        shift = uint(14 - exponent);
+    }
+
+    half |= mantissa >> shift;
+    const uint remainder = mantissa & ((1u << shift) - 1);
+    const uint halfway   = 1u << (shift - 1);
+    // A carry out of the mantissa correctly increments the exponent
+    if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+        ++half;
+    }
+    return sign | half;
+}
+
+inline float f16tof32(uint x)
+{
+    const uint sign     = (x & 0x8000u) << 16;
+    const uint exponent = (x >> 10) & 0x1Fu;
+    const uint mantissa = x & 0x3FFu;
+
+    if (exponent == 0) {
+        const float magnitude = std::ldexp(float(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+    if (exponent == 31) {
+        return asfloat(sign | 0x7F800000u | (mantissa << 13));
+    }
+    return asfloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+inline uint countbits(uint x) { return uint(std::popcount(x)); }
+inline uint reversebits(uint x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+inline uint firstbitlow(uint x) { return x == 0 ? ~0u : uint(std::countr_zero(x)); }
+inline uint firstbithigh(uint x) { return x == 0 ? ~0u : uint(31 - std::countl_zero(x)); }
+
+// ============================ Matrices ====================
+
+// Row-major like HLSL: floatRxC holds R rows of C components.
+template <typename T, int R, int C>
+struct mat {
+    vec<T, C> rows[R];
+
+    mat() = default;
+
+    template <Numeric... Args>
+        requires(sizeof...(Args) == R * C && (ScalarType<Args> && ...))
+    mat(const Args&... args)
+    {
+        const T values[] = { T(args)... };
+        for (int r = 0; r < R; ++r) {
+            for (int c = 0; c < C; ++c) {
+                rows[r].data[c] = values[r * C + c];
+            }
+        }
+    }
+
+    template <VectorType... Args>
+        requires(sizeof...(Args) == R && ((SizeOf<Args> == C) && ...))
+    mat(const Args&... args) : rows{ vec<T, C>(args)... }
+    {
+    }
+
+    vec<T, C>&       operator[](int r) { return rows[r]; }
+    const vec<T, C>& operator[](int r) const { return rows[r]; }
+};
+
+typedef mat<float, 2, 2> float2x2;
+typedef mat<float, 3, 2> float3x2;
+typedef mat<float, 3, 3> float3x3;
+typedef mat<float, 3, 4> float3x4;
+typedef mat<float, 4, 2> float4x2;
+typedef mat<float, 4, 3> float4x3;
+typedef mat<float, 4, 4> float4x4;
+
+template <typename T, int R, int C, VectorType V>
+    requires(SizeOf<V> == C)
+vec<float, R> mul(const mat<T, R, C>& m, const V& v)
+{
+    if constexpr (std::is_same_v<T, float> && SimdRowSize<C> && SimdFloatVector<V>) {
+        return simd::MatrixVector(m, v);
+    }
+    vec<float, R> result;
+    for (int r = 0; r < R; ++r) {
+        result.data[r] = dot(m.rows[r], v);
+    }
+    return result;
+}
+
+template <typename T, int R, int C, VectorType V>
+    requires(SizeOf<V> == R)
+vec<float, C> mul(const V& v, const mat<T, R, C>& m)
+{
+    if constexpr (std::is_same_v<T, float> && SimdRowSize<C> && SimdFloatVector<V>) {
+        return simd::VectorMatrix(v, m);
+    }
+    const vec<float, R> row = v;
+    vec<float, C> result    = 0.f;
+    for (int r = 0; r < R; ++r) {
+        for (int c = 0; c < C; ++c) {
+            result.data[c] += row.data[r] * float(m.rows[r].data[c]);
+        }
+    }
+    return result;
+}
+
+template <typename T, int R, int K, int C>
+mat<float, R, C> mul(const mat<T, R, K>& a, const mat<T, K, C>& b)
+{
+    if constexpr (std::is_same_v<T, float> && SimdRowSize<K> && SimdRowSize<C>) {
+        return simd::MatrixMatrix(a, b);
+    }
+    mat<float, R, C> result;
+    for (int r = 0; r < R; ++r) {
+        result.rows[r] = mul(a.rows[r], b);
+    }
+    return result;
+}
+
+template <typename T, int R, int C>
+mat<T, C, R> transpose(const mat<T, R, C>& m)
+{
+    mat<T, C, R> result;
+    for (int r = 0; r < R; ++r) {
+        for (int c = 0; c < C; ++c) {
+            result.rows[c].data[r] = m.rows[r].data[c];
+        }
+    }
+    return result;
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+// ============================ SIMD Backend ====================
+// SSE4.1 (and optional AVX/FMA) implementations for float3/float4 arithmetic, dot products,
+// normalize, cross and matrix products. Included by Hlsl.h after the vector types; the generic
+// templates dispatch here when all operands are float vectors (or scalars) of 3 or 4 components.
+// Vectors keep their packed HLSL layout (float3 = 12 bytes), so records match the shader side;
+// values are loaded into registers per operation.
+//
+// HLSL_SIMD defaults to 1 when the compiler targets SSE4.1; define it to 0 for the scalar path.
+
+#ifndef HLSL_SIMD
+#if defined(__SSE4_1__)
+#define HLSL_SIMD 1
+#else
+#define HLSL_SIMD 0
+#endif
+#endif
+
+#if HLSL_SIMD
+#include <immintrin.h>
+#endif
+
+// Float vector with a SIMD path (vec or swizzle)
+template <typename T>
+concept SimdFloatVector = bool(HLSL_SIMD) && VectorType<T> && std::is_same_v<ScalarOf<T>, float> && (SizeOf<T> == 3 || SizeOf<T> == 4);
+
+// Operands of a component-wise operation with a SIMD path
+template <typename A, typename B>
+concept SimdOperands = (SimdFloatVector<A> && SimdFloatVector<B> && SizeOf<A> == SizeOf<B>) ||
+                       (SimdFloatVector<A> && ScalarType<B>) ||
+                       (ScalarType<A> && SimdFloatVector<B>);
+
+namespace simd {
+
+    enum class Op { Add, Sub, Mul, Div };
+
+    // Entry points used by Hlsl.h; only defined (and only instantiated) when HLSL_SIMD is enabled.
+    template <Op op, typename A, typename B>
+    auto Binary(const A& a, const B& b);
+
+    template <typename A, typename B>
+    float DotProduct(const A& a, const B& b);
+
+    template <typename A>
+    auto Normalize(const A& a);
+
+    template <typename A, typename B>
+    vec<float, 3> CrossProduct(const A& a, const B& b);
+
+    template <typename A, typename B, typename C>
+    auto Lerp(const A& a, const B& b, const C& t);
+
+    template <int R, int C, typename V>
+    vec<float, R> MatrixVector(const mat<float, R, C>& m, const V& v);
+
+    template <int R, int C, typename V>
+    vec<float, C> VectorMatrix(const V& v, const mat<float, R, C>& m);
+
+    template <int R, int K, int C>
+    mat<float, R, C> MatrixMatrix(const mat<float, R, K>& a, const mat<float, K, C>& b);
+
+} // namespace simd
+
+// Matrix with SIMD rows
+template <int C>
+concept SimdRowSize = bool(HLSL_SIMD) && (C == 3 || C == 4);
+
+#if HLSL_SIMD
+
+namespace simd {
+
+    inline __m128 Load(const vec<float, 4>& v)
+    {
+        return _mm_loadu_ps(v.data);
+    }
+
+    inline __m128 Load(const vec<float, 3>& v)
+    {
+        const __m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(v.data)));
+        const __m128 z  = _mm_load_ss(v.data + 2);
+        return _mm_movelh_ps(xy, z);
+    }
+
+    template <int N, int... I>
+    __m128 Load(const Swizzle<float, N, I...>& v)
+    {
+        const float c[] = { v.data[I]... };
+        if constexpr (sizeof...(I) == 4) {
+            return _mm_setr_ps(c[0], c[1], c[2], c[3]);
+        } else {
+            return _mm_setr_ps(c[0], c[1], c[2], 0.f);
+        }
+    }
+
+    template <ScalarType S>
+    __m128 Load(const S& s)
+    {
+        return _mm_set1_ps(float(s));
+    }
+
+    template <int N>
+    vec<float, N> Store(__m128 m)
+    {
+        vec<float, N> result;
+        if constexpr (N == 4) {
+            _mm_storeu_ps(result.data, m);
+        } else {
+            _mm_store_sd(reinterpret_cast<double*>(result.data), _mm_castps_pd(m));
+            _mm_store_ss(result.data + 2, _mm_movehl_ps(m, m));
+        }
+        return result;
+    }
+
+    // dpps mask: multiply the first N components, broadcast the sum to all lanes
+    template <int N>
+    inline constexpr int DotMask = (N == 4) ? 0xFF : 0x7F;
+
+    template <int N>
+    __m128 Dot(__m128 a, __m128 b)
+    {
+        return _mm_dp_ps(a, b, DotMask<N>);
+    }
+
+    inline __m128 MulAdd(__m128 a, __m128 b, __m128 c)
+    {
+#if defined(__FMA__)
+        return _mm_fmadd_ps(a, b, c);
+#else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+    }
+
+    inline __m128 Cross(__m128 a, __m128 b)
+    {
+        const __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        const __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        const __m128 c    = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+        return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+
+    // Sum of v[r] * rows[r], i.e. the row-vector product v * M
+    template <int R, int C>
+    __m128 RowCombination(__m128 v, const mat<float, R, C>& m)
+    {
+        alignas(16) float c[4];
+        _mm_store_ps(c, v);
+
+        __m128 result = _mm_mul_ps(_mm_set1_ps(c[0]), Load(m.rows[0]));
+        for (int r = 1; r < R; ++r) {
+            result = MulAdd(_mm_set1_ps(c[r]), Load(m.rows[r]), result);
+        }
+        return result;
+    }
+
+    // ============================ Entry Points ====================
+
+    template <Op op, typename A, typename B>
+    auto Binary(const A& a, const B& b)
+    {
+        const __m128 x = Load(a);
+        const __m128 y = Load(b);
+
+        __m128 result;
+        if constexpr (op == Op::Add) {
+            result = _mm_add_ps(x, y);
+        } else if constexpr (op == Op::Sub) {
+            result = _mm_sub_ps(x, y);
+        } else if constexpr (op == Op::Mul) {
+            result = _mm_mul_ps(x, y);
+        } else {
+            result = _mm_div_ps(x, y);
+        }
+        return Store<ComponentCount<A, B>>(result);
+    }
+
+    template <typename A, typename B>
+    float DotProduct(const A& a, const B& b)
+    {
+        return _mm_cvtss_f32(Dot<SizeOf<A>>(Load(a), Load(b)));
+    }
+
+    template <typename A>
+    auto Normalize(const A& a)
+    {
+        const __m128 v = Load(a);
+        return Store<SizeOf<A>>(_mm_div_ps(v, _mm_sqrt_ps(Dot<SizeOf<A>>(v, v))));
+    }
+
+    template <typename A, typename B>
+    vec<float, 3> CrossProduct(const A& a, const B& b)
+    {
+        return Store<3>(Cross(Load(a), Load(b)));
+    }
+
+    template <typename A, typename B, typename C>
+    auto Lerp(const A& a, const B& b, const C& t)
+    {
+        const __m128 x = Load(a);
+        return Store<ComponentCount<A, B, C>>(MulAdd(Load(t), _mm_sub_ps(Load(b), x), x));
+    }
+
+    template <int R, int C, typename V>
+    vec<float, R> MatrixVector(const mat<float, R, C>& m, const V& v)
+    {
+        const __m128 x = Load(v);
+
+        alignas(16) float result[4];
+        for (int r = 0; r < R; ++r) {
+            result[r] = _mm_cvtss_f32(Dot<C>(Load(m.rows[r]), x));
+        }
+
+        vec<float, R> out;
+        std::memcpy(out.data, result, sizeof(out.data));
+        return out;
+    }
+
+    template <int R, int C, typename V>
+    vec<float, C> VectorMatrix(const V& v, const mat<float, R, C>& m)
+    {
+        return Store<C>(RowCombination(Load(v), m));
+    }
+
+    template <int R, int K, int C>
+    mat<float, R, C> MatrixMatrix(const mat<float, R, K>& a, const mat<float, K, C>& b)
+    {
+        mat<float, R, C> result;
+#if defined(__AVX__)
+        if constexpr (K == 4 && C == 4) {
+            // Two rows per iteration: low half computes row r, high half row r + 1
+            int r = 0;
+            for (; r + 1 < R; r += 2) {
+                __m256 sum = _mm256_setzero_ps();
+                for (int k = 0; k < K; ++k) {
+                    const __m256 ak = _mm256_setr_m128(_mm_set1_ps(a.rows[r].data[k]), _mm_set1_ps(a.rows[r + 1].data[k]));
+                    const __m256 bk = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.rows[k].data));
+#if defined(__FMA__)
+                    sum = _mm256_fmadd_ps(ak, bk, sum);
+#else
+                    sum = _mm256_add_ps(_mm256_mul_ps(ak, bk), sum);
+#endif
+                }
+                _mm256_storeu_ps(result.rows[r].data, sum);
+            }
+            for (; r < R; ++r) {
+                result.rows[r] = Store<4>(RowCombination(Load(a.rows[r]), b));
+            }
+            return result;
+        }
+#endif
+        for (int r = 0; r < R; ++r) {
+            result.rows[r] = Store<C>(RowCombination(Load(a.rows[r]), b));
+        }
+        return result;
+    }
+
+} // namespace simd
+
+#endif
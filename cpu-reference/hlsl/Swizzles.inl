@@ -0,0 +1,94 @@
+// Generated swizzle members for vec<T, N>, included by Hlsl.h.
+// All two- and three-component swizzles (xyzw and rgba sets), plus the identity four-component ones.
+
+#define HLSL_SWIZZLES_2(T) \
+    Swizzle<T, 2, 0, 0> xx; Swizzle<T, 2, 0, 1> xy; Swizzle<T, 2, 1, 0> yx; \
+    Swizzle<T, 2, 1, 1> yy; Swizzle<T, 2, 0, 0, 0> xxx; Swizzle<T, 2, 0, 0, 1> xxy; \
+    Swizzle<T, 2, 0, 1, 0> xyx; Swizzle<T, 2, 0, 1, 1> xyy; Swizzle<T, 2, 1, 0, 0> yxx; \
+    Swizzle<T, 2, 1, 0, 1> yxy; Swizzle<T, 2, 1, 1, 0> yyx; Swizzle<T, 2, 1, 1, 1> yyy; \
+    Swizzle<T, 2, 0, 0> rr; Swizzle<T, 2, 0, 1> rg; Swizzle<T, 2, 1, 0> gr; \
+    Swizzle<T, 2, 1, 1> gg; Swizzle<T, 2, 0, 0, 0> rrr; Swizzle<T, 2, 0, 0, 1> rrg; \
+    Swizzle<T, 2, 0, 1, 0> rgr; Swizzle<T, 2, 0, 1, 1> rgg; Swizzle<T, 2, 1, 0, 0> grr; \
+    Swizzle<T, 2, 1, 0, 1> grg; Swizzle<T, 2, 1, 1, 0> ggr; Swizzle<T, 2, 1, 1, 1> ggg;
+
+#define HLSL_SWIZZLES_3(T) \
+    Swizzle<T, 3, 0, 0> xx; Swizzle<T, 3, 0, 1> xy; Swizzle<T, 3, 0, 2> xz; \
+    Swizzle<T, 3, 1, 0> yx; Swizzle<T, 3, 1, 1> yy; Swizzle<T, 3, 1, 2> yz; \
+    Swizzle<T, 3, 2, 0> zx; Swizzle<T, 3, 2, 1> zy; Swizzle<T, 3, 2, 2> zz; \
+    Swizzle<T, 3, 0, 0, 0> xxx; Swizzle<T, 3, 0, 0, 1> xxy; Swizzle<T, 3, 0, 0, 2> xxz; \
+    Swizzle<T, 3, 0, 1, 0> xyx; Swizzle<T, 3, 0, 1, 1> xyy; Swizzle<T, 3, 0, 1, 2> xyz; \
+    Swizzle<T, 3, 0, 2, 0> xzx; Swizzle<T, 3, 0, 2, 1> xzy; Swizzle<T, 3, 0, 2, 2> xzz; \
+    Swizzle<T, 3, 1, 0, 0> yxx; Swizzle<T, 3, 1, 0, 1> yxy; Swizzle<T, 3, 1, 0, 2> yxz; \
+    Swizzle<T, 3, 1, 1, 0> yyx; Swizzle<T, 3, 1, 1, 1> yyy; Swizzle<T, 3, 1, 1, 2> yyz; \
+    Swizzle<T, 3, 1, 2, 0> yzx; Swizzle<T, 3, 1, 2, 1> yzy; Swizzle<T, 3, 1, 2, 2> yzz; \
+    Swizzle<T, 3, 2, 0, 0> zxx; Swizzle<T, 3, 2, 0, 1> zxy; Swizzle<T, 3, 2, 0, 2> zxz; \
+    Swizzle<T, 3, 2, 1, 0> zyx; Swizzle<T, 3, 2, 1, 1> zyy; Swizzle<T, 3, 2, 1, 2> zyz; \
+    Swizzle<T, 3, 2, 2, 0> zzx; Swizzle<T, 3, 2, 2, 1> zzy; Swizzle<T, 3, 2, 2, 2> zzz; \
+    Swizzle<T, 3, 0, 0> rr; Swizzle<T, 3, 0, 1> rg; Swizzle<T, 3, 0, 2> rb; \
+    Swizzle<T, 3, 1, 0> gr; Swizzle<T, 3, 1, 1> gg; Swizzle<T, 3, 1, 2> gb; \
+    Swizzle<T, 3, 2, 0> br; Swizzle<T, 3, 2, 1> bg; Swizzle<T, 3, 2, 2> bb; \
+    Swizzle<T, 3, 0, 0, 0> rrr; Swizzle<T, 3, 0, 0, 1> rrg; Swizzle<T, 3, 0, 0, 2> rrb; \
+    Swizzle<T, 3, 0, 1, 0> rgr; Swizzle<T, 3, 0, 1, 1> rgg; Swizzle<T, 3, 0, 1, 2> rgb; \
+    Swizzle<T, 3, 0, 2, 0> rbr; Swizzle<T, 3, 0, 2, 1> rbg; Swizzle<T, 3, 0, 2, 2> rbb; \
+    Swizzle<T, 3, 1, 0, 0> grr; Swizzle<T, 3, 1, 0, 1> grg; Swizzle<T, 3, 1, 0, 2> grb; \
+    Swizzle<T, 3, 1, 1, 0> ggr; Swizzle<T, 3, 1, 1, 1> ggg; Swizzle<T, 3, 1, 1, 2> ggb; \
+    Swizzle<T, 3, 1, 2, 0> gbr; Swizzle<T, 3, 1, 2, 1> gbg; Swizzle<T, 3, 1, 2, 2> gbb; \
+    Swizzle<T, 3, 2, 0, 0> brr; Swizzle<T, 3, 2, 0, 1> brg; Swizzle<T, 3, 2, 0, 2> brb; \
+    Swizzle<T, 3, 2, 1, 0> bgr; Swizzle<T, 3, 2, 1, 1> bgg; Swizzle<T, 3, 2, 1, 2> bgb; \
+    Swizzle<T, 3, 2, 2, 0> bbr; Swizzle<T, 3, 2, 2, 1> bbg; Swizzle<T, 3, 2, 2, 2> bbb;
+
+#define HLSL_SWIZZLES_4(T) \
+    Swizzle<T, 4, 0, 0> xx; Swizzle<T, 4, 0, 1> xy; Swizzle<T, 4, 0, 2> xz; \
+    Swizzle<T, 4, 0, 3> xw; Swizzle<T, 4, 1, 0> yx; Swizzle<T, 4, 1, 1> yy; \
+    Swizzle<T, 4, 1, 2> yz; Swizzle<T, 4, 1, 3> yw; Swizzle<T, 4, 2, 0> zx; \
+    Swizzle<T, 4, 2, 1> zy; Swizzle<T, 4, 2, 2> zz; Swizzle<T, 4, 2, 3> zw; \
+    Swizzle<T, 4, 3, 0> wx; Swizzle<T, 4, 3, 1> wy; Swizzle<T, 4, 3, 2> wz; \
+    Swizzle<T, 4, 3, 3> ww; Swizzle<T, 4, 0, 0, 0> xxx; Swizzle<T, 4, 0, 0, 1> xxy; \
+    Swizzle<T, 4, 0, 0, 2> xxz; Swizzle<T, 4, 0, 0, 3> xxw; Swizzle<T, 4, 0, 1, 0> xyx; \
+    Swizzle<T, 4, 0, 1, 1> xyy; Swizzle<T, 4, 0, 1, 2> xyz; Swizzle<T, 4, 0, 1, 3> xyw; \
+    Swizzle<T, 4, 0, 2, 0> xzx; Swizzle<T, 4, 0, 2, 1> xzy; Swizzle<T, 4, 0, 2, 2> xzz; \
+    Swizzle<T, 4, 0, 2, 3> xzw; Swizzle<T, 4, 0, 3, 0> xwx; Swizzle<T, 4, 0, 3, 1> xwy; \
+    Swizzle<T, 4, 0, 3, 2> xwz; Swizzle<T, 4, 0, 3, 3> xww; Swizzle<T, 4, 1, 0, 0> yxx; \
+    Swizzle<T, 4, 1, 0, 1> yxy; Swizzle<T, 4, 1, 0, 2> yxz; Swizzle<T, 4, 1, 0, 3> yxw; \
+    Swizzle<T, 4, 1, 1, 0> yyx; Swizzle<T, 4, 1, 1, 1> yyy; Swizzle<T, 4, 1, 1, 2> yyz; \
+    Swizzle<T, 4, 1, 1, 3> yyw; Swizzle<T, 4, 1, 2, 0> yzx; Swizzle<T, 4, 1, 2, 1> yzy; \
+    Swizzle<T, 4, 1, 2, 2> yzz; Swizzle<T, 4, 1, 2, 3> yzw; Swizzle<T, 4, 1, 3, 0> ywx; \
+    Swizzle<T, 4, 1, 3, 1> ywy; Swizzle<T, 4, 1, 3, 2> ywz; Swizzle<T, 4, 1, 3, 3> yww; \
+    Swizzle<T, 4, 2, 0, 0> zxx; Swizzle<T, 4, 2, 0, 1> zxy; Swizzle<T, 4, 2, 0, 2> zxz; \
+    Swizzle<T, 4, 2, 0, 3> zxw; Swizzle<T, 4, 2, 1, 0> zyx; Swizzle<T, 4, 2, 1, 1> zyy; \
+    Swizzle<T, 4, 2, 1, 2> zyz; Swizzle<T, 4, 2, 1, 3> zyw; Swizzle<T, 4, 2, 2, 0> zzx; \
+    Swizzle<T, 4, 2, 2, 1> zzy; Swizzle<T, 4, 2, 2, 2> zzz; Swizzle<T, 4, 2, 2, 3> zzw; \
+    Swizzle<T, 4, 2, 3, 0> zwx; Swizzle<T, 4, 2, 3, 1> zwy; Swizzle<T, 4, 2, 3, 2> zwz; \
+    Swizzle<T, 4, 2, 3, 3> zww; Swizzle<T, 4, 3, 0, 0> wxx; Swizzle<T, 4, 3, 0, 1> wxy; \
+    Swizzle<T, 4, 3, 0, 2> wxz; Swizzle<T, 4, 3, 0, 3> wxw; Swizzle<T, 4, 3, 1, 0> wyx; \
+    Swizzle<T, 4, 3, 1, 1> wyy; Swizzle<T, 4, 3, 1, 2> wyz; Swizzle<T, 4, 3, 1, 3> wyw; \
+    Swizzle<T, 4, 3, 2, 0> wzx; Swizzle<T, 4, 3, 2, 1> wzy; Swizzle<T, 4, 3, 2, 2> wzz; \
+    Swizzle<T, 4, 3, 2, 3> wzw; Swizzle<T, 4, 3, 3, 0> wwx; Swizzle<T, 4, 3, 3, 1> wwy; \
+    Swizzle<T, 4, 3, 3, 2> wwz; Swizzle<T, 4, 3, 3, 3> www; Swizzle<T, 4, 0, 1, 2, 3> xyzw; \
+    Swizzle<T, 4, 0, 0> rr; Swizzle<T, 4, 0, 1> rg; Swizzle<T, 4, 0, 2> rb; \
+    Swizzle<T, 4, 0, 3> ra; Swizzle<T, 4, 1, 0> gr; Swizzle<T, 4, 1, 1> gg; \
+    Swizzle<T, 4, 1, 2> gb; Swizzle<T, 4, 1, 3> ga; Swizzle<T, 4, 2, 0> br; \
+    Swizzle<T, 4, 2, 1> bg; Swizzle<T, 4, 2, 2> bb; Swizzle<T, 4, 2, 3> ba; \
+    Swizzle<T, 4, 3, 0> ar; Swizzle<T, 4, 3, 1> ag; Swizzle<T, 4, 3, 2> ab; \
+    Swizzle<T, 4, 3, 3> aa; Swizzle<T, 4, 0, 0, 0> rrr; Swizzle<T, 4, 0, 0, 1> rrg; \
+    Swizzle<T, 4, 0, 0, 2> rrb; Swizzle<T, 4, 0, 0, 3> rra; Swizzle<T, 4, 0, 1, 0> rgr; \
+    Swizzle<T, 4, 0, 1, 1> rgg; Swizzle<T, 4, 0, 1, 2> rgb; Swizzle<T, 4, 0, 1, 3> rga; \
+    Swizzle<T, 4, 0, 2, 0> rbr; Swizzle<T, 4, 0, 2, 1> rbg; Swizzle<T, 4, 0, 2, 2> rbb; \
+    Swizzle<T, 4, 0, 2, 3> rba; Swizzle<T, 4, 0, 3, 0> rar; Swizzle<T, 4, 0, 3, 1> rag; \
+    Swizzle<T, 4, 0, 3, 2> rab; Swizzle<T, 4, 0, 3, 3> raa; Swizzle<T, 4, 1, 0, 0> grr; \
+    Swizzle<T, 4, 1, 0, 1> grg; Swizzle<T, 4, 1, 0, 2> grb; Swizzle<T, 4, 1, 0, 3> gra; \
+    Swizzle<T, 4, 1, 1, 0> ggr; Swizzle<T, 4, 1, 1, 1> ggg; Swizzle<T, 4, 1, 1, 2> ggb; \
+    Swizzle<T, 4, 1, 1, 3> gga; Swizzle<T, 4, 1, 2, 0> gbr; Swizzle<T, 4, 1, 2, 1> gbg; \
+    Swizzle<T, 4, 1, 2, 2> gbb; Swizzle<T, 4, 1, 2, 3> gba; Swizzle<T, 4, 1, 3, 0> gar; \
+    Swizzle<T, 4, 1, 3, 1> gag; Swizzle<T, 4, 1, 3, 2> gab; Swizzle<T, 4, 1, 3, 3> gaa; \
+    Swizzle<T, 4, 2, 0, 0> brr; Swizzle<T, 4, 2, 0, 1> brg; Swizzle<T, 4, 2, 0, 2> brb; \
+    Swizzle<T, 4, 2, 0, 3> bra; Swizzle<T, 4, 2, 1, 0> bgr; Swizzle<T, 4, 2, 1, 1> bgg; \
+    Swizzle<T, 4, 2, 1, 2> bgb; Swizzle<T, 4, 2, 1, 3> bga; Swizzle<T, 4, 2, 2, 0> bbr; \
+    Swizzle<T, 4, 2, 2, 1> bbg; Swizzle<T, 4, 2, 2, 2> bbb; Swizzle<T, 4, 2, 2, 3> bba; \
+    Swizzle<T, 4, 2, 3, 0> bar; Swizzle<T, 4, 2, 3, 1> bag; Swizzle<T, 4, 2, 3, 2> bab; \
+    Swizzle<T, 4, 2, 3, 3> baa; Swizzle<T, 4, 3, 0, 0> arr; Swizzle<T, 4, 3, 0, 1> arg; \
+    Swizzle<T, 4, 3, 0, 2> arb; Swizzle<T, 4, 3, 0, 3> ara; Swizzle<T, 4, 3, 1, 0> agr; \
+    Swizzle<T, 4, 3, 1, 1> agg; Swizzle<T, 4, 3, 1, 2> agb; Swizzle<T, 4, 3, 1, 3> aga; \
+    Swizzle<T, 4, 3, 2, 0> abr; Swizzle<T, 4, 3, 2, 1> abg; Swizzle<T, 4, 3, 2, 2> abb; \
+    Swizzle<T, 4, 3, 2, 3> aba; Swizzle<T, 4, 3, 3, 0> aar; Swizzle<T, 4, 3, 3, 1> aag; \
+    Swizzle<T, 4, 3, 3, 2> aab; Swizzle<T, 4, 3, 3, 3> aaa; Swizzle<T, 4, 0, 1, 2, 3> rgba;
@@ -0,0 +1,236 @@
+#include "Wave.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif !(defined(__x86_64__) && defined(__ELF__))
+#include <ucontext.h>
+#endif
+
+// ============================ Fibers ====================
+// Every lane of a Wave is a fiber that runs RunLanes, which loops over the runs of the wave. On x86-64 (System V),
+// fibers switch stacks with WaveSwitchStack, on Windows they are Windows fibers, elsewhere ucontext contexts.
+
+namespace {
+
+    // Stack size of a lane; stacks are only committed as far as they are used
+    constexpr size_t fiberStackSize = 256 * 1024;
+
+} // namespace
+
+#if defined(_WIN32)
+
+struct Wave::Fiber {
+    LPVOID handle   = nullptr;
+    bool   isThread = false;
+
+    ~Fiber()
+    {
+        if ((handle != nullptr) && !isThread) {
+            DeleteFiber(handle);
+        }
+    }
+
+    static VOID CALLBACK Entry(LPVOID)
+    {
+        RunLanes();
+    }
+
+    static std::unique_ptr<Fiber> CreateLane()
+    {
+        auto fiber    = std::make_unique<Fiber>();
+        fiber->handle = CreateFiber(fiberStackSize, &Entry, nullptr);
+        if (fiber->handle == nullptr) {
+            std::abort();
+        }
+        return fiber;
+    }
+
+    // Makes the calling thread the fiber that a wave returns to
+    void EnterFromThread()
+    {
+        isThread = true;
+        handle   = IsThreadAFiber() ? GetCurrentFiber() : ConvertThreadToFiber(nullptr);
+    }
+
+    static void Switch(Fiber&, Fiber& to)
+    {
+        SwitchToFiber(to.handle);
+    }
+};
+
+#elif defined(__x86_64__) && defined(__ELF__)
+
+// Saves the callee-saved registers on the current stack and its stack pointer to *stackPointer, then restores the
+// registers from nextStackPointer and returns on that stack.
+extern "C" void WaveSwitchStack(void** stackPointer, void* nextStackPointer);
+
+asm(R"(
+    .text
+    .p2align 4
+    .globl WaveSwitchStack
+    .hidden WaveSwitchStack
+    .type WaveSwitchStack, @function
+WaveSwitchStack:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    movq  %rsp, (%rdi)
+    movq  %rsi, %rsp
+    popq  %r15
+    popq  %r14
+    popq  %r13
+    popq  %r12
+    popq  %rbx
+    popq  %rbp
+    ret
+    .size WaveSwitchStack, .-WaveSwitchStack
+)");
+
+struct Wave::Fiber {
+    std::unique_ptr<char[]> stack;
+    void*                   stackPointer = nullptr;
+
+    static void Entry()
+    {
+        RunLanes();
+        std::abort();
+    }
+
+    static std::unique_ptr<Fiber> CreateLane()
+    {
+        auto fiber   = std::make_unique<Fiber>();
+        fiber->stack = std::unique_ptr<char[]>(new char[fiberStackSize]);
+
+        // Registers of WaveSwitchStack, which returns to Entry as if Entry had been called
+        const uintptr_t top   = (reinterpret_cast<uintptr_t>(fiber->stack.get()) + fiberStackSize) & ~uintptr_t(15);
+        void**          frame = reinterpret_cast<void**>(top) - 8;
+
+        std::fill(frame, frame + 8, nullptr);
+        frame[6] = reinterpret_cast<void*>(&Entry);
+
+        fiber->stackPointer = frame;
+        return fiber;
+    }
+
+    void EnterFromThread() {}
+
+    static void Switch(Fiber& from, Fiber& to)
+    {
+        WaveSwitchStack(&from.stackPointer, to.stackPointer);
+    }
+};
+
+#else
+
+struct Wave::Fiber {
+    std::unique_ptr<char[]> stack;
+    ucontext_t              context = {};
+
+    static void Entry()
+    {
+        RunLanes();
+        std::abort();
+    }
+
+    static std::unique_ptr<Fiber> CreateLane()
+    {
+        auto fiber   = std::make_unique<Fiber>();
+        fiber->stack = std::unique_ptr<char[]>(new char[fiberStackSize]);
+
+        getcontext(&fiber->context);
+        fiber->context.uc_stack.ss_sp   = fiber->stack.get();
+        fiber->context.uc_stack.ss_size = fiberStackSize;
+        fiber->context.uc_link          = nullptr;
+        makecontext(&fiber->context, &Entry, 0);
+        return fiber;
+    }
+
+    void EnterFromThread() {}
+
+    static void Switch(Fiber& from, Fiber& to)
+    {
+        swapcontext(&from.context, &to.context);
+    }
+};
+
+#endif
+
+// ============================ Wave ====================
+
+Wave::Wave(uint32_t laneCount)
+    : laneCount_(laneCount), caller_(std::make_unique<Fiber>()), exchangeCounts_(laneCount), isFinished_(laneCount)
+{
+    for (std::vector<Slot>& slots : slots_) {
+        slots.resize(laneCount);
+    }
+    for (uint32_t lane = 0; lane < laneCount; ++lane) {
+        fibers_.push_back(Fiber::CreateLane());
+    }
+}
+
+// Lanes are suspended between runs and own no resources, so their fibers are released as they are
+Wave::~Wave() = default;
+
+void Wave::Run(const std::function<void(uint32_t)>& function)
+{
+    Wave* const previousWave = currentWave;
+    currentWave              = this;
+
+    function_      = &function;
+    currentLane_   = 0;
+    finishedLanes_ = 0;
+    std::fill(exchangeCounts_.begin(), exchangeCounts_.end(), 0u);
+    std::fill(isFinished_.begin(), isFinished_.end(), false);
+
+    caller_->EnterFromThread();
+    Fiber::Switch(*caller_, *fibers_[0]);
+
+    currentWave = previousWave;
+}
+
+void Wave::Sync()
+{
+    uint32_t lane = currentLane_;
+    do {
+        lane = (lane + 1) % laneCount_;
+    } while (isFinished_[lane] && (lane != currentLane_));
+
+    if (lane != currentLane_) {
+        SwitchTo(lane);
+    }
+}
+
+void Wave::SwitchTo(uint32_t lane)
+{
+    Fiber& from  = *fibers_[currentLane_];
+    currentLane_ = lane;
+    Fiber::Switch(from, *fibers_[lane]);
+}
+
+void Wave::RunLanes()
+{
+    // A fiber belongs to the wave that created it
+    Wave& wave = *currentWave;
+
+    while (true) {
+        const uint32_t lane = wave.currentLane_;
+        (*wave.function_)(lane);
+
+        wave.isFinished_[lane] = true;
+        if (++wave.finishedLanes_ == wave.laneCount_) {
+            Fiber::Switch(*wave.fibers_[lane], *wave.caller_);
+        } else {
+            // Lanes still waiting in a wave operation continue without this lane
+            wave.Sync();
+        }
+    }
+}
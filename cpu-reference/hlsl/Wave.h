@@ -0,0 +1,194 @@
+#pragma once
+
+// ============================ Host Waves ====================
+// Wave intrinsics for shader functions that are compiled on the host as written, e.g. GenerateStem in
+// TreeGeneration.h. The lanes of a wave are fibers on the thread that runs the wave: a lane runs until its next
+// wave operation, stores its value and switches to the next lane; when the last lane has stored its value, every
+// lane reduces the stored values in turn. Hence
+//   - wave operations have to be reached by all lanes, i.e. in wave-uniform control flow,
+//   - WaveIsFirstLane and WaveReadLaneFirst refer to lane 0,
+//   - a thread group is a single wave.
+// groupshared variables are thread_local; the lanes of a group share them, as they run on the same thread.
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#define groupshared static thread_local
+
+class Wave {
+public:
+    explicit Wave(uint32_t laneCount);
+    ~Wave();
+
+    Wave(const Wave&)            = delete;
+    Wave& operator=(const Wave&) = delete;
+
+    // Runs function(lane) on all lanes and returns when every lane has returned.
+    void Run(const std::function<void(uint32_t)>& function);
+
+    uint32_t GetLaneCount() const { return laneCount_; }
+
+    // Wave and lane of the calling fiber; only valid on the lanes of a wave.
+    static Wave&    GetCurrent() { return *currentWave; }
+    static uint32_t GetLaneIndex() { return currentWave->currentLane_; }
+
+    // Every lane passes its value and gets reduce(valueOfLane), where valueOfLane(lane) returns the value of a lane.
+    template <typename T, typename Reduce>
+    auto Exchange(const T& value, Reduce&& reduce)
+    {
+        static_assert(std::is_trivially_destructible_v<T> && (sizeof(T) <= sizeof(Slot)), "unsupported wave value");
+
+        // Lanes run in turn, so they are at most one wave operation apart: consecutive operations alternate
+        // between two sets of slots.
+        const uint32_t lane  = currentLane_;
+        Slot*          slots = slots_[exchangeCounts_[lane]++ & 1].data();
+
+        std::memcpy(slots[lane].data(), static_cast<const void*>(&value), sizeof(T));
+        Sync();
+
+        return reduce([slots](uint32_t valueLane) {
+            T laneValue;
+            std::memcpy(static_cast<void*>(&laneValue), slots[valueLane].data(), sizeof(T));
+            return laneValue;
+        });
+    }
+
+    // Switches to the next lane; returns when all other lanes have reached their next Sync.
+    void Sync();
+
+private:
+    using Slot = std::array<unsigned char, 64>;
+
+    // Fiber of one lane, defined in Wave.cpp
+    struct Fiber;
+
+    static void RunLanes();
+
+    void SwitchTo(uint32_t lane);
+
+    static inline thread_local Wave* currentWave = nullptr;
+
+    uint32_t                            laneCount_;
+    std::vector<std::unique_ptr<Fiber>> fibers_;
+    std::unique_ptr<Fiber>              caller_;
+    std::array<std::vector<Slot>, 2>    slots_;
+    std::vector<uint32_t>               exchangeCounts_;
+    std::vector<bool>                   isFinished_;
+
+    const std::function<void(uint32_t)>* function_      = nullptr;
+    uint32_t                             currentLane_   = 0;
+    uint32_t                             finishedLanes_ = 0;
+};
+
+// ============================ Wave Intrinsics ====================
+
+inline uint32_t WaveGetLaneIndex()
+{
+    return Wave::GetLaneIndex();
+}
+
+inline uint32_t WaveGetLaneCount()
+{
+    return Wave::GetCurrent().GetLaneCount();
+}
+
+inline bool WaveIsFirstLane()
+{
+    return WaveGetLaneIndex() == 0;
+}
+
+inline void GroupMemoryBarrierWithGroupSync()
+{
+    Wave::GetCurrent().Sync();
+}
+
+// Barrier flags of HLSL; device memory is only visible to other groups once their records are submitted, which
+// happens after the group, so only GROUP_SYNC has an effect.
+static const uint32_t UAV_MEMORY          = 0x1;
+static const uint32_t GROUP_SHARED_MEMORY = 0x2;
+static const uint32_t GROUP_SYNC          = 0x1;
+static const uint32_t GROUP_SCOPE         = 0x2;
+static const uint32_t DEVICE_SCOPE        = 0x4;
+
+inline void Barrier(uint32_t, uint32_t semantics)
+{
+    if (semantics & GROUP_SYNC) {
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+// Atomics on groupshared variables; lanes only switch at wave operations, so plain operations are atomic.
+template <typename T, typename U>
+void InterlockedAdd(T& destination, U value, T& originalValue)
+{
+    originalValue = destination;
+    destination += T(value);
+}
+
+template <typename T, typename U>
+void InterlockedAdd(T& destination, U value)
+{
+    destination += T(value);
+}
+
+template <typename T>
+T WaveReadLaneAt(const T& value, uint32_t lane)
+{
+    return Wave::GetCurrent().Exchange(value, [=](auto valueOfLane) { return valueOfLane(lane); });
+}
+
+template <typename T>
+T WaveReadLaneFirst(const T& value)
+{
+    return WaveReadLaneAt(value, 0);
+}
+
+template <typename T>
+T WaveActiveSum(const T& value)
+{
+    return Wave::GetCurrent().Exchange(value, [](auto valueOfLane) {
+        T sum = T(0);
+        for (uint32_t lane = 0; lane < WaveGetLaneCount(); ++lane) {
+            sum += valueOfLane(lane);
+        }
+        return sum;
+    });
+}
+
+// Exclusive prefix sum, accumulated in lane order
+template <typename T>
+T WavePrefixSum(const T& value)
+{
+    return Wave::GetCurrent().Exchange(value, [](auto valueOfLane) {
+        T sum = T(0);
+        for (uint32_t lane = 0; lane < WaveGetLaneIndex(); ++lane) {
+            sum += valueOfLane(lane);
+        }
+        return sum;
+    });
+}
+
+inline uint32_t WaveActiveCountBits(bool value)
+{
+    return WaveActiveSum(uint32_t(value));
+}
+
+inline uint32_t WavePrefixCountBits(bool value)
+{
+    return WavePrefixSum(uint32_t(value));
+}
+
+inline bool WaveActiveAllTrue(bool value)
+{
+    return WaveActiveCountBits(value) == WaveGetLaneCount();
+}
+
+inline bool WaveActiveAnyTrue(bool value)
+{
+    return WaveActiveCountBits(value) != 0;
+}
@@ -0,0 +1,425 @@
+#include "QuaternionCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+
+#include "Hlsl.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Shader headers last: Quaternion.h defines macros with common names (X, Y, Z, ...).
+// TreeGraph.cpp compiles the same functions, this translation unit keeps its copy internal.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+namespace {
+#include "Quaternion.h"
+} // namespace
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+    float4 LoadQuaternion(const float* q)
+    {
+        return float4(q[0], q[1], q[2], q[3]);
+    }
+
+    void StoreQuaternion(float* q, const float4& value)
+    {
+        std::memcpy(q, value.data, sizeof(value.data));
+    }
+
+#if defined(__AVX2__)
+
+    // ============================ AVX2 ====================
+    // Eight quaternions per iteration in structure-of-arrays registers. Every step repeats the
+    // float operations of Quaternion.h in the same order, so the results match the scalar functions.
+
+    // Fields of qCompress32
+    constexpr int BitsX32 = 10;
+    constexpr int BitsY32 = 11;
+    constexpr int BitsZ32 = 10;
+    // Fields of qCompress64
+    constexpr int Bits64  = 21;
+
+    inline __m256 Abs(__m256 v)
+    {
+        return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v);
+    }
+
+    // q0..q7 to x, y, z, w: the low 128-bit lanes hold q0..q3, the high lanes q4..q7
+    inline void LoadQuaternions(const float* q, __m256& x, __m256& y, __m256& z, __m256& w)
+    {
+        const __m256 r0 = _mm256_setr_m128(_mm_loadu_ps(q + 0), _mm_loadu_ps(q + 16));
+        const __m256 r1 = _mm256_setr_m128(_mm_loadu_ps(q + 4), _mm_loadu_ps(q + 20));
+        const __m256 r2 = _mm256_setr_m128(_mm_loadu_ps(q + 8), _mm_loadu_ps(q + 24));
+        const __m256 r3 = _mm256_setr_m128(_mm_loadu_ps(q + 12), _mm_loadu_ps(q + 28));
+
+        const __m256d xy01 = _mm256_castps_pd(_mm256_unpacklo_ps(r0, r1));
+        const __m256d xy23 = _mm256_castps_pd(_mm256_unpacklo_ps(r2, r3));
+        const __m256d zw01 = _mm256_castps_pd(_mm256_unpackhi_ps(r0, r1));
+        const __m256d zw23 = _mm256_castps_pd(_mm256_unpackhi_ps(r2, r3));
+
+        x = _mm256_castpd_ps(_mm256_unpacklo_pd(xy01, xy23));
+        y = _mm256_castpd_ps(_mm256_unpackhi_pd(xy01, xy23));
+        z = _mm256_castpd_ps(_mm256_unpacklo_pd(zw01, zw23));
+        w = _mm256_castpd_ps(_mm256_unpackhi_pd(zw01, zw23));
+    }
+
+    // normalize(q) as the SSE backend of Hlsl.h computes it, with dpps on each 128-bit lane
+    inline __m256 Normalize(__m256 q)
+    {
+        return _mm256_div_ps(q, _mm256_sqrt_ps(_mm256_dp_ps(q, q, 0xFF)));
+    }
+
+    // Inverse of LoadQuaternions; normalizes the quaternions
+    inline void StoreNormalizedQuaternions(float* q, __m256 x, __m256 y, __m256 z, __m256 w)
+    {
+        const __m256d xy01 = _mm256_castps_pd(_mm256_unpacklo_ps(x, y));
+        const __m256d xy23 = _mm256_castps_pd(_mm256_unpackhi_ps(x, y));
+        const __m256d zw01 = _mm256_castps_pd(_mm256_unpacklo_ps(z, w));
+        const __m256d zw23 = _mm256_castps_pd(_mm256_unpackhi_ps(z, w));
+
+        const __m256 r0 = Normalize(_mm256_castpd_ps(_mm256_unpacklo_pd(xy01, zw01)));
+        const __m256 r1 = Normalize(_mm256_castpd_ps(_mm256_unpackhi_pd(xy01, zw01)));
+        const __m256 r2 = Normalize(_mm256_castpd_ps(_mm256_unpacklo_pd(xy23, zw23)));
+        const __m256 r3 = Normalize(_mm256_castpd_ps(_mm256_unpackhi_pd(xy23, zw23)));
+
+        _mm_storeu_ps(q + 0, _mm256_castps256_ps128(r0));
+        _mm_storeu_ps(q + 4, _mm256_castps256_ps128(r1));
+        _mm_storeu_ps(q + 8, _mm256_castps256_ps128(r2));
+        _mm_storeu_ps(q + 12, _mm256_castps256_ps128(r3));
+        _mm_storeu_ps(q + 16, _mm256_extractf128_ps(r0, 1));
+        _mm_storeu_ps(q + 20, _mm256_extractf128_ps(r1, 1));
+        _mm_storeu_ps(q + 24, _mm256_extractf128_ps(r2, 1));
+        _mm_storeu_ps(q + 28, _mm256_extractf128_ps(r3, 1));
+    }
+
+    // abs(q.w) + abs(q.x) + abs(q.y) + abs(q.z)
+    inline __m256 L1Norm(__m256 x, __m256 y, __m256 z, __m256 w)
+    {
+        return _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(Abs(w), Abs(x)), Abs(y)), Abs(z));
+    }
+
+    // 1 - abs(q.x) - abs(q.y) - abs(q.z)
+    inline __m256 ReconstructW(__m256 x, __m256 y, __m256 z)
+    {
+        return _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.f), Abs(x)), Abs(y)), Abs(z));
+    }
+
+    // int(v * scale) & mask
+    inline __m256i Quantize(__m256 v, float scale, int mask)
+    {
+        return _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(scale))), _mm256_set1_epi32(mask));
+    }
+
+    // Sign-extends the field of the given width in bit offset of every 32-bit lane
+    template <int Offset, int Width>
+    inline __m256i ExtractSigned(__m256i v)
+    {
+        return _mm256_srai_epi32(_mm256_slli_epi32(v, 32 - Offset - Width), 32 - Width);
+    }
+
+    // Low 32 bits of the 64-bit lanes of a (q0..q3) and b (q4..q7)
+    inline __m256i Truncate64(__m256i a, __m256i b)
+    {
+        const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        const __m256i lo   = _mm256_permutevar8x32_epi32(a, even);
+        const __m256i hi   = _mm256_permutevar8x32_epi32(b, even);
+        return _mm256_permute2x128_si256(lo, hi, 0x20);
+    }
+
+    size_t Compress32(const float* quaternions, uint32_t* encoded, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 x, y, z, w;
+            LoadQuaternions(quaternions + i * 4, x, y, z, w);
+
+            const __m256 norm = L1Norm(x, y, z, w);
+            x = _mm256_div_ps(x, norm);
+            y = _mm256_div_ps(y, norm);
+            z = _mm256_div_ps(z, norm);
+
+            const __m256i qx = Quantize(x, float((1 << (BitsX32 - 1)) - 1), (1 << BitsX32) - 1);
+            const __m256i qy = Quantize(y, float((1 << (BitsY32 - 1)) - 1), (1 << BitsY32) - 1);
+            const __m256i qz = Quantize(z, float((1 << (BitsZ32 - 1)) - 1), (1 << BitsZ32) - 1);
+            const __m256i sign = _mm256_and_si256(_mm256_castps_si256(w), _mm256_set1_epi32(int(0x80000000u)));
+
+            __m256i result = _mm256_or_si256(qx, _mm256_slli_epi32(qy, BitsX32));
+            result = _mm256_or_si256(result, _mm256_slli_epi32(qz, BitsX32 + BitsY32));
+            result = _mm256_or_si256(result, sign);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(encoded + i), result);
+        }
+        return i;
+    }
+
+    size_t Decompress32(const uint32_t* encoded, float* quaternions, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(encoded + i));
+
+            const __m256i qx = ExtractSigned<0, BitsX32>(e);
+            const __m256i qy = ExtractSigned<BitsX32, BitsY32>(e);
+            const __m256i qz = ExtractSigned<BitsX32 + BitsY32, BitsZ32>(e);
+
+            const __m256 x = _mm256_div_ps(_mm256_cvtepi32_ps(qx), _mm256_set1_ps(float((1 << (BitsX32 - 1)) - 1)));
+            const __m256 y = _mm256_div_ps(_mm256_cvtepi32_ps(qy), _mm256_set1_ps(float((1 << (BitsY32 - 1)) - 1)));
+            const __m256 z = _mm256_div_ps(_mm256_cvtepi32_ps(qz), _mm256_set1_ps(float((1 << (BitsZ32 - 1)) - 1)));
+
+            const __m256i sign = _mm256_and_si256(e, _mm256_set1_epi32(int(0x80000000u)));
+            const __m256  w    = _mm256_or_ps(ReconstructW(x, y, z), _mm256_castsi256_ps(sign));
+
+            StoreNormalizedQuaternions(quaternions + i * 4, x, y, z, w);
+        }
+        return i;
+    }
+
+    size_t Compress64(const float* quaternions, uint64_t* encoded, size_t count)
+    {
+        const float scale = float((1 << (Bits64 - 1)) - 1);
+        const int   mask  = (1 << Bits64) - 1;
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 x, y, z, w;
+            LoadQuaternions(quaternions + i * 4, x, y, z, w);
+
+            // Ignore sign of real component
+            const __m256 flip = _mm256_and_ps(_mm256_cmp_ps(w, _mm256_setzero_ps(), _CMP_LT_OQ), _mm256_set1_ps(-0.f));
+            x = _mm256_xor_ps(x, flip);
+            y = _mm256_xor_ps(y, flip);
+            z = _mm256_xor_ps(z, flip);
+
+            const __m256 norm = L1Norm(x, y, z, w);
+            const __m256i qx  = Quantize(_mm256_div_ps(x, norm), scale, mask);
+            const __m256i qy  = Quantize(_mm256_div_ps(y, norm), scale, mask);
+            const __m256i qz  = Quantize(_mm256_div_ps(z, norm), scale, mask);
+
+            for (int half = 0; half < 2; ++half) {
+                const auto widen = [half](__m256i v) {
+                    return _mm256_cvtepu32_epi64(half == 0 ? _mm256_castsi256_si128(v) : _mm256_extracti128_si256(v, 1));
+                };
+
+                __m256i result = widen(qx);
+                result = _mm256_or_si256(result, _mm256_slli_epi64(widen(qy), Bits64));
+                result = _mm256_or_si256(result, _mm256_slli_epi64(widen(qz), 2 * Bits64));
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(encoded + i + half * 4), result);
+            }
+        }
+        return i;
+    }
+
+    size_t Decompress64(const uint64_t* encoded, float* quaternions, size_t count)
+    {
+        const __m256 scale = _mm256_set1_ps(float((1 << (Bits64 - 1)) - 1));
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(encoded + i));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(encoded + i + 4));
+
+            const __m256i qx = ExtractSigned<0, Bits64>(Truncate64(a, b));
+            const __m256i qy = ExtractSigned<0, Bits64>(Truncate64(_mm256_srli_epi64(a, Bits64), _mm256_srli_epi64(b, Bits64)));
+            const __m256i qz = ExtractSigned<0, Bits64>(Truncate64(_mm256_srli_epi64(a, 2 * Bits64), _mm256_srli_epi64(b, 2 * Bits64)));
+
+            const __m256 x = _mm256_div_ps(_mm256_cvtepi32_ps(qx), scale);
+            const __m256 y = _mm256_div_ps(_mm256_cvtepi32_ps(qy), scale);
+            const __m256 z = _mm256_div_ps(_mm256_cvtepi32_ps(qz), scale);
+
+            StoreNormalizedQuaternions(quaternions + i * 4, x, y, z, ReconstructW(x, y, z));
+        }
+        return i;
+    }
+
+#else
+
+    size_t Compress32(const float*, uint32_t*, size_t) { return 0; }
+    size_t Decompress32(const uint32_t*, float*, size_t) { return 0; }
+    size_t Compress64(const float*, uint64_t*, size_t) { return 0; }
+    size_t Decompress64(const uint64_t*, float*, size_t) { return 0; }
+
+#endif
+
+    // ============================ Benchmark ====================
+
+    // Uniformly distributed rotation (Shoemake)
+    float4 RandomRotation(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        const float u0 = uniform(rng);
+        const float u1 = uniform(rng) * 2.f * 3.14159265f;
+        const float u2 = uniform(rng) * 2.f * 3.14159265f;
+
+        const float a = std::sqrt(1.f - u0);
+        const float b = std::sqrt(u0);
+        return float4(a * std::sin(u1), a * std::cos(u1), b * std::sin(u2), b * std::cos(u2));
+    }
+
+    // Rotation angle between two unit quaternions; q and -q are the same rotation
+    double AngularError(const float* a, const float* b)
+    {
+        double d = 0;
+        double lengthA = 0;
+        double lengthB = 0;
+        for (int c = 0; c < 4; ++c) {
+            d += double(a[c]) * b[c];
+            lengthA += double(a[c]) * a[c];
+            lengthB += double(b[c]) * b[c];
+        }
+        d = std::abs(d) / std::sqrt(lengthA * lengthB);
+        return 2.0 * std::acos(std::min(d, 1.0));
+    }
+
+    // Seconds per call of pass, repeated for at least minSeconds
+    double Measure(const std::function<void()>& pass, double minSeconds)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        uint64_t     passes = 0;
+        const auto   start  = Clock::now();
+        double       seconds = 0;
+        do {
+            pass();
+            ++passes;
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (seconds < minSeconds);
+
+        return seconds / passes;
+    }
+
+    template <typename T>
+    uint64_t CountMismatches(const std::vector<T>& a, const std::vector<T>& b)
+    {
+        uint64_t mismatches = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            mismatches += std::memcmp(&a[i], &b[i], sizeof(T)) != 0;
+        }
+        return mismatches;
+    }
+
+} // namespace
+
+void qCompress32Batch(const float* quaternions, uint32_t* encoded, size_t count)
+{
+    for (size_t i = Compress32(quaternions, encoded, count); i < count; ++i) {
+        encoded[i] = qCompress32(LoadQuaternion(quaternions + i * 4));
+    }
+}
+
+void qDecompress32Batch(const uint32_t* encoded, float* quaternions, size_t count)
+{
+    for (size_t i = Decompress32(encoded, quaternions, count); i < count; ++i) {
+        StoreQuaternion(quaternions + i * 4, qDecompress32(encoded[i]));
+    }
+}
+
+void qCompress64Batch(const float* quaternions, uint64_t* encoded, size_t count)
+{
+    for (size_t i = Compress64(quaternions, encoded, count); i < count; ++i) {
+        encoded[i] = qCompress64(LoadQuaternion(quaternions + i * 4));
+    }
+}
+
+void qDecompress64Batch(const uint64_t* encoded, float* quaternions, size_t count)
+{
+    for (size_t i = Decompress64(encoded, quaternions, count); i < count; ++i) {
+        StoreQuaternion(quaternions + i * 4, qDecompress64(encoded[i]));
+    }
+}
+
+bool IsQuaternionCodecVectorized()
+{
+#if defined(__AVX2__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+QuaternionCodecBenchmark RunQuaternionCodecBenchmark(size_t count, uint32_t seed, double minSeconds)
+{
+    std::mt19937 rng(seed);
+
+    std::vector<float> rotations(count * 4);
+    for (size_t i = 0; i < count; ++i) {
+        StoreQuaternion(rotations.data() + i * 4, RandomRotation(rng));
+    }
+
+    std::vector<uint32_t> encoded32(count), batchEncoded32(count);
+    std::vector<uint64_t> encoded64(count), batchEncoded64(count);
+    std::vector<float>    decoded(count * 4), batchDecoded(count * 4);
+
+    QuaternionCodecBenchmark result;
+    result.count = count;
+
+    // Every variant writes its own output, the mismatch counts compare the final passes.
+    {
+        QuaternionCodecTiming& timing = result.timings.emplace_back();
+        timing.name          = "qCompress32";
+        timing.scalarSeconds = Measure([&] {
+            for (size_t i = 0; i < count; ++i) {
+                encoded32[i] = qCompress32(LoadQuaternion(rotations.data() + i * 4));
+            }
+        }, minSeconds);
+        timing.batchSeconds = Measure([&] { qCompress32Batch(rotations.data(), batchEncoded32.data(), count); }, minSeconds);
+        timing.mismatches   = CountMismatches(encoded32, batchEncoded32);
+    }
+    {
+        QuaternionCodecTiming& timing = result.timings.emplace_back();
+        timing.name          = "qDecompress32";
+        timing.scalarSeconds = Measure([&] {
+            for (size_t i = 0; i < count; ++i) {
+                StoreQuaternion(decoded.data() + i * 4, qDecompress32(encoded32[i]));
+            }
+        }, minSeconds);
+        timing.batchSeconds = Measure([&] { qDecompress32Batch(encoded32.data(), batchDecoded.data(), count); }, minSeconds);
+        timing.mismatches   = CountMismatches(decoded, batchDecoded);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        result.maxAngularError32 = std::max(result.maxAngularError32, AngularError(rotations.data() + i * 4, decoded.data() + i * 4));
+    }
+
+    {
+        QuaternionCodecTiming& timing = result.timings.emplace_back();
+        timing.name          = "qCompress64";
+        timing.scalarSeconds = Measure([&] {
+            for (size_t i = 0; i < count; ++i) {
+                encoded64[i] = qCompress64(LoadQuaternion(rotations.data() + i * 4));
+            }
+        }, minSeconds);
+        timing.batchSeconds = Measure([&] { qCompress64Batch(rotations.data(), batchEncoded64.data(), count); }, minSeconds);
+        timing.mismatches   = CountMismatches(encoded64, batchEncoded64);
+    }
+    {
+        QuaternionCodecTiming& timing = result.timings.emplace_back();
+        timing.name          = "qDecompress64";
+        timing.scalarSeconds = Measure([&] {
+            for (size_t i = 0; i < count; ++i) {
+                StoreQuaternion(decoded.data() + i * 4, qDecompress64(encoded64[i]));
+            }
+        }, minSeconds);
+        timing.batchSeconds = Measure([&] { qDecompress64Batch(encoded64.data(), batchDecoded.data(), count); }, minSeconds);
+        timing.mismatches   = CountMismatches(decoded, batchDecoded);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        result.maxAngularError64 = std::max(result.maxAngularError64, AngularError(rotations.data() + i * 4, decoded.data() + i * 4));
+    }
+
+    return result;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ============================ Quaternion Codec ====================
+// Batch versions of qCompress32/qDecompress32 and qCompress64/qDecompress64 (Quaternion.h) for
+// baking rotations on the host. Quaternions are arrays of float xyzw.
+// With AVX2, eight quaternions are encoded or decoded per iteration with the same float operations
+// as the scalar shader functions, i.e. the batch results are bit-identical to them. The remaining
+// elements, and builds without AVX2, call the shader functions directly.
+
+void qCompress32Batch(const float* quaternions, uint32_t* encoded, size_t count);
+void qDecompress32Batch(const uint32_t* encoded, float* quaternions, size_t count);
+
+void qCompress64Batch(const float* quaternions, uint64_t* encoded, size_t count);
+void qDecompress64Batch(const uint64_t* encoded, float* quaternions, size_t count);
+
+// True if the batch functions use the AVX2 path.
+bool IsQuaternionCodecVectorized();
+
+// ============================ Benchmark ====================
+
+struct QuaternionCodecTiming {
+    std::string name;
+    double      scalarSeconds = 0;
+    double      batchSeconds  = 0;
+    // Batch results that are not bit-identical to the scalar shader function
+    uint64_t    mismatches = 0;
+};
+
+struct QuaternionCodecBenchmark {
+    uint64_t                           count = 0;
+    std::vector<QuaternionCodecTiming> timings;
+    // Largest rotation angle (radians) between a quaternion and its decoded encoding
+    double                             maxAngularError32 = 0;
+    double                             maxAngularError64 = 0;
+};
+
+// Encodes and decodes count uniformly distributed random rotations with the scalar shader functions and
+// the batch functions, repeated until every variant ran for at least minSeconds.
+QuaternionCodecBenchmark RunQuaternionCodecBenchmark(size_t count, uint32_t seed, double minSeconds = 0.5);
@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+    thread_local int workerIndex = -1;
+    thread_local uint32_t stealSeed = 0;
+} // namespace
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    threadCount = std::max(threadCount, 1u);
+
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        workers_.emplace_back(std::make_unique<Worker>());
+    }
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        workers_[i]->thread = std::thread(&ThreadPool::Run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    WaitIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stop_ = true;
+    }
+    wakeCondition_.notify_all();
+
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+int ThreadPool::GetWorkerIndex()
+{
+    return workerIndex;
+}
+
+void ThreadPool::Submit(Task task)
+{
+    pendingTasks_.fetch_add(1, std::memory_order_relaxed);
+
+    const uint32_t target = (workerIndex >= 0) ? uint32_t(workerIndex)
+                                               : nextWorker_.fetch_add(1, std::memory_order_relaxed) % GetThreadCount();
+    {
+        std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+        workers_[target]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        submitSequence_.fetch_add(1, std::memory_order_relaxed);
+    }
+    wakeCondition_.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    idleCondition_.wait(lock, [this] { return pendingTasks_.load() == 0; });
+}
+
+bool ThreadPool::TryPop(uint32_t index, Task& task)
+{
+    Worker& worker = *workers_[index];
+
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::TrySteal(uint32_t thiefIndex, Task& task)
+{
+    const uint32_t count = GetThreadCount();
+
+    // xorshift to pick a random first victim, then scan all others
+    stealSeed ^= stealSeed << 13;
+    stealSeed ^= stealSeed >> 17;
+    stealSeed ^= stealSeed << 5;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t victim = (stealSeed + i) % count;
+        if (victim == thiefIndex) {
+            continue;
+        }
+
+        Worker& worker = *workers_[victim];
+
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Run(uint32_t index)
+{
+    workerIndex = int(index);
+    stealSeed   = 0x9e3779b9u * (index + 1);
+
+    while (true) {
+        // Sample the sequence before searching, so a submission during the search is not missed
+        const uint64_t sequence = submitSequence_.load(std::memory_order_relaxed);
+
+        Task task;
+        if (TryPop(index, task) || TrySteal(index, task)) {
+            task();
+
+            if (pendingTasks_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(wakeMutex_);
+                idleCondition_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wakeCondition_.wait(lock, [&] { return stop_ || submitSequence_.load(std::memory_order_relaxed) != sequence; });
+        if (stop_) {
+            return;
+        }
+    }
+}
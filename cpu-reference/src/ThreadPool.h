@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================ Thread Pool ====================
+// Work-stealing pool: every worker owns a deque and pops its newest task (LIFO, good locality
+// for recursive expansion), idle workers steal the oldest task (FIFO) of a random victim.
+// Tasks submitted from a worker go to that worker's deque, external submissions are spread
+// round-robin.
+
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(Task task);
+
+    // Blocks until all submitted tasks, including tasks submitted by tasks, have finished.
+    void WaitIdle();
+
+    uint32_t GetThreadCount() const { return uint32_t(workers_.size()); }
+
+    // Index of the calling worker thread, or -1 if called from outside the pool.
+    static int GetWorkerIndex();
+
+private:
+    struct Worker {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+        std::thread      thread;
+    };
+
+    void Run(uint32_t workerIndex);
+    bool TryPop(uint32_t workerIndex, Task& task);
+    bool TrySteal(uint32_t thiefIndex, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex              wakeMutex_;
+    std::condition_variable wakeCondition_;
+    std::condition_variable idleCondition_;
+
+    std::atomic<uint64_t> pendingTasks_   = 0;
+    std::atomic<uint32_t> nextWorker_     = 0;
+    std::atomic<uint64_t> submitSequence_ = 0;
+    bool                  stop_           = false;
+};
@@ -0,0 +1,574 @@
+#include "TreeGraph.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Shader headers last: Common.h and Quaternion.h define macros with common names (random, X, Y, Z, ...)
+#include "Common.h"
+
+#include "Config.h"
+#include "TreeParameters.h"
+#include "Quaternion.h"
+#include "Records.h"
+#include "TreeModel.h"
+#include "Camera.h"
+#include "Statistics.h"
+#include "TriangleBudget.h"
+#include "SplineTessellation.h"
+#include "TreeTemplates.h"
+#include "TreeGeneration.h"
+#include "LeafCoalescing.h"
+#include "Chunks.h"
+
+// ============================ Records ====================
+// Records declared next to node code that does not compile on the host.
+
+struct EmptyRecord {
+};
+
+
+struct TreeGraph::Nodes {
+    ThreadNode<EmptyRecord>*       entry;
+    ThreadNode<EmptyRecord>*       userInterface;
+    MeshNode<EmptyRecord>*         skybox;
+    MeshNode<EmptyRecord>*         simpleCube;
+    MeshNode<EmptyRecord>*         simpleCubeShadow;
+    BroadcastingNode<EmptyRecord>*        chunks;
+    BroadcastingNode<TreeRootsRecord>*    treeRoots;
+    BroadcastingNode<EmptyRecord>*        treeTemplates;
+    BroadcastingNode<TreeInstanceRecord>* treeInstance;
+    std::array<BroadcastingNode<GenerateTreeRecord>*, TREE_TYPE_COUNT> stem;
+    std::array<CoalescingNode<GenerateTreeRecord>*, TREE_TYPE_COUNT>   twig;
+    MeshNode<DrawSegmentRecord>*   drawSegment;
+    MeshNode<DrawSegmentRecord>*   drawSegmentShadow;
+    std::array<CoalescingNode<DrawSegmentRecord>*, 2> coalesceDrawSegments;
+    MeshNode<DrawSegmentBundleRecord>* drawSegmentBundle;
+    MeshNode<DrawSegmentBundleRecord>* drawSegmentBundleShadow;
+    std::array<CoalescingNode<DrawLeafRecord>*, 3> coalesceDrawLeaves;
+    MeshNode<DrawLeafRecordBundle>*  drawLeafBundle;
+    MeshNode<DrawLeafRecordBundle>*  drawLeafBundleShadow;
+    MeshNode<DrawFruitRecordBundle>* drawFruitBundle;
+};
+
+namespace {
+
+    // ============================ Entry ====================
+
+    void StoreConfig(const TreeGraphOptions& options)
+    {
+        Time       = options.time;
+        RenderSize = uint2(options.renderWidth, options.renderHeight);
+
+        StorePersistentConfig(PersistentConfig::TREE_TYPE, options.treeType % TREE_TYPE_COUNT);
+        StorePersistentConfig(PersistentConfig::TREE_ATTRACTION_UP, GetTreeParameters().AttractionUp);
+        StorePersistentConfig(PersistentConfig::SEASON, options.season);
+        StorePersistentConfig(PersistentConfig::WIND_STRENGTH, options.windStrength);
+        StorePersistentConfig(PersistentConfig::SEED, options.seed);
+        StorePersistentConfig(PersistentConfig::DRAW_DISTANCE, options.drawDistance);
+        StorePersistentConfig(PersistentConfig::TREE_TEMPLATE_COUNT, options.treeTemplateCount);
+        StorePersistentConfig(PersistentConfig::TRIANGLE_BUDGET, options.triangleBudget);
+
+        const TreeParameters params     = GetTreeParameters();
+        const float          treeHeight = params.Scale * params.nLength[0];
+
+        StorePersistentConfig(PersistentConfig::CAMERA_YAW, options.cameraYaw);
+        StorePersistentConfig(PersistentConfig::CAMERA_PITCH, options.cameraPitch);
+        StorePersistentConfig(PersistentConfig::CAMERA_DISTANCE,
+                              options.cameraDistance < 0.f ? treeHeight * 1.2f : options.cameraDistance);
+
+        StorePersistentConfig(PersistentConfig::TIME, Time);
+        StorePersistentConfig(PersistentConfig::MOUSE_X, float(MousePosition.x));
+        StorePersistentConfig(PersistentConfig::MOUSE_Y, float(MousePosition.y));
+        StorePersistentConfig(PersistentConfig::KEY_SPACE_DOWN, 0u);
+
+        // Mark config initialized
+        PersistentScratchBuffer.Store<uint>(0, 1);
+    }
+
+
+    // ============================ Stem and Twig ====================
+    // GenerateStem and GenerateTwig of TreeGeneration.h, called with a literal tree type like the STEM_NODE and
+    // TWIG_NODE nodes.
+
+    template <uint TreeType>
+    void Stem(TreeGraph::Nodes& nodes, const GenerateTreeRecord& ir, const uint remainingRecursionLevels)
+    {
+        NodeStatistics& statistics = nodes.stem[TreeType]->GetStatistics();
+
+        NodeOutput<GenerateTreeRecord> generateTreeOutput(
+            statistics, nodes.stem[TreeType], maxChildRecords, stemMaxRecursionDepth - remainingRecursionLevels + 1);
+        NodeOutput<GenerateTreeRecord> twigOutput(statistics, nodes.twig[TreeType], maxChildRecords);
+        NodeOutput<DrawLeafRecord>     drawLeafOutputs[3] = {
+            { statistics, nodes.coalesceDrawLeaves[0], maxChildRecords },
+            { statistics, nodes.coalesceDrawLeaves[1], maxChildRecords },
+            { statistics, nodes.coalesceDrawLeaves[2], maxChildRecords },
+        };
+        NodeOutputArray<DrawLeafRecord> drawLeafOutput(drawLeafOutputs);
+        NodeOutput<DrawSegmentRecord>   drawSegmentOutput(statistics, nodes.drawSegment, maxSegmentRecords);
+        NodeOutput<DrawSegmentRecord>   drawSegmentShadowOutput(statistics, nodes.drawSegmentShadow, maxSegmentRecords);
+        NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentOutput(statistics, nodes.coalesceDrawSegments[0], maxSegmentRecords);
+        NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentShadowOutput(statistics, nodes.coalesceDrawSegments[1], maxSegmentRecords);
+
+        RunShaderGroup(StemThreadGroupSize, remainingRecursionLevels, [&](uint32_t gtid) {
+            GenerateStem(TreeType,
+                         gtid,
+                         ir,
+                         generateTreeOutput,
+                         twigOutput,
+                         drawLeafOutput,
+                         drawSegmentOutput,
+                         drawSegmentShadowOutput,
+                         coalesceDrawSegmentOutput,
+                         coalesceDrawSegmentShadowOutput);
+        });
+
+        // [MaxRecordsSharedWith(generateTreeOutput)]
+        ValidateSharedBudget(statistics,
+                             generateTreeOutput.Count() + twigOutput.Count() +
+                                 drawLeafOutputs[0].Count() + drawLeafOutputs[1].Count() + drawLeafOutputs[2].Count(),
+                             maxChildRecords);
+        // [MaxRecordsSharedWith(drawSegmentOutput)], [MaxRecordsSharedWith(drawSegmentShadowOutput)]
+        ValidateSharedBudget(statistics, drawSegmentOutput.Count() + coalesceDrawSegmentOutput.Count(), maxSegmentRecords);
+        ValidateSharedBudget(statistics, drawSegmentShadowOutput.Count() + coalesceDrawSegmentShadowOutput.Count(), maxSegmentRecords);
+    }
+
+    template <uint TreeType>
+    void Twig(TreeGraph::Nodes& nodes, const std::vector<GenerateTreeRecord>& irs)
+    {
+        NodeStatistics& statistics = nodes.twig[TreeType]->GetStatistics();
+
+        NodeOutput<DrawLeafRecord> drawLeafOutputs[3] = {
+            { statistics, nodes.coalesceDrawLeaves[0], maxTwigLeafRecords },
+            { statistics, nodes.coalesceDrawLeaves[1], maxTwigLeafRecords },
+            { statistics, nodes.coalesceDrawLeaves[2], maxTwigLeafRecords },
+        };
+        NodeOutputArray<DrawLeafRecord> drawLeafOutput(drawLeafOutputs);
+        NodeOutput<DrawSegmentRecord>   drawSegmentOutput(statistics, nodes.drawSegment, maxTwigSegmentRecords);
+        NodeOutput<DrawSegmentRecord>   drawSegmentShadowOutput(statistics, nodes.drawSegmentShadow, maxTwigSegmentRecords);
+        NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentOutput(statistics, nodes.coalesceDrawSegments[0], maxTwigSegmentRecords);
+        NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentShadowOutput(statistics, nodes.coalesceDrawSegments[1], maxTwigSegmentRecords);
+
+        const uint twigCount = uint(irs.size());
+
+        RunShaderGroup(TwigThreadGroupSize, 0, [&](uint32_t gtid) {
+            GenerateTwig(TreeType,
+                         gtid,
+                         twigCount,
+                         irs[min(gtid, twigCount - 1)],
+                         drawLeafOutput,
+                         drawSegmentOutput,
+                         drawSegmentShadowOutput,
+                         coalesceDrawSegmentOutput,
+                         coalesceDrawSegmentShadowOutput);
+        });
+
+        // [MaxRecords(maxTwigLeafRecords)] of the CoalesceDrawLeaves node array
+        ValidateSharedBudget(statistics, drawLeafOutputs[0].Count() + drawLeafOutputs[1].Count() + drawLeafOutputs[2].Count(), maxTwigLeafRecords);
+        // [MaxRecordsSharedWith(drawSegmentOutput)], [MaxRecordsSharedWith(drawSegmentShadowOutput)]
+        ValidateSharedBudget(statistics, drawSegmentOutput.Count() + coalesceDrawSegmentOutput.Count(), maxTwigSegmentRecords);
+        ValidateSharedBudget(statistics, drawSegmentShadowOutput.Count() + coalesceDrawSegmentShadowOutput.Count(), maxTwigSegmentRecords);
+    }
+
+    // ============================ Mesh Output Counts ====================
+
+    // Output counts of StemMeshShader and StemShadowMeshShader in SplineSegment.h.
+    MeshOutputCounts StemMeshOutputCounts(const uint groupOfSegment, const DrawSegmentRecord& segmentRecord, const bool isShadow)
+    {
+        const SegmentGroupTessellation tessellation = GetSegmentGroupTessellation(segmentRecord, groupOfSegment);
+
+        const int V = max(tessellation.V, 0);
+        const int T = max(tessellation.T, 0);
+
+        AddStatistic(isShadow ? StatisticsCounter::STEM_SHADOW_MESH_GROUPS : StatisticsCounter::STEM_MESH_GROUPS, 1);
+        AddStatistic(isShadow ? StatisticsCounter::STEM_SHADOW_MESH_VERTICES : StatisticsCounter::STEM_MESH_VERTICES, V);
+        AddStatistic(isShadow ? StatisticsCounter::STEM_SHADOW_MESH_TRIANGLES : StatisticsCounter::STEM_MESH_TRIANGLES, T);
+
+        return MeshOutputCounts{ uint32_t(V), uint32_t(T) };
+    }
+
+    // Output counts of StemBundleMeshShader and StemShadowBundleMeshShader in SplineSegment.h.
+    MeshOutputCounts StemBundleMeshOutputCounts(const uint gid, const DrawSegmentBundleRecord& bundle, const bool isShadow)
+    {
+        const SegmentBundleGroup& group = bundle.groups[gid];
+
+        AddStatistic(isShadow ? StatisticsCounter::STEM_SHADOW_MESH_GROUPS : StatisticsCounter::STEM_MESH_GROUPS, 1);
+        AddStatistic(isShadow ? StatisticsCounter::STEM_SHADOW_MESH_VERTICES : StatisticsCounter::STEM_MESH_VERTICES, group.vertexCount);
+        AddStatistic(isShadow ? StatisticsCounter::STEM_SHADOW_MESH_TRIANGLES : StatisticsCounter::STEM_MESH_TRIANGLES, group.triangleCount);
+
+        return MeshOutputCounts{ group.vertexCount, group.triangleCount };
+    }
+
+} // namespace
+
+// ============================ Graph ====================
+
+TreeGraph::TreeGraph(ThreadPool& pool) : graph_(pool), nodes_(std::make_unique<Nodes>())
+{
+    Nodes& nodes = *nodes_;
+
+    auto fixedGrid = [](uint32_t x, uint32_t y = 1, uint32_t z = 1) {
+        return [=](const auto&) { return Uint3{ x, y, z }; };
+    };
+
+    // Sinks first, so producers can reference them
+    nodes.skybox = &graph_.AddNode<MeshNode<EmptyRecord>>(
+        "Skybox", [](const Uint3&, const EmptyRecord&) { return MeshOutputCounts{ 12, 14 }; }, fixedGrid(1), MeshOutputCounts{ 12, 14 });
+
+    nodes.simpleCube = &graph_.AddNode<MeshNode<EmptyRecord>>(
+        "SimpleCube", [](const Uint3&, const EmptyRecord&) { return MeshOutputCounts{ 8, 12 }; }, fixedGrid(1), MeshOutputCounts{ 8, 12 });
+
+    nodes.simpleCubeShadow = &graph_.AddNode<MeshNode<EmptyRecord>>(
+        "SimpleCubeShadow", [](const Uint3&, const EmptyRecord&) { return MeshOutputCounts{ 8, 12 }; }, fixedGrid(1), MeshOutputCounts{ 8, 12 });
+
+    // UserInterface only prints text, its broadcasting children are not emulated
+    nodes.userInterface = &graph_.AddNode<ThreadNode<EmptyRecord>>("UserInterface", [](const EmptyRecord&) {});
+
+    // DrawSegment and its depth-only variant DrawSegmentShadow
+    for (const bool isShadow : { false, true }) {
+        (isShadow ? nodes.drawSegmentShadow : nodes.drawSegment) = &graph_.AddNode<MeshNode<DrawSegmentRecord>>(
+            isShadow ? "DrawSegmentShadow" : "DrawSegment",
+            [isShadow](const Uint3& groupId, const DrawSegmentRecord& record) { return StemMeshOutputCounts(groupId.x, record, isShadow); },
+            [](const DrawSegmentRecord& record) { return Uint3{ record.dispatchGrid, 1, 1 }; },
+            MeshOutputCounts{ uint32_t(maxNumVerticesPerGroup), uint32_t(maxNumTrianglesPerGroup) },
+            Uint3{ uint32_t(maxNumTriangleRingsPerSegment), 1, 1 });
+    }
+
+    // DrawSegmentBundle and DrawSegmentBundleShadow, fed by CoalesceDrawSegments[0] and [1]
+    for (const bool isShadow : { false, true }) {
+        (isShadow ? nodes.drawSegmentBundleShadow : nodes.drawSegmentBundle) = &graph_.AddNode<MeshNode<DrawSegmentBundleRecord>>(
+            isShadow ? "DrawSegmentBundleShadow" : "DrawSegmentBundle",
+            [isShadow](const Uint3& gid, const DrawSegmentBundleRecord& record) { return StemBundleMeshOutputCounts(gid.x, record, isShadow); },
+            [](const DrawSegmentBundleRecord& record) { return Uint3{ record.dispatchGrid, 1, 1 }; },
+            MeshOutputCounts{ uint32_t(maxNumVerticesPerGroup), uint32_t(maxNumTrianglesPerGroup) },
+            Uint3{ uint32_t(maxCoalescedDrawSegmentRecords), 1, 1 });
+
+        nodes.coalesceDrawSegments[isShadow] = &graph_.AddNode<CoalescingNode<DrawSegmentRecord>>(
+            isShadow ? "CoalesceDrawSegments[1]" : "CoalesceDrawSegments[0]",
+            [&nodes, isShadow](const std::vector<DrawSegmentRecord>& irs) {
+                NodeOutput<DrawSegmentBundleRecord> output(
+                    nodes.coalesceDrawSegments[isShadow]->GetStatistics(), isShadow ? nodes.drawSegmentBundleShadow : nodes.drawSegmentBundle, 1);
+
+                RunShaderGroup(maxCoalescedDrawSegmentRecords, 0, [&](uint32_t gtid) {
+                    CoalesceDrawSegmentRecords(gtid, GroupNodeInputRecords<DrawSegmentRecord>(irs), output);
+                });
+            },
+            maxCoalescedDrawSegmentRecords);
+    }
+
+    // DrawLeafBundle and its depth-only variant DrawLeafBundleShadow
+    for (const bool isShadow : { false, true }) {
+        (isShadow ? nodes.drawLeafBundleShadow : nodes.drawLeafBundle) = &graph_.AddNode<MeshNode<DrawLeafRecordBundle>>(
+            isShadow ? "DrawLeafBundleShadow" : "DrawLeafBundle",
+            [isShadow](const Uint3& gid, const DrawLeafRecordBundle& record) {
+                const int leavesPerGroup   = record.isCard ? cardsPerGroup : lobesPerGroup;
+                const int verticesPerLeaf  = record.isCard ? verticesPerCard : verticesPerLobe;
+                const int trianglesPerLeaf = record.isCard ? trianglesPerCard : trianglesPerLobe;
+
+                const int localLeafCount = clamp(int(record.leafCount) - int(gid.x) * leavesPerGroup, 0, leavesPerGroup);
+                const int V              = localLeafCount * verticesPerLeaf;
+                const int T              = localLeafCount * trianglesPerLeaf;
+
+                AddStatistic(isShadow ? StatisticsCounter::LEAF_SHADOW_MESH_GROUPS : StatisticsCounter::LEAF_MESH_GROUPS, 1);
+                AddStatistic(isShadow ? StatisticsCounter::LEAF_SHADOW_MESH_VERTICES : StatisticsCounter::LEAF_MESH_VERTICES, V);
+                AddStatistic(isShadow ? StatisticsCounter::LEAF_SHADOW_MESH_TRIANGLES : StatisticsCounter::LEAF_MESH_TRIANGLES, T);
+
+                return MeshOutputCounts{ uint32_t(V), uint32_t(T) };
+            },
+            [](const DrawLeafRecordBundle& record) { return Uint3{ record.dispatchGrid.x, record.dispatchGrid.y, 1 }; },
+            MeshOutputCounts{ uint32_t(maxNumVerticesPerLobeGroup), uint32_t(maxNumTrianglesPerLobeGroup) },
+            Uint3{ uint32_t(maxDrawLobeGroupsPerDispatch), TREE_MAX_LOBE_COUNT, 1 });
+    }
+
+    // GetFruitLodFruitsPerGroup packs the fruits of a LOD into the output limits of LOD 0
+    static_assert((fruitLod1Vertices <= maxNumVerticesPerFruitGroup) && (fruitLod1Triangles <= maxNumTrianglesPerFruitGroup) &&
+                      (fruitLod2Vertices <= maxNumVerticesPerFruitGroup) && (fruitLod2Triangles <= maxNumTrianglesPerFruitGroup),
+                  "Fruit LOD exceeds the mesh output limits of FruitMeshShader");
+    nodes.drawFruitBundle = &graph_.AddNode<MeshNode<DrawFruitRecordBundle>>(
+        "DrawFruitBundle",
+        [](const Uint3& gid, const DrawFruitRecordBundle& record) {
+            const uint fruitsPerGroup = GetFruitLodFruitsPerGroup(record.lod);
+            const uint fruitCount     = min(record.fruitCount - gid.x * fruitsPerGroup, fruitsPerGroup);
+            const uint V              = fruitCount * GetFruitLodVertexCount(record.lod);
+            const uint T              = fruitCount * GetFruitLodTriangleCount(record.lod);
+
+            AddStatistic(StatisticsCounter::FRUIT_MESH_GROUPS, 1);
+            AddStatistic(StatisticsCounter::FRUIT_MESH_VERTICES, V);
+            AddStatistic(StatisticsCounter::FRUIT_MESH_TRIANGLES, T);
+
+            return MeshOutputCounts{ V, T };
+        },
+        [](const DrawFruitRecordBundle& record) { return Uint3{ record.dispatchGrid, 1, 1 }; },
+        MeshOutputCounts{ uint32_t(maxNumVerticesPerFruitGroup), uint32_t(maxNumTrianglesPerFruitGroup) },
+        Uint3{ uint32_t(maxDrawFruitGroupsPerDispatch), 1, 1 });
+
+    // CoalesceDrawLeaves[0] (leaves) and [1] (blossoms) of Leaves.h; leaves emit a lobe and a card bundle per view,
+    // blossoms only a lobe bundle
+    for (uint isBlossom = 0; isBlossom < 2; ++isBlossom) {
+        nodes.coalesceDrawLeaves[isBlossom] = &graph_.AddNode<CoalescingNode<DrawLeafRecord>>(
+            isBlossom ? "CoalesceDrawLeaves[1]" : "CoalesceDrawLeaves[0]",
+            [&nodes, isBlossom](const std::vector<DrawLeafRecord>& irs) {
+                NodeStatistics& statistics = nodes.coalesceDrawLeaves[isBlossom]->GetStatistics();
+
+                NodeOutput<DrawLeafRecordBundle> output(statistics, nodes.drawLeafBundle, isBlossom ? 1 : 2);
+                NodeOutput<DrawLeafRecordBundle> shadowOutput(statistics, nodes.drawLeafBundleShadow, isBlossom ? 1 : 2);
+
+                RunShaderGroup(maxCoalescedDrawLeafRecords, 0, [&](uint32_t gtid) {
+                    if (isBlossom) {
+                        CoalesceDrawBlossomRecords(gtid, GroupNodeInputRecords<DrawLeafRecord>(irs), output, shadowOutput);
+                    } else {
+                        CoalesceDrawLeafRecords(gtid, GroupNodeInputRecords<DrawLeafRecord>(irs), output, shadowOutput);
+                    }
+                });
+            },
+            maxCoalescedDrawLeafRecords);
+    }
+
+    // CoalesceDrawLeaves[2] (fruits) of Fruits.h
+    nodes.coalesceDrawLeaves[2] = &graph_.AddNode<CoalescingNode<DrawLeafRecord>>(
+        "CoalesceDrawLeaves[2]",
+        [&nodes](const std::vector<DrawLeafRecord>& irs) {
+            NodeOutput<DrawFruitRecordBundle> output(nodes.coalesceDrawLeaves[2]->GetStatistics(), nodes.drawFruitBundle, FruitLodCount);
+
+            RunShaderGroup(maxDrawFruitGroupsPerDispatch, 0, [&](uint32_t gtid) {
+                CoalesceDrawFruitRecords(gtid, GroupNodeInputRecords<DrawLeafRecord>(irs), output);
+            });
+        },
+        maxDrawFruitGroupsPerDispatch);
+
+    // Twig node array, one node per tree type
+    const auto addTwigNode = [&]<uint TreeType>() {
+        nodes.twig[TreeType] = &graph_.AddNode<CoalescingNode<GenerateTreeRecord>>(
+            "Twig[" + std::to_string(TreeType) + "]",
+            [&nodes](const std::vector<GenerateTreeRecord>& irs) { Twig<TreeType>(nodes, irs); },
+            TwigThreadGroupSize);
+    };
+    addTwigNode.operator()<TREE_TYPE_APPLE>();
+    addTwigNode.operator()<TREE_TYPE_SASSAFRAS>();
+    addTwigNode.operator()<TREE_TYPE_PALM>();
+    addTwigNode.operator()<TREE_TYPE_TAMARACK>();
+
+    // Stem node array, one node per tree type
+    const auto addStemNode = [&]<uint TreeType>() {
+        nodes.stem[TreeType] = &graph_.AddNode<BroadcastingNode<GenerateTreeRecord>>(
+            "Stem[" + std::to_string(TreeType) + "]",
+            [&nodes](const Uint3&, const GenerateTreeRecord& record, uint32_t remainingRecursionLevels) {
+                Stem<TreeType>(nodes, record, remainingRecursionLevels);
+            },
+            fixedGrid(1),
+            Uint3{ 1, 1, 1 },
+            stemMaxRecursionDepth);
+    };
+    addStemNode.operator()<TREE_TYPE_APPLE>();
+    addStemNode.operator()<TREE_TYPE_SASSAFRAS>();
+    addStemNode.operator()<TREE_TYPE_PALM>();
+    addStemNode.operator()<TREE_TYPE_TAMARACK>();
+
+    // TreeTemplatesNode in ProceduralTreeGeneration.hlsl; one regenerated template tree per thread
+    nodes.treeTemplates = &graph_.AddNode<BroadcastingNode<EmptyRecord>>(
+        "TreeTemplates",
+        [&nodes](const Uint3&, const EmptyRecord&, uint32_t) {
+            NodeStatistics& statistics = nodes.treeTemplates->GetStatistics();
+
+            NodeOutput<GenerateTreeRecord> treeOutputs[TREE_TYPE_COUNT] = {
+                { statistics, nodes.stem[0], MaxTreeTemplateCount },
+                { statistics, nodes.stem[1], MaxTreeTemplateCount },
+                { statistics, nodes.stem[2], MaxTreeTemplateCount },
+                { statistics, nodes.stem[3], MaxTreeTemplateCount },
+            };
+            NodeOutputArray<GenerateTreeRecord> treeOutput(treeOutputs);
+
+            RunShaderGroup(MaxTreeTemplateCount, 0, [&](uint32_t gtid) { GenerateTreeTemplates(gtid, treeOutput); });
+        },
+        fixedGrid(1),
+        Uint3{ 1, 1, 1 });
+
+    // TreeInstanceNode in ProceduralTreeGeneration.hlsl; one segment and one leaf of the template per thread
+    nodes.treeInstance = &graph_.AddNode<BroadcastingNode<TreeInstanceRecord>>(
+        "TreeInstance",
+        [&nodes](const Uint3& groupId, const TreeInstanceRecord& instance, uint32_t) {
+            NodeStatistics& statistics = nodes.treeInstance->GetStatistics();
+
+            NodeOutput<DrawLeafRecord> drawLeafOutputs[3] = {
+                { statistics, nodes.coalesceDrawLeaves[0], TreeInstanceGroupSize },
+                { statistics, nodes.coalesceDrawLeaves[1], TreeInstanceGroupSize },
+                { statistics, nodes.coalesceDrawLeaves[2], TreeInstanceGroupSize },
+            };
+            NodeOutputArray<DrawLeafRecord> drawLeafOutput(drawLeafOutputs);
+            NodeOutput<DrawSegmentRecord>   drawSegmentOutput(statistics, nodes.drawSegment, TreeInstanceGroupSize);
+            NodeOutput<DrawSegmentRecord>   drawSegmentShadowOutput(statistics, nodes.drawSegmentShadow, TreeInstanceGroupSize);
+            NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentOutput(statistics, nodes.coalesceDrawSegments[0], TreeInstanceGroupSize);
+            NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentShadowOutput(statistics, nodes.coalesceDrawSegments[1], TreeInstanceGroupSize);
+
+            RunShaderGroup(TreeInstanceGroupSize, 0, [&](uint32_t gtid) {
+                GenerateTreeInstance(gtid,
+                                     groupId.x * TreeInstanceGroupSize + gtid,
+                                     instance,
+                                     drawLeafOutput,
+                                     drawSegmentOutput,
+                                     drawSegmentShadowOutput,
+                                     coalesceDrawSegmentOutput,
+                                     coalesceDrawSegmentShadowOutput);
+            });
+
+            // [MaxRecordsSharedWith(drawSegmentOutput)], [MaxRecordsSharedWith(drawSegmentShadowOutput)]
+            ValidateSharedBudget(statistics, drawSegmentOutput.Count() + coalesceDrawSegmentOutput.Count(), TreeInstanceGroupSize);
+            ValidateSharedBudget(statistics, drawSegmentShadowOutput.Count() + coalesceDrawSegmentShadowOutput.Count(), TreeInstanceGroupSize);
+            // NodeOutputArray: MaxRecords covers all array entries
+            ValidateSharedBudget(statistics, drawLeafOutputs[0].Count() + drawLeafOutputs[1].Count() + drawLeafOutputs[2].Count(), TreeInstanceGroupSize);
+        },
+        [](const TreeInstanceRecord& record) { return Uint3{ record.dispatchGrid, 1, 1 }; },
+        Uint3{ TreeInstanceMaxGroups, 1, 1 });
+
+    // TreeRootsNode in ProceduralTreeGeneration.hlsl; one group per chunk, one tree per thread
+    nodes.treeRoots = &graph_.AddNode<BroadcastingNode<TreeRootsRecord>>(
+        "TreeRoots",
+        [&nodes](const Uint3&, const TreeRootsRecord& chunkRecord, uint32_t) {
+            NodeStatistics& statistics = nodes.treeRoots->GetStatistics();
+
+            NodeOutput<GenerateTreeRecord> treeOutputs[TREE_TYPE_COUNT] = {
+                { statistics, nodes.stem[0], ChunkTreeCount },
+                { statistics, nodes.stem[1], ChunkTreeCount },
+                { statistics, nodes.stem[2], ChunkTreeCount },
+                { statistics, nodes.stem[3], ChunkTreeCount },
+            };
+            NodeOutputArray<GenerateTreeRecord> treeOutput(treeOutputs);
+            NodeOutput<TreeInstanceRecord>      treeInstanceOutput(statistics, nodes.treeInstance, ChunkTreeCount);
+
+            RunShaderGroup(ChunkTreeCount, 0, [&](uint32_t gtid) {
+                const uint2 groupThreadID = uint2(gtid % ChunkTreeGridSize, gtid / ChunkTreeGridSize);
+
+                GenerateTreeRoots(groupThreadID, chunkRecord, treeOutput, treeInstanceOutput);
+            });
+        },
+        fixedGrid(1),
+        Uint3{ 1, 1, 1 });
+
+    // ChunksNode in ProceduralTreeGeneration.hlsl; one chunk of the window around the camera per thread
+    nodes.chunks = &graph_.AddNode<BroadcastingNode<EmptyRecord>>(
+        "Chunks",
+        [&nodes](const Uint3& groupId, const EmptyRecord&, uint32_t) {
+            NodeOutput<TreeRootsRecord> treeRootsOutput(nodes.chunks->GetStatistics(), nodes.treeRoots, ChunksGroupSize * ChunksGroupSize);
+
+            RunShaderGroup(ChunksGroupSize * ChunksGroupSize, 0, [&](uint32_t gtid) {
+                const uint2 dispatchThreadID =
+                    uint2(groupId.x, groupId.y) * ChunksGroupSize + uint2(gtid % ChunksGroupSize, gtid / ChunksGroupSize);
+
+                GenerateChunks(dispatchThreadID, treeRootsOutput);
+            });
+        },
+        fixedGrid(ChunksGroups, ChunksGroups),
+        Uint3{ ChunksGroups, ChunksGroups, 1 });
+
+    // EntryFunction in ProceduralTreeGeneration.hlsl; the configuration comes from the options instead of user input.
+    nodes.entry = &graph_.AddNode<ThreadNode<EmptyRecord>>("Entry", [this](const EmptyRecord&) {
+        Nodes&          nodes      = *nodes_;
+        NodeStatistics& statistics = nodes.entry->GetStatistics();
+
+        StoreConfig(options_);
+
+        // Advance shadow map banks; ClearShadowMap, BuildOcclusionPyramid and BakeBarkTexture are not emulated, as mesh
+        // nodes are not rasterized. The occlusion pyramid thus never becomes valid and occludes nothing.
+        StorePersistentConfig(PersistentConfig::FRAME_INDEX, LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX) + 1);
+
+        const uint regeneratedTreeTemplateCount = BeginTreeFrame();
+
+        NodeOutput<EmptyRecord> userInterfaceOutput(statistics, nodes.userInterface, 1);
+        NodeOutput<EmptyRecord> skyboxOutput(statistics, nodes.skybox, 1);
+        NodeOutput<EmptyRecord> simpleCubeOutput(statistics, nodes.simpleCube, 1);
+        NodeOutput<EmptyRecord> simpleCubeShadowOutput(statistics, nodes.simpleCubeShadow, 1);
+        NodeOutput<EmptyRecord> chunksOutput(statistics, nodes.chunks, 1);
+        NodeOutput<EmptyRecord> treeTemplatesOutput(statistics, nodes.treeTemplates, 1);
+
+        userInterfaceOutput.Emit();
+        skyboxOutput.Emit();
+        simpleCubeOutput.Emit();
+        simpleCubeShadowOutput.Emit();
+
+        if (regeneratedTreeTemplateCount > 0) {
+            treeTemplatesOutput.Emit();
+        }
+        chunksOutput.Emit();
+    });
+}
+
+TreeGraph::~TreeGraph()
+{
+    graph_.Drain();
+}
+
+void TreeGraph::RunFrame(const TreeGraphOptions& options)
+{
+    options_ = options;
+
+    nodes_->entry->Enqueue({ EmptyRecord{} }, 0);
+    graph_.Drain();
+}
+
+uint64_t TreeGraph::GetTreeCount() const
+{
+    return nodes_->treeRoots->GetStatistics().outputRecords;
+}
+
+std::vector<std::pair<std::string, uint32_t>> TreeGraph::GetFrameCounters() const
+{
+    static const char* const names[] = {
+        "TREE_ROOTS_GROUPS",
+        "TREE_ROOTS_RECORDS",
+        "TREE_ROOTS_OCCLUDED_RECORDS",
+        "TREE_ROOTS_SHADOW_ONLY_RECORDS",
+        "TREE_INSTANCE_GROUPS",
+        "TREE_INSTANCE_RECORDS",
+        "STEM_GROUPS",
+        "STEM_BRANCH_RECORDS",
+        "STEM_SEGMENT_RECORDS",
+        "STEM_SHADOW_SEGMENT_RECORDS",
+        "STEM_LEAF_RECORDS",
+        "STEM_CONTINUATION_RECORDS",
+        "STEM_DROPPED_CONTINUATION",
+        "STEM_CULLED_RECORDS",
+        "STEM_OCCLUDED_RECORDS",
+        "STEM_SHADOW_ONLY_RECORDS",
+        "TWIG_GROUPS",
+        "TWIG_RECORDS",
+        "COALESCE_LEAF_GROUPS",
+        "COALESCE_LEAF_RECORDS",
+        "COALESCE_LEAF_CAMERA_CARD_RECORDS",
+        "COALESCE_LEAF_SHADOW_CARD_RECORDS",
+        "COALESCE_BLOSSOM_GROUPS",
+        "COALESCE_BLOSSOM_RECORDS",
+        "COALESCE_FRUIT_GROUPS",
+        "COALESCE_FRUIT_RECORDS",
+        "COALESCE_SEGMENT_GROUPS",
+        "COALESCE_SEGMENT_RECORDS",
+        "STEM_MESH_GROUPS",
+        "STEM_MESH_VERTICES",
+        "STEM_MESH_TRIANGLES",
+        "LEAF_MESH_GROUPS",
+        "LEAF_MESH_VERTICES",
+        "LEAF_MESH_TRIANGLES",
+        "FRUIT_MESH_GROUPS",
+        "FRUIT_MESH_VERTICES",
+        "FRUIT_MESH_TRIANGLES",
+        "STEM_SHADOW_MESH_GROUPS",
+        "STEM_SHADOW_MESH_VERTICES",
+        "STEM_SHADOW_MESH_TRIANGLES",
+        "LEAF_SHADOW_MESH_GROUPS",
+        "LEAF_SHADOW_MESH_VERTICES",
+        "LEAF_SHADOW_MESH_TRIANGLES",
+    };
+    static_assert(std::size(names) == uint(StatisticsCounter::COUNT), "Counter names out of sync with Statistics.h");
+
+    // The graph is drained, so the counters of the current frame are complete
+    std::vector<std::pair<std::string, uint32_t>> counters;
+    for (uint i = 0; i < uint(StatisticsCounter::COUNT); ++i) {
+        counters.emplace_back(names[i], LoadStatistic(StatisticsCounter(i)));
+    }
+    return counters;
+}
+
+float TreeGraph::GetTriangleBudgetDetail() const
+{
+    return ::GetTriangleBudgetDetail();
+}
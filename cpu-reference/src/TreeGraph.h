@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "WorkGraph.h"
+
+// ============================ Tree Work Graph ====================
+// Host executor of the node graph of ProceduralTreeGeneration.hlsl:
+//   Entry -> Chunks -> TreeRoots -> Stem[tree type] (recursive) -> DrawSegment, DrawSegmentShadow
+//                                                      -> Twig[tree type] -> DrawSegment(Shadow), CoalesceDrawSegments, CoalesceDrawLeaves
+//                                                      -> CoalesceDrawSegments[0..1] -> DrawSegmentBundle(Shadow)
+//                                                      -> CoalesceDrawLeaves[0..2] -> DrawLeafBundle(Shadow) / DrawFruitBundle
+//                               -> TreeInstance -> DrawSegment(Shadow), CoalesceDrawSegments, CoalesceDrawLeaves
+//         -> TreeTemplates -> Stem[tree type]
+//         -> Skybox, SimpleCube, SimpleCubeShadow, UserInterface
+// The nodes run the node functions of the shader headers as written (e.g. GenerateStem in TreeGeneration.h), one
+// thread group per task on a Wave (see WorkGraph.h); only the mesh nodes are reduced to their output counts.
+
+struct TreeGraphOptions {
+    uint32_t treeType          = 0;
+    uint32_t seed              = 0;
+    // Trees are generated in the chunks around the camera up to this distance (see Chunks.h); the default is
+    // DefaultDrawDistance of Chunks.h
+    float    drawDistance      = 20.f;
+    // Template trees the forest is instanced from, 0 generates every tree (see TreeTemplates.h)
+    uint32_t treeTemplateCount = 0;
+    // Triangles per frame in millions, 0 draws at full detail (see TriangleBudget.h)
+    float    triangleBudget    = 0.f;
+    float    season            = 2.f;
+    float    windStrength      = 5.f;
+    float    time              = 0.f;
+
+    uint32_t renderWidth  = 1920;
+    uint32_t renderHeight = 1080;
+
+    float cameraYaw      = 0.f;
+    float cameraPitch    = 20.f;
+    // Negative values select the default distance of the playground (1.2 times the tree height)
+    float cameraDistance = -1.f;
+};
+
+class TreeGraph {
+public:
+    // Node handles, defined in TreeGraph.cpp
+    struct Nodes;
+
+    explicit TreeGraph(ThreadPool& pool);
+    ~TreeGraph();
+
+    // Runs Entry once and drains the graph.
+    void RunFrame(const TreeGraphOptions& options);
+
+    WorkGraph&       GetGraph() { return graph_; }
+    const WorkGraph& GetGraph() const { return graph_; }
+
+    // Number of trees (TreeRoots output records) generated since the last statistics reset.
+    uint64_t GetTreeCount() const;
+
+    // Statistics counters (Statistics.h) of the last frame, as read by the UserInterface_Statistics_* nodes.
+    std::vector<std::pair<std::string, uint32_t>> GetFrameCounters() const;
+
+    // Detail factor of the triangle budget controller (TriangleBudget.h) in the last frame.
+    float GetTriangleBudgetDetail() const;
+
+private:
+    WorkGraph              graph_;
+    std::unique_ptr<Nodes> nodes_;
+    TreeGraphOptions       options_;
+};
@@ -0,0 +1,556 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "Wave.h"
+
+// ============================ Work Graph Emulation ====================
+// Host emulation of the D3D12 work graph node launch modes. Nodes are invoked on a thread pool:
+//   thread       - one task per input record
+//   broadcasting - one task per thread group of the (fixed or record-provided) dispatch grid
+//   coalescing   - records are batched up to MaxRecords; partial batches are flushed when the
+//                  graph runs out of other work
+//   mesh         - sink node; the group function only reports its SetMeshOutputCounts(V, T)
+// A thread group is executed as a single task. Node functions compiled from the shader source run the lanes of the
+// group on a Wave (see Shader Node Functions below).
+
+struct Uint3 {
+    uint32_t x = 1;
+    uint32_t y = 1;
+    uint32_t z = 1;
+
+    uint32_t Count() const { return x * y * z; }
+
+    bool Exceeds(const Uint3& max) const { return (x > max.x) || (y > max.y) || (z > max.z); }
+};
+
+struct MeshOutputCounts {
+    uint32_t vertices   = 0;
+    uint32_t primitives = 0;
+};
+
+struct NodeStatistics {
+    std::atomic<uint64_t> inputRecords     = 0;
+    std::atomic<uint64_t> threadGroups     = 0;
+    std::atomic<uint64_t> outputRecords    = 0;
+    std::atomic<uint64_t> vertices         = 0;
+    std::atomic<uint64_t> primitives       = 0;
+    std::atomic<uint64_t> budgetViolations = 0;
+
+    void Reset()
+    {
+        inputRecords     = 0;
+        threadGroups     = 0;
+        outputRecords    = 0;
+        vertices         = 0;
+        primitives       = 0;
+        budgetViolations = 0;
+    }
+};
+
+class WorkGraph;
+
+class NodeBase {
+public:
+    NodeBase(WorkGraph& graph, std::string name, std::string launch)
+        : graph_(graph), name_(std::move(name)), launch_(std::move(launch))
+    {
+    }
+    virtual ~NodeBase() = default;
+
+    const std::string&    GetName() const { return name_; }
+    const std::string&    GetLaunch() const { return launch_; }
+    NodeStatistics&       GetStatistics() { return statistics_; }
+    const NodeStatistics& GetStatistics() const { return statistics_; }
+
+    // Launches pending partial work (coalescing batches). Returns true if any work was launched.
+    virtual bool Flush() { return false; }
+
+protected:
+    ThreadPool& GetPool();
+
+    WorkGraph&     graph_;
+    std::string    name_;
+    std::string    launch_;
+    NodeStatistics statistics_;
+};
+
+// Node that accepts records of type Record.
+// recursionLevel is 0 for records from other nodes and the producer's level plus one for recursive outputs.
+template <typename Record>
+class InputNode : public NodeBase {
+public:
+    using NodeBase::NodeBase;
+
+    virtual void Enqueue(std::vector<Record>&& records, uint32_t recursionLevel) = 0;
+};
+
+// Records of one thread, returned by NodeOutput::GetThreadNodeOutputRecords, or of the whole thread group, returned by
+// NodeOutput::GetGroupNodeOutputRecords.
+template <typename Record>
+class ThreadNodeOutputRecords {
+public:
+    explicit ThreadNodeOutputRecords(Record* records) : records_(records) {}
+
+    Record& Get(uint32_t index = 0) const { return records_[index]; }
+
+    // Records are submitted with the NodeOutput
+    void OutputComplete() const {}
+
+private:
+    Record* records_;
+};
+
+template <typename Record>
+using GroupNodeOutputRecords = ThreadNodeOutputRecords<Record>;
+
+// Input records of a coalescing node function compiled from the shader source.
+template <typename Record>
+class GroupNodeInputRecords {
+public:
+    explicit GroupNodeInputRecords(const std::vector<Record>& records) : records_(records) {}
+
+    const Record& Get(uint32_t index = 0) const { return records_[index]; }
+
+    uint32_t Count() const { return uint32_t(records_.size()); }
+
+private:
+    const std::vector<Record>& records_;
+};
+
+// Records written by one thread group to one output, submitted to the target when the group completes.
+// Mirrors GetThreadNodeOutputRecords/OutputComplete; MaxRecords is validated on submission.
+template <typename Record>
+class NodeOutput {
+public:
+    NodeOutput(NodeStatistics& producer, InputNode<Record>* target, uint32_t maxRecords, uint32_t recursionLevel = 0)
+        : producer_(producer), target_(target), maxRecords_(maxRecords), recursionLevel_(recursionLevel)
+    {
+    }
+
+    ~NodeOutput() { Submit(); }
+
+    NodeOutput(const NodeOutput&)            = delete;
+    NodeOutput& operator=(const NodeOutput&) = delete;
+
+    Record& Emit()
+    {
+        records_.emplace_back();
+        return records_.back();
+    }
+
+    uint32_t Count() const { return uint32_t(records_.size()); }
+
+    // GetThreadNodeOutputRecords of a node function compiled from the shader source. Called by all lanes of the
+    // Wave; the records of a lane stay valid until the next call.
+    ThreadNodeOutputRecords<Record> GetThreadNodeOutputRecords(uint32_t recordCount)
+    {
+        const uint32_t groupFirst = Count();
+
+        // Offset of the lane and record count of the wave in one wave operation
+        const LaneRecords records = Wave::GetCurrent().Exchange(recordCount, [](auto recordCountOfLane) {
+            LaneRecords records;
+            for (uint32_t lane = 0; lane < WaveGetLaneCount(); ++lane) {
+                records.offset += (lane < WaveGetLaneIndex()) ? recordCountOfLane(lane) : 0;
+                records.waveCount += recordCountOfLane(lane);
+            }
+            return records;
+        });
+
+        return GetLaneRecords(groupFirst, records);
+    }
+
+    // Offset of the records of a lane within the records of its wave, see GetThreadNodeOutputRecords
+    struct LaneRecords {
+        uint32_t offset    = 0;
+        uint32_t waveCount = 0;
+    };
+
+    // Records of a lane after the wave operation that allocates them; groupFirst is Count() before that operation.
+    // Lanes resume one after another, the first one appends the records of the wave.
+    ThreadNodeOutputRecords<Record> GetLaneRecords(uint32_t groupFirst, const LaneRecords& records)
+    {
+        if (records_.size() < groupFirst + records.waveCount) {
+            records_.resize(groupFirst + records.waveCount);
+        }
+        return ThreadNodeOutputRecords<Record>(records_.data() + groupFirst + records.offset);
+    }
+
+    // GetGroupNodeOutputRecords of a node function compiled from the shader source; recordCount is group-uniform.
+    GroupNodeOutputRecords<Record> GetGroupNodeOutputRecords(uint32_t recordCount)
+    {
+        const uint32_t first = Count();
+        GroupMemoryBarrierWithGroupSync();
+
+        if (WaveIsFirstLane()) {
+            records_.resize(records_.size() + recordCount);
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        return GroupNodeOutputRecords<Record>(records_.data() + first);
+    }
+
+    void Submit()
+    {
+        if (records_.empty()) {
+            return;
+        }
+        producer_.outputRecords += records_.size();
+        if (records_.size() > maxRecords_) {
+            producer_.budgetViolations += 1;
+        }
+        if (target_ != nullptr) {
+            target_->Enqueue(std::move(records_), recursionLevel_);
+        }
+        records_.clear();
+    }
+
+private:
+    NodeStatistics&     producer_;
+    InputNode<Record>*  target_;
+    uint32_t            maxRecords_;
+    uint32_t            recursionLevel_;
+    std::vector<Record> records_;
+};
+
+// Validates a MaxRecordsSharedWith budget, which spans several outputs of the same group.
+inline void ValidateSharedBudget(NodeStatistics& producer, uint32_t count, uint32_t maxRecords)
+{
+    if (count > maxRecords) {
+        producer.budgetViolations += 1;
+    }
+}
+
+// ============================ Shader Node Functions ====================
+// Node functions compiled from the shader source as written, e.g. GenerateStem in TreeGeneration.h, take their
+// outputs as NodeOutput and NodeOutputArray references and run the lanes of a thread group on a Wave.
+
+// Outputs of a node output array, owned by the caller.
+template <typename Record>
+class NodeOutputArray {
+public:
+    // Output of the array as indexed by one lane. Lanes may index different outputs.
+    class Element {
+    public:
+        Element(const NodeOutputArray& array, uint32_t index) : array_(array), index_(index) {}
+
+        // Called by all lanes of the Wave, like NodeOutput::GetThreadNodeOutputRecords; the offset of a lane only
+        // counts the records of lanes that index the same output.
+        ThreadNodeOutputRecords<Record> GetThreadNodeOutputRecords(uint32_t recordCount) const
+        {
+            using LaneRecords = typename NodeOutput<Record>::LaneRecords;
+
+            struct LaneOutput {
+                uint32_t index;
+                uint32_t recordCount;
+            };
+
+            NodeOutput<Record>& output     = array_.outputs_[index_];
+            const uint32_t      groupFirst = output.Count();
+
+            const LaneRecords records = Wave::GetCurrent().Exchange(LaneOutput{ index_, recordCount }, [index = index_](auto outputOfLane) {
+                LaneRecords records;
+                for (uint32_t lane = 0; lane < WaveGetLaneCount(); ++lane) {
+                    const LaneOutput laneOutput = outputOfLane(lane);
+                    if (laneOutput.index == index) {
+                        records.offset += (lane < WaveGetLaneIndex()) ? laneOutput.recordCount : 0;
+                        records.waveCount += laneOutput.recordCount;
+                    }
+                }
+                return records;
+            });
+
+            return output.GetLaneRecords(groupFirst, records);
+        }
+
+    private:
+        const NodeOutputArray& array_;
+        uint32_t               index_;
+    };
+
+    template <size_t Size>
+    explicit NodeOutputArray(NodeOutput<Record> (&outputs)[Size]) : outputs_(outputs), size_(uint32_t(Size))
+    {
+    }
+
+    Element operator[](uint32_t index) const { return Element(*this, index); }
+
+private:
+    NodeOutput<Record>* outputs_;
+    uint32_t            size_;
+};
+
+// GetRemainingRecursionLevels of the thread group running on the calling thread
+inline thread_local uint32_t shaderGroupRemainingRecursionLevels = 0;
+
+inline uint32_t GetRemainingRecursionLevels()
+{
+    return shaderGroupRemainingRecursionLevels;
+}
+
+// Runs function(gtid) on the threadCount lanes of a Wave of the calling thread. Groups on different threads run
+// concurrently, as groupshared variables are thread_local.
+inline void RunShaderGroup(uint32_t threadCount, uint32_t remainingRecursionLevels, const std::function<void(uint32_t)>& function)
+{
+    thread_local std::vector<std::unique_ptr<Wave>> waves;
+
+    auto wave = std::find_if(waves.begin(), waves.end(), [=](const auto& wave) { return wave->GetLaneCount() == threadCount; });
+    if (wave == waves.end()) {
+        wave = waves.insert(waves.end(), std::make_unique<Wave>(threadCount));
+    }
+
+    shaderGroupRemainingRecursionLevels = remainingRecursionLevels;
+    (*wave)->Run(function);
+}
+
+// ============================ Launch Modes ====================
+
+template <typename Record>
+class ThreadNode : public InputNode<Record> {
+public:
+    using Function = std::function<void(const Record&)>;
+
+    ThreadNode(WorkGraph& graph, std::string name, Function function)
+        : InputNode<Record>(graph, std::move(name), "thread"), function_(std::move(function))
+    {
+    }
+
+    void Enqueue(std::vector<Record>&& records, uint32_t) override
+    {
+        this->statistics_.inputRecords += records.size();
+        this->statistics_.threadGroups += records.size();
+
+        for (Record& record : records) {
+            this->GetPool().Submit([this, record = std::move(record)] { function_(record); });
+        }
+    }
+
+private:
+    Function function_;
+};
+
+template <typename Record>
+class BroadcastingNode : public InputNode<Record> {
+public:
+    // groupId, record, remaining recursion levels (GetRemainingRecursionLevels)
+    using Function     = std::function<void(const Uint3&, const Record&, uint32_t)>;
+    using GridFunction = std::function<Uint3(const Record&)>;
+
+    BroadcastingNode(WorkGraph&   graph,
+                     std::string  name,
+                     Function     function,
+                     GridFunction grid,
+                     Uint3        maxDispatchGrid,
+                     uint32_t     maxRecursionDepth = 0)
+        : InputNode<Record>(graph, std::move(name), "broadcasting"),
+          function_(std::move(function)),
+          grid_(std::move(grid)),
+          maxDispatchGrid_(maxDispatchGrid),
+          maxRecursionDepth_(maxRecursionDepth)
+    {
+    }
+
+    void Enqueue(std::vector<Record>&& records, uint32_t recursionLevel) override
+    {
+        this->statistics_.inputRecords += records.size();
+
+        if (recursionLevel > maxRecursionDepth_) {
+            // Exceeding NodeMaxRecursionDepth is undefined behavior on the GPU
+            this->statistics_.budgetViolations += records.size();
+            return;
+        }
+
+        const uint32_t remainingRecursionLevels = maxRecursionDepth_ - recursionLevel;
+
+        for (const Record& record : records) {
+            const Uint3 grid = grid_(record);
+            this->statistics_.threadGroups += grid.Count();
+            this->statistics_.budgetViolations += grid.Exceeds(maxDispatchGrid_);
+
+            for (uint32_t z = 0; z < grid.z; ++z) {
+                for (uint32_t y = 0; y < grid.y; ++y) {
+                    for (uint32_t x = 0; x < grid.x; ++x) {
+                        this->GetPool().Submit([this, record, groupId = Uint3{ x, y, z }, remainingRecursionLevels] {
+                            function_(groupId, record, remainingRecursionLevels);
+                        });
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    Function     function_;
+    GridFunction grid_;
+    Uint3        maxDispatchGrid_;
+    uint32_t     maxRecursionDepth_;
+};
+
+template <typename Record>
+class CoalescingNode : public InputNode<Record> {
+public:
+    using Function = std::function<void(const std::vector<Record>&)>;
+
+    CoalescingNode(WorkGraph& graph, std::string name, Function function, uint32_t maxRecords)
+        : InputNode<Record>(graph, std::move(name), "coalescing"), function_(std::move(function)), maxRecords_(maxRecords)
+    {
+    }
+
+    void Enqueue(std::vector<Record>&& records, uint32_t) override
+    {
+        this->statistics_.inputRecords += records.size();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Record& record : records) {
+            pending_.push_back(std::move(record));
+            if (pending_.size() == maxRecords_) {
+                Launch();
+            }
+        }
+    }
+
+    bool Flush() override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.empty()) {
+            return false;
+        }
+        Launch();
+        return true;
+    }
+
+private:
+    // requires mutex_ to be held
+    void Launch()
+    {
+        this->statistics_.threadGroups += 1;
+        this->GetPool().Submit([this, batch = std::move(pending_)] { function_(batch); });
+        pending_ = {};
+        pending_.reserve(maxRecords_);
+    }
+
+    Function            function_;
+    uint32_t            maxRecords_;
+    std::mutex          mutex_;
+    std::vector<Record> pending_;
+};
+
+template <typename Record>
+class MeshNode : public InputNode<Record> {
+public:
+    using Function     = std::function<MeshOutputCounts(const Uint3&, const Record&)>;
+    using GridFunction = std::function<Uint3(const Record&)>;
+
+    MeshNode(WorkGraph&       graph,
+             std::string      name,
+             Function         function,
+             GridFunction     grid,
+             MeshOutputCounts maxOutputCounts,
+             Uint3            maxDispatchGrid = Uint3{ 1, 1, 1 })
+        : InputNode<Record>(graph, std::move(name), "mesh"),
+          function_(std::move(function)),
+          grid_(std::move(grid)),
+          maxOutputCounts_(maxOutputCounts),
+          maxDispatchGrid_(maxDispatchGrid)
+    {
+    }
+
+    // Mesh nodes are leaves of the graph, so groups are evaluated inline by the producer.
+    void Enqueue(std::vector<Record>&& records, uint32_t) override
+    {
+        this->statistics_.inputRecords += records.size();
+
+        uint64_t groups     = 0;
+        uint64_t vertices   = 0;
+        uint64_t primitives = 0;
+        uint64_t violations = 0;
+
+        for (const Record& record : records) {
+            const Uint3 grid = grid_(record);
+            groups += grid.Count();
+            violations += grid.Exceeds(maxDispatchGrid_);
+
+            for (uint32_t z = 0; z < grid.z; ++z) {
+                for (uint32_t y = 0; y < grid.y; ++y) {
+                    for (uint32_t x = 0; x < grid.x; ++x) {
+                        const MeshOutputCounts counts = function_(Uint3{ x, y, z }, record);
+                        vertices += counts.vertices;
+                        primitives += counts.primitives;
+                        violations += (counts.vertices > maxOutputCounts_.vertices) ||
+                                      (counts.primitives > maxOutputCounts_.primitives);
+                    }
+                }
+            }
+        }
+
+        this->statistics_.threadGroups += groups;
+        this->statistics_.vertices += vertices;
+        this->statistics_.primitives += primitives;
+        this->statistics_.budgetViolations += violations;
+    }
+
+private:
+    Function         function_;
+    GridFunction     grid_;
+    MeshOutputCounts maxOutputCounts_;
+    Uint3            maxDispatchGrid_;
+};
+
+// ============================ Graph ====================
+
+class WorkGraph {
+public:
+    explicit WorkGraph(ThreadPool& pool) : pool_(pool) {}
+
+    template <typename Node, typename... Args>
+    Node& AddNode(Args&&... args)
+    {
+        nodes_.emplace_back(std::make_unique<Node>(*this, std::forward<Args>(args)...));
+        return static_cast<Node&>(*nodes_.back());
+    }
+
+    // Runs until the graph is drained: no queued tasks and no pending coalescing batches.
+    void Drain()
+    {
+        while (true) {
+            pool_.WaitIdle();
+
+            bool flushed = false;
+            for (auto& node : nodes_) {
+                flushed |= node->Flush();
+            }
+            if (!flushed) {
+                return;
+            }
+        }
+    }
+
+    void ResetStatistics()
+    {
+        for (auto& node : nodes_) {
+            node->GetStatistics().Reset();
+        }
+    }
+
+    ThreadPool& GetPool() { return pool_; }
+
+    const std::vector<std::unique_ptr<NodeBase>>& GetNodes() const { return nodes_; }
+
+private:
+    ThreadPool&                            pool_;
+    std::vector<std::unique_ptr<NodeBase>> nodes_;
+};
+
+inline ThreadPool& NodeBase::GetPool()
+{
+    return graph_.GetPool();
+}
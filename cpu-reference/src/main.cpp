@@ -0,0 +1,176 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "QuaternionCodec.h"
+#include "ThreadPool.h"
+#include "TreeGraph.h"
+
+namespace {
+
+    void PrintUsage(const char* executable)
+    {
+        std::printf(
+            "Usage: %s [options]\n"
+            "  --tree-type <0-3>        apple, sassafras, palm, tamarack (default 0)\n"
+            "  --seed <n>               base seed of the forest (default 0)\n"
+            "  --draw-distance <d>      distance up to which chunks generate trees (default 20)\n"
+            "  --templates <n>          instance the trees from n template trees of an earlier frame,\n"
+            "                           i.e. only from the second frame on (default 0: no instancing)\n"
+            "  --triangle-budget <m>    steer the detail towards m million triangles per frame, measured\n"
+            "                           in the previous frame (default 0: full detail)\n"
+            "  --frames <n>             number of graph launches (default 1)\n"
+            "  --threads <n>            worker threads (default: all cores)\n"
+            "  --season <0-4>           season (default 2)\n"
+            "  --wind <strength>        wind strength (default 5)\n"
+            "  --time <seconds>         animation time (default 0)\n"
+            "  --render-size <w> <h>    render target size (default 1920 1080)\n"
+            "  --camera <yaw> <pitch> <distance>\n"
+            "                           orbit camera in degrees, negative distance for default\n"
+            "  --counters               print the statistics counters of the scratch buffer\n"
+            "  --codec-benchmark <n>    benchmark the batch qCompress32/qCompress64 codecs on n random\n"
+            "                           rotations instead of running the graph\n",
+            executable);
+    }
+
+    void PrintStatistics(const WorkGraph& graph)
+    {
+        std::printf("%-24s %-13s %12s %12s %12s %12s %12s %10s\n",
+                    "Node", "Launch", "Records", "Groups", "Outputs", "Vertices", "Triangles", "Violations");
+
+        for (const auto& node : graph.GetNodes()) {
+            const NodeStatistics& s = node->GetStatistics();
+            std::printf("%-24s %-13s %12llu %12llu %12llu %12llu %12llu %10llu\n",
+                        node->GetName().c_str(),
+                        node->GetLaunch().c_str(),
+                        (unsigned long long)s.inputRecords.load(),
+                        (unsigned long long)s.threadGroups.load(),
+                        (unsigned long long)s.outputRecords.load(),
+                        (unsigned long long)s.vertices.load(),
+                        (unsigned long long)s.primitives.load(),
+                        (unsigned long long)s.budgetViolations.load());
+        }
+    }
+
+    void PrintQuaternionCodecBenchmark(const QuaternionCodecBenchmark& benchmark)
+    {
+        std::printf("%llu random rotations, %s batch codec\n\n",
+                    (unsigned long long)benchmark.count,
+                    IsQuaternionCodecVectorized() ? "AVX2" : "scalar");
+        std::printf("%-16s %16s %16s %8s %10s\n", "Function", "Scalar [M/s]", "Batch [M/s]", "Speedup", "Mismatches");
+
+        for (const QuaternionCodecTiming& t : benchmark.timings) {
+            std::printf("%-16s %16.1f %16.1f %7.2fx %10llu\n",
+                        t.name.c_str(),
+                        benchmark.count / t.scalarSeconds * 1e-6,
+                        benchmark.count / t.batchSeconds * 1e-6,
+                        t.scalarSeconds / t.batchSeconds,
+                        (unsigned long long)t.mismatches);
+        }
+
+        std::printf("\nMax angular error: qCompress32 %.4f deg, qCompress64 %.6f deg\n",
+                    benchmark.maxAngularError32 * 180.0 / 3.14159265358979323846,
+                    benchmark.maxAngularError64 * 180.0 / 3.14159265358979323846);
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    TreeGraphOptions options;
+    uint32_t         frames      = 1;
+    uint32_t         threadCount = std::thread::hardware_concurrency();
+    bool             counters    = false;
+    uint32_t         codecCount  = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--tree-type") {
+            options.treeType = std::atoi(next());
+        } else if (arg == "--seed") {
+            options.seed = std::atoi(next());
+        } else if (arg == "--draw-distance") {
+            options.drawDistance = std::atof(next());
+        } else if (arg == "--templates") {
+            options.treeTemplateCount = std::atoi(next());
+        } else if (arg == "--triangle-budget") {
+            options.triangleBudget = std::atof(next());
+        } else if (arg == "--frames") {
+            frames = std::atoi(next());
+        } else if (arg == "--threads") {
+            threadCount = std::atoi(next());
+        } else if (arg == "--season") {
+            options.season = std::atof(next());
+        } else if (arg == "--wind") {
+            options.windStrength = std::atof(next());
+        } else if (arg == "--time") {
+            options.time = std::atof(next());
+        } else if (arg == "--render-size") {
+            options.renderWidth  = std::atoi(next());
+            options.renderHeight = std::atoi(next());
+        } else if (arg == "--camera") {
+            options.cameraYaw      = std::atof(next());
+            options.cameraPitch    = std::atof(next());
+            options.cameraDistance = std::atof(next());
+        } else if (arg == "--counters") {
+            counters = true;
+        } else if (arg == "--codec-benchmark") {
+            codecCount = std::atoi(next());
+        } else if (arg == "--help" || arg == "-h") {
+            PrintUsage(argv[0]);
+            return 0;
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (codecCount > 0) {
+        PrintQuaternionCodecBenchmark(RunQuaternionCodecBenchmark(codecCount, options.seed));
+        return 0;
+    }
+
+    ThreadPool pool(threadCount);
+    TreeGraph  treeGraph(pool);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        treeGraph.RunFrame(options);
+    }
+
+    const auto   end     = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+
+    PrintStatistics(treeGraph.GetGraph());
+
+    if (counters) {
+        std::printf("\nStatistics counters (last frame)\n");
+        for (const auto& [name, value] : treeGraph.GetFrameCounters()) {
+            std::printf("  %-28s %12u\n", name.c_str(), value);
+        }
+        std::printf("  %-28s %12.4f\n", "Triangle budget detail", treeGraph.GetTriangleBudgetDetail());
+    }
+
+    const uint64_t trees = treeGraph.GetTreeCount();
+    std::printf("\n%u frame(s), %llu trees on %u thread(s) in %.3f s: %.1f trees/s\n",
+                frames,
+                (unsigned long long)trees,
+                pool.GetThreadCount(),
+                seconds,
+                seconds > 0 ? trees / seconds : 0.0);
+
+    return 0;
+}
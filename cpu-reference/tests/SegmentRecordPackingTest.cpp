@@ -0,0 +1,214 @@
+// Packs tessellation data and ao distances into DrawSegmentRecords with CreateDrawSegmentRecord and checks the
+// values returned by GetSegmentTessellationData and GetSegmentAoDistance against the error bounds of the
+// packing (see Record Packing in SplineTessellation.h):
+//   - points on the 8.8 fixed point grid of QuantizeSegmentPoints, ring and thread group counts are exact,
+//   - points off the grid are off by at most half a grid step,
+//   - opening angles in [0, PI] are off by at most half a unorm16 step, plus the float rounding of the
+//     unpacked angle (one ulp of PI),
+//   - ao distances are off by at most half an ulp of their half, i.e. 2^-11 relative or 2^-25 absolute.
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+// Shader headers last: Common.h and Quaternion.h define macros with common names (random, X, Y, Z, ...)
+#include "Common.h"
+
+#include "Config.h"
+#include "TreeParameters.h"
+#include "Quaternion.h"
+#include "Records.h"
+#include "TreeModel.h"
+#include "Camera.h"
+#include "SplineTessellation.h"
+
+namespace {
+
+    class Check {
+    public:
+        explicit Check(std::string name) : name_(std::move(name)) {}
+
+        // Records the error of one value; fails if it exceeds bound
+        void Add(float value, float error, float bound)
+        {
+            ++count_;
+            if (!(error <= bound)) {
+                if (failures_ < 8) {
+                    std::printf("  %s: value %.9g, error %.9g exceeds %.9g\n", name_.c_str(), value, error, bound);
+                }
+                ++failures_;
+            }
+            maxRelativeError_ = max(maxRelativeError_, (bound > 0) ? error / bound : error);
+        }
+
+        uint Report() const
+        {
+            std::printf("%-24s %10u values, max error %.3f of bound, %u failure(s)\n",
+                        name_.c_str(), count_, maxRelativeError_, failures_);
+            return failures_;
+        }
+
+    private:
+        std::string name_;
+        uint        count_            = 0;
+        uint        failures_         = 0;
+        float       maxRelativeError_ = 0;
+    };
+
+    DrawSegmentRecord Pack(const SegmentTessellationData& tessellationData, float aoDistance)
+    {
+        TreeTransform trafo;
+        trafo.pos = float3(0, 0, 0);
+        trafo.rot = float4(0, 0, 0, 1);
+
+        SegmentInfo si;
+        si.level  = 0;
+        si.fromZ  = 0;
+        si.toZ    = 0;
+        si.length = 1;
+        si.radius = 1;
+
+        return CreateDrawSegmentRecord(trafo, trafo, si, aoDistance, tessellationData);
+    }
+
+    SegmentTessellationData CreateTessellationData(float points, float openingAngle)
+    {
+        SegmentTessellationData data;
+        data.threadGroupCount  = 1;
+        data.fromPoints        = points;
+        data.toPoints          = points;
+        data.vPoints           = points;
+        data.faceRingsPerGroup = 1;
+        data.fromOpeningAngle  = openingAngle;
+        data.toOpeningAngle    = openingAngle;
+        return data;
+    }
+
+    // Calls function(x) for x, the floats next to it, and the midpoints to the next step of a grid of the given
+    // step size, i.e. the values that round to either side
+    void SweepGrid(float first, float last, float step, const std::function<void(float)>& function)
+    {
+        const uint steps = uint(round((last - first) / step));
+
+        for (uint i = 0; i <= steps; ++i) {
+            for (const float value : { first + i * step, first + (i + .5f) * step }) {
+                function(value);
+                function(std::nextafter(value, -INFINITY));
+                function(std::nextafter(value, INFINITY));
+            }
+        }
+    }
+
+    uint TestPoints()
+    {
+        Check onGrid("Points on grid");
+        Check offGrid("Points off grid");
+
+        const float maxPoints = float(max(maxPointsU, maxPointsV));
+        const float step      = 1.f / segmentPointsScale;
+
+        for (float points = 0; points <= maxPoints; points += step) {
+            const SegmentTessellationData unpacked = GetSegmentTessellationData(Pack(CreateTessellationData(points, 0), 0));
+
+            onGrid.Add(points, abs(unpacked.fromPoints - points), 0);
+            onGrid.Add(points, abs(unpacked.toPoints - points), 0);
+            onGrid.Add(points, abs(unpacked.vPoints - points), 0);
+        }
+
+        SweepGrid(minPoints, maxPoints, step, [&](float points) {
+            const SegmentTessellationData unpacked = GetSegmentTessellationData(Pack(CreateTessellationData(points, 0), 0));
+
+            offGrid.Add(points, abs(unpacked.fromPoints - points), .5f * step);
+        });
+
+        return onGrid.Report() + offGrid.Report();
+    }
+
+    uint TestCounts()
+    {
+        Check counts("Rings and groups");
+
+        for (uint count = 0; count <= uint(maxPointsV); ++count) {
+            SegmentTessellationData data = CreateTessellationData(minPoints, 0);
+            data.threadGroupCount        = count;
+            data.faceRingsPerGroup       = int(count);
+
+            const SegmentTessellationData unpacked = GetSegmentTessellationData(Pack(data, 0));
+
+            counts.Add(float(count), float(abs(int(unpacked.threadGroupCount) - int(count))), 0);
+            counts.Add(float(count), float(abs(unpacked.faceRingsPerGroup - int(count))), 0);
+        }
+
+        return counts.Report();
+    }
+
+    uint TestOpeningAngles()
+    {
+        Check angles("Opening angles");
+
+        const float step     = PI / 65535.f;
+        const float maxError = .5f * step + (std::nextafter(PI, INFINITY) - PI);
+
+        const auto check = [&](float angle) {
+            angle = clamp(angle, 0.f, PI);
+
+            const SegmentTessellationData unpacked = GetSegmentTessellationData(Pack(CreateTessellationData(minPoints, angle), 0));
+
+            angles.Add(angle, abs(unpacked.fromOpeningAngle - angle), maxError);
+            angles.Add(angle, abs(unpacked.toOpeningAngle - angle), maxError);
+        };
+
+        SweepGrid(0, PI, step, check);
+        // Extremes and the opening angle of segments with less than five points
+        for (const float angle : { 0.f, .5f * PI, PI }) {
+            check(angle);
+        }
+
+        return angles.Report();
+    }
+
+    uint TestAoDistances()
+    {
+        Check normal("Ao distances");
+        Check subnormal("Ao distances subnormal");
+
+        // Every finite non-negative half, the floats next to it and the midpoints to the next half
+        for (uint half = 0; half < 0x7BFF; ++half) {
+            const float value = f16tof32(half);
+            const float next  = f16tof32(half + 1);
+
+            for (const float midpoint : { value, .5f * (value + next) }) {
+                for (const float aoDistance : { std::nextafter(midpoint, -INFINITY), midpoint, std::nextafter(midpoint, INFINITY) }) {
+                    if (aoDistance < 0) {
+                        continue;
+                    }
+
+                    const float error    = abs(GetSegmentAoDistance(Pack(CreateTessellationData(minPoints, 0), aoDistance)) - aoDistance);
+                    const bool  isNormal = aoDistance >= std::ldexp(1.f, -14);
+                    const float maxError = isNormal ? aoDistance * std::ldexp(1.f, -11) : std::ldexp(1.f, -25);
+
+                    (isNormal ? normal : subnormal).Add(aoDistance, error, maxError);
+                }
+            }
+        }
+
+        return normal.Report() + subnormal.Report();
+    }
+
+} // namespace
+
+int main()
+{
+    // CreateDrawSegmentRecord packs the cage relative to the root of tree 0
+    TreeRoot root;
+    root.pos    = float3(0, 0, 0);
+    root.radius = 1;
+    StoreTreeRoot(0, root);
+
+    const uint failures = TestPoints() + TestCounts() + TestOpeningAngles() + TestAoDistances();
+
+    std::printf("\n%u failure(s)\n", failures);
+
+    return failures == 0 ? 0 : 1;
+}
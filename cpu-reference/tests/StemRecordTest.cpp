@@ -0,0 +1,445 @@
+// Runs the Stem and Twig nodes, which run GenerateStem and GenerateTwig of TreeGeneration.h as written, on the same
+// trees with one worker thread and with several. Fails if the two runs disagree on the contents of any record that
+// Stem and Twig receive or output (position, rotation, scale, seed, tessellation, continuation, ...), if Stem or
+// Twig exceed their output budgets, or if a tree type has more levels than the Stem recursion depth is sized for.
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "TreeGraph.h"
+#include "WorkGraph.h"
+
+// Shader headers last: Common.h and Quaternion.h define macros with common names (random, X, Y, Z, ...)
+#include "Common.h"
+
+#include "Config.h"
+#include "TreeParameters.h"
+#include "Quaternion.h"
+#include "Records.h"
+#include "TreeModel.h"
+#include "Camera.h"
+#include "Shadow.h"
+#include "LeafDensity.h"
+#include "SplineTessellation.h"
+#include "Statistics.h"
+#include "TriangleBudget.h"
+#include "StemGrowth.h"
+#include "Occlusion.h"
+#include "Chunks.h"
+#include "TreeTemplates.h"
+#include "TreeGeneration.h"
+
+namespace {
+
+    struct TestCase {
+        std::string name;
+        float       cameraDistance;
+        float       windStrength;
+        bool        isTemplate;
+        bool        isCameraOccluded;
+        // Runs on the tree types below; the variants only run on tree type 0, which is cheap and has twigs and
+        // blossoms, to keep the test at a few seconds
+        uint        treeTypeCount;
+    };
+
+    // Worker threads of the run that is compared with a single worker thread
+    constexpr uint parallelThreadCount = 4;
+
+    // ============================ Record Fields ====================
+    // Records are compared field by field; floats by their bits, as both runs execute the same code.
+
+    struct Field {
+        const char* name;
+        uint64_t    value;
+    };
+
+    using Fields = std::vector<Field>;
+
+    uint64_t Bits(float value)
+    {
+        return std::bit_cast<uint32_t>(value);
+    }
+
+    Fields GetFields(const GenerateTreeRecord& record)
+    {
+        return {
+            { "pos.x", record.trafo.pos.x },
+            { "pos.y", record.trafo.pos.y },
+            { "rot", record.trafo.rot },
+            { "seed", record.seed },
+            { "children", record.children },
+            { "firstChild", record.firstChild },
+            { "level", record.level },
+            { "lod", record.lod },
+            { "isTemplate", record.isTemplate },
+            { "isCameraOccluded", record.isCameraOccluded },
+            { "firstSegment", record.firstSegment },
+            { "scale", Bits(record.scale) },
+            { "length", Bits(record.length) },
+            { "radius", Bits(record.radius) },
+            { "aoDistance", Bits(record.aoDistance) },
+        };
+    }
+
+    Fields GetFields(const DrawSegmentRecord& record)
+    {
+        return {
+            { "cage.from.pos.x", Bits(record.cage.from.trafo.x) },
+            { "cage.from.pos.y", Bits(record.cage.from.trafo.y) },
+            { "cage.from.pos.z", Bits(record.cage.from.trafo.z) },
+            { "cage.from.rot", Bits(record.cage.from.trafo.w) },
+            { "cage.to.pos.x", Bits(record.cage.to.trafo.x) },
+            { "cage.to.pos.y", Bits(record.cage.to.trafo.y) },
+            { "cage.to.pos.z", Bits(record.cage.to.trafo.z) },
+            { "cage.to.rot", Bits(record.cage.to.trafo.w) },
+            { "si.level", record.si.level },
+            { "si.fromZ", record.si.fromZ },
+            { "si.toZ", record.si.toZ },
+            { "si.length", Bits(record.si.length) },
+            { "si.radius", Bits(record.si.radius) },
+            { "fromPoints", record.fromPoints },
+            { "toPoints", record.toPoints },
+            { "vPoints", record.vPoints },
+            { "faceRingsPerGroup", record.faceRingsPerGroup },
+            { "fromOpeningAngle", record.fromOpeningAngle },
+            { "toOpeningAngle", record.toOpeningAngle },
+            { "aoDistance", record.aoDistance },
+            { "dispatchGrid", record.dispatchGrid },
+        };
+    }
+
+    Fields GetFields(const DrawLeafRecord& record)
+    {
+        return {
+            { "pos.x", record.trafo.pos.x },
+            { "pos.y", record.trafo.pos.y },
+            { "rot", record.trafo.rot },
+            { "seed", record.seed },
+            { "viewMask", record.viewMask },
+            { "scale", Bits(record.scale) },
+            { "aoDistance", Bits(record.aoDistance) },
+        };
+    }
+
+    bool IsLess(const Fields& a, const Fields& b)
+    {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](const Field& x, const Field& y) {
+            return x.value < y.value;
+        });
+    }
+
+    // Records of one run per node, sorted, as the order of records depends on the scheduling of thread groups
+    class RecordLog {
+    public:
+        template <typename Record>
+        void Add(const std::string& node, const Record& record)
+        {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            records_[node].push_back(GetFields(record));
+        }
+
+        void Add(const std::string& node, const Fields& fields)
+        {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            records_[node].push_back(fields);
+        }
+
+        std::map<std::string, std::vector<Fields>> Take()
+        {
+            std::map<std::string, std::vector<Fields>> records = std::move(records_);
+            for (auto& [node, nodeRecords] : records) {
+                std::sort(nodeRecords.begin(), nodeRecords.end(), IsLess);
+            }
+            records_.clear();
+            return records;
+        }
+
+    private:
+        std::mutex                                  mutex_;
+        std::map<std::string, std::vector<Fields>> records_;
+    };
+
+    // ============================ Stem Graph ====================
+    // Stem and Twig nodes of one tree type as in TreeGraph, with sinks that log the records of their outputs.
+
+    class StemGraph {
+    public:
+        StemGraph(ThreadPool& pool, uint treeType)
+            : graph_(pool), treeType_(treeType)
+        {
+            drawSegment_       = &AddSink<DrawSegmentRecord>("DrawSegment");
+            drawSegmentShadow_ = &AddSink<DrawSegmentRecord>("DrawSegmentShadow");
+            for (uint i = 0; i < 2; ++i) {
+                coalesceDrawSegments_[i] = &AddSink<DrawSegmentRecord>("CoalesceDrawSegments[" + std::to_string(i) + "]");
+            }
+            for (uint i = 0; i < 3; ++i) {
+                coalesceDrawLeaves_[i] = &AddSink<DrawLeafRecord>("CoalesceDrawLeaves[" + std::to_string(i) + "]");
+            }
+
+            twig_ = &graph_.AddNode<CoalescingNode<GenerateTreeRecord>>(
+                "Twig",
+                [this](const std::vector<GenerateTreeRecord>& irs) { Twig(irs); },
+                TwigThreadGroupSize);
+
+            stem_ = &graph_.AddNode<BroadcastingNode<GenerateTreeRecord>>(
+                "Stem",
+                [this](const Uint3&, const GenerateTreeRecord& record, uint32_t remainingRecursionLevels) {
+                    Stem(record, remainingRecursionLevels);
+                },
+                [](const GenerateTreeRecord&) { return Uint3{ 1, 1, 1 }; },
+                Uint3{ 1, 1, 1 },
+                stemMaxRecursionDepth);
+        }
+
+        // Records of all nodes for one tree, with the template counts and the budget violations of Stem and Twig
+        std::map<std::string, std::vector<Fields>> Run(const GenerateTreeRecord& record, uint64_t& budgetViolations)
+        {
+            // The template write bank collects the records of template trees
+            const uint headerAddress = GetTreeTemplateHeaderAddress(GetTreeTemplateWriteBank(0), 0);
+            PersistentScratchBuffer.Store<uint4>(headerAddress, uint4(0, 0, 0, 0));
+
+            graph_.ResetStatistics();
+            stem_->Enqueue({ record }, 0);
+            graph_.Drain();
+
+            const TreeTemplateHeader header = PersistentScratchBuffer.Load<TreeTemplateHeader>(headerAddress);
+            log_.Add("Template", Fields{ { "segmentCount", header.segmentCount }, { "leafCount", header.leafCount } });
+
+            budgetViolations = stem_->GetStatistics().budgetViolations.load() + twig_->GetStatistics().budgetViolations.load();
+
+            return log_.Take();
+        }
+
+    private:
+        template <typename Record>
+        ThreadNode<Record>& AddSink(const std::string& name)
+        {
+            return graph_.AddNode<ThreadNode<Record>>(name, [this, name](const Record& record) { log_.Add(name, record); });
+        }
+
+        void Stem(const GenerateTreeRecord& record, uint32_t remainingRecursionLevels)
+        {
+            log_.Add("Stem", record);
+
+            NodeStatistics& statistics = stem_->GetStatistics();
+
+            NodeOutput<GenerateTreeRecord> generateTreeOutput(
+                statistics, stem_, maxChildRecords, stemMaxRecursionDepth - remainingRecursionLevels + 1);
+            NodeOutput<GenerateTreeRecord> twigOutput(statistics, twig_, maxChildRecords);
+            NodeOutput<DrawLeafRecord>     drawLeafOutputs[3] = {
+                { statistics, coalesceDrawLeaves_[0], maxChildRecords },
+                { statistics, coalesceDrawLeaves_[1], maxChildRecords },
+                { statistics, coalesceDrawLeaves_[2], maxChildRecords },
+            };
+            NodeOutputArray<DrawLeafRecord> drawLeafOutput(drawLeafOutputs);
+            NodeOutput<DrawSegmentRecord>   drawSegmentOutput(statistics, drawSegment_, maxSegmentRecords);
+            NodeOutput<DrawSegmentRecord>   drawSegmentShadowOutput(statistics, drawSegmentShadow_, maxSegmentRecords);
+            NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentOutput(statistics, coalesceDrawSegments_[0], maxSegmentRecords);
+            NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentShadowOutput(statistics, coalesceDrawSegments_[1], maxSegmentRecords);
+
+            RunShaderGroup(StemThreadGroupSize, remainingRecursionLevels, [&](uint32_t gtid) {
+                GenerateStem(treeType_,
+                             gtid,
+                             record,
+                             generateTreeOutput,
+                             twigOutput,
+                             drawLeafOutput,
+                             drawSegmentOutput,
+                             drawSegmentShadowOutput,
+                             coalesceDrawSegmentOutput,
+                             coalesceDrawSegmentShadowOutput);
+            });
+
+            // Shared budgets as in TreeGraph
+            ValidateSharedBudget(statistics,
+                                 generateTreeOutput.Count() + twigOutput.Count() +
+                                     drawLeafOutputs[0].Count() + drawLeafOutputs[1].Count() + drawLeafOutputs[2].Count(),
+                                 maxChildRecords);
+            ValidateSharedBudget(statistics, drawSegmentOutput.Count() + coalesceDrawSegmentOutput.Count(), maxSegmentRecords);
+            ValidateSharedBudget(statistics, drawSegmentShadowOutput.Count() + coalesceDrawSegmentShadowOutput.Count(), maxSegmentRecords);
+        }
+
+        void Twig(const std::vector<GenerateTreeRecord>& irs)
+        {
+            for (const GenerateTreeRecord& record : irs) {
+                log_.Add("Twig", record);
+            }
+
+            NodeStatistics& statistics = twig_->GetStatistics();
+
+            NodeOutput<DrawLeafRecord> drawLeafOutputs[3] = {
+                { statistics, coalesceDrawLeaves_[0], maxTwigLeafRecords },
+                { statistics, coalesceDrawLeaves_[1], maxTwigLeafRecords },
+                { statistics, coalesceDrawLeaves_[2], maxTwigLeafRecords },
+            };
+            NodeOutputArray<DrawLeafRecord> drawLeafOutput(drawLeafOutputs);
+            NodeOutput<DrawSegmentRecord>   drawSegmentOutput(statistics, drawSegment_, maxTwigSegmentRecords);
+            NodeOutput<DrawSegmentRecord>   drawSegmentShadowOutput(statistics, drawSegmentShadow_, maxTwigSegmentRecords);
+            NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentOutput(statistics, coalesceDrawSegments_[0], maxTwigSegmentRecords);
+            NodeOutput<DrawSegmentRecord>   coalesceDrawSegmentShadowOutput(statistics, coalesceDrawSegments_[1], maxTwigSegmentRecords);
+
+            const uint twigCount = uint(irs.size());
+
+            RunShaderGroup(TwigThreadGroupSize, 0, [&](uint32_t gtid) {
+                GenerateTwig(treeType_,
+                             gtid,
+                             twigCount,
+                             irs[min(gtid, twigCount - 1)],
+                             drawLeafOutput,
+                             drawSegmentOutput,
+                             drawSegmentShadowOutput,
+                             coalesceDrawSegmentOutput,
+                             coalesceDrawSegmentShadowOutput);
+            });
+
+            ValidateSharedBudget(statistics, drawLeafOutputs[0].Count() + drawLeafOutputs[1].Count() + drawLeafOutputs[2].Count(), maxTwigLeafRecords);
+            ValidateSharedBudget(statistics, drawSegmentOutput.Count() + coalesceDrawSegmentOutput.Count(), maxTwigSegmentRecords);
+            ValidateSharedBudget(statistics, drawSegmentShadowOutput.Count() + coalesceDrawSegmentShadowOutput.Count(), maxTwigSegmentRecords);
+        }
+
+        WorkGraph graph_;
+        uint      treeType_;
+        RecordLog log_;
+
+        BroadcastingNode<GenerateTreeRecord>* stem_;
+        CoalescingNode<GenerateTreeRecord>*   twig_;
+        ThreadNode<DrawSegmentRecord>*        drawSegment_;
+        ThreadNode<DrawSegmentRecord>*        drawSegmentShadow_;
+        ThreadNode<DrawSegmentRecord>*        coalesceDrawSegments_[2];
+        ThreadNode<DrawLeafRecord>*           coalesceDrawLeaves_[3];
+    };
+
+    // Tree at the origin with tree index 0, like the template trees of TreeTemplates
+    GenerateTreeRecord CreateTestTree(uint treeType, uint seed, bool isTemplate, bool isCameraOccluded)
+    {
+        GenerateTreeRecord record = CreateTreeRecord(0, qRotateX(PI * -0.5), seed, 0);
+        record.isTemplate         = isTemplate;
+        record.isCameraOccluded   = isCameraOccluded;
+
+        TreeRoot root;
+        root.pos    = float3(0, 0, 0);
+        root.radius = GetMaxSubtreeReach(GetTreeParameters(treeType), 0, record.length, record.radius);
+        StoreTreeRoot(0, root);
+
+        return record;
+    }
+
+    // Prints the first difference between the records of two runs; returns the number of differing nodes
+    uint CompareRuns(const std::map<std::string, std::vector<Fields>>& expected,
+                     const std::map<std::string, std::vector<Fields>>& actual)
+    {
+        uint failures = 0;
+
+        for (const auto& [node, expectedRecords] : expected) {
+            const auto                 it            = actual.find(node);
+            const std::vector<Fields>& actualRecords = (it != actual.end()) ? it->second : std::vector<Fields>();
+
+            bool isEqual = expectedRecords.size() == actualRecords.size();
+            if (!isEqual) {
+                std::printf("  %-24s %zu records, %zu with %u threads  MISMATCH\n",
+                            node.c_str(), expectedRecords.size(), actualRecords.size(), parallelThreadCount);
+            }
+
+            for (size_t i = 0; isEqual && (i < expectedRecords.size()); ++i) {
+                for (size_t f = 0; f < expectedRecords[i].size(); ++f) {
+                    if (expectedRecords[i][f].value != actualRecords[i][f].value) {
+                        std::printf("  %-24s record %zu, %s: %llu, %llu with %u threads  MISMATCH\n",
+                                    node.c_str(),
+                                    i,
+                                    expectedRecords[i][f].name,
+                                    (unsigned long long)expectedRecords[i][f].value,
+                                    (unsigned long long)actualRecords[i][f].value,
+                                    parallelThreadCount);
+                        isEqual = false;
+                        break;
+                    }
+                }
+            }
+
+            if (isEqual) {
+                std::printf("  %-24s %zu records\n", node.c_str(), expectedRecords.size());
+            }
+            failures += isEqual ? 0 : 1;
+        }
+
+        return failures;
+    }
+
+} // namespace
+
+int main()
+{
+    const std::vector<TestCase> testCases = {
+        { "near", -1.f, 5.f, false, false, TREE_TYPE_COUNT },
+        // Leaf density below one
+        { "far", 80.f, 5.f, false, false, 1 },
+        // Curve scan of split-free stems
+        { "no wind", -1.f, 0.f, false, false, 1 },
+        { "template", -1.f, 5.f, true, false, 1 },
+        // Shadow records only, see TreeRoots
+        { "camera occluded", -1.f, 5.f, false, true, 1 },
+    };
+
+    ThreadPool serialPool(1);
+    ThreadPool parallelPool(parallelThreadCount);
+    TreeGraph  treeGraph(serialPool);
+
+    uint failures = 0;
+
+    // stemMaxRecursionDepth assumes at most TREE_MAX_LEVELS levels
+    for (uint treeType = 0; treeType < TREE_TYPE_COUNT; ++treeType) {
+        const int levels = GetTreeParameters(treeType).Levels;
+        if (levels > TREE_MAX_LEVELS) {
+            std::printf("Tree type %u has %d levels, TREE_MAX_LEVELS is %d\n", treeType, levels, TREE_MAX_LEVELS);
+            failures += 1;
+        }
+    }
+
+    for (uint treeType = 0; treeType < TREE_TYPE_COUNT; ++treeType) {
+        StemGraph serialGraph(serialPool, treeType);
+        StemGraph parallelGraph(parallelPool, treeType);
+
+        for (const TestCase& testCase : testCases) {
+            if (treeType >= testCase.treeTypeCount) {
+                continue;
+            }
+
+            // One frame sets up the config, camera and occlusion state
+            TreeGraphOptions options;
+            options.treeType       = treeType;
+            options.seed           = 7;
+            options.drawDistance   = 0.f;
+            options.windStrength   = testCase.windStrength;
+            options.time           = 1.5f;
+            options.cameraDistance = testCase.cameraDistance;
+            treeGraph.RunFrame(options);
+
+            const GenerateTreeRecord record = CreateTestTree(treeType, 1234 + treeType, testCase.isTemplate, testCase.isCameraOccluded);
+
+            uint64_t   serialViolations   = 0;
+            uint64_t   parallelViolations = 0;
+            const auto serialRecords      = serialGraph.Run(record, serialViolations);
+            const auto parallelRecords    = parallelGraph.Run(record, parallelViolations);
+
+            std::printf("Tree type %u, %s\n", treeType, testCase.name.c_str());
+            failures += CompareRuns(serialRecords, parallelRecords);
+
+            if ((serialViolations != 0) || (parallelViolations != 0)) {
+                std::printf("  %llu, %llu budget violation(s)  MISMATCH\n",
+                            (unsigned long long)serialViolations,
+                            (unsigned long long)parallelViolations);
+                failures += 1;
+            }
+        }
+    }
+
+    std::printf("\n%u mismatch(es)\n", failures);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+// Packs positions relative to tree roots with PackTreeLocalPosition and checks UnpackTreeLocalPosition and
+// GetPackedTreeIndex against the bound of the snorm16 quantization over the bounding sphere (see TreeRoots.h):
+// positions within the root radius of the root are off by at most half a quantization step per axis, plus the
+// float rounding of the absolute position, and every tree index below MaxTreeCount round-trips.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Shader headers last: Common.h and Quaternion.h define macros with common names (random, X, Y, Z, ...)
+#include "Common.h"
+
+#include "Config.h"
+#include "TreeRoots.h"
+
+namespace {
+
+    struct Result {
+        uint  count         = 0;
+        uint  failures      = 0;
+        float maxError      = 0;
+        uint  indexFailures = 0;
+    };
+
+    float Ulp(float x)
+    {
+        x = abs(x);
+        return std::nextafter(x, INFINITY) - x;
+    }
+
+    void Check(Result& result, uint treeIndex, const TreeRoot& root, const float3 position)
+    {
+        // Unpacks with the root of the packed tree index, i.e. through the root table
+        const uint2  packedPos = PackTreeLocalPosition(position, treeIndex, root);
+        const float3 unpacked  = UnpackTreeLocalPosition(packedPos, LoadTreeRoot(GetPackedTreeIndex(packedPos)));
+
+        ++result.count;
+
+        if (GetPackedTreeIndex(packedPos) != treeIndex) {
+            if (result.indexFailures < 8) {
+                std::printf("  tree index %u unpacks to %u\n", treeIndex, GetPackedTreeIndex(packedPos));
+            }
+            ++result.indexFailures;
+        }
+
+        const float step = root.radius / treeLocalPositionScale;
+
+        for (uint axis = 0; axis < 3; ++axis) {
+            const float error = abs(unpacked[axis] - position[axis]);
+            const float bound = .5f * step + 2 * Ulp(max(abs(position[axis]), abs(root.pos[axis]) + root.radius));
+
+            result.maxError = max(result.maxError, error / bound);
+
+            if (!(error <= bound)) {
+                if (result.failures < 8) {
+                    std::printf("  tree %u, root (%g %g %g) radius %g: axis %u of (%.9g %.9g %.9g) is off by %.9g, bound %.9g\n",
+                                treeIndex, root.pos.x, root.pos.y, root.pos.z, root.radius, axis,
+                                position.x, position.y, position.z, error, bound);
+                }
+                ++result.failures;
+            }
+        }
+    }
+
+    uint Report(const char* name, const Result& result)
+    {
+        std::printf("%-24s %10u positions, max error %.3f of bound, %u failure(s), %u tree index failure(s)\n",
+                    name, result.count, result.maxError, result.failures, result.indexFailures);
+        return result.failures + result.indexFailures;
+    }
+
+    std::vector<TreeRoot> GetTestRoots()
+    {
+        std::vector<TreeRoot> roots;
+        for (const float3& pos : { float3(0, 0, 0), float3(1000, 0, -1000), float3(-4096.5f, 12.25f, 8191.75f) }) {
+            // Radii of GetMaxSubtreeReach range from a few to about 50 meters
+            for (const float radius : { .25f, 7.f, 60.f }) {
+                TreeRoot root;
+                root.pos    = pos;
+                root.radius = radius;
+                roots.push_back(root);
+            }
+        }
+        return roots;
+    }
+
+    // Every quantization step and the midpoints between them along each axis, from -radius to radius
+    uint TestAxes()
+    {
+        Result result;
+
+        const std::vector<TreeRoot> roots = GetTestRoots();
+
+        for (uint i = 0; i < roots.size(); ++i) {
+            const TreeRoot& root = roots[i];
+            StoreTreeRoot(i, root);
+
+            const int steps = int(treeLocalPositionScale);
+
+            for (int q = -steps; q <= steps; ++q) {
+                for (const float offset : { float(q), q + .5f }) {
+                    const float t = clamp(offset / treeLocalPositionScale, -1.f, 1.f);
+
+                    for (uint axis = 0; axis < 3; ++axis) {
+                        float3 position = root.pos;
+                        position[axis] += t * root.radius;
+
+                        Check(result, i, root, position);
+                    }
+                }
+            }
+        }
+
+        return Report("Axes", result);
+    }
+
+    // Corners, face centers and the center of the cube of the root radius, for every tree index
+    uint TestTreeIndices()
+    {
+        Result result;
+
+        const std::vector<TreeRoot> roots = GetTestRoots();
+
+        for (uint treeIndex = 0; treeIndex < MaxTreeCount; ++treeIndex) {
+            const TreeRoot& root = roots[treeIndex % roots.size()];
+            StoreTreeRoot(treeIndex, root);
+
+            for (int x = -1; x <= 1; ++x) {
+                for (int y = -1; y <= 1; ++y) {
+                    for (int z = -1; z <= 1; ++z) {
+                        Check(result, treeIndex, root, root.pos + float3(float(x), float(y), float(z)) * root.radius);
+                    }
+                }
+            }
+        }
+
+        return Report("Tree indices", result);
+    }
+
+} // namespace
+
+int main()
+{
+    const uint failures = TestAxes() + TestTreeIndices();
+
+    std::printf("\n%u failure(s)\n", failures);
+
+    return failures == 0 ? 0 : 1;
+}
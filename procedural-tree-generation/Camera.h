@@ -2,6 +2,8 @@
 
 #include "TreeParameters.h"
 #include "Config.h"
+#include "Statistics.h"
+#include "TriangleBudget.h"
 
 struct CameraParameters {
     float3 position;
@@ -9,7 +11,7 @@ struct CameraParameters {
 };
 
 // Returns camera rotating around the tree
-CameraParameters GetCameraParameters() {
+CameraParameters ComputeCameraParameters() {
     const TreeParameters params = GetTreeParameters();
     const float treeHeight = params.Scale * params.nLength[0];
 
@@ -26,15 +28,9 @@ CameraParameters GetCameraParameters() {
     return cameraParams;
 }
 
-float3 GetCameraPosition()
-{
-    return GetCameraParameters().position;
-}
-
 // Returns view-projection matrix for the camera looking at the tree
-float4x4 GetViewProjectionMatrix()
+float4x4 ComputeViewProjectionMatrix(in const CameraParameters params)
 {
-    const CameraParameters params = GetCameraParameters();
     const float3 forward          = normalize(params.position - params.focus);
     const float3 right            = normalize(cross(float3(0, 1, 0), forward));
     const float3 up               = normalize(cross(forward, right));
@@ -74,12 +70,10 @@ struct Frustum {
     FrustumPlane planes[6];  // Left, Right, Bottom, Top, Near, Far
 };
 
-// Extract frustum planes from view-projection matrix
+// Extract frustum planes from a view-projection matrix
 // Planes are in world space and normalized
 // Uses Gribb-Hartmann method for row-major matrices
-Frustum GetViewFrustum() {
-    float4x4 vp = GetViewProjectionMatrix();
-
+Frustum GetFrustum(in const float4x4 vp) {
     // Extract rows from matrix
     float4 row0 = vp[0];  // [m00, m01, m02, m03]
     float4 row1 = vp[1];  // [m10, m11, m12, m13]
@@ -138,4 +132,65 @@ bool SphereInFrustum(in Frustum frustum, in float3 center, in float radius) {
         }
     }
     return true;  // Sphere intersects or inside frustum
-}
\ No newline at end of file
+}
+
+// View for culling and tessellation: either the perspective camera or an orthographic light view
+struct ViewParameters {
+    float4x4 viewProjectionMatrix;
+    Frustum  frustum;
+    float3   position;        // eye position of perspective views
+    float3   direction;       // direction towards the viewer of orthographic views
+    uint     isOrthographic;  // bool; uint to be loadable from PersistentScratchBuffer
+    float2   viewportSize;    // in pixels
+};
+
+ViewParameters ComputeCameraView() {
+    const CameraParameters params = ComputeCameraParameters();
+
+    ViewParameters view;
+    view.viewProjectionMatrix = ComputeViewProjectionMatrix(params);
+    view.frustum              = GetFrustum(view.viewProjectionMatrix);
+    view.position             = params.position;
+    view.direction            = 0;
+    view.isOrthographic       = false;
+    view.viewportSize         = RenderSize;
+
+    return view;
+}
+
+// ============================ View Constants ====================
+// The camera and light views only change once per frame. EntryFunction computes them with StoreCameraView
+// and StoreShadowView (see Shadow.h) and places them after the triangle budget state, all other nodes load
+// them with a single Load<ViewParameters> instead of recomputing the matrices and frustum planes.
+
+static const uint CameraViewOffset   = (TriangleBudgetEnd + 15) & ~15u;
+static const uint ShadowViewOffset   = CameraViewOffset + sizeof(ViewParameters);
+// First byte after the view constants
+static const uint ViewConstantsEnd   = ShadowViewOffset + sizeof(ViewParameters);
+
+void StoreCameraView() {
+    PersistentScratchBuffer.Store<ViewParameters>(CameraViewOffset, ComputeCameraView());
+}
+
+ViewParameters GetCameraView() {
+    return PersistentScratchBuffer.Load<ViewParameters>(CameraViewOffset);
+}
+
+float3 GetCameraPosition()
+{
+    return GetCameraView().position;
+}
+
+float4x4 GetViewProjectionMatrix()
+{
+    return GetCameraView().viewProjectionMatrix;
+}
+
+Frustum GetViewFrustum() {
+    return GetCameraView().frustum;
+}
+
+// Vector from position towards the viewer; not normalized for perspective views
+float3 GetToViewer(in const ViewParameters view, in const float3 position) {
+    return view.isOrthographic ? view.direction : (view.position - position);
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "Camera.h"
+#include "Config.h"
+#include "Occlusion.h"
+#include "Shadow.h"
+#include "StemGrowth.h"
+#include "TreeRoots.h"
+#include "TreeTemplates.h"
+
+// ============================ World Chunks ====================
+// The forest is an unbounded grid of square chunks with ChunkTreeGridSize x ChunkTreeGridSize trees each.
+// Every frame, the Chunks node tests the chunks in a window around the camera against the draw distance
+// and the camera and light frustums, and sends one TreeRoots record per remaining chunk. The cost of a
+// frame thus depends on the chunks in view, not on the size of the world. Tree positions and seeds only
+// depend on the grid cell of the tree, so a chunk regenerates the same trees whenever it comes into view.
+
+static const uint  ChunkTreeGridSize = 8;
+static const uint  ChunkTreeCount    = ChunkTreeGridSize * ChunkTreeGridSize;
+// Distance between neighboring grid cells; trees are jittered within their cell
+static const float TreeSpacing       = 7.f;
+static const float ChunkSize         = ChunkTreeGridSize * TreeSpacing;
+
+// Upper bound of PersistentConfig::DRAW_DISTANCE; the Chunks dispatch covers all chunks within it
+static const float MaxDrawDistance   = 1200.f;
+static const int   ChunkWindowRadius = int(MaxDrawDistance / ChunkSize) + 1;
+static const uint  ChunkWindowSize   = 2 * ChunkWindowRadius + 1;
+static const uint  ChunksGroupSize   = 8;
+static const uint  ChunksGroups      = (ChunkWindowSize + ChunksGroupSize - 1) / ChunksGroupSize;
+
+// Initial PersistentConfig::DRAW_DISTANCE: about 25 trees (PI * 20^2 / TreeSpacing^2), like the fixed 5x5 tree
+// grid of the sample before the forest was streamed in chunks
+static const float DefaultDrawDistance = 20.f;
+
+// Chunks beyond these distances from the camera generate their trees with tree LOD 1 and 2
+static const float treeLod1Distance  = 150.f;
+static const float treeLod2Distance  = 400.f;
+
+struct TreeRootsRecord {
+    int2 chunk;
+    // First of the ChunkTreeCount tree indices allocated for the chunk, see ChunksNode
+    uint firstTreeIndex;
+    uint lod;
+};
+
+float GetDrawDistance() {
+    return min(LoadPersistentConfigFloat(PersistentConfig::DRAW_DISTANCE), MaxDrawDistance);
+}
+
+// Chunk that contains the grid cell closest to position
+int2 GetChunk(in const float3 position) {
+    return int2(floor((position.xz + TreeSpacing * .5f) / ChunkSize));
+}
+
+// Center of the chunk on the floor (X-Z plane)
+float3 GetChunkCenter(in const int2 chunk) {
+    const float2 center = (float2(chunk) * ChunkTreeGridSize + (ChunkTreeGridSize - 1) * .5f) * TreeSpacing;
+    return float3(center.x, 0, center.y);
+}
+
+// Radius of a sphere around the chunk center that contains all trees of the chunk
+float GetChunkRadius(in const TreeParameters params) {
+    const float maxScale  = params.Scale + .5 * abs(params.ScaleV);
+    const float maxLength = maxScale * (params.nLength[0] + abs(params.nLengthV[0]));
+
+    return ChunkSize * sqrt(.5f) + GetMaxSubtreeReach(params, 0, maxLength, maxLength * params.Ratio);
+}
+
+uint GetTreeLod(in const float distanceToCamera) {
+    return (distanceToCamera < treeLod1Distance) ? 0 : ((distanceToCamera < treeLod2Distance) ? 1 : 2);
+}
+
+uint GetTreeSeed(in const int2 cell) {
+    return random::CombineSeed(LoadPersistentConfigUint(PersistentConfig::SEED), uint(cell.x), uint(cell.y));
+}
+
+// Tree position in grid cell cell on the floor (X-Z plane)
+float3 GetTreePosition(in const int2 cell, in const uint treeSeed) {
+    float2 position = float2(cell) * TreeSpacing;
+
+    // The tree at the origin stays in place, it is the focus of the camera
+    if (cell.x != 0 || cell.y != 0) {
+        position += float2(random::SignedRandom(treeSeed, 'j', 'x'), random::SignedRandom(treeSeed, 'j', 'z')) * (TreeSpacing * .35f);
+    }
+
+    return float3(position.x, 0, position.y);
+}
+
+// ============================ Frame ====================
+
+// Part of EntryFunction that prepares the tree generation of a frame, after the persistent config is updated.
+// Returns the number of tree templates to regenerate in this frame.
+uint BeginTreeFrame() {
+    // Keep counters of the last frame for the statistics UI, start counting this frame
+    BeginStatisticsFrame();
+    // Adjust the detail of this frame to the triangles of the last frame
+    UpdateTriangleBudget();
+
+    // Compute camera and light view once for all nodes of this frame
+    StoreCameraView();
+    StoreShadowView();
+    StoreOcclusionView();
+
+    // Tree indices of this frame are allocated by the Chunks node, after the indices of the template trees
+    ResetTreeRootCount(GetTreeTemplateCount());
+
+    return BeginTreeTemplateFrame();
+}
+
+// ============================ Chunks ====================
+
+// Body of the Chunks node: one chunk of the window around the camera per thread
+void GenerateChunks(
+    in const uint2 dispatchThreadID,
+    NodeOutput<TreeRootsRecord> treeRootsOutput
+)
+{
+    const float3 cameraPosition = GetCameraPosition();
+    const int2   chunk          = GetChunk(cameraPosition) + int2(dispatchThreadID) - ChunkWindowRadius;
+    const float3 chunkCenter    = GetChunkCenter(chunk);
+    const float  chunkRadius    = GetChunkRadius(GetTreeParameters());
+
+    const float distanceToCamera = distance(cameraPosition.xz, chunkCenter.xz);
+
+    // Skip chunks outside the window, beyond the draw distance or outside the camera and the light frustum
+    const bool isVisible = all(dispatchThreadID < ChunkWindowSize) &&
+                           ((distanceToCamera - ChunkSize * sqrt(.5f)) <= GetDrawDistance()) &&
+                           (SphereInFrustum(GetCameraView().frustum, chunkCenter, chunkRadius) ||
+                            SphereInFrustum(GetShadowView().frustum, chunkCenter, chunkRadius));
+
+    // Allocate the tree indices of all visible chunks of the wave with one atomic
+    const uint treeCount = isVisible ? ChunkTreeCount : 0;
+    const uint waveCount = WaveActiveSum(treeCount);
+
+    uint waveFirstTreeIndex = 0;
+    if (WaveIsFirstLane()) {
+        PersistentScratchBuffer.InterlockedAdd(TreeRootCountOffset, waveCount, waveFirstTreeIndex);
+    }
+
+    const uint firstTreeIndex = WaveReadLaneFirst(waveFirstTreeIndex) + WavePrefixSum(treeCount);
+
+    // Tree indices are limited to 16 bits; chunks beyond MaxTreeCount trees are dropped
+    const bool hasOutput = isVisible && ((firstTreeIndex + ChunkTreeCount) <= MaxTreeCount);
+
+    ThreadNodeOutputRecords<TreeRootsRecord> outputRecord = treeRootsOutput.GetThreadNodeOutputRecords(hasOutput);
+
+    if (hasOutput) {
+        outputRecord.Get().chunk          = chunk;
+        outputRecord.Get().firstTreeIndex = firstTreeIndex;
+        outputRecord.Get().lod            = GetTreeLod(distanceToCamera);
+    }
+
+    outputRecord.OutputComplete();
+}
+
+// ============================ Tree Roots ====================
+
+// Body of the TreeRoots node: one tree of the chunk per thread. Trees of complete templates are sent to
+// TreeInstance, all others to the Stem node of the current tree type.
+void GenerateTreeRoots(
+    in const uint2 gtid,
+    in const TreeRootsRecord chunkRecord,
+    NodeOutputArray<GenerateTreeRecord> treeOutput,
+    NodeOutput<TreeInstanceRecord> treeInstanceOutput
+)
+{
+    const int2   cell     = chunkRecord.chunk * int(ChunkTreeGridSize) + int2(gtid);
+    const uint   treeSeed = GetTreeSeed(cell);
+    const float3 position = GetTreePosition(cell, treeSeed);
+
+    // Select the Stem node specialized for the current tree type
+    const uint treeType = LoadPersistentConfigUint(PersistentConfig::TREE_TYPE);
+
+    const uint               treeIndex  = chunkRecord.firstTreeIndex + gtid.x + gtid.y * ChunkTreeGridSize;
+    const GenerateTreeRecord treeRecord = CreateTreeRecord(treeIndex, qRotateX(PI * -0.5), treeSeed, chunkRecord.lod);
+
+    // Instanced trees replay their template; until it is complete, e.g. in the first frame, they run through Stem
+    const uint               treeTemplateCount = GetTreeTemplateCount();
+    const uint               templateIndex     = (treeTemplateCount > 0) ? (treeSeed % treeTemplateCount) : 0;
+    const bool               isInstance        = (treeTemplateCount > 0) && IsTreeTemplateComplete(templateIndex);
+    const TreeTemplateHeader treeTemplate      = LoadTreeTemplateHeader(templateIndex);
+
+    // All positions of the tree are stored relative to its root; make the root visible to the Stem nodes.
+    // Instances take the radius of their template, grown by the bound of their wind offset (see ApplyTreeWind).
+    TreeRoot root;
+    root.pos    = position;
+    root.radius = isInstance ? treeTemplate.radius + GetMaxTreeWindOffset(treeTemplate.radius) :
+                               GetMaxSubtreeReach(GetTreeParameters(treeType), 0, treeRecord.length, treeRecord.radius);
+    StoreTreeRoot(treeIndex, root);
+    Barrier(UAV_MEMORY, DEVICE_SCOPE);
+
+    // Skip trees beyond the draw distance, outside the camera and the light frustum,
+    // or only inside the camera frustum and occluded. Occluded trees inside the light frustum
+    // only emit their shadow records.
+    const bool isInCamera       = SphereInFrustum(GetCameraView().frustum, position, root.radius);
+    const bool isInShadow       = SphereInFrustum(GetShadowView().frustum, position, root.radius);
+    const bool isInRange        = (root.radius > 0) && (distance(GetCameraPosition().xz, position.xz) <= GetDrawDistance());
+    const bool isCameraOccluded = isInRange && isInCamera && IsSphereOccluded(GetOcclusionView(), position, root.radius);
+    const bool isOccluded       = isCameraOccluded && !isInShadow;
+    const bool isVisible        = isInRange && (isInCamera || isInShadow) && !isOccluded;
+
+    ThreadNodeOutputRecords<GenerateTreeRecord> outputRecord = treeOutput[treeType].GetThreadNodeOutputRecords(isVisible && !isInstance);
+
+    if (isVisible && !isInstance) {
+        outputRecord.Get()                  = treeRecord;
+        outputRecord.Get().isCameraOccluded = isCameraOccluded;
+    }
+
+    outputRecord.OutputComplete();
+
+    const uint instanceGroupCount = GetTreeInstanceGroupCount(treeTemplate);
+    const bool hasInstanceOutput  = isVisible && isInstance && (instanceGroupCount > 0);
+
+    ThreadNodeOutputRecords<TreeInstanceRecord> instanceRecord = treeInstanceOutput.GetThreadNodeOutputRecords(hasInstanceOutput);
+
+    if (hasInstanceOutput) {
+        instanceRecord.Get().treeIndex        = treeIndex;
+        instanceRecord.Get().templateIndex    = templateIndex;
+        instanceRecord.Get().lod              = chunkRecord.lod;
+        instanceRecord.Get().isCameraOccluded = isCameraOccluded;
+        instanceRecord.Get().dispatchGrid     = instanceGroupCount;
+    }
+
+    instanceRecord.OutputComplete();
+
+    const uint treeCount           = WaveActiveCountBits(isVisible);
+    const uint occludedTreeCount   = WaveActiveCountBits(isOccluded);
+    const uint shadowOnlyTreeCount = WaveActiveCountBits(isVisible && isCameraOccluded);
+    if (WaveIsFirstLane()) {
+        AddStatistic(StatisticsCounter::TREE_ROOTS_RECORDS, treeCount);
+        AddStatistic(StatisticsCounter::TREE_ROOTS_OCCLUDED_RECORDS, occludedTreeCount);
+        AddStatistic(StatisticsCounter::TREE_ROOTS_SHADOW_ONLY_RECORDS, shadowOnlyTreeCount);
+    }
+    if (all(gtid == 0)) {
+        AddStatistic(StatisticsCounter::TREE_ROOTS_GROUPS, 1);
+    }
+}
@@ -8,6 +8,12 @@ enum class PersistentConfig : uint {
     SEASON,
     WIND_STRENGTH,
     SEED,
+    // Trees are generated up to this distance from the camera, see Chunks.h
+    DRAW_DISTANCE,
+    // Number of template trees the forest is instanced from, 0 generates every tree, see TreeTemplates.h
+    TREE_TEMPLATE_COUNT,
+    // Triangles per frame in millions, 0 draws at full detail, see TriangleBudget.h
+    TRIANGLE_BUDGET,
 
     CAMERA_YAW,
     CAMERA_PITCH,
@@ -17,6 +23,12 @@ enum class PersistentConfig : uint {
     MOUSE_X,
     MOUSE_Y,
     KEY_SPACE_DOWN,
+
+    // Incremented by EntryFunction every frame
+    FRAME_INDEX,
+
+    // Number of config values; data placed after the config block starts here
+    COUNT,
 };
 
 float LoadPersistentConfigFloat(in PersistentConfig config) {
@@ -0,0 +1,372 @@
+#pragma once
+
+#include "Records.h"
+#include "TreeParameters.h"
+#include "Camera.h"
+#include "Shadow.h"
+#include "Statistics.h"
+#include "SplineTessellation.h"
+
+// ============================ Leaf Coalescing ====================
+// Stem and Twig send their leaf, blossom and fruit records to the CoalesceDrawLeaves node array, which bundles up to
+// maxCoalescedDrawLeafRecords of them per view and LOD for the mesh nodes of Leaves.h and Fruits.h. The bodies of the
+// coalescing nodes are declared here, apart from the mesh and pixel shaders, so the CPU reference executor compiles
+// them as well.
+
+static const int verticesPerLobe  = 16;
+static const int trianglesPerLobe = 16;
+
+static const int lobesPerGroup = min(128 / verticesPerLobe, 128 / trianglesPerLobe);
+
+static const int maxNumVerticesPerLobeGroup  = lobesPerGroup * verticesPerLobe;
+static const int maxNumTrianglesPerLobeGroup = lobesPerGroup * trianglesPerLobe;
+
+// Leaf LOD: leaves below leafCardPixelSize in a view are drawn as a single card instead of their lobes,
+// see CoalesceDrawLeafRecords and ComputeLeafCardVertex
+static const int verticesPerCard = 4;
+static const int trianglesPerCard = 2;
+
+static const int cardsPerGroup = min(128 / verticesPerCard, 128 / trianglesPerCard);
+
+static const float leafCardPixelSize = 8.f;
+
+static const int maxCoalescedDrawLeafRecords = 256;
+static const int maxDrawLobeGroupsPerDispatch = (maxCoalescedDrawLeafRecords + lobesPerGroup - 1) / lobesPerGroup;
+
+struct DrawLeafRecordBundle {
+    uint2 dispatchGrid : SV_DispatchGrid;
+    uint isBlossom : 1;
+    uint isCard    : 1;
+    uint leafCount : 30;
+    DrawLeafRecord leaves[maxCoalescedDrawLeafRecords];
+};
+
+// Projected length in pixels of view of a leaf at position with the given scale, measured perpendicular to the view
+// direction
+float GetLeafPixelSize(in const float3 position, in const float scale, in const ViewParameters view)
+{
+    const float3 perpendicular = normalize(ArbitraryOrthonormal(normalize(GetToViewer(view, position))));
+
+    return distance(PosToPixel(view, position).xy, PosToPixel(view, position + perpendicular * scale).xy);
+}
+
+bool IsLeafCard(in const float3 position, in const float scale, in const ViewParameters view)
+{
+    return GetLeafPixelSize(position, scale, view) < leafCardPixelSize;
+}
+
+// Position of a leaf record; the records of a group may belong to different trees
+float3 GetDrawLeafPosition(in DrawLeafRecord leafRecord)
+{
+    return leafRecord.trafo.GetPos(LoadTreeRoot(leafRecord.trafo.GetTreeIndex()));
+}
+
+// Number of coalesced records per view, see CoalesceDrawLeafRecords and CoalesceDrawBlossomRecords
+groupshared uint groupCameraLeafCount;
+groupshared uint groupShadowLeafCount;
+// Number of coalesced records per view drawn as cards, see CoalesceDrawLeafRecords
+groupshared uint groupCameraCardCount;
+groupshared uint groupShadowCardCount;
+
+// Body of CoalesceDrawLeaves[0]: one lobe and one card bundle per view
+void CoalesceDrawLeafRecords(
+    in const uint gtid,
+    GroupNodeInputRecords<DrawLeafRecord> irs,
+    NodeOutput<DrawLeafRecordBundle> output,
+    NodeOutput<DrawLeafRecordBundle> shadowOutput
+){
+    const TreeParameters treeParams = GetTreeParameters();
+
+    if (gtid == 0) {
+        groupCameraLeafCount = 0;
+        groupShadowLeafCount = 0;
+        groupCameraCardCount = 0;
+        groupShadowCardCount = 0;
+
+        AddStatistic(StatisticsCounter::COALESCE_LEAF_GROUPS, 1);
+        AddStatistic(StatisticsCounter::COALESCE_LEAF_RECORDS, irs.Count());
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Select the LOD of each view and compact the records of each view and LOD
+    const bool hasRecord = gtid < irs.Count();
+    const DrawLeafRecord leafRecord = irs.Get(min(gtid, irs.Count() - 1));
+    const uint viewMask  = hasRecord ? leafRecord.viewMask : 0;
+    const float3 position = GetDrawLeafPosition(leafRecord);
+
+    const bool isCameraCard = (viewMask & ViewMaskCamera) && IsLeafCard(position, leafRecord.scale, GetCameraView());
+    const bool isShadowCard = (viewMask & ViewMaskShadow) && IsLeafCard(position, leafRecord.scale, GetShadowView());
+
+    uint cameraLeafIndex = 0;
+    uint shadowLeafIndex = 0;
+    if (viewMask & ViewMaskCamera) {
+        if (isCameraCard) {
+            InterlockedAdd(groupCameraCardCount, 1, cameraLeafIndex);
+        } else {
+            InterlockedAdd(groupCameraLeafCount, 1, cameraLeafIndex);
+        }
+    }
+    if (viewMask & ViewMaskShadow) {
+        if (isShadowCard) {
+            InterlockedAdd(groupShadowCardCount, 1, shadowLeafIndex);
+        } else {
+            InterlockedAdd(groupShadowLeafCount, 1, shadowLeafIndex);
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    const uint cameraLeafCount = groupCameraLeafCount;
+    const uint shadowLeafCount = groupShadowLeafCount;
+    const uint cameraCardCount = groupCameraCardCount;
+    const uint shadowCardCount = groupShadowCardCount;
+    const uint lobes           = min(treeParams.Leaf.Lobes, TREE_MAX_LOBE_COUNT);
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::COALESCE_LEAF_CAMERA_CARD_RECORDS, cameraCardCount);
+        AddStatistic(StatisticsCounter::COALESCE_LEAF_SHADOW_CARD_RECORDS, shadowCardCount);
+    }
+
+    // Lobe bundle first, card bundle second
+    const uint cameraCardBundleIndex = cameraLeafCount > 0;
+    const uint shadowCardBundleIndex = shadowLeafCount > 0;
+
+    GroupNodeOutputRecords<DrawLeafRecordBundle> outputRecords =
+        output.GetGroupNodeOutputRecords(cameraCardBundleIndex + (cameraCardCount > 0));
+
+    if (cameraLeafCount > 0) {
+        outputRecords.Get(0).dispatchGrid = uint2(DivideAndRoundUp(cameraLeafCount, lobesPerGroup), lobes);
+        outputRecords.Get(0).isBlossom    = 0;
+        outputRecords.Get(0).isCard       = 0;
+        outputRecords.Get(0).leafCount    = cameraLeafCount;
+
+        if ((viewMask & ViewMaskCamera) && !isCameraCard) {
+            outputRecords.Get(0).leaves[cameraLeafIndex] = leafRecord;
+        }
+    }
+
+    if (cameraCardCount > 0) {
+        outputRecords.Get(cameraCardBundleIndex).dispatchGrid = uint2(DivideAndRoundUp(cameraCardCount, cardsPerGroup), 1);
+        outputRecords.Get(cameraCardBundleIndex).isBlossom    = 0;
+        outputRecords.Get(cameraCardBundleIndex).isCard       = 1;
+        outputRecords.Get(cameraCardBundleIndex).leafCount    = cameraCardCount;
+
+        if (isCameraCard) {
+            outputRecords.Get(cameraCardBundleIndex).leaves[cameraLeafIndex] = leafRecord;
+        }
+    }
+
+    outputRecords.OutputComplete();
+
+    GroupNodeOutputRecords<DrawLeafRecordBundle> shadowOutputRecords =
+        shadowOutput.GetGroupNodeOutputRecords(shadowCardBundleIndex + (shadowCardCount > 0));
+
+    if (shadowLeafCount > 0) {
+        shadowOutputRecords.Get(0).dispatchGrid = uint2(DivideAndRoundUp(shadowLeafCount, lobesPerGroup), lobes);
+        shadowOutputRecords.Get(0).isBlossom    = 0;
+        shadowOutputRecords.Get(0).isCard       = 0;
+        shadowOutputRecords.Get(0).leafCount    = shadowLeafCount;
+
+        if ((viewMask & ViewMaskShadow) && !isShadowCard) {
+            shadowOutputRecords.Get(0).leaves[shadowLeafIndex] = leafRecord;
+        }
+    }
+
+    if (shadowCardCount > 0) {
+        shadowOutputRecords.Get(shadowCardBundleIndex).dispatchGrid = uint2(DivideAndRoundUp(shadowCardCount, cardsPerGroup), 1);
+        shadowOutputRecords.Get(shadowCardBundleIndex).isBlossom    = 0;
+        shadowOutputRecords.Get(shadowCardBundleIndex).isCard       = 1;
+        shadowOutputRecords.Get(shadowCardBundleIndex).leafCount    = shadowCardCount;
+
+        if (isShadowCard) {
+            shadowOutputRecords.Get(shadowCardBundleIndex).leaves[shadowLeafIndex] = leafRecord;
+        }
+    }
+
+    shadowOutputRecords.OutputComplete();
+}
+
+// Body of CoalesceDrawLeaves[1]: one lobe bundle per view
+void CoalesceDrawBlossomRecords(
+    in const uint gtid,
+    GroupNodeInputRecords<DrawLeafRecord> irs,
+    NodeOutput<DrawLeafRecordBundle> output,
+    NodeOutput<DrawLeafRecordBundle> shadowOutput
+){
+    const TreeParameters treeParams = GetTreeParameters();
+
+    if (gtid == 0) {
+        groupCameraLeafCount = 0;
+        groupShadowLeafCount = 0;
+
+        AddStatistic(StatisticsCounter::COALESCE_BLOSSOM_GROUPS, 1);
+        AddStatistic(StatisticsCounter::COALESCE_BLOSSOM_RECORDS, irs.Count());
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Compact the records of each view
+    const bool hasRecord = gtid < irs.Count();
+    const uint viewMask  = hasRecord ? irs.Get(gtid).viewMask : 0;
+
+    uint cameraLeafIndex = 0;
+    uint shadowLeafIndex = 0;
+    if (viewMask & ViewMaskCamera) {
+        InterlockedAdd(groupCameraLeafCount, 1, cameraLeafIndex);
+    }
+    if (viewMask & ViewMaskShadow) {
+        InterlockedAdd(groupShadowLeafCount, 1, shadowLeafIndex);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    const uint cameraLeafCount = groupCameraLeafCount;
+    const uint shadowLeafCount = groupShadowLeafCount;
+    const uint lobes           = min(treeParams.Blossom.Lobes, TREE_MAX_LOBE_COUNT);
+
+    GroupNodeOutputRecords<DrawLeafRecordBundle> outputRecord = output.GetGroupNodeOutputRecords(cameraLeafCount > 0);
+
+    if (cameraLeafCount > 0) {
+        outputRecord.Get().dispatchGrid = uint2(DivideAndRoundUp(cameraLeafCount, lobesPerGroup), lobes);
+        outputRecord.Get().isBlossom    = 1;
+        outputRecord.Get().isCard       = 0;
+        outputRecord.Get().leafCount    = cameraLeafCount;
+
+        if (viewMask & ViewMaskCamera) {
+            outputRecord.Get().leaves[cameraLeafIndex] = irs.Get(gtid);
+        }
+    }
+
+    outputRecord.OutputComplete();
+
+    GroupNodeOutputRecords<DrawLeafRecordBundle> shadowOutputRecord = shadowOutput.GetGroupNodeOutputRecords(shadowLeafCount > 0);
+
+    if (shadowLeafCount > 0) {
+        shadowOutputRecord.Get().dispatchGrid = uint2(DivideAndRoundUp(shadowLeafCount, lobesPerGroup), lobes);
+        shadowOutputRecord.Get().isBlossom    = 1;
+        shadowOutputRecord.Get().isCard       = 0;
+        shadowOutputRecord.Get().leafCount    = shadowLeafCount;
+
+        if (viewMask & ViewMaskShadow) {
+            shadowOutputRecord.Get().leaves[shadowLeafIndex] = irs.Get(gtid);
+        }
+    }
+
+    shadowOutputRecord.OutputComplete();
+}
+
+// ============================ Fruit Coalescing ====================
+// Fruit LOD: 0 is the full mesh of positions/triangles, 1 and 2 are coarser spheres of the same profile,
+// several of which share a thread group of FruitMeshShader. CoalesceDrawFruitRecords selects the LOD of each fruit
+// from its projected size.
+
+static const int maxDrawFruitGroupsPerDispatch = 256;
+
+static const int maxNumVerticesPerFruitGroup = 130;
+static const int maxNumTrianglesPerFruitGroup = 256;
+
+static const uint FruitLodCount = 3;
+// Minimum projected fruit size in pixels of LOD 0 and 1, see GetLeafPixelSize
+static const float fruitLod0PixelSize = 32.f;
+static const float fruitLod1PixelSize = 12.f;
+
+// Every LOD fits one thread group of FruitMeshShader, i.e. at most maxNumVerticesPerFruitGroup vertices and
+// maxNumTrianglesPerFruitGroup triangles, so GetFruitLodFruitsPerGroup is at least one; the host executor checks this
+// with a static_assert (see DrawFruitBundle in cpu-reference/src/TreeGraph.cpp)
+static const int fruitLod1Vertices  = 32;
+static const int fruitLod1Triangles = 60;
+static const int fruitLod2Vertices  = 12;
+static const int fruitLod2Triangles = 20;
+
+uint GetFruitLodVertexCount(in const uint lod) {
+    return (lod == 0) ? maxNumVerticesPerFruitGroup : (lod == 1) ? fruitLod1Vertices : fruitLod2Vertices;
+}
+
+uint GetFruitLodTriangleCount(in const uint lod) {
+    return (lod == 0) ? maxNumTrianglesPerFruitGroup : (lod == 1) ? fruitLod1Triangles : fruitLod2Triangles;
+}
+
+uint GetFruitLodFruitsPerGroup(in const uint lod) {
+    return min(maxNumVerticesPerFruitGroup / GetFruitLodVertexCount(lod), maxNumTrianglesPerFruitGroup / GetFruitLodTriangleCount(lod));
+}
+
+struct DrawFruitRecordBundle {
+    uint dispatchGrid : SV_DispatchGrid;
+    uint lod        : 2;
+    uint fruitCount : 30;
+    DrawLeafRecord fruits[maxDrawFruitGroupsPerDispatch];
+};
+
+// Fruits are only drawn into the camera view (Stem and TreeInstance never set ViewMaskShadow on fruits), so the LOD
+// follows their size in the camera view
+uint GetFruitLod(in const DrawLeafRecord fruitRecord)
+{
+    const float pixelSize = GetLeafPixelSize(GetDrawLeafPosition(fruitRecord), fruitRecord.scale, GetCameraView());
+
+    return (pixelSize >= fruitLod0PixelSize) ? 0 : (pixelSize >= fruitLod1PixelSize) ? 1 : 2;
+}
+
+// Number of coalesced records per LOD, see CoalesceDrawFruitRecords
+groupshared uint groupFruitLodCount[FruitLodCount];
+
+// Body of CoalesceDrawLeaves[2]: one bundle per LOD
+void CoalesceDrawFruitRecords(
+    in const uint gtid,
+    GroupNodeInputRecords<DrawLeafRecord> irs,
+    NodeOutput<DrawFruitRecordBundle> output
+){
+    if (gtid < FruitLodCount) {
+        groupFruitLodCount[gtid] = 0;
+    }
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::COALESCE_FRUIT_GROUPS, 1);
+        AddStatistic(StatisticsCounter::COALESCE_FRUIT_RECORDS, irs.Count());
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Compact the records of each LOD; records without ViewMaskCamera would not be visible in any view
+    const DrawLeafRecord fruitRecord = irs.Get(min(gtid, irs.Count() - 1));
+    const bool hasRecord = (gtid < irs.Count()) && (fruitRecord.viewMask & ViewMaskCamera);
+    const uint fruitLod = GetFruitLod(fruitRecord);
+
+    uint fruitIndex = 0;
+    if (hasRecord) {
+        InterlockedAdd(groupFruitLodCount[fruitLod], 1, fruitIndex);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // One bundle per LOD with records
+    uint bundleCount = 0;
+    uint fruitBundle = 0;
+    for (uint lod = 0; lod < FruitLodCount; ++lod) {
+        if (lod == fruitLod) {
+            fruitBundle = bundleCount;
+        }
+        bundleCount += groupFruitLodCount[lod] > 0;
+    }
+
+    GroupNodeOutputRecords<DrawFruitRecordBundle> outputRecords = output.GetGroupNodeOutputRecords(bundleCount);
+
+    if (gtid == 0) {
+        uint bundle = 0;
+        for (uint lod = 0; lod < FruitLodCount; ++lod) {
+            const uint fruitCount = groupFruitLodCount[lod];
+            if (fruitCount > 0) {
+                outputRecords.Get(bundle).dispatchGrid = DivideAndRoundUp(fruitCount, GetFruitLodFruitsPerGroup(lod));
+                outputRecords.Get(bundle).lod          = lod;
+                outputRecords.Get(bundle).fruitCount   = fruitCount;
+                bundle++;
+            }
+        }
+    }
+
+    if (hasRecord) {
+        outputRecords.Get(fruitBundle).fruits[fruitIndex] = fruitRecord;
+    }
+
+    outputRecords.OutputComplete();
+}
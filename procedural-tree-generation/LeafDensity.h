@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Common.h"
+#include "TriangleBudget.h"
 
 // ============================ Leaf Density Functions ====================
 
@@ -9,8 +10,14 @@ float ComputeChildScale(in float childDensity)
     return clamp(1.f / sqrt(childDensity), 1.f, 5.f);
 }
 
-float ComputeChildDensity(in const float distanceToCamera)
+// Template trees keep all of their leaves: the leaves are stored once and thinned out by every instance with the
+// density of its own distance and of the detail of the current frame, see GetTreeInstanceLeafScale.
+float ComputeChildDensity(in const float distanceToCamera, in const bool isTemplate)
 {
+    if (isTemplate) {
+        return 1.f;
+    }
+
 #if USING_SOFTWARE_ADAPTER
     // Use lower tree density settings for WARP software adapter
     const float densityFactor       = 0.9f;
@@ -20,12 +27,12 @@ float ComputeChildDensity(in const float distanceToCamera)
     const float densityHalfDistance = 60.f;
 #endif
 
-    return clamp(densityFactor * pow(2, -distanceToCamera / densityHalfDistance), 0.0001, 1);
+    return clamp(densityFactor * pow(2, -distanceToCamera / densityHalfDistance) * GetTriangleBudgetDetail(), 0.0001, 1);
 }
 
-void ComputeChildDensityAndScale(in const float distanceToCamera, out float childDensity, out float childScale)
+void ComputeChildDensityAndScale(in const float distanceToCamera, in const bool isTemplate, out float childDensity, out float childScale)
 {
-    childDensity = ComputeChildDensity(distanceToCamera);
+    childDensity = ComputeChildDensity(distanceToCamera, isTemplate);
     childScale   = ComputeChildScale(childDensity);
 }
 
@@ -63,7 +70,7 @@ float GetChildScaleFromIndex(in uint childIndex, in uint childCount, in float ch
     const uint groupIndex   = groupCount - 1 - (smallGroupSkip + (k / groupSize));
     const uint elementIndex = (k % groupSize);
 
-    const float d = virtualChildDensity == 1.f? 1.f : ((virtualChildDensity * groupSize) % 1.f);
+    const float d = virtualChildDensity == 1.f? 1.f : fmod(virtualChildDensity * groupSize, 1.f);
 
     const float groupScale   = clamp(((d * groupCount)) - (groupIndex), 0.f, 1.f);
     const float elementScale = clamp((virtualChildDensity * groupSize) - elementIndex, 0.f, 1.f);
@@ -80,6 +87,16 @@ float GetChildScaleFromIndex(in uint childIndex, in uint childCount, in float ch
     return GetChildScale(groupScale, elementScale);
 }
 
+// GetNthChildIndexAndScale returns the children in the order of their index along the stem, or in reverse order if
+// there are no more alive children than child groups
+bool IsNthChildOrderReversed(in uint childCount, in float childDensity)
+{
+    const uint groupSize  = GetChildScaleGroupSize(childCount);
+    const uint groupCount = DivideAndRoundUp(childCount, groupSize);
+
+    return ceil(childCount * childDensity) <= groupCount;
+}
+
 void GetNthChildIndexAndScale(in uint n, in uint childCount, in float childDensity, out uint childIndex, out float childScale)
 {
     const uint groupSize  = GetChildScaleGroupSize(childCount);
@@ -99,7 +116,7 @@ void GetNthChildIndexAndScale(in uint n, in uint childCount, in float childDensi
     const uint childrenPerGroupF = max(floor(groupSize * virtualChildDensity), 1);
     const uint childrenPerGroupC = max(ceil(groupSize * virtualChildDensity), 1);
 
-    const float d = ((virtualChildDensity * groupSize) % 1.f) == 0? 1.f : ((virtualChildDensity * groupSize) % 1.f);
+    const float d = fmod(virtualChildDensity * groupSize, 1.f) == 0? 1.f : fmod(virtualChildDensity * groupSize, 1.f);
 
     // Small groups to match child count
     const uint smallGroupCount = virtualChildCount - childCount;
@@ -4,24 +4,9 @@
 #include "Shading.h"
 #include "Camera.h"
 #include "TreeModel.h"
-
-static const int verticesPerLobe  = 16;
-static const int trianglesPerLobe = 16;
-
-static const int lobesPerGroup = min(128 / verticesPerLobe, 128 / trianglesPerLobe);
-
-static const int maxNumVerticesPerLobeGroup  = lobesPerGroup * verticesPerLobe;
-static const int maxNumTrianglesPerLobeGroup = lobesPerGroup * trianglesPerLobe;
-
-static const int maxCoalescedDrawLeafRecords = 256;
-static const int maxDrawLobeGroupsPerDispatch = (maxCoalescedDrawLeafRecords + lobesPerGroup - 1) / lobesPerGroup;
-
-struct DrawLeafRecordBundle {
-    uint2 dispatchGrid : SV_DispatchGrid;
-    uint isBlossom : 1;
-    uint leafCount : 31;
-    DrawLeafRecord leaves[maxCoalescedDrawLeafRecords];
-};
+#include "Statistics.h"
+#include "SplineTessellation.h"
+#include "LeafCoalescing.h"
 
 [Shader("node")]
 [NodeLaunch("coalescing")]
@@ -33,23 +18,16 @@ void CoalesceDrawLeaves(
     [MaxRecords(maxCoalescedDrawLeafRecords)]
     GroupNodeInputRecords<DrawLeafRecord> irs,
 
-    [MaxRecords(1)]
+    // Lobe and card bundle
+    [MaxRecords(2)]
     [NodeId("DrawLeafBundle")]
-    NodeOutput<DrawLeafRecordBundle> output
-){
-    GroupNodeOutputRecords<DrawLeafRecordBundle> outputRecord = output.GetGroupNodeOutputRecords(1);
-
-    const TreeParameters treeParams = GetTreeParameters();
-
-    outputRecord.Get().dispatchGrid = uint2(DivideAndRoundUp(irs.Count(), lobesPerGroup), min(treeParams.Leaf.Lobes, TREE_MAX_LOBE_COUNT));
-    outputRecord.Get().isBlossom    = 0;
-    outputRecord.Get().leafCount    = irs.Count();
+    NodeOutput<DrawLeafRecordBundle> output,
 
-    if (gtid < irs.Count()) {
-        outputRecord.Get().leaves[gtid] = irs.Get(gtid);
-    }
-
-    outputRecord.OutputComplete();
+    [MaxRecords(2)]
+    [NodeId("DrawLeafBundleShadow")]
+    NodeOutput<DrawLeafRecordBundle> shadowOutput
+){
+    CoalesceDrawLeafRecords(gtid, irs, output, shadowOutput);
 }
 
 [Shader("node")]
@@ -64,21 +42,13 @@ void CoalesceDrawBlossom(
 
     [MaxRecords(1)]
     [NodeId("DrawLeafBundle")]
-    NodeOutput<DrawLeafRecordBundle> output
-){
-    GroupNodeOutputRecords<DrawLeafRecordBundle> outputRecord = output.GetGroupNodeOutputRecords(1);
-
-    const TreeParameters treeParams = GetTreeParameters();
-
-    outputRecord.Get().dispatchGrid = uint2(DivideAndRoundUp(irs.Count(), lobesPerGroup), min(treeParams.Blossom.Lobes, TREE_MAX_LOBE_COUNT));
-    outputRecord.Get().isBlossom    = 1;
-    outputRecord.Get().leafCount    = irs.Count();
+    NodeOutput<DrawLeafRecordBundle> output,
 
-    if (gtid < irs.Count()) {
-        outputRecord.Get().leaves[gtid] = irs.Get(gtid);
-    }
-
-    outputRecord.OutputComplete();
+    [MaxRecords(1)]
+    [NodeId("DrawLeafBundleShadow")]
+    NodeOutput<DrawLeafRecordBundle> shadowOutput
+){
+    CoalesceDrawBlossomRecords(gtid, irs, output, shadowOutput);
 }
 
 struct LeafVertex{
@@ -109,6 +79,255 @@ float2 Rotate2D(float2 v, float angle){
         s * v.x + c * v.y);
 }
 
+// Computes vertex inLeaf of a leaf lobe at position (see GetDrawLeafPosition); clipSpacePosition is left to the caller
+LeafVertex ComputeLeafVertex(
+    in const DrawLeafRecord leafRecord,
+    in const float3         position,
+    in const LeafParameters params,
+    in const bool           isBlossom,
+    in const uint           lobeIndex,
+    in const int            inLeaf
+){
+    LeafVertex vertex;
+
+    const bool isLeft = inLeaf > 8;
+    const int inHalf = (isLeft) ? (16 - inLeaf) : inLeaf;
+
+    const float4 rot = leafRecord.trafo.GetRot();
+
+    const int  lobe = isBlossom? 0 : lobeIndex;
+
+    float botAngle = radians(params.BotAngle);
+    float midAngle = radians(params.MidAngle);
+    float topAngle = radians(params.TopAngle) + 0.2 * random::SignedRandom(leafRecord.seed, 222);
+
+    const float3x2 p = {
+        float2(0, 0),
+        float2(-.5 + 0.1 * random::SignedRandom(leafRecord.seed, 92), params.SideOffset + 0.1 * random::SignedRandom(leafRecord.seed, 29)),
+        float2(0, 1)
+    };
+    const float3x2 t = {
+        float2(sin(botAngle), cos(botAngle)),
+        float2(sin(midAngle), cos(midAngle)),
+        float2(sin(topAngle), cos(topAngle))
+    };
+    float4x4 w = {
+        float4(  1,     0,   0,     0),
+        float4(  1,  0.25,   0,     0),
+        float4(0.5, 0.125, 0.5, 0.125),
+        float4(  0,     0,   1,  0.25)
+    };
+
+    int isSecond = (inHalf > 3);
+    const float l = isSecond ? distance(p[1], p[2]) : distance(p[0], p[1]);
+    isSecond += (inHalf > 7);
+
+    const float4x2 cp = float4x2(
+            p[isSecond + 0],
+            t[min(isSecond + 0, 2)] * l,
+            p[min(isSecond + 1, 2)],
+            t[min(isSecond + 1, 2)] * -l
+    );
+    float3 modelSpacePosition;
+    modelSpacePosition.y = 0.;
+    modelSpacePosition.xz = mul(w[inHalf % 4], cp);
+
+    if(isLeft) modelSpacePosition.x = -modelSpacePosition.x;
+
+    float centerLobeF = (params.Lobes - 1) / 2.;
+    int centerLobe = centerLobeF;
+
+    float lobeScale = 1 - params.LobeFalloff * abs(lobe - centerLobeF);
+
+    vertex.lobeTexCoord = modelSpacePosition.xz;
+    vertex.lobeTexCoord.x *= params.ScaleX;
+
+    modelSpacePosition *= leafRecord.scale * lobeScale;
+    modelSpacePosition.x *= params.ScaleX;
+
+    if (isBlossom) {
+        const uint  blossomLeaf = lobeIndex;
+
+        const float blossomLeafAngleStep = 2 * PI / float(params.Lobes);
+        const float blossomLeafAngle     = blossomLeaf * blossomLeafAngleStep;
+
+        float angle = blossomLeafAngleStep / 4.f;
+        angle = (modelSpacePosition.x > 0) ? angle : -angle;
+
+        const float4 blossomRotation =
+            qMul(qRotateZ(blossomLeafAngle),
+                 qMul(qRotateX(radians(params.LobeAngle)), qRotateZ(angle)));
+        modelSpacePosition = qTransform(blossomRotation, modelSpacePosition);
+
+        vertex.worldSpaceNormal.xyz = qGetY(qMul(rot, blossomRotation));
+    } else {
+        float angle = 0;
+
+        if (params.IsNeedle) {
+            int inBlade = inLeaf % 4;
+            modelSpacePosition.x = .25 * params.ScaleX * ((inBlade & 1) ? 1 : -1);
+            modelSpacePosition.y = 0;
+            modelSpacePosition.z = inBlade >> 1;
+
+            vertex.lobeTexCoord = modelSpacePosition.xz;
+            modelSpacePosition *= leafRecord.scale * lobeScale;
+            angle = 0.75 * PI * (inLeaf / 4);
+        } else {
+            angle = max(0, GetSeason() - 2) * radians(20);
+            angle = (modelSpacePosition.x > 0) ? angle : -angle;
+        }
+
+        // Needle rotation or leaf folding in fall
+        modelSpacePosition.xy = Rotate2D(modelSpacePosition.xy, angle);
+        vertex.worldSpaceNormal.xyz = qGetY(qMul(rot, qRotateZ(angle)));
+
+        // lobe rotation
+        modelSpacePosition.xz = Rotate2D(modelSpacePosition.xz, radians(-params.LobeAngle * centerLobeF + params.LobeAngle * lobe));
+
+        if (!params.IsNeedle) {
+            if(lobe < centerLobe){
+                modelSpacePosition.x = max(0, modelSpacePosition.x);
+            }else if(lobe > centerLobe){
+                modelSpacePosition.x = min(0, modelSpacePosition.x);
+            }
+        }
+    }
+
+    modelSpacePosition.y -= abs(vertex.lobeTexCoord.x / lobeScale * 0.001);
+
+    vertex.texCoord = modelSpacePosition.xz;
+
+    float3 worldSpacePosition = position + qTransform(rot, modelSpacePosition);
+
+    vertex.worldSpacePosition.xyz = worldSpacePosition;
+
+    vertex.ao = fakeAOfromDistance(leafRecord.aoDistance);
+
+    return vertex;
+}
+
+// Computes triangle inLeaf of a leaf lobe, indices relative to the first vertex of the lobe
+uint3 ComputeLeafTriangle(
+    in const DrawLeafRecord leafRecord,
+    in const LeafParameters params,
+    in const bool           isBlossom,
+    in const uint           lobeIndex,
+    in const int            inLeaf,
+    out LeafPrimitive       primitive
+){
+    const int inHalf = inLeaf / 2;
+    const bool isLeft = inLeaf % 2;
+
+    const bool topIsConvex = params.TopConvex;
+    const bool isNeedle    = params.IsNeedle;
+
+    static const uint3 buffer[8] = {
+        uint3(0,2,4),
+        uint3(0,4,6),
+        uint3(0,6,7),
+        uint3(0,7,8),
+        uint3(0,1,2),
+        uint3(2,3,4),
+        uint3(4,5,6),
+        uint3(6,7,8),
+    };
+
+    uint3 tri = buffer[inHalf];
+    primitive.triangleType = (inHalf > 3) ? 1 : 0;
+
+    if(topIsConvex){
+        if(inHalf == 2){
+            tri.z += 1;
+        }else if(inHalf == 3){
+            tri = uint3(0,0,0);
+        }
+    }else if(inHalf == 7){
+        tri = tri.zyx;
+        primitive.triangleType = -1;
+    }
+
+    if(isLeft){
+        tri = (16 - tri) * (tri > 0);
+        tri = tri.zyx;
+    }
+
+    // In theory, a smart compiler could detect this as a single move...
+    BlossomSeed blossomSeed;
+    blossomSeed.blossom = isBlossom;
+    blossomSeed.seed    = leafRecord.seed;
+
+    primitive.blossomSeed = (uint)blossomSeed;
+    primitive.lobe        = isBlossom? 0 : lobeIndex;
+
+    if(isNeedle){
+        int blade = inLeaf / 2;
+        int inBlade = inLeaf % 2;
+        tri = blade * 4 + ((inBlade == 0) ? uint3(0,1,2) : uint3(1,3,2));
+        if(blade > 3) tri = uint3(0,0,0);
+        primitive.triangleType = 0;
+    }
+
+    return tri;
+}
+
+// Computes vertex inCard of a leaf card: a diamond of the lobe outline (p in ComputeLeafVertex),
+// widened to the fan of all lobes, at position (see GetDrawLeafPosition). clipSpacePosition is left to the caller.
+LeafVertex ComputeLeafCardVertex(
+    in const DrawLeafRecord leafRecord,
+    in const float3         position,
+    in const LeafParameters params,
+    in const int            inCard
+){
+    LeafVertex vertex;
+
+    const float4 rot = leafRecord.trafo.GetRot();
+
+    const float fanAngle  = radians(params.LobeAngle * (min(params.Lobes, TREE_MAX_LOBE_COUNT) - 1) / 2.);
+    const float halfWidth = .5 * params.ScaleX + sin(min(fanAngle, PI / 2));
+
+    const float2 outline[verticesPerCard] = {
+        float2(0, 0),
+        float2(-halfWidth, params.SideOffset),
+        float2(0, 1),
+        float2(halfWidth, params.SideOffset)
+    };
+
+    float3 modelSpacePosition;
+    modelSpacePosition.y  = 0;
+    modelSpacePosition.xz = outline[inCard];
+
+    vertex.lobeTexCoord = modelSpacePosition.xz;
+
+    modelSpacePosition *= leafRecord.scale;
+
+    vertex.texCoord = modelSpacePosition.xz;
+
+    vertex.worldSpaceNormal.xyz = qGetY(rot);
+
+    vertex.worldSpacePosition = position + qTransform(rot, modelSpacePosition);
+
+    vertex.ao = fakeAOfromDistance(leafRecord.aoDistance);
+
+    return vertex;
+}
+
+// Computes triangle inCard of a leaf card, indices relative to the first vertex of the card
+uint3 ComputeLeafCardTriangle(
+    in const DrawLeafRecord leafRecord,
+    in const int            inCard,
+    out LeafPrimitive       primitive
+){
+    BlossomSeed blossomSeed;
+    blossomSeed.blossom = 0;
+    blossomSeed.seed    = leafRecord.seed;
+
+    primitive.triangleType = 0;
+    primitive.blossomSeed  = (uint)blossomSeed;
+    primitive.lobe         = 0;
+
+    return (inCard == 0) ? uint3(0, 1, 2) : uint3(2, 3, 0);
+}
+
 [Shader("node")]
 [NodeLaunch("mesh")]
 [NodeId("DrawLeafBundle")]
@@ -127,212 +346,159 @@ void LeafMeshShader(
     const TreeParameters treeParams = GetTreeParameters();
     const LeafParameters params     = GetLeafParameters(treeParams, isBlossom);
 
-    const int startGlobalLeafId = gid.x * lobesPerGroup;
+    // Cards draw one card per leaf, otherwise every thread group in y draws one lobe of each leaf
+    const bool isCard           = ir.Get().isCard;
+    const int  leavesPerGroup   = isCard ? cardsPerGroup : lobesPerGroup;
+    const int  verticesPerLeaf  = isCard ? verticesPerCard : verticesPerLobe;
+    const int  trianglesPerLeaf = isCard ? trianglesPerCard : trianglesPerLobe;
+
+    const int startGlobalLeafId = gid.x * leavesPerGroup;
 
-    const int localLeafCount = clamp(ir.Get().leafCount - int(gid.x) * lobesPerGroup, 0, lobesPerGroup);
-    const int V = localLeafCount * verticesPerLobe;
-    const int T = localLeafCount * trianglesPerLobe;
+    const int localLeafCount = clamp(ir.Get().leafCount - int(gid.x) * leavesPerGroup, 0, leavesPerGroup);
+    const int V = localLeafCount * verticesPerLeaf;
+    const int T = localLeafCount * trianglesPerLeaf;
 
     SetMeshOutputCounts(V, T);
 
-    LeafVertex vertex;
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::LEAF_MESH_GROUPS, 1);
+        AddStatistic(StatisticsCounter::LEAF_MESH_VERTICES, V);
+        AddStatistic(StatisticsCounter::LEAF_MESH_TRIANGLES, T);
+    }
 
     if (gtid < V)
     {
         const int vertId = gtid;
 
-        const int globalLeafId = startGlobalLeafId + vertId / verticesPerLobe;
-        const int inLeaf = vertId % verticesPerLobe;
-
-        const bool isLeft = inLeaf > 8;
-        const int inHalf = (isLeft) ? (16 - inLeaf) : inLeaf;
+        const int globalLeafId = startGlobalLeafId + vertId / verticesPerLeaf;
+        const int inLeaf = vertId % verticesPerLeaf;
 
         const DrawLeafRecord leafRecord = ir.Get().leaves[(globalLeafId)];
+        const float3         position   = GetDrawLeafPosition(leafRecord);
 
-        const float4 rot = leafRecord.trafo.GetRot();
-
-        const int  lobe = isBlossom? 0 : gid.y;
-
-        float botAngle = radians(params.BotAngle);
-        float midAngle = radians(params.MidAngle);
-        float topAngle = radians(params.TopAngle) + 0.2 * random::SignedRandom(leafRecord.seed, 222);
-
-        const float3x2 p = {
-            float2(0, 0),
-            float2(-.5 + 0.1 * random::SignedRandom(leafRecord.seed, 92), params.SideOffset + 0.1 * random::SignedRandom(leafRecord.seed, 29)),
-            float2(0, 1)
-        };
-        const float3x2 t = {
-            float2(sin(botAngle), cos(botAngle)),
-            float2(sin(midAngle), cos(midAngle)),
-            float2(sin(topAngle), cos(topAngle))
-        };
-        float4x4 w = {
-            float4(  1,     0,   0,     0),
-            float4(  1,  0.25,   0,     0),
-            float4(0.5, 0.125, 0.5, 0.125),
-            float4(  0,     0,   1,  0.25)
-        };
-
-        int isSecond = (inHalf > 3);
-        const float l = isSecond ? distance(p[1], p[2]) : distance(p[0], p[1]);
-        isSecond += (inHalf > 7);
-
-        const float4x2 cp = float4x2(
-                p[isSecond + 0],
-                t[min(isSecond + 0, 2)] * l,
-                p[min(isSecond + 1, 2)],
-                t[min(isSecond + 1, 2)] * -l
-        );
-        float3 modelSpacePosition;
-        modelSpacePosition.y = 0.;
-        modelSpacePosition.xz = mul(w[inHalf % 4], cp);
-
-        if(isLeft) modelSpacePosition.x = -modelSpacePosition.x;
-
-        float centerLobeF = (params.Lobes - 1) / 2.;
-        int centerLobe = centerLobeF;
-
-        float lobeScale = 1 - params.LobeFalloff * abs(lobe - centerLobeF);
-
-        vertex.lobeTexCoord = modelSpacePosition.xz;
-        vertex.lobeTexCoord.x *= params.ScaleX;
-
-        modelSpacePosition *= leafRecord.scale * lobeScale;
-        modelSpacePosition.x *= params.ScaleX;
-
-        if (isBlossom) {
-            const uint  blossomLeaf = gid.y;
-
-            const float blossomLeafAngleStep = 2 * PI / float(params.Lobes);
-            const float blossomLeafAngle     = blossomLeaf * blossomLeafAngleStep;
-
-            float angle = blossomLeafAngleStep / 4.f;
-            angle = (modelSpacePosition.x > 0) ? angle : -angle;
+        LeafVertex vertex;
+        if (isCard) {
+            vertex = ComputeLeafCardVertex(leafRecord, position, params, inLeaf);
+        } else {
+            vertex = ComputeLeafVertex(leafRecord, position, params, isBlossom, gid.y, inLeaf);
+        }
 
-            const float4 blossomRotation =
-                qMul(qRotateZ(blossomLeafAngle),
-                     qMul(qRotateX(radians(params.LobeAngle)), qRotateZ(angle)));
-            modelSpacePosition = qTransform(blossomRotation, modelSpacePosition);
+        vertex.clipSpacePosition = mul(GetViewProjectionMatrix(), float4(vertex.worldSpacePosition, 1));
 
-            vertex.worldSpaceNormal.xyz = qGetY(qMul(rot, blossomRotation));
-        } else {
-            float angle = 0;
-
-            if (params.IsNeedle) {
-                int inBlade = inLeaf % 4;
-                modelSpacePosition.x = .25 * params.ScaleX * ((inBlade & 1) ? 1 : -1);
-                modelSpacePosition.y = 0;
-                modelSpacePosition.z = inBlade >> 1;
-
-                vertex.lobeTexCoord = modelSpacePosition.xz;
-                modelSpacePosition *= leafRecord.scale * lobeScale;
-                angle = 0.75 * PI * (inLeaf / 4);
-            } else {
-                angle = max(0, GetSeason() - 2) * radians(20);
-                angle = (modelSpacePosition.x > 0) ? angle : -angle;
-            }
+        verts[vertId] = vertex;
+    }
 
-            // Needle rotation or leaf folding in fall
-            modelSpacePosition.xy = Rotate2D(modelSpacePosition.xy, angle);
-            vertex.worldSpaceNormal.xyz = qGetY(qMul(rot, qRotateZ(angle)));
+    if (gtid < T) {
+        const int triId = gtid;
 
-            // lobe rotation
-            modelSpacePosition.xz = Rotate2D(modelSpacePosition.xz, radians(-params.LobeAngle * centerLobeF + params.LobeAngle * lobe));
+        const int inLeaf      = triId % trianglesPerLeaf;
+        const int localLeafId = triId / trianglesPerLeaf;
+        const int globalLeafId = startGlobalLeafId + localLeafId;
 
-            if (!params.IsNeedle) {
-                if(lobe < centerLobe){
-                    modelSpacePosition.x = max(0, modelSpacePosition.x);
-                }else if(lobe > centerLobe){
-                    modelSpacePosition.x = min(0, modelSpacePosition.x);
-                }
-            }
+        const DrawLeafRecord leafRecord = ir.Get().leaves[(globalLeafId)];
+
+        LeafPrimitive primitive;
+        uint3 tri;
+        if (isCard) {
+            tri = ComputeLeafCardTriangle(leafRecord, inLeaf, primitive);
+        } else {
+            tri = ComputeLeafTriangle(leafRecord, params, isBlossom, gid.y, inLeaf, primitive);
         }
 
-        modelSpacePosition.y -= abs(vertex.lobeTexCoord.x / lobeScale * 0.001);
+        tris[triId] = localLeafId * verticesPerLeaf + tri;
 
-        vertex.texCoord = modelSpacePosition.xz;
+        prims[triId] = primitive;
+    }
+}
 
-        float3 worldSpacePosition = leafRecord.trafo.GetPos() + qTransform(rot, modelSpacePosition);
+// Depth-only variant of LeafMeshShader for the shadow map.
+// Curved leaf edges are not cut out (see LeafPixelShader), i.e. leaves cast their convex hull.
+[Shader("node")]
+[NodeLaunch("mesh")]
+[NodeId("DrawLeafBundleShadow")]
+[NodeMaxDispatchGrid(maxDrawLobeGroupsPerDispatch, TREE_MAX_LOBE_COUNT, 1)]
+[NumThreads(128, 1, 1)]
+[OutputTopology("triangle")]
+void LeafShadowMeshShader(
+    uint2 gid : SV_GroupID,
+    uint  gtid : SV_GroupThreadID,
+    DispatchNodeInputRecord<DrawLeafRecordBundle> ir,
+    out vertices ShadowVertex verts[maxNumVerticesPerLobeGroup],
+    out indices uint3 tris[maxNumTrianglesPerLobeGroup]
+){
+    const bool isBlossom            = ir.Get().isBlossom;
+    const TreeParameters treeParams = GetTreeParameters();
+    const LeafParameters params     = GetLeafParameters(treeParams, isBlossom);
 
-        vertex.worldSpacePosition.xyz = worldSpacePosition;
+    // Cards draw one card per leaf, otherwise every thread group in y draws one lobe of each leaf
+    const bool isCard           = ir.Get().isCard;
+    const int  leavesPerGroup   = isCard ? cardsPerGroup : lobesPerGroup;
+    const int  verticesPerLeaf  = isCard ? verticesPerCard : verticesPerLobe;
+    const int  trianglesPerLeaf = isCard ? trianglesPerCard : trianglesPerLobe;
 
-        vertex.clipSpacePosition = mul(GetViewProjectionMatrix(), float4(worldSpacePosition, 1));
+    const int startGlobalLeafId = gid.x * leavesPerGroup;
 
-        vertex.ao = fakeAOfromDistance(leafRecord.aoDistance);
+    const int localLeafCount = clamp(ir.Get().leafCount - int(gid.x) * leavesPerGroup, 0, leavesPerGroup);
+    const int V = localLeafCount * verticesPerLeaf;
+    const int T = localLeafCount * trianglesPerLeaf;
 
-        verts[vertId] = vertex;
-    }
+    SetMeshOutputCounts(V, T);
 
-    if (gtid < T) {
-        const int triId = gtid;
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::LEAF_SHADOW_MESH_GROUPS, 1);
+        AddStatistic(StatisticsCounter::LEAF_SHADOW_MESH_VERTICES, V);
+        AddStatistic(StatisticsCounter::LEAF_SHADOW_MESH_TRIANGLES, T);
+    }
 
-        const int inLeaf      = triId % trianglesPerLobe;
-        const int localLeafId = triId / trianglesPerLobe;
-        const int globalLeafId = startGlobalLeafId + localLeafId;
+    if (gtid < V)
+    {
+        const int vertId = gtid;
 
-        const int inHalf = inLeaf / 2;
-        const bool isLeft = inLeaf % 2;
+        const int globalLeafId = startGlobalLeafId + vertId / verticesPerLeaf;
+        const int inLeaf = vertId % verticesPerLeaf;
 
         const DrawLeafRecord leafRecord = ir.Get().leaves[(globalLeafId)];
+        const float3         position   = GetDrawLeafPosition(leafRecord);
 
-        const bool topIsConvex = params.TopConvex;
-        const bool isNeedle    = params.IsNeedle;
-
-        LeafPrimitive primitive;
-
-        static const uint3 buffer[8] = {
-            uint3(0,2,4),
-            uint3(0,4,6),
-            uint3(0,6,7),
-            uint3(0,7,8),
-            uint3(0,1,2),
-            uint3(2,3,4),
-            uint3(4,5,6),
-            uint3(6,7,8),
-        };
-
-        uint3 tri = buffer[inHalf];
-        primitive.triangleType = (inHalf > 3) ? 1 : 0;
-
-        if(topIsConvex){
-            if(inHalf == 2){
-                tri.z += 1;
-            }else if(inHalf == 3){
-                tri = uint3(0,0,0);
-            }
-        }else if(inHalf == 7){
-            tri = tri.zyx;
-            primitive.triangleType = -1;
+        LeafVertex vertex;
+        if (isCard) {
+            vertex = ComputeLeafCardVertex(leafRecord, position, params, inLeaf);
+        } else {
+            vertex = ComputeLeafVertex(leafRecord, position, params, isBlossom, gid.y, inLeaf);
         }
 
-        if(isLeft){
-            tri = (16 - tri) * (tri > 0);
-            tri = tri.zyx;
-        }
+        verts[vertId] = GetShadowVertex(vertex.worldSpacePosition);
+    }
 
-        // In theory, a smart compiler could detect this as a single move...
-        BlossomSeed blossomSeed;
-        blossomSeed.blossom = isBlossom;
-        blossomSeed.seed    = leafRecord.seed;
+    if (gtid < T) {
+        const int triId = gtid;
 
-        primitive.blossomSeed = (uint)blossomSeed;
-        primitive.lobe        = isBlossom? 0 : gid.y;
+        const int inLeaf      = triId % trianglesPerLeaf;
+        const int localLeafId = triId / trianglesPerLeaf;
+        const int globalLeafId = startGlobalLeafId + localLeafId;
 
-        if(isNeedle){
-            int blade = inLeaf / 2;
-            int inBlade = inLeaf % 2;
-            tri = blade * 4 + ((inBlade == 0) ? uint3(0,1,2) : uint3(1,3,2));
-            if(blade > 3) tri = uint3(0,0,0);
-            primitive.triangleType = 0;
-        }
+        const DrawLeafRecord leafRecord = ir.Get().leaves[(globalLeafId)];
 
-        tris[triId] = localLeafId * verticesPerLobe + tri;
+        LeafPrimitive primitive;
+        uint3 tri;
+        if (isCard) {
+            tri = ComputeLeafCardTriangle(leafRecord, inLeaf, primitive);
+        } else {
+            tri = ComputeLeafTriangle(leafRecord, params, isBlossom, gid.y, inLeaf, primitive);
+        }
 
-        prims[triId] = primitive;
+        tris[triId] = localLeafId * verticesPerLeaf + tri;
     }
 }
 
+float4 LeafShadowPixelShader(const in ShadowVertex vertex) : SV_Target0
+{
+    StoreShadowDepth(vertex.lightPosition, vertex.depth);
+    discard;
+
+    return 0;
+}
+
 float2 computeUV(const float3 bary){
     return float2(mad(bary.y,.5f, bary.z),  bary.z);
 }
@@ -508,5 +674,7 @@ float4 LeafPixelShader(
         surface.baseColor.rgb = .25 * float3(.85,.82,.28);
     }
 
-    return ShadeSurface(surface);
+    StoreOcclusionDepth(vertex.clipSpacePosition);
+
+    return ShadeSurface(surface, GetLightVisibility(vertex.worldSpacePosition));
 }
\ No newline at end of file
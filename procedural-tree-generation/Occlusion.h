@@ -0,0 +1,242 @@
+#pragma once
+
+#include "Camera.h"
+#include "Config.h"
+#include "Shadow.h"
+
+// ============================ Occlusion Culling ====================
+// Hierarchical-Z occlusion culling of trees, branches and stem segments against the camera depth of an earlier frame.
+// The camera pixel shaders write one depth sample per texel of an OcclusionDepthWidth x OcclusionDepthHeight map
+// with InterlockedMax into PersistentScratchBuffer (see StoreOcclusionDepth), like the shadow map. Texels store
+// 1 - depth, so a zeroed (cleared) texel is at the far plane.
+//
+// The work graph cannot wait for its own rasterization: the depth of frame N is reduced to the occlusion pyramid
+// by the BuildOcclusionPyramid node in frame N+1, which Stem, TreeInstance and TreeRoots test against in frame N+2
+// with the camera view of frame N. Pyramid texels hold the farthest depth below them; a bounding sphere is occluded
+// if its nearest point is behind the farthest depth of all pyramid texels its screen rectangle overlaps.
+//
+// Occluded records never write depth, so they do not keep themselves occluded: every frame re-tests them against
+// the newest pyramid. Occlusion is only valid for the geometry and view it was rendered with, so the test is
+// suspended while the camera moves or the generation settings differ from the depth frame (GetOcclusionView).
+// Only the camera view is culled: trees and branches occluded in the camera view, but inside the light frustum,
+// are still generated with GenerateTreeRecord::isCameraOccluded set and only emit their shadow records.
+
+static const uint OcclusionDepthWidth     = 512;
+static const uint OcclusionDepthHeight    = 256;
+static const uint OcclusionDepthBankCount = 3;
+
+// Level 0 reduces 2x2 depth texels; every BuildOcclusionPyramid group reduces 32x32 level 0 texels to one texel
+// of the last level
+static const uint OcclusionPyramidWidth     = OcclusionDepthWidth / 2;
+static const uint OcclusionPyramidHeight    = OcclusionDepthHeight / 2;
+static const uint OcclusionPyramidLevels    = 6;
+static const uint OcclusionPyramidGroupSize = 1 << (OcclusionPyramidLevels - 1);
+static const uint OcclusionPyramidGroupsX   = OcclusionPyramidWidth / OcclusionPyramidGroupSize;
+static const uint OcclusionPyramidGroupsY   = OcclusionPyramidHeight / OcclusionPyramidGroupSize;
+static const uint OcclusionPyramidBankCount = 2;
+
+// Stem geometry sways with the wind between the depth frame and the test
+static const float OcclusionDepthMargin     = .25f;
+static const float OcclusionMaxCameraMotion = .01f;
+
+// Camera view and generation settings of the frame a depth map or pyramid was rendered in
+struct OcclusionViewHeader {
+    float4x4 viewProjectionMatrix;
+    float3   cameraPosition;
+    // Hash of the generation settings, see GetOcclusionKey; 0 for banks that were never written
+    uint     key;
+};
+
+struct OcclusionView {
+    float4x4 viewProjectionMatrix;
+    uint     isValid;
+};
+
+// Each bank is an OcclusionViewHeader followed by the texels
+static const uint OcclusionDepthBankSize   = sizeof(OcclusionViewHeader) + OcclusionDepthWidth * OcclusionDepthHeight * sizeof(uint);
+static const uint OcclusionPyramidTexels   = (OcclusionPyramidWidth * OcclusionPyramidHeight * 4 -
+                                              (OcclusionPyramidWidth >> (OcclusionPyramidLevels - 1)) * (OcclusionPyramidHeight >> (OcclusionPyramidLevels - 1))) / 3;
+static const uint OcclusionPyramidBankSize = sizeof(OcclusionViewHeader) + OcclusionPyramidTexels * sizeof(float);
+
+// Placed after the shadow maps, before the tree templates (see TreeTemplates.h)
+static const uint OcclusionDepthOffset   = ShadowMapOffset + ShadowMapBankCount * ShadowMapBankSize;
+static const uint OcclusionPyramidOffset = OcclusionDepthOffset + OcclusionDepthBankCount * OcclusionDepthBankSize;
+static const uint OcclusionEnd           = OcclusionPyramidOffset + OcclusionPyramidBankCount * OcclusionPyramidBankSize;
+
+// Depth map written in this frame
+uint GetOcclusionDepthWriteBank() {
+    return LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX);
+}
+
+// Depth map completed in the last frame
+uint GetOcclusionDepthReadBank() {
+    return LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX) + (OcclusionDepthBankCount - 1);
+}
+
+// Depth map cleared in this frame, written in the next frame
+uint GetOcclusionDepthClearBank() {
+    return LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX) + 1;
+}
+
+// Pyramid built in this frame
+uint GetOcclusionPyramidWriteBank() {
+    return LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX);
+}
+
+// Pyramid built in the last frame
+uint GetOcclusionPyramidReadBank() {
+    return LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX) + 1;
+}
+
+uint GetOcclusionDepthBankAddress(in uint bank) {
+    return OcclusionDepthOffset + (bank % OcclusionDepthBankCount) * OcclusionDepthBankSize;
+}
+
+uint GetOcclusionDepthTexelAddress(in uint bank, in uint2 texel) {
+    texel = min(texel, uint2(OcclusionDepthWidth, OcclusionDepthHeight) - 1);
+    return GetOcclusionDepthBankAddress(bank) + sizeof(OcclusionViewHeader) + (texel.y * OcclusionDepthWidth + texel.x) * sizeof(uint);
+}
+
+uint GetOcclusionPyramidBankAddress(in uint bank) {
+    return OcclusionPyramidOffset + (bank % OcclusionPyramidBankCount) * OcclusionPyramidBankSize;
+}
+
+uint2 GetOcclusionPyramidLevelSize(in uint level) {
+    return uint2(OcclusionPyramidWidth >> level, OcclusionPyramidHeight >> level);
+}
+
+uint GetOcclusionPyramidTexelAddress(in uint bank, in uint level, in uint2 texel) {
+    uint levelOffset = 0;
+    for (uint l = 0; l < level; ++l) {
+        levelOffset += GetOcclusionPyramidLevelSize(l).x * GetOcclusionPyramidLevelSize(l).y;
+    }
+
+    const uint2 levelSize = GetOcclusionPyramidLevelSize(level);
+    texel = min(texel, levelSize - 1);
+    return GetOcclusionPyramidBankAddress(bank) + sizeof(OcclusionViewHeader) +
+           (levelOffset + texel.y * levelSize.x + texel.x) * sizeof(float);
+}
+
+// Hash of the settings that change the generated geometry, PersistentConfig::TREE_TYPE to TREE_TEMPLATE_COUNT
+uint GetOcclusionKey() {
+    uint key = 1;
+    for (uint config = (uint)PersistentConfig::TREE_TYPE; config <= (uint)PersistentConfig::TREE_TEMPLATE_COUNT; ++config) {
+        key = random::CombineSeed(key, LoadPersistentConfigUint((PersistentConfig)config));
+    }
+    // 0 marks banks that were never written
+    return max(key, 1u);
+}
+
+// Stores the camera view of this frame with its depth map. Must run in EntryFunction, after StoreCameraView.
+void StoreOcclusionView() {
+    const ViewParameters cameraView = GetCameraView();
+
+    OcclusionViewHeader header;
+    header.viewProjectionMatrix = cameraView.viewProjectionMatrix;
+    header.cameraPosition       = cameraView.position;
+    header.key                  = GetOcclusionKey();
+
+    PersistentScratchBuffer.Store<OcclusionViewHeader>(GetOcclusionDepthBankAddress(GetOcclusionDepthWriteBank()), header);
+}
+
+// Called by the camera pixel shaders with SV_Position. Only the pixel at the center of each depth texel writes,
+// so the depth map holds point samples of the depth buffer; uncovered samples stay at the far plane.
+void StoreOcclusionDepth(in const float4 pixelPosition) {
+    const float2 depthSize   = float2(OcclusionDepthWidth, OcclusionDepthHeight);
+    const uint2  texel       = uint2(pixelPosition.xy / float2(RenderSize) * depthSize);
+    const uint2  samplePixel = uint2((texel + .5) / depthSize * float2(RenderSize));
+
+    if (all(uint2(pixelPosition.xy) == samplePixel)) {
+        // Non-negative floats order like their bit patterns
+        PersistentScratchBuffer.InterlockedMax(GetOcclusionDepthTexelAddress(GetOcclusionDepthWriteBank(), texel),
+                                               asuint(1 - saturate(pixelPosition.z)));
+    }
+}
+
+// Depth of a texel of the last frame's depth map, in [0, 1]
+float LoadOcclusionDepth(in const uint2 texel) {
+    return 1 - asfloat(PersistentScratchBuffer.Load<uint>(GetOcclusionDepthTexelAddress(GetOcclusionDepthReadBank(), texel)));
+}
+
+float LoadOcclusionPyramidTexel(in const uint level, in const uint2 texel) {
+    return PersistentScratchBuffer.Load<float>(GetOcclusionPyramidTexelAddress(GetOcclusionPyramidReadBank(), level, texel));
+}
+
+// View of the pyramid built in the last frame; nodes load it once and pass it to IsSphereOccluded
+OcclusionView GetOcclusionView() {
+    const OcclusionViewHeader header =
+        PersistentScratchBuffer.Load<OcclusionViewHeader>(GetOcclusionPyramidBankAddress(GetOcclusionPyramidReadBank()));
+
+    OcclusionView view;
+    view.viewProjectionMatrix = header.viewProjectionMatrix;
+    view.isValid              = (header.key == GetOcclusionKey()) &&
+                                (distance(header.cameraPosition, GetCameraPosition()) <= OcclusionMaxCameraMotion);
+
+    return view;
+}
+
+// View that occludes nothing, e.g. for the shadow view
+OcclusionView GetNoOcclusionView() {
+    OcclusionView view;
+    view.viewProjectionMatrix = float4x4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+    view.isValid              = false;
+
+    return view;
+}
+
+// Returns true if the sphere is hidden behind the depth of the occlusion view.
+// Spheres outside the viewport are not occluded, frustum culling decides on them.
+bool IsSphereOccluded(in const OcclusionView view, in const float3 center, in const float radius) {
+    if (!view.isValid) {
+        return false;
+    }
+
+    const float4x4 m    = view.viewProjectionMatrix;
+    const float4   clip = mul(m, float4(center, 1));
+
+    // Depth only depends on the distance along the view direction (row 3 of the perspective matrix),
+    // the sphere is nearest to the camera at its center moved towards the camera by its radius
+    const float  nearRadius = radius + OcclusionDepthMargin;
+    const float4 nearClip   = mul(m, float4(center - normalize(m[3].xyz) * nearRadius, 1));
+
+    // Spheres that reach the near plane are always visible
+    if ((nearClip.z <= 0) || (clip.w <= nearRadius)) {
+        return false;
+    }
+
+    const float nearDepth = nearClip.z / nearClip.w;
+
+    // Screen rectangle of the box around the sphere: x / w takes its extremes at the corners of
+    // [x - r, x + r] x [w - r, w + r] in clip space
+    const float2 extent  = radius * float2(length(m[0].xyz), length(m[1].xyz));
+    const float  nearW   = clip.w - radius;
+    const float  farW    = clip.w + radius;
+    const float2 clipMin = min((clip.xy - extent) / nearW, (clip.xy - extent) / farW);
+    const float2 clipMax = max((clip.xy + extent) / nearW, (clip.xy + extent) / farW);
+
+    if (any(clipMin > 1) || any(clipMax < -1)) {
+        return false;
+    }
+
+    // Same mapping as the rasterizer: y points down in pixel coordinates
+    const float2 levelSize0 = float2(OcclusionPyramidWidth, OcclusionPyramidHeight);
+    const float2 texelMin   = saturate(float2(clipMin.x, -clipMax.y) * .5 + .5) * levelSize0;
+    const float2 texelMax   = saturate(float2(clipMax.x, -clipMin.y) * .5 + .5) * levelSize0;
+
+    // Level at which the rectangle covers at most 2x2 texels; larger rectangles loop over the texels of the last level
+    const float maxExtent = max(max(texelMax.x - texelMin.x, texelMax.y - texelMin.y), 1);
+    const uint  level     = min(uint(ceil(log2(maxExtent))), OcclusionPyramidLevels - 1);
+
+    const uint2 levelSize = GetOcclusionPyramidLevelSize(level);
+    const uint2 first     = min(uint2(texelMin) >> level, levelSize - 1);
+    const uint2 last      = min(uint2(texelMax) >> level, levelSize - 1);
+
+    float farthestDepth = 0;
+    for (uint y = first.y; y <= last.y; ++y) {
+        for (uint x = first.x; x <= last.x; ++x) {
+            farthestDepth = max(farthestDepth, LoadOcclusionPyramidTexel(level, uint2(x, y)));
+        }
+    }
+
+    return nearDepth > farthestDepth;
+}
@@ -11,6 +11,7 @@
 #include "Leaves.h"
 #include "Fruits.h"
 #include "TreeGeneration.h"
+#include "Chunks.h"
 
 [Shader("node")]
 [NodeIsProgramEntry]
@@ -18,8 +19,12 @@
 [NodeId("Entry", 0)]
 void EntryFunction(
     [MaxRecords(1)]
-    [NodeId("TreeRoots")]
-    NodeOutput<TreeRootsRecord> treeRootsOutput,
+    [NodeId("Chunks")]
+    EmptyNodeOutput chunksOutput,
+
+    [MaxRecords(1)]
+    [NodeId("TreeTemplates")]
+    EmptyNodeOutput treeTemplatesOutput,
 
     [MaxRecords(1)]
     [NodeId("Skybox")]
@@ -29,9 +34,25 @@ void EntryFunction(
     [NodeId("SimpleCube")]
     NodeOutput<SimpleCubeRecord> simpleCubeOutput,
 
+    [MaxRecords(1)]
+    [NodeId("SimpleCubeShadow")]
+    NodeOutput<SimpleCubeRecord> simpleCubeShadowOutput,
+
     [MaxRecords(1)]
     [NodeId("UserInterface")]
-    EmptyNodeOutput userInterfaceOutput
+    EmptyNodeOutput userInterfaceOutput,
+
+    [MaxRecords(1)]
+    [NodeId("ClearShadowMap")]
+    EmptyNodeOutput clearShadowMapOutput,
+
+    [MaxRecords(1)]
+    [NodeId("BuildOcclusionPyramid")]
+    EmptyNodeOutput buildOcclusionPyramidOutput,
+
+    [MaxRecords(1)]
+    [NodeId("BakeBarkTexture")]
+    EmptyNodeOutput bakeBarkTextureOutput
 )
 {
     // Check and init persistent config with default values
@@ -41,6 +62,9 @@ void EntryFunction(
         StorePersistentConfig(PersistentConfig::TREE_ATTRACTION_UP, GetTreeParameters().AttractionUp);
         StorePersistentConfig(PersistentConfig::SEASON, 2.f);
         StorePersistentConfig(PersistentConfig::WIND_STRENGTH, 5.f);
+        StorePersistentConfig(PersistentConfig::DRAW_DISTANCE, DefaultDrawDistance);
+        StorePersistentConfig(PersistentConfig::TREE_TEMPLATE_COUNT, 0);
+        StorePersistentConfig(PersistentConfig::TRIANGLE_BUDGET, 0.f);
 
 
         const TreeParameters params = GetTreeParameters();
@@ -54,6 +78,10 @@ void EntryFunction(
         StorePersistentConfig(PersistentConfig::MOUSE_X, MousePosition.x);
         StorePersistentConfig(PersistentConfig::MOUSE_Y, MousePosition.y);
         StorePersistentConfig(PersistentConfig::KEY_SPACE_DOWN, 0);
+        StorePersistentConfig(PersistentConfig::FRAME_INDEX, 0);
+
+        // Bark textures of all tree types are baked once
+        bakeBarkTextureOutput.ThreadIncrementOutputCount(1);
 
         // Mark config initialized
         PersistentScratchBuffer.Store<uint>(0, 1);
@@ -103,11 +131,22 @@ void EntryFunction(
         // Store mouse position to compute delta in next frame
         StorePersistentConfig(PersistentConfig::MOUSE_X, MousePosition.x);
         StorePersistentConfig(PersistentConfig::MOUSE_Y, MousePosition.y);
+        // Advance shadow map banks
+        StorePersistentConfig(PersistentConfig::FRAME_INDEX, LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX) + 1);
     }
 
+    // Statistics, triangle budget, views and tree indices of this frame
+    const uint regeneratedTreeTemplateCount = BeginTreeFrame();
+
     // kick off rendering UI
     userInterfaceOutput.ThreadIncrementOutputCount(1);
 
+    // clear shadow map of the next frame
+    clearShadowMapOutput.ThreadIncrementOutputCount(1);
+
+    // reduce the depth of the last frame to the occlusion pyramid of the next frame
+    buildOcclusionPyramidOutput.ThreadIncrementOutputCount(1);
+
     // draw skybox
     ThreadNodeOutputRecords<SkyboxRecord> skyboxRecord = skyboxOutput.GetThreadNodeOutputRecords(1);
     skyboxRecord.Get().test = 0;
@@ -118,48 +157,332 @@ void EntryFunction(
     simpleCubeRecord.Get().test = 0;
     simpleCubeRecord.OutputComplete();
 
-    // dispatch TreeRoots broadcasting node to generate trees
-    ThreadNodeOutputRecords<TreeRootsRecord> treeRootsRecord = treeRootsOutput.GetThreadNodeOutputRecords(1);
-    treeRootsRecord.Get().dispatchGrid = uint3(5, 5, 1);  // 5x5 grid of trees
-    treeRootsRecord.OutputComplete();
+    ThreadNodeOutputRecords<SimpleCubeRecord> simpleCubeShadowRecord = simpleCubeShadowOutput.GetThreadNodeOutputRecords(1);
+    simpleCubeShadowRecord.Get().test = 0;
+    simpleCubeShadowRecord.OutputComplete();
+
+    // dispatch TreeTemplates broadcasting node to regenerate the templates whose inputs changed
+    treeTemplatesOutput.ThreadIncrementOutputCount(regeneratedTreeTemplateCount > 0 ? 1 : 0);
+
+    // dispatch Chunks broadcasting node to generate the trees around the camera
+    chunksOutput.ThreadIncrementOutputCount(1);
+}
+
+// ============================ Chunks Broadcasting Node ====================
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(ChunksGroups, ChunksGroups, 1)]
+[NumThreads(ChunksGroupSize, ChunksGroupSize, 1)]
+[NodeId("Chunks")]
+void ChunksNode(
+    [MaxRecords(ChunksGroupSize * ChunksGroupSize)]
+    [NodeId("TreeRoots")]
+    NodeOutput<TreeRootsRecord> treeRootsOutput,
+
+    uint3 dispatchThreadID : SV_DispatchThreadID
+)
+{
+    GenerateChunks(dispatchThreadID.xy, treeRootsOutput);
 }
 
 // ============================ TreeRoots Broadcasting Node ====================
 
 [Shader("node")]
 [NodeLaunch("broadcasting")]
-[NodeMaxDispatchGrid(16, 16, 1)]  // Max grid for dynamic dispatch
-[NumThreads(1, 1, 1)]
+[NodeDispatchGrid(1, 1, 1)]
+[NumThreads(ChunkTreeGridSize, ChunkTreeGridSize, 1)]
 [NodeId("TreeRoots")]
 void TreeRootsNode(
     DispatchNodeInputRecord<TreeRootsRecord> input,
 
-    [MaxRecords(1)]
+    [MaxRecords(ChunkTreeCount)]
     [NodeId("Stem")]
-    NodeOutput<GenerateTreeRecord> treeOutput,
+    [NodeArraySize(TREE_TYPE_COUNT)]
+    NodeOutputArray<GenerateTreeRecord> treeOutput,
 
-    uint3 dispatchThreadID : SV_DispatchThreadID
+    [MaxRecords(ChunkTreeCount)]
+    [NodeId("TreeInstance")]
+    NodeOutput<TreeInstanceRecord> treeInstanceOutput,
+
+    uint3 gtid : SV_GroupThreadID
+)
+{
+    GenerateTreeRoots(gtid.xy, input.Get(), treeOutput, treeInstanceOutput);
+}
+
+// ============================ Stem Broadcasting Nodes ====================
+
+// Declares the Stem node of one tree type at index TREE_TYPE_INDEX of the "Stem" node array.
+// Branches recurse into the same node array entry, i.e. a tree never changes its type.
+#define STEM_NODE(NAME, TREE_TYPE_INDEX)                                                                               \
+[Shader("node")]                                                                                                       \
+[NodeLaunch("broadcasting")]                                                                                           \
+[NodeId("Stem", TREE_TYPE_INDEX)]                                                                                      \
+[NodeMaxRecursionDepth(stemMaxRecursionDepth)]                                                                         \
+[NodeDispatchGrid(1, 1, 1)]                                                                                            \
+[NumThreads(StemThreadGroupSize, 1, 1)]                                                                                \
+void NAME(                                                                                                             \
+    uint gtid : SV_GroupThreadId,                                                                                      \
+    DispatchNodeInputRecord<GenerateTreeRecord> ir,                                                                    \
+                                                                                                                       \
+    [MaxRecords(maxChildRecords)]                                                                                      \
+    [NodeId("Stem", TREE_TYPE_INDEX)]                                                                                  \
+    NodeOutput<GenerateTreeRecord> generateTreeOutput,                                                                 \
+                                                                                                                       \
+    [MaxRecordsSharedWith(generateTreeOutput)]                                                                         \
+    [NodeId("Twig", TREE_TYPE_INDEX)]                                                                                  \
+    NodeOutput<GenerateTreeRecord> twigOutput,                                                                         \
+                                                                                                                       \
+    [MaxRecordsSharedWith(generateTreeOutput)]                                                                         \
+    [NodeId("CoalesceDrawLeaves")]                                                                                     \
+    [NodeArraySize(3)]                                                                                                 \
+    NodeOutputArray<DrawLeafRecord> drawLeafOutput,                                                                    \
+                                                                                                                       \
+    [MaxRecords(maxSegmentRecords)]                                                                                    \
+    [NodeId("DrawSegment")]                                                                                            \
+    NodeOutput<DrawSegmentRecord> drawSegmentOutput,                                                                   \
+                                                                                                                       \
+    [MaxRecords(maxSegmentRecords)]                                                                                    \
+    [NodeId("DrawSegmentShadow")]                                                                                      \
+    NodeOutput<DrawSegmentRecord> drawSegmentShadowOutput,                                                             \
+                                                                                                                       \
+    [MaxRecordsSharedWith(drawSegmentOutput)]                                                                          \
+    [NodeId("CoalesceDrawSegments", 0)]                                                                                \
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentOutput,                                                           \
+                                                                                                                       \
+    [MaxRecordsSharedWith(drawSegmentShadowOutput)]                                                                    \
+    [NodeId("CoalesceDrawSegments", 1)]                                                                                \
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentShadowOutput                                                      \
+)                                                                                                                      \
+{                                                                                                                      \
+    GenerateStem(                                                                                                      \
+        TREE_TYPE_INDEX,                                                                                               \
+        gtid,                                                                                                          \
+        ir.Get(),                                                                                                      \
+        generateTreeOutput,                                                                                            \
+        twigOutput,                                                                                                    \
+        drawLeafOutput,                                                                                                \
+        drawSegmentOutput,                                                                                             \
+        drawSegmentShadowOutput,                                                                                       \
+        coalesceDrawSegmentOutput,                                                                                     \
+        coalesceDrawSegmentShadowOutput);                                                                              \
+}
+
+STEM_NODE(StemApple, TREE_TYPE_APPLE)
+STEM_NODE(StemSassafras, TREE_TYPE_SASSAFRAS)
+STEM_NODE(StemPalm, TREE_TYPE_PALM)
+STEM_NODE(StemTamarack, TREE_TYPE_TAMARACK)
+
+// ============================ Twig Coalescing Nodes ====================
+
+// Declares the Twig node of one tree type at index TREE_TYPE_INDEX of the "Twig" node array, which the Stem node
+// of the same tree type sends its twigs to.
+#define TWIG_NODE(NAME, TREE_TYPE_INDEX)                                                                               \
+[Shader("node")]                                                                                                       \
+[NodeLaunch("coalescing")]                                                                                             \
+[NodeId("Twig", TREE_TYPE_INDEX)]                                                                                      \
+[NumThreads(TwigThreadGroupSize, 1, 1)]                                                                                \
+void NAME(                                                                                                             \
+    uint gtid : SV_GroupThreadId,                                                                                      \
+                                                                                                                       \
+    [MaxRecords(TwigThreadGroupSize)]                                                                                  \
+    GroupNodeInputRecords<GenerateTreeRecord> irs,                                                                     \
+                                                                                                                       \
+    [MaxRecords(maxTwigLeafRecords)]                                                                                   \
+    [NodeId("CoalesceDrawLeaves")]                                                                                     \
+    [NodeArraySize(3)]                                                                                                 \
+    NodeOutputArray<DrawLeafRecord> drawLeafOutput,                                                                    \
+                                                                                                                       \
+    [MaxRecords(maxTwigSegmentRecords)]                                                                                \
+    [NodeId("DrawSegment")]                                                                                            \
+    NodeOutput<DrawSegmentRecord> drawSegmentOutput,                                                                   \
+                                                                                                                       \
+    [MaxRecords(maxTwigSegmentRecords)]                                                                                \
+    [NodeId("DrawSegmentShadow")]                                                                                      \
+    NodeOutput<DrawSegmentRecord> drawSegmentShadowOutput,                                                             \
+                                                                                                                       \
+    [MaxRecordsSharedWith(drawSegmentOutput)]                                                                          \
+    [NodeId("CoalesceDrawSegments", 0)]                                                                                \
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentOutput,                                                           \
+                                                                                                                       \
+    [MaxRecordsSharedWith(drawSegmentShadowOutput)]                                                                    \
+    [NodeId("CoalesceDrawSegments", 1)]                                                                                \
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentShadowOutput                                                      \
+)                                                                                                                      \
+{                                                                                                                      \
+    GenerateTwig(                                                                                                      \
+        TREE_TYPE_INDEX,                                                                                               \
+        gtid,                                                                                                          \
+        irs.Count(),                                                                                                   \
+        irs.Get(min(gtid, irs.Count() - 1)),                                                                           \
+        drawLeafOutput,                                                                                                \
+        drawSegmentOutput,                                                                                             \
+        drawSegmentShadowOutput,                                                                                       \
+        coalesceDrawSegmentOutput,                                                                                     \
+        coalesceDrawSegmentShadowOutput);                                                                              \
+}
+
+TWIG_NODE(TwigApple, TREE_TYPE_APPLE)
+TWIG_NODE(TwigSassafras, TREE_TYPE_SASSAFRAS)
+TWIG_NODE(TwigPalm, TREE_TYPE_PALM)
+TWIG_NODE(TwigTamarack, TREE_TYPE_TAMARACK)
+
+// ============================ TreeTemplates Broadcasting Node ====================
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NumThreads(MaxTreeTemplateCount, 1, 1)]
+[NodeId("TreeTemplates")]
+void TreeTemplatesNode(
+    [MaxRecords(MaxTreeTemplateCount)]
+    [NodeId("Stem")]
+    [NodeArraySize(TREE_TYPE_COUNT)]
+    NodeOutputArray<GenerateTreeRecord> treeOutput,
+
+    uint gtid : SV_GroupThreadID
+)
+{
+    GenerateTreeTemplates(gtid, treeOutput);
+}
+
+// ============================ TreeInstance Broadcasting Node ====================
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeMaxDispatchGrid(TreeInstanceMaxGroups, 1, 1)]
+[NumThreads(TreeInstanceGroupSize, 1, 1)]
+[NodeId("TreeInstance")]
+void TreeInstanceNode(
+    DispatchNodeInputRecord<TreeInstanceRecord> input,
+
+    [MaxRecords(TreeInstanceGroupSize)]
+    [NodeId("CoalesceDrawLeaves")]
+    [NodeArraySize(3)]
+    NodeOutputArray<DrawLeafRecord> drawLeafOutput,
+
+    [MaxRecords(TreeInstanceGroupSize)]
+    [NodeId("DrawSegment")]
+    NodeOutput<DrawSegmentRecord> drawSegmentOutput,
+
+    [MaxRecords(TreeInstanceGroupSize)]
+    [NodeId("DrawSegmentShadow")]
+    NodeOutput<DrawSegmentRecord> drawSegmentShadowOutput,
+
+    [MaxRecordsSharedWith(drawSegmentOutput)]
+    [NodeId("CoalesceDrawSegments", 0)]
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentOutput,
+
+    [MaxRecordsSharedWith(drawSegmentShadowOutput)]
+    [NodeId("CoalesceDrawSegments", 1)]
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentShadowOutput,
+
+    uint gtid : SV_GroupThreadID,
+    uint dispatchThreadID : SV_DispatchThreadID
+)
+{
+    GenerateTreeInstance(
+        gtid,
+        dispatchThreadID,
+        input.Get(),
+        drawLeafOutput,
+        drawSegmentOutput,
+        drawSegmentShadowOutput,
+        coalesceDrawSegmentOutput,
+        coalesceDrawSegmentShadowOutput);
+}
+
+// ============================ ClearShadowMap Broadcasting Node ====================
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(ShadowMapClearGroups, 1, 1)]
+[NumThreads(ShadowMapClearGroupSize, 1, 1)]
+[NodeId("ClearShadowMap")]
+void ClearShadowMapNode(uint dispatchThreadID : SV_DispatchThreadID)
+{
+    // Four texels per thread; nothing reads or writes this bank in the current frame
+    PersistentScratchBuffer.Store<uint4>(GetShadowMapBankAddress(GetShadowMapClearBank()) + dispatchThreadID * sizeof(uint4), (uint4)0);
+}
+
+// ============================ BuildOcclusionPyramid Broadcasting Node ====================
+// See Occlusion.h
+
+groupshared float groupOcclusionDepth[OcclusionPyramidGroupSize * OcclusionPyramidGroupSize];
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(OcclusionPyramidGroupsX, OcclusionPyramidGroupsY, 1)]
+[NumThreads(OcclusionPyramidGroupSize, OcclusionPyramidGroupSize, 1)]
+[NodeId("BuildOcclusionPyramid")]
+void BuildOcclusionPyramidNode(
+    uint2 gid : SV_GroupID,
+    uint2 gtid : SV_GroupThreadID,
+    uint2 dispatchThreadID : SV_DispatchThreadID
 )
 {
-    const uint3 gridSize = input.Get().dispatchGrid;
-    const float spacing = 7.0f;  // Distance between trees
+    const uint writeBank = GetOcclusionPyramidWriteBank();
+
+    // The pyramid is tested with the camera view the depth was rendered with
+    if (all(dispatchThreadID == 0)) {
+        const uint headerAddress = GetOcclusionDepthBankAddress(GetOcclusionDepthReadBank());
+        PersistentScratchBuffer.Store<OcclusionViewHeader>(GetOcclusionPyramidBankAddress(writeBank),
+                                                           PersistentScratchBuffer.Load<OcclusionViewHeader>(headerAddress));
+    }
 
-    // Calculate tree position based on thread ID in grid layout on the floor (X-Z plane)
-    // Center the grid around origin
-    const float3 position = float3(
-        (dispatchThreadID.x - (gridSize.x - 1) * 0.5f) * spacing,  // X position
-        0,                                                           // Y = 0 (floor level)
-        (dispatchThreadID.y - (gridSize.y - 1) * 0.5f) * spacing   // Z position (use Y dimension for Z axis)
-    );
+    // Level 0: farthest of 2x2 depth texels per thread. Nothing reads or writes the clear bank in the current
+    // frame, so the same thread clears these texels for the next frame.
+    float farthestDepth = 0;
+    for (uint y = 0; y < 2; ++y) {
+        const uint2 texel = dispatchThreadID * 2 + uint2(0, y);
 
-    // Each thread generates one tree
-    // Use thread ID to vary the seed for different trees
-    const uint baseSeed = LoadPersistentConfigUint(PersistentConfig::SEED);
-    const uint treeSeed = baseSeed + dispatchThreadID.x + dispatchThreadID.y * gridSize.x;
+        farthestDepth = max(farthestDepth, max(LoadOcclusionDepth(texel), LoadOcclusionDepth(texel + uint2(1, 0))));
+        PersistentScratchBuffer.Store<uint2>(GetOcclusionDepthTexelAddress(GetOcclusionDepthClearBank(), texel), (uint2)0);
+    }
+
+    PersistentScratchBuffer.Store<float>(GetOcclusionPyramidTexelAddress(writeBank, 0, dispatchThreadID), farthestDepth);
+    groupOcclusionDepth[gtid.y * OcclusionPyramidGroupSize + gtid.x] = farthestDepth;
+
+    // Further levels within the group, down to one texel per group
+    for (uint level = 1; level < OcclusionPyramidLevels; ++level) {
+        const uint levelGroupSize = OcclusionPyramidGroupSize >> level;
+        const bool isLevelThread  = all(gtid < levelGroupSize);
+
+        GroupMemoryBarrierWithGroupSync();
+
+        if (isLevelThread) {
+            const uint child = (gtid.y * 2) * OcclusionPyramidGroupSize + gtid.x * 2;
+
+            farthestDepth = max(max(groupOcclusionDepth[child], groupOcclusionDepth[child + 1]),
+                                max(groupOcclusionDepth[child + OcclusionPyramidGroupSize], groupOcclusionDepth[child + OcclusionPyramidGroupSize + 1]));
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+
+        if (isLevelThread) {
+            groupOcclusionDepth[gtid.y * OcclusionPyramidGroupSize + gtid.x] = farthestDepth;
+            PersistentScratchBuffer.Store<float>(GetOcclusionPyramidTexelAddress(writeBank, level, gid * levelGroupSize + gtid), farthestDepth);
+        }
+    }
+}
+
+// ============================ BakeBarkTexture Broadcasting Node ====================
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(BarkTextureBakeGroups, TREE_TYPE_COUNT, 1)]
+[NumThreads(BarkTextureBakeGroupSize, 1, 1)]
+[NodeId("BakeBarkTexture")]
+void BakeBarkTextureNode(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    using namespace splineSegment;
+
+    // One texel per thread, one tile per row of the dispatch grid
+    const uint  treeType = dispatchThreadID.y;
+    const uint2 texel    = uint2(dispatchThreadID.x % BarkTextureWidth, dispatchThreadID.x / BarkTextureWidth);
 
-    ThreadNodeOutputRecords<GenerateTreeRecord> outputRecord = treeOutput.GetThreadNodeOutputRecords(1);
-    outputRecord.Get() = CreateTreeRecord(position, qRotateX(PI * -0.5), treeSeed);
-    outputRecord.OutputComplete();
+    StoreBarkTexel(treeType, texel, BakeBarkTexel(GetTreeParameters(treeType), texel));
 }
 
 // ============================ UI ====================
@@ -222,6 +545,29 @@ Cursor GetUserInterfaceCursor(uint l) {
     return Cursor(float2(10, 30 + l * 16), 2, float3(0, 0, 0));
 }
 
+// Statistics table in the bottom left corner: label column followed by value columns
+static const uint statisticsRows        = 17;
+static const uint statisticsLabelWidth  = 16;
+static const uint statisticsColumnWidth = 10;
+
+Cursor GetStatisticsCursor(uint row) {
+    return Cursor(float2(10, RenderSize.y - (statisticsRows - row + 1) * 16), 2, float3(0, 0, 0));
+}
+
+void PrintStatisticsChar(uint row, uint column, int c) {
+    Cursor cursor = GetStatisticsCursor(row);
+    cursor.Right(column);
+
+    printutil::PrintChar(cursor, c);
+}
+
+void PrintStatistic(uint row, uint column, uint value) {
+    Cursor cursor = GetStatisticsCursor(row);
+    cursor.Right(statisticsLabelWidth + column * statisticsColumnWidth);
+
+    PrintUint(cursor, value);
+}
+
 [Shader("node")]
 [NodeLaunch("thread")]
 [NodeId("UserInterface")]
@@ -380,3 +726,334 @@ void UserInterface_Slider_3(uint gtid : SV_GROUPTHREADID)
         Slider(cursor, PersistentConfig::SEED, 0, 200, true);
     }
 }
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(13, 1, 1)]
+void UserInterface_Slider_4(uint gtid : SV_GROUPTHREADID)
+{
+    Cursor cursor = GetUserInterfaceCursor(10);
+    cursor.Down(25);
+    cursor.Right(gtid);
+
+    printutil::PrintChar(cursor, printutil::CharToInt("Draw Distance"[gtid]));
+
+    if (gtid == 0) {
+        cursor.Newline();
+        Slider(cursor, PersistentConfig::DRAW_DISTANCE, 10, MaxDrawDistance);
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(9, 1, 1)]
+void UserInterface_Slider_5(uint gtid : SV_GROUPTHREADID)
+{
+    Cursor cursor = GetUserInterfaceCursor(11);
+    cursor.Down(29);
+    cursor.Right(gtid);
+
+    printutil::PrintChar(cursor, printutil::CharToInt("Templates"[gtid]));
+
+    if (gtid == 0) {
+        cursor.Newline();
+        Slider(cursor, PersistentConfig::TREE_TEMPLATE_COUNT, 0, MaxTreeTemplateCount, true);
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(15, 1, 1)]
+void UserInterface_Slider_6(uint gtid : SV_GROUPTHREADID)
+{
+    Cursor cursor = GetUserInterfaceCursor(12);
+    cursor.Down(33);
+    cursor.Right(gtid);
+
+    printutil::PrintChar(cursor, printutil::CharToInt("Triangle Budget"[gtid]));
+
+    if (gtid == 0) {
+        cursor.Newline();
+        Slider(cursor, PersistentConfig::TRIANGLE_BUDGET, 0, 50);
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(55, 1, 1)]
+void UserInterface_Statistics_Header(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(0, gtid, printutil::CharToInt("Previous Frame  Groups    Records   Vertices  Triangles"[gtid]));
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(4, 1, 1)]
+void UserInterface_Statistics_Stem(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(1, gtid, printutil::CharToInt("Stem"[gtid]));
+
+    if (gtid == 0) {
+        // Records emitted to all outputs
+        const uint records = LoadPreviousStatistic(StatisticsCounter::STEM_BRANCH_RECORDS) +
+                             LoadPreviousStatistic(StatisticsCounter::STEM_SEGMENT_RECORDS) +
+                             LoadPreviousStatistic(StatisticsCounter::STEM_SHADOW_SEGMENT_RECORDS) +
+                             LoadPreviousStatistic(StatisticsCounter::STEM_LEAF_RECORDS) +
+                             LoadPreviousStatistic(StatisticsCounter::STEM_CONTINUATION_RECORDS);
+
+        PrintStatistic(1, 0, LoadPreviousStatistic(StatisticsCounter::STEM_GROUPS));
+        PrintStatistic(1, 1, records);
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(6, 1, 1)]
+void UserInterface_Statistics_Leaves(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(2, gtid, printutil::CharToInt("Leaves"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(2, 0, LoadPreviousStatistic(StatisticsCounter::COALESCE_LEAF_GROUPS));
+        PrintStatistic(2, 1, LoadPreviousStatistic(StatisticsCounter::COALESCE_LEAF_RECORDS));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(8, 1, 1)]
+void UserInterface_Statistics_Blossoms(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(3, gtid, printutil::CharToInt("Blossoms"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(3, 0, LoadPreviousStatistic(StatisticsCounter::COALESCE_BLOSSOM_GROUPS));
+        PrintStatistic(3, 1, LoadPreviousStatistic(StatisticsCounter::COALESCE_BLOSSOM_RECORDS));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(6, 1, 1)]
+void UserInterface_Statistics_Fruits(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(4, gtid, printutil::CharToInt("Fruits"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(4, 0, LoadPreviousStatistic(StatisticsCounter::COALESCE_FRUIT_GROUPS));
+        PrintStatistic(4, 1, LoadPreviousStatistic(StatisticsCounter::COALESCE_FRUIT_RECORDS));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(11, 1, 1)]
+void UserInterface_Statistics_DrawSegment(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(5, gtid, printutil::CharToInt("DrawSegment"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(5, 0, LoadPreviousStatistic(StatisticsCounter::STEM_MESH_GROUPS));
+        PrintStatistic(5, 1, LoadPreviousStatistic(StatisticsCounter::STEM_SEGMENT_RECORDS));
+        PrintStatistic(5, 2, LoadPreviousStatistic(StatisticsCounter::STEM_MESH_VERTICES));
+        PrintStatistic(5, 3, LoadPreviousStatistic(StatisticsCounter::STEM_MESH_TRIANGLES));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(14, 1, 1)]
+void UserInterface_Statistics_DrawLeafBundle(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(6, gtid, printutil::CharToInt("DrawLeafBundle"[gtid]));
+
+    if (gtid == 0) {
+        // One bundle record per leaf and blossom coalescing group
+        const uint records = LoadPreviousStatistic(StatisticsCounter::COALESCE_LEAF_GROUPS) +
+                             LoadPreviousStatistic(StatisticsCounter::COALESCE_BLOSSOM_GROUPS);
+
+        PrintStatistic(6, 0, LoadPreviousStatistic(StatisticsCounter::LEAF_MESH_GROUPS));
+        PrintStatistic(6, 1, records);
+        PrintStatistic(6, 2, LoadPreviousStatistic(StatisticsCounter::LEAF_MESH_VERTICES));
+        PrintStatistic(6, 3, LoadPreviousStatistic(StatisticsCounter::LEAF_MESH_TRIANGLES));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(15, 1, 1)]
+void UserInterface_Statistics_DrawFruitBundle(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(7, gtid, printutil::CharToInt("DrawFruitBundle"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(7, 0, LoadPreviousStatistic(StatisticsCounter::FRUIT_MESH_GROUPS));
+        PrintStatistic(7, 1, LoadPreviousStatistic(StatisticsCounter::COALESCE_FRUIT_GROUPS));
+        PrintStatistic(7, 2, LoadPreviousStatistic(StatisticsCounter::FRUIT_MESH_VERTICES));
+        PrintStatistic(7, 3, LoadPreviousStatistic(StatisticsCounter::FRUIT_MESH_TRIANGLES));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(17, 1, 1)]
+void UserInterface_Statistics_DrawSegmentShadow(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(8, gtid, printutil::CharToInt("DrawSegmentShadow"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(8, 0, LoadPreviousStatistic(StatisticsCounter::STEM_SHADOW_MESH_GROUPS));
+        PrintStatistic(8, 1, LoadPreviousStatistic(StatisticsCounter::STEM_SHADOW_SEGMENT_RECORDS));
+        PrintStatistic(8, 2, LoadPreviousStatistic(StatisticsCounter::STEM_SHADOW_MESH_VERTICES));
+        PrintStatistic(8, 3, LoadPreviousStatistic(StatisticsCounter::STEM_SHADOW_MESH_TRIANGLES));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(14, 1, 1)]
+void UserInterface_Statistics_DrawLeafShadow(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(9, gtid, printutil::CharToInt("DrawLeafShadow"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(9, 0, LoadPreviousStatistic(StatisticsCounter::LEAF_SHADOW_MESH_GROUPS));
+        PrintStatistic(9, 2, LoadPreviousStatistic(StatisticsCounter::LEAF_SHADOW_MESH_VERTICES));
+        PrintStatistic(9, 3, LoadPreviousStatistic(StatisticsCounter::LEAF_SHADOW_MESH_TRIANGLES));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(8, 1, 1)]
+void UserInterface_Statistics_Segments(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(10, gtid, printutil::CharToInt("Segments"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(10, 0, LoadPreviousStatistic(StatisticsCounter::COALESCE_SEGMENT_GROUPS));
+        PrintStatistic(10, 1, LoadPreviousStatistic(StatisticsCounter::COALESCE_SEGMENT_RECORDS));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(5, 1, 1)]
+void UserInterface_Statistics_Trees(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(11, gtid, printutil::CharToInt("Trees"[gtid]));
+
+    if (gtid == 0) {
+        // One TreeRoots group per visible chunk
+        PrintStatistic(11, 0, LoadPreviousStatistic(StatisticsCounter::TREE_ROOTS_GROUPS));
+        PrintStatistic(11, 1, LoadPreviousStatistic(StatisticsCounter::TREE_ROOTS_RECORDS));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(9, 1, 1)]
+void UserInterface_Statistics_Instances(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(12, gtid, printutil::CharToInt("Instances"[gtid]));
+
+    if (gtid == 0) {
+        PrintStatistic(12, 0, LoadPreviousStatistic(StatisticsCounter::TREE_INSTANCE_GROUPS));
+        PrintStatistic(12, 1, LoadPreviousStatistic(StatisticsCounter::TREE_INSTANCE_RECORDS));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(8, 1, 1)]
+void UserInterface_Statistics_Occluded(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(13, gtid, printutil::CharToInt("Occluded"[gtid]));
+
+    if (gtid == 0) {
+        // Tree and branch records dropped by occlusion culling
+        PrintStatistic(13, 1, LoadPreviousStatistic(StatisticsCounter::TREE_ROOTS_OCCLUDED_RECORDS) +
+                              LoadPreviousStatistic(StatisticsCounter::STEM_OCCLUDED_RECORDS));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(5, 1, 1)]
+void UserInterface_Statistics_Twigs(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(14, gtid, printutil::CharToInt("Twigs"[gtid]));
+
+    if (gtid == 0) {
+        // Twig records packed into Twig thread groups
+        PrintStatistic(14, 0, LoadPreviousStatistic(StatisticsCounter::TWIG_GROUPS));
+        PrintStatistic(14, 1, LoadPreviousStatistic(StatisticsCounter::TWIG_RECORDS));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(7, 1, 1)]
+void UserInterface_Statistics_Dropped(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(15, gtid, printutil::CharToInt("Dropped"[gtid]));
+
+    if (gtid == 0) {
+        // Stem groups whose continuation exceeded the recursion depth, see STEM_DROPPED_CONTINUATION
+        PrintStatistic(15, 0, LoadPreviousStatistic(StatisticsCounter::STEM_DROPPED_CONTINUATION));
+    }
+}
+
+[Shader("node")]
+[NodeLaunch("broadcasting")]
+[NodeDispatchGrid(1, 1, 1)]
+[NodeShareInputOf("UserInterface")]
+[NumThreads(11, 1, 1)]
+void UserInterface_Statistics_ShadowOnly(uint gtid : SV_GROUPTHREADID)
+{
+    PrintStatisticsChar(16, gtid, printutil::CharToInt("Shadow only"[gtid]));
+
+    if (gtid == 0) {
+        // Tree and branch records occluded in the camera view, whose subtrees are only drawn into the shadow map
+        PrintStatistic(16, 1, LoadPreviousStatistic(StatisticsCounter::TREE_ROOTS_SHADOW_ONLY_RECORDS) +
+                              LoadPreviousStatistic(StatisticsCounter::STEM_SHADOW_ONLY_RECORDS));
+    }
+}
@@ -61,9 +61,10 @@ float4 qSlerpShortest(in const float4 a, in const float4 b, in const float t) {
     return qSlerp(a, b, t);
 }
 
+// Derivative of qSlerp with respect to t (central difference)
 float4 qSlerp_(in const float4 a, in const float4 b, in const float t) {
     static const float h = 0.001;
-    return (qSlerp_(a, b, t + h) - qSlerp_(a, b, t - h)) / (2*h);
+    return (qSlerp(a, b, t + h) - qSlerp(a, b, t - h)) / (2*h);
 }
 
 #define FACT(BITS) ((1 << (BITS-1)) - 1)
@@ -98,7 +99,7 @@ float4 qDecompress32(uint encoded) {
     q.y = y / float(FACT(Y));
     q.z = z / float(FACT(Z));
 
-    q.w = 1.0 - abs(q.x) - abs(q.y) - abs(q.z);
+    q.w = 1.f - abs(q.x) - abs(q.y) - abs(q.z);
     q.w = asfloat(asuint(q.w) | (encoded & MSB));
     return normalize(q);
 }
@@ -129,6 +130,6 @@ float4 qDecompress64(uint64_t encoded){
     q.y = y / float(0xfffff);
     q.z = z / float(0xfffff);
 
-    q.w = 1.0 - abs(q.x) - abs(q.y) - abs(q.z);
+    q.w = 1.f - abs(q.x) - abs(q.y) - abs(q.z);
     return normalize(q);
 }
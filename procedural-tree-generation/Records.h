@@ -2,11 +2,13 @@
 
 #include "Quaternion.h"
 #include "TreeParameters.h"
+#include "TreeRoots.h"
 
 // ========================= Constants ====================
 // List of constants for records (e.g. coalescing factors)
 
 #define LEVEL_BITS             2
+#define TREE_LOD_BITS          2
 #define SEGMENT_Z_BITS         15
 #define TREE_MAX_LOBE_COUNT    5
 
@@ -14,6 +16,15 @@ static const int maxNumTriangleRingsPerSegment = 128;
 static const int maxNumVerticesPerGroup  = 128;
 static const int maxNumTrianglesPerGroup = 128;
 
+// Tree LODs of distant chunks (GenerateTreeRecord::lod), see GetTreeLod
+static const uint TreeLodCount = 3;
+// Fraction of the branches generated per LOD, see GetTreeLodBranchCount
+static const float treeLodBranchFraction[TreeLodCount] = { 1.f, .75f, .5f };
+
+// Views of a DrawLeafRecord (DrawLeafRecord::viewMask)
+static const uint ViewMaskCamera = 1;
+static const uint ViewMaskShadow = 2;
+
 // ========================== Records =====================
 
 struct SkyboxRecord {
@@ -24,10 +35,6 @@ struct SimpleCubeRecord {
     uint test;
 };
 
-struct TreeRootsRecord {
-    uint3 dispatchGrid : SV_DispatchGrid;
-};
-
 struct TreeTransform {
     float3 pos;
     float4 rot;
@@ -86,6 +93,48 @@ struct TreeTransformCompressedq64 {
     void SetRot(float4 irot){ rot = qCompress64(irot); }
 };
 
+// Tree transforms with the position relative to the root of their tree, see TreeRoots.h. Callers load the root of
+// the tree once (see LoadTreeRoot) and pass it to every position access.
+struct TreeTransformLocalq32 {
+    uint2 pos;
+    uint  rot;
+
+    TreeTransform Decompress(TreeRoot root) {
+        TreeTransform result;
+
+        result.pos = GetPos(root);
+        result.rot = GetRot();
+
+        return result;
+    }
+
+    uint GetTreeIndex(){ return GetPackedTreeIndex(pos); }
+    float3 GetPos(TreeRoot root){ return UnpackTreeLocalPosition(pos, root); }
+    void SetPos(float3 ipos, uint treeIndex, TreeRoot root){ pos = PackTreeLocalPosition(ipos, treeIndex, root); }
+    float4 GetRot(){ return qDecompress32(rot); }
+    void SetRot(float4 irot){ rot = qCompress32(irot); }
+};
+
+struct TreeTransformLocalq64 {
+    uint2 pos;
+    uint64_t rot;
+
+    TreeTransform Decompress(TreeRoot root) {
+        TreeTransform result;
+
+        result.pos = GetPos(root);
+        result.rot = GetRot();
+
+        return result;
+    }
+
+    uint GetTreeIndex(){ return GetPackedTreeIndex(pos); }
+    float3 GetPos(TreeRoot root){ return UnpackTreeLocalPosition(pos, root); }
+    void SetPos(float3 ipos, uint treeIndex, TreeRoot root){ pos = PackTreeLocalPosition(ipos, treeIndex, root); }
+    float4 GetRot(){ return qDecompress64(rot); }
+    void SetRot(float4 irot){ rot = qCompress64(irot); }
+};
+
 struct StemTubeCage {
     TreeTransform from;
     TreeTransform to;
@@ -149,28 +198,41 @@ typedef uint3 PackedSegmentInfo;
 struct DrawSegmentRecord {
     StemTubeCageCompressed cage;
     SegmentInfo  si;
-    float aoDistance;
-    float fromPoints;
-    float toPoints;
-    float vPoints;
-    int faceRingsPerGroup;
-    float fromOpeningAngle;
-    float toOpeningAngle;
+    // SegmentTessellationData and ao distance in 16 bits each, see GetSegmentTessellationData
+    uint fromPoints        : 16;
+    uint toPoints          : 16;
+    uint vPoints           : 16;
+    uint faceRingsPerGroup : 16;
+    uint fromOpeningAngle  : 16;
+    uint toOpeningAngle    : 16;
+    uint aoDistance        : 16;
     uint dispatchGrid : SV_DispatchGrid;
 };
 
 struct DrawLeafRecord {
-    TreeTransformCompressedq32 trafo;
+    TreeTransformLocalq32 trafo;
     
-    uint  seed;
+    uint  seed     : 30;
+    uint  viewMask : 2;
     float scale;
     float aoDistance;
 };
 
 struct GenerateTreeRecord {
-    TreeTransformCompressedq64 trafo;
+    TreeTransformLocalq64 trafo;
     uint seed;
-    uint children;
+    uint children         : 16;
+    // Continuation: first child index and first segment index handled by this record, see Stem
+    uint firstChild       : 16;
+    uint level            : LEVEL_BITS;
+    // Tree LOD of the chunk, inherited by all stems of the tree
+    uint lod              : TREE_LOD_BITS;
+    // Stems of template trees store their segments and leaves instead of drawing them, see TreeTemplates.h
+    uint isTemplate       : 1;
+    // Occluded in the camera view, but inside the light frustum: the stem and its subtree are only drawn into
+    // the shadow map, see Stem
+    uint isCameraOccluded : 1;
+    uint firstSegment     : 32 - LEVEL_BITS - TREE_LOD_BITS - 2;
     float scale;
     float length;
     float radius;
@@ -179,41 +241,75 @@ struct GenerateTreeRecord {
 
 // =========================== Utils ======================
 
-GenerateTreeRecord CreateTreeRecord(in const float3 position, in const float4 rotation, in const uint seed)
+// root is the root of tree treeIndex, see LoadTreeRoot
+TreeTransformLocalq32 CreateTreeLocalTransformq32(in const uint treeIndex, in const TreeRoot root, in const float3 position, in const float4 rotation)
+{
+    TreeTransformLocalq32 trafo;
+    trafo.pos = PackTreeLocalPosition(position, treeIndex, root);
+    trafo.SetRot(rotation);
+    return trafo;
+}
+
+TreeTransformLocalq64 CreateTreeLocalTransformq64(in const uint treeIndex, in const TreeRoot root, in const float3 position, in const float4 rotation)
+{
+    TreeTransformLocalq64 trafo;
+    trafo.pos = PackTreeLocalPosition(position, treeIndex, root);
+    trafo.SetRot(rotation);
+    return trafo;
+}
+
+// Number of child stems of a branch with the given number of children at full detail
+uint GetTreeLodBranchCount(in const uint children, in const uint lod)
+{
+    return uint(round(children * treeLodBranchFraction[min(lod, TreeLodCount - 1)]));
+}
+
+// Record of the trunk of tree treeIndex; its position is the root of the tree, see StoreTreeRoot
+GenerateTreeRecord CreateTreeRecord(in const uint treeIndex, in const float4 rotation, in const uint seed, in const uint lod)
 {
     const TreeParameters params = GetTreeParameters();
 
     GenerateTreeRecord record;
 
-    record.trafo.SetPos(position);
+    record.trafo.pos = uint2(0, treeIndex << 16);
     record.trafo.SetRot(rotation);
 
     record.seed = seed;
     record.aoDistance = 0;
 
+    record.level            = 0;
+    record.lod              = lod;
+    record.isTemplate       = 0;
+    record.isCameraOccluded = 0;
+    record.firstChild       = 0;
+    record.firstSegment     = 0;
+
     record.scale = params.Scale + .5 * params.ScaleV * random::SignedRandom(record.seed, 2413);
     record.length = record.scale * (params.nLength[0] + params.nLengthV[0] * random::SignedRandom(record.seed, 123));
     record.radius = record.length * params.Ratio;
-    record.children = (params.Levels == 1) ? (params.Leaf.Count + params.Blossom.Count) : params.nBranches[1];
+    record.children = (params.Levels == 1) ? (params.Leaf.Count + params.Blossom.Count) : GetTreeLodBranchCount(params.nBranches[1], lod);
 
     return record;
 }
 
 PackedSegmentInfo PackSegmentInfo(in const SegmentInfo si)
 {
-    // This packs the bit-field, not sure about the floats, so they are handled manually
-    PackedSegmentInfo sip = (uint3)si;
-    sip.y                 = asuint(si.length);
-    sip.z                 = asuint(si.radius);
+    // Bit-field is packed explicitly (same layout as the implicit (uint3) cast), so this also compiles as C++
+    PackedSegmentInfo sip;
+    sip.x = si.level | (si.fromZ << LEVEL_BITS) | (si.toZ << (LEVEL_BITS + SEGMENT_Z_BITS));
+    sip.y = asuint(si.length);
+    sip.z = asuint(si.radius);
     return sip;
 }
 
 SegmentInfo UnpackSegmentInfo(in const PackedSegmentInfo sip)
 {
-    // this initializes the bit-field, so we only need to handle the two floats
-    SegmentInfo si = (SegmentInfo)sip.x;
-    si.length      = asfloat(sip.y);
-    si.radius      = asfloat(sip.z);
+    SegmentInfo si;
+    si.level  = sip.x & ((1u << LEVEL_BITS) - 1);
+    si.fromZ  = (sip.x >> LEVEL_BITS) & ((1u << SEGMENT_Z_BITS) - 1);
+    si.toZ    = (sip.x >> (LEVEL_BITS + SEGMENT_Z_BITS)) & ((1u << SEGMENT_Z_BITS) - 1);
+    si.length = asfloat(sip.y);
+    si.radius = asfloat(sip.z);
     return si;
 }
 
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "Occlusion.h"
+#include "Shadow.h"
+
 float3 Normal(float3 pos)
 {
     return normalize(cross(ddy_fine(pos), ddx_fine(pos)));
@@ -14,16 +17,76 @@ struct SurfaceData {
     float translucency;
 };
 
-static const float3 LightDirection = normalize(float3(1, 1, 1));
-static const float3 LightColor     = float3(2, 1.8, 1.8);
+// ============================ Shadow Map Access ====================
+// See Shadow.h
+
+// Texel of the light-space position xy in [-1, 1]; same mapping as the rasterizer: y points down in pixel coordinates
+uint2 GetShadowMapTexel(in const float2 lightPosition) {
+    const float2 uv = float2(lightPosition.x, -lightPosition.y) * .5 + .5;
+    return uint2(uv * ShadowMapResolution);
+}
+
+// Called by the shadow pixel shaders: lightPosition is the interpolated light-space position of the fragment,
+// depth the light-space depth in [0, 1].
+void StoreShadowDepth(in const float2 lightPosition, in const float depth) {
+    // Fragments outside the square shadow viewport, see GetShadowVertex
+    if (any(abs(lightPosition) > 1)) {
+        return;
+    }
+
+    // Non-negative floats order like their bit patterns
+    PersistentScratchBuffer.InterlockedMax(GetShadowMapTexelAddress(GetShadowMapWriteBank(), GetShadowMapTexel(lightPosition)),
+                                           asuint(1 - saturate(depth)));
+}
+
+// Returns 1 if worldSpacePosition is lit by LightDirection in the shadow map of the last frame, 0 if it is in shadow
+float GetLightVisibility(in const float3 worldSpacePosition) {
+    const float3 lightClip = mul(GetLightViewProjectionMatrix(), float4(worldSpacePosition, 1)).xyz;
+
+    if (any(abs(lightClip.xy) > 1)) {
+        return 1;
+    }
 
-float4 ShadeSurface(in const SurfaceData surface)
+    const float occluderDepth =
+        1 - asfloat(PersistentScratchBuffer.Load<uint>(GetShadowMapTexelAddress(GetShadowMapReadBank(), GetShadowMapTexel(lightClip.xy))));
+
+    return (lightClip.z - ShadowDepthBias) <= occluderDepth ? 1 : 0;
+}
+
+// Vertex of the depth-only shadow mesh shaders
+struct ShadowVertex {
+    float4 clipSpacePosition : SV_POSITION;
+    float2 lightPosition     : TEXCOORD0;
+    float  depth             : TEXCOORD1;
+};
+
+ShadowVertex GetShadowVertex(in const float3 worldSpacePosition) {
+    // Orthographic, i.e. w = 1
+    const float4 lightClip = mul(GetLightViewProjectionMatrix(), float4(worldSpacePosition, 1));
+
+    // Rasterize into a square in the center of the render target, such that the rasterizer samples both axes of
+    // the shadow map at the same rate
+    const float2 viewportScale = min(RenderSize.x, RenderSize.y) / float2(RenderSize);
+
+    ShadowVertex vertex;
+    // Rasterize on the near plane, so the camera depth buffer never rejects shadow fragments
+    vertex.clipSpacePosition = float4(lightClip.xy * viewportScale, 0, lightClip.w);
+    vertex.lightPosition     = lightClip.xy / lightClip.w;
+    vertex.depth             = lightClip.z / lightClip.w;
+
+    return vertex;
+}
+
+// lightVisibility: 0 in shadow, 1 lit, see GetLightVisibility
+float4 ShadeSurface(in const SurfaceData surface, in const float lightVisibility = 1)
 {
     float3 light = saturate(dot(LightDirection, surface.normal)) * LightColor;
 
     // handle translucency
     light += saturate(dot(LightDirection, -surface.normal)) * LightColor * surface.translucency;
 
+    light *= lightVisibility;
+
     float3 color = 0;
 
     // ambient
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Camera.h"
+#include "Config.h"
+#include "Statistics.h"
+
+// ============================ Light ====================
+
+static const float3 LightDirection = normalize(float3(1, 1, 1));
+static const float3 LightColor     = float3(2, 1.8, 1.8);
+
+// ============================ Shadow Map ====================
+// Depth-only shadow map of LightDirection, rendered from the records of the single Stem run per frame:
+// Stem sends segments and leaves inside the light frustum to DrawSegmentShadow and DrawLeafBundleShadow,
+// the entry node draws SimpleCubeShadow.
+// The shadow mesh nodes rasterize in light space into a square in the center of the regular render target; their pixel shaders
+// write the depth with InterlockedMax into PersistentScratchBuffer and discard the fragment.
+// Texels store 1 - depth, so a zeroed (cleared) texel is at the far plane.
+//
+// The shadow map is triple-buffered by frame index: nodes write the map of the current frame and
+// shade with the map of the previous frame, while ClearShadowMap resets the map of the next frame.
+
+static const uint  ShadowMapResolution   = 1024;
+static const uint  ShadowMapBankCount    = 3;
+// Bounds of the half extent of the light frustum around the camera focus, see ComputeShadowExtent. At
+// MaxShadowExtent, a texel covers 0.25 m; trees further from the focus neither cast nor receive shadows.
+static const float MinShadowExtent       = 32.f;
+static const float MaxShadowExtent       = 128.f;
+// Depth range of the light frustum per unit of its half extent
+static const float ShadowDepthRangeScale = 4.f;
+// In normalized depth, i.e. proportional to the texel size
+static const float ShadowDepthBias       = 0.001f;
+// Shadow segments do not need screen-space detail, see ComputeVisibilityAndTessellationData
+static const float ShadowPixelsPerTriangle = 8.f;
+
+float GetShadowPixelsPerTriangle() {
+    return ShadowPixelsPerTriangle * GetTriangleBudgetPixelsPerTriangleScale();
+}
+
+static const uint ShadowMapClearGroupSize = 256;
+static const uint ShadowMapClearGroups    = (ShadowMapResolution * ShadowMapResolution) / (ShadowMapClearGroupSize * 4);
+
+// First shadow map; placed after the view constants and aligned for Store4
+static const uint ShadowMapOffset   = (ViewConstantsEnd + 15) & ~15u;
+static const uint ShadowMapBankSize = ShadowMapResolution * ShadowMapResolution * sizeof(uint);
+
+// Half extent of the light frustum: trees are drawn up to PersistentConfig::DRAW_DISTANCE from the camera, which
+// orbits the focus, so the frustum covers the draw distance plus the horizontal camera distance and a tree height,
+// up to MaxShadowExtent. The extent grows in powers of two: shading reads the shadow map of the last frame with the
+// light matrix of this frame, which only disagree in the frames in which the extent changes, not while zooming.
+float ComputeShadowExtent()
+{
+    const TreeParameters   params = GetTreeParameters();
+    const CameraParameters camera = ComputeCameraParameters();
+
+    const float reach = LoadPersistentConfigFloat(PersistentConfig::DRAW_DISTANCE) +
+                        distance(camera.position.xz, camera.focus.xz) + params.Scale * params.nLength[0];
+
+    return clamp(exp2(ceil(log2(max(reach, 1.f)))), MinShadowExtent, MaxShadowExtent);
+}
+
+// Orthographic view-projection matrix of the light, centered on the camera focus
+float4x4 ComputeLightViewProjectionMatrix()
+{
+    const float3 forward = LightDirection;
+    const float3 right   = normalize(cross(float3(0, 1, 0), forward));
+    const float3 up      = normalize(cross(forward, right));
+
+    const float shadowExtent     = ComputeShadowExtent();
+    const float shadowDepthRange = ShadowDepthRangeScale * shadowExtent;
+
+    const float3 position = ComputeCameraParameters().focus + forward * (shadowDepthRange / 2.f);
+
+    const float3 translation = float3(
+        dot(position, right),
+        dot(position, up),
+        dot(position, forward)
+    );
+
+    const float4x4 viewMatrix = float4x4(
+        right.x, right.y, right.z, -translation.x,
+        up.x, up.y, up.z, -translation.y,
+        forward.x, forward.y, forward.z, -translation.z,
+        0, 0, 0, 1
+    );
+
+    const float4x4 projectionMatrix = float4x4(
+        1.f / shadowExtent, 0, 0, 0,
+        0, 1.f / shadowExtent, 0, 0,
+        0, 0, -1.f / shadowDepthRange, 0,
+        0, 0, 0, 1
+    );
+
+    return mul(projectionMatrix, viewMatrix);
+}
+
+ViewParameters ComputeShadowView() {
+    ViewParameters view;
+    view.viewProjectionMatrix = ComputeLightViewProjectionMatrix();
+    view.frustum              = GetFrustum(view.viewProjectionMatrix);
+    view.position             = 0;
+    view.direction            = LightDirection;
+    view.isOrthographic       = true;
+    view.viewportSize         = float2(ShadowMapResolution, ShadowMapResolution);
+
+    return view;
+}
+
+// See View Constants in Camera.h
+void StoreShadowView() {
+    PersistentScratchBuffer.Store<ViewParameters>(ShadowViewOffset, ComputeShadowView());
+}
+
+ViewParameters GetShadowView() {
+    return PersistentScratchBuffer.Load<ViewParameters>(ShadowViewOffset);
+}
+
+float4x4 GetLightViewProjectionMatrix() {
+    return GetShadowView().viewProjectionMatrix;
+}
+
+uint GetShadowMapBankAddress(in uint bank) {
+    return ShadowMapOffset + (bank % ShadowMapBankCount) * ShadowMapBankSize;
+}
+
+uint GetShadowMapTexelAddress(in uint bank, in uint2 texel) {
+    texel = min(texel, ShadowMapResolution - 1);
+    return GetShadowMapBankAddress(bank) + (texel.y * ShadowMapResolution + texel.x) * sizeof(uint);
+}
+
+// Shadow map written in this frame
+uint GetShadowMapWriteBank() {
+    return LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX);
+}
+
+// Shadow map completed in the last frame
+uint GetShadowMapReadBank() {
+    return LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX) + (ShadowMapBankCount - 1);
+}
+
+// Shadow map cleared in this frame, written in the next frame
+uint GetShadowMapClearBank() {
+    return LoadPersistentConfigUint(PersistentConfig::FRAME_INDEX) + 1;
+}
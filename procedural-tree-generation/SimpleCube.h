@@ -80,6 +80,40 @@ void SimpleCubeMeshShader(
     }
 }
 
+// Depth-only variant of SimpleCubeMeshShader for the shadow map
+[Shader("node")]
+[NodeLaunch("mesh")]
+[NodeId("SimpleCubeShadow", 0)]
+[NodeDispatchGrid(1, 1, 1)]
+[NumThreads(12, 1, 1)]
+[OutputTopology("triangle")]
+void SimpleCubeShadowMeshShader(
+    DispatchNodeInputRecord<SimpleCubeRecord> input,
+
+    uint groupThreadId : SV_GroupThreadID,
+
+    out indices uint3 outputIndices[12],
+    out vertices ShadowVertex outputVertices[8])
+{
+    SetMeshOutputCounts(8, 12);
+
+    if (groupThreadId < 8) {
+        outputVertices[groupThreadId] = GetShadowVertex(CubeVertices[groupThreadId]);
+    }
+
+    if (groupThreadId < 12) {
+        outputIndices[groupThreadId] = SimpleCubeIndices[groupThreadId];
+    }
+}
+
+float4 SimpleCubeShadowPixelShader(const in ShadowVertex vertex) : SV_Target0
+{
+    StoreShadowDepth(vertex.lightPosition, vertex.depth);
+    discard;
+
+    return 0;
+}
+
 // Simple hash function for procedural noise
 float hash(float2 p)
 {
@@ -103,6 +137,7 @@ float noise(float2 p)
 }
 
 float4 SimpleCubePixelShader(
+    float4 pixelPosition : SV_POSITION,
     float3 position : POSITION0,
     bool isFrontFace : SV_IsFrontFace) : SV_TARGET
 {
@@ -170,6 +205,9 @@ float4 SimpleCubePixelShader(
     surface.occlusion    = 0.5;
     surface.translucency = 0.0;
 
+    // The cube occludes the trees behind it
+    StoreOcclusionDepth(pixelPosition);
+
     // Apply lighting
-    return ShadeSurface(surface);
+    return ShadeSurface(surface, GetLightVisibility(position));
 }
@@ -99,7 +99,7 @@ float4 SkyboxPixelShader(
         surface.occlusion    = 1;
         surface.translucency = 0;
 
-        return ShadeSurface(surface);
+        return ShadeSurface(surface, GetLightVisibility(position));
     }
 
     // Compute view direction
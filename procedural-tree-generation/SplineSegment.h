@@ -5,6 +5,27 @@
 #include "Config.h"
 #include "TreeModel.h"
 #include "Shading.h"
+#include "Statistics.h"
+#include "Shadow.h"
+#include "TreeTemplates.h"
+
+// ============================ Bark Texture ====================
+// Bark noise does not change between frames, so BakeBarkTexture evaluates it once into PersistentScratchBuffer,
+// one tile per tree type, and the stem mesh and pixel shaders fetch it with bilinear filtering (SampleBarkTexture).
+// A tile spans BarkTileSize in bark uv (see ComputeStemRingVertex); all noise lattices wrap at the tile border.
+// EntryFunction bakes the tiles when it initializes the persistent config, so only the first frame samples
+// a partially baked texture.
+
+static const uint   BarkTextureWidth  = 128;
+static const uint   BarkTextureHeight = 512;
+static const float2 BarkTileSize      = float2(1, 4);
+
+static const uint BarkTextureBakeGroupSize = 256;
+static const uint BarkTextureBakeGroups    = (BarkTextureWidth * BarkTextureHeight) / BarkTextureBakeGroupSize;
+
+// First tile; placed after the tree template banks
+static const uint BarkTextureOffset   = TreeTemplateEnd;
+static const uint BarkTextureTileSize = BarkTextureWidth * BarkTextureHeight * sizeof(uint2);
 
 namespace splineSegment {
 
@@ -27,21 +48,21 @@ namespace splineSegment {
         return radius;
     }
 
-    int2 Wrap(int2 v, int xWrap){
-        v.x = (v.x + 256 * xWrap) % xWrap;
-        return v;
+    // Noise functions below repeat after wrap lattice cells in x and y, see BakeBarkTexel
+    int2 Wrap(int2 v, int2 wrap){
+        return (v + 256 * wrap) % wrap;
     }
 
-    float WrappingXPerlinNoise(in float2 position, int xWrap) {
+    float WrappingPerlinNoise(in float2 position, int2 wrap) {
         const int2   grid = floor(position);
         const float2 uv  = frac(position);
-        const int a = (grid.x + 0) % xWrap;
-        const int b = (grid.x + 1) % xWrap;
+        const int2 a = Wrap(grid + int2(0, 0), wrap);
+        const int2 b = Wrap(grid + int2(1, 1), wrap);
 
-        const float d00 = dot(random::PerlinNoiseDir2D(int2(a, grid.y + 0)), uv - float2(0, 0));
-        const float d01 = dot(random::PerlinNoiseDir2D(int2(a, grid.y + 1)), uv - float2(0, 1));
-        const float d10 = dot(random::PerlinNoiseDir2D(int2(b, grid.y + 0)), uv - float2(1, 0));
-        const float d11 = dot(random::PerlinNoiseDir2D(int2(b, grid.y + 1)), uv - float2(1, 1));
+        const float d00 = dot(random::PerlinNoiseDir2D(int2(a.x, a.y)), uv - float2(0, 0));
+        const float d01 = dot(random::PerlinNoiseDir2D(int2(a.x, b.y)), uv - float2(0, 1));
+        const float d10 = dot(random::PerlinNoiseDir2D(int2(b.x, a.y)), uv - float2(1, 0));
+        const float d11 = dot(random::PerlinNoiseDir2D(int2(b.x, b.y)), uv - float2(1, 1));
 
         const float2 interpolationWeights = uv * uv * uv * (uv * (uv * 6 - 15) + 10);
         const float d0 = lerp(d00, d01, interpolationWeights.y);
@@ -49,14 +70,14 @@ namespace splineSegment {
         return lerp(d0, d1, interpolationWeights.x);
     }
 
-    float CloudNoiseWrapX(float2 pos, int xWrap, int levels=8){
+    float CloudNoiseWrap(float2 pos, int2 wrap, int levels=8){
         int n = clamp(floor(levels), 1, 8);
         float noise = 0;
         for(int i = 0; i < n; ++i){
             float s = pow(2, i);
-            noise += WrappingXPerlinNoise(pos * s, xWrap) / s;
+            noise += WrappingPerlinNoise(pos * s, wrap) / s;
             pos += 20;
-            xWrap *= 2;
+            wrap *= 2;
         }
         return noise;
     }
@@ -64,7 +85,7 @@ namespace splineSegment {
     float hash1( float n ) { return frac(sin(n)*43758.5453); }
     float2 hash2( float2 p ) { return frac(sin(float2(dot(p,float2(127.1,311.7)),dot(p,float2(269.5,183.3))))*43758.5453);}
 
-    float Voronoi( in float2 x )
+    float VoronoiWrap( in float2 x, int2 wrap )
     {
         int2 p = floor( x );
         float2  f = frac( x );
@@ -74,7 +95,7 @@ namespace splineSegment {
         for( int i=-1; i<=1; i++ )
         {
             int2 b = int2( i, j );
-            float2  r = float2( b ) - f + hash2( p + b );
+            float2  r = float2( b ) - f + hash2( Wrap(p + b, wrap) );
             float d = dot( r, r );
 
             res = min( res, d );
@@ -83,10 +104,10 @@ namespace splineSegment {
     }
 
 
-    float VoronoiDistanceWrapX(in float2 x, int xWrap)
+    float VoronoiDistanceWrap(in float2 x, int2 wrap)
     {
         int2 p = int2(floor(x));
-        p = Wrap(p, xWrap);
+        p = Wrap(p, wrap);
 
         float2 f = frac(x);
 
@@ -98,7 +119,7 @@ namespace splineSegment {
         for( int i=-1; i<=1; i++ )
         {
             int2 b = int2(i, j);
-            int2 h = Wrap(p + b, xWrap);
+            int2 h = Wrap(p + b, wrap);
             float2 r = float2(b) + hash2(h) - f;
             float d = dot(r,r);
 
@@ -115,7 +136,7 @@ namespace splineSegment {
         for( int i=-2; i<=2; i++ )
         {
             int2 b = mb + int2(i, j);
-            int2 h = Wrap(p + b, xWrap);
+            int2 h = Wrap(p + b, wrap);
             float2  r = float2(b) + hash2(h) - f;
             float d = dot(0.5*(mr+r), normalize(r-mr));
 
@@ -142,6 +163,114 @@ namespace splineSegment {
         return nearValue * t;
     }
 
+    // Octaves of the cloud noise of the vertex displacement, and the octaves that the texel grid resolves
+    static const int   barkVertexCloudLevels = 2;
+    static const int   barkCloudLevels       = 4;
+    // Cloud noises are stored in [-barkCloudRange, barkCloudRange], lichen voronoi in [0, barkLichenRange]
+    static const float barkCloudRange        = 1.5;
+    static const float barkLichenRange       = 1.5;
+
+    struct BarkSample {
+        float cloudVertex;
+        float cloud;
+        // Distance to the border of the bark voronoi cell
+        float voronoi;
+        float birch;
+        float lichen;
+    };
+
+    // Bark noise at the center of a texel of the tile of params
+    BarkSample BakeBarkTexel(in const TreeParameters params, in const uint2 texel)
+    {
+        const float2 uv = ((texel + .5) / float2(BarkTextureWidth, BarkTextureHeight)) * BarkTileSize;
+
+        BarkSample bark;
+
+        const float2 cloudPos  = uv * float2(8, 2);
+        const int2   cloudWrap = int2(BarkTileSize * float2(8, 2));
+        bark.cloudVertex = CloudNoiseWrap(cloudPos, cloudWrap, barkVertexCloudLevels);
+        bark.cloud       = CloudNoiseWrap(cloudPos, cloudWrap, barkCloudLevels);
+
+        const float o = WrappingPerlinNoise(uv * 2, int2(BarkTileSize * 2));
+        bark.voronoi = VoronoiDistanceWrap((uv + 0.03 * o) * float2(8, 1), int2(BarkTileSize * float2(8, 1)));
+
+        bark.birch = CloudNoiseWrap(uv * float2(4, 1.25), int2(BarkTileSize * float2(4, 1.25)), barkCloudLevels);
+
+        // lichen cells must tile as well
+        const int lichenFrequency = max(1, int(round(params.StemLichenFrequency)));
+        bark.lichen = VoronoiWrap(uv * lichenFrequency, int2(BarkTileSize * lichenFrequency));
+
+        return bark;
+    }
+
+    uint GetBarkTexelAddress(in uint treeType, in int2 texel)
+    {
+        texel = Wrap(texel, int2(BarkTextureWidth, BarkTextureHeight));
+        return BarkTextureOffset + treeType * BarkTextureTileSize + (texel.y * BarkTextureWidth + texel.x) * sizeof(uint2);
+    }
+
+    uint PackBarkUnorm(in float x, in uint byte)
+    {
+        return uint(saturate(x) * 255 + .5) << (8 * byte);
+    }
+
+    float UnpackBarkUnorm(in uint packed, in uint byte)
+    {
+        return ((packed >> (8 * byte)) & 0xFF) / 255.;
+    }
+
+    void StoreBarkTexel(in uint treeType, in uint2 texel, in const BarkSample bark)
+    {
+        uint2 packed;
+        packed.x = PackBarkUnorm(SnormToUnorm(bark.cloudVertex / barkCloudRange), 0) |
+                   PackBarkUnorm(SnormToUnorm(bark.cloud / barkCloudRange), 1) |
+                   PackBarkUnorm(bark.voronoi, 2) |
+                   PackBarkUnorm(SnormToUnorm(bark.birch / barkCloudRange), 3);
+        packed.y = PackBarkUnorm(bark.lichen / barkLichenRange, 0);
+
+        PersistentScratchBuffer.Store<uint2>(GetBarkTexelAddress(treeType, texel), packed);
+    }
+
+    BarkSample LoadBarkTexel(in uint treeType, in int2 texel)
+    {
+        const uint2 packed = PersistentScratchBuffer.Load<uint2>(GetBarkTexelAddress(treeType, texel));
+
+        BarkSample bark;
+        bark.cloudVertex = UnormToSnorm(UnpackBarkUnorm(packed.x, 0)) * barkCloudRange;
+        bark.cloud       = UnormToSnorm(UnpackBarkUnorm(packed.x, 1)) * barkCloudRange;
+        bark.voronoi     = UnpackBarkUnorm(packed.x, 2);
+        bark.birch       = UnormToSnorm(UnpackBarkUnorm(packed.x, 3)) * barkCloudRange;
+        bark.lichen      = UnpackBarkUnorm(packed.y, 0) * barkLichenRange;
+
+        return bark;
+    }
+
+    BarkSample LerpBarkSample(in const BarkSample a, in const BarkSample b, in const float t)
+    {
+        BarkSample bark;
+        bark.cloudVertex = lerp(a.cloudVertex, b.cloudVertex, t);
+        bark.cloud       = lerp(a.cloud, b.cloud, t);
+        bark.voronoi     = lerp(a.voronoi, b.voronoi, t);
+        bark.birch       = lerp(a.birch, b.birch, t);
+        bark.lichen      = lerp(a.lichen, b.lichen, t);
+        return bark;
+    }
+
+    // Bilinear fetch of the bark tile of the current tree type at bark uv position uv
+    BarkSample SampleBarkTexture(in const float2 uv)
+    {
+        const uint treeType = LoadPersistentConfigUint(PersistentConfig::TREE_TYPE);
+
+        const float2 texelPos = (uv / BarkTileSize) * float2(BarkTextureWidth, BarkTextureHeight) - .5;
+        const int2   texel    = floor(texelPos);
+        const float2 w        = frac(texelPos);
+
+        const BarkSample b0 = LerpBarkSample(LoadBarkTexel(treeType, texel + int2(0, 0)), LoadBarkTexel(treeType, texel + int2(1, 0)), w.x);
+        const BarkSample b1 = LerpBarkSample(LoadBarkTexel(treeType, texel + int2(0, 1)), LoadBarkTexel(treeType, texel + int2(1, 1)), w.x);
+
+        return LerpBarkSample(b0, b1, w.y);
+    }
+
     float SmoothTessellation(int p, float xf, int x){
         float step = (xf - x + 2) * .5 / (x - 1);
         float t = lerp(step, 1. - step, float(p-1) / (x - 3));
@@ -149,122 +278,195 @@ namespace splineSegment {
         return t;
     }
 
+    // Only attributes that vary over a segment are per vertex, see StemPrimitive
     struct StemVertex {
         float4 clipSpacePosition : SV_POSITION;
         float4 openingAngle_u_v_z : NORMAL1;
         float  ao : BLENDWEIGHTS0;
-
-        nointerpolation float4 fromTrafo : POSITION3;
-        nointerpolation float4 toTrafo   : POSITION6;
     };
 
+    // Segment attributes; the same for all triangles of a segment
     struct StemPrimitive {
-        uint3 sip : BLENDINDICES0;
+        uint3  sip       : BLENDINDICES0;
+        float4 fromTrafo : POSITION3;
+        float4 toTrafo   : POSITION6;
     };
 
-}
+    StemPrimitive GetStemPrimitive(in const DrawSegmentRecord segmentRecord)
+    {
+        StemPrimitive primitive;
+        primitive.sip       = PackSegmentInfo(segmentRecord.si);
+        primitive.fromTrafo = segmentRecord.cage.from.trafo;
+        primitive.toTrafo   = segmentRecord.cage.to.trafo;
+        return primitive;
+    }
 
-[Shader("node")]
-[NodeLaunch("mesh")]
-[NodeId("DrawSegment", 0)]
-[NodeMaxDispatchGrid(maxNumTriangleRingsPerSegment, 1, 1)]
-[NumThreads(128, 1, 1)]
-[OutputTopology("triangle")]
-void StemMeshShader(
-    uint gtid : SV_GroupThreadID,
-    uint groupOfSegment : SV_GroupID,
-    DispatchNodeInputRecord<DrawSegmentRecord> ir,
-    out vertices splineSegment::StemVertex verts[maxNumVerticesPerGroup],
-    out indices uint3 tris[maxNumTrianglesPerGroup],
-    out primitives splineSegment::StemPrimitive prims[maxNumTrianglesPerGroup]
-)
-{
-    using namespace splineSegment;
+    // Tessellation parameters (u around the ring, v along the segment) of vertex id of a thread group,
+    // ring is the index of the vertex ring in the segment
+    float2 GetSegmentVertexUV(in const DrawSegmentRecord segmentRecord, in const SegmentGroupTessellation tessellation, in const int id, out int ring)
+    {
+        const int fromPointsI = tessellation.fromPointsI;
+        const int toPointsI   = tessellation.toPointsI;
+        const int uPointsI    = tessellation.uPointsI;
+        const int vPointsI    = tessellation.vPointsI;
 
-    const DrawSegmentRecord segmentRecord = ir.Get();
+        int lastRingVertexStart = fromPointsI + uPointsI * (vPointsI - 2);
 
-    const int ringsPerGroup = segmentRecord.faceRingsPerGroup;
+        int globalVertexId = tessellation.globalVertexOffset + id;
+        bool inFirstRing = (globalVertexId < fromPointsI);
+        bool inLastRing  = (globalVertexId >= lastRingVertexStart);
+        ring = !inFirstRing + max(0, (globalVertexId - fromPointsI) / uPointsI);
+        ring = min(ring, vPointsI - 1);
 
-    float uPoints = lerp(segmentRecord.fromPoints, segmentRecord.toPoints, .5);
+        int vertsBeforeRing = !inFirstRing * (fromPointsI + (ring - 1) * uPointsI);
+        int inRing = globalVertexId - vertsBeforeRing;
 
-    int fromPointsI = RoundUpMultiple2(segmentRecord.fromPoints);
-    int toPointsI   = RoundUpMultiple2(segmentRecord.toPoints);
-    int uPointsI    = RoundUpMultiple2(uPoints);
-    int vPointsI    = RoundUpMultiple2(segmentRecord.vPoints);
+        int pointsInRing = inFirstRing ? fromPointsI : inLastRing ? toPointsI : uPointsI;
+        float pointsInRingf = inFirstRing ? tessellation.fromPoints : inLastRing ? tessellation.toPoints : tessellation.uPoints;
+        float u = SmoothTessellation(inRing, pointsInRingf, pointsInRing);
 
-    bool isFirstGroup = groupOfSegment == 0;
-    bool isLastGroup  = groupOfSegment == (segmentRecord.dispatchGrid - 1);
+        float v = SmoothTessellation(ring, tessellation.vPoints, vPointsI);
 
+        return float2(u, v);
+    }
 
-    int V = (ringsPerGroup + 1) * uPointsI;
-    int T = ringsPerGroup * 2 * (uPointsI - 1);
+    float2 GetSegmentVertexUV(in const DrawSegmentRecord segmentRecord, in const SegmentGroupTessellation tessellation, in const int id)
+    {
+        int ring;
+        return GetSegmentVertexUV(segmentRecord, tessellation, id, ring);
+    }
 
-    if(isLastGroup){
-        int globalRings = vPointsI - 1;
-        int ringsLastGroup = globalRings - (ringsPerGroup * (segmentRecord.dispatchGrid - 1));
+    // Vertex indices of triangle id of a thread group
+    uint3 GetSegmentTriangle(in const SegmentGroupTessellation tessellation, in const int id)
+    {
+        const int fromPointsI = tessellation.fromPointsI;
+        const int toPointsI   = tessellation.toPointsI;
+        const int uPointsI    = tessellation.uPointsI;
+        const int vPointsI    = tessellation.vPointsI;
 
-        V = (ringsLastGroup + 1) * uPointsI;
-        V += - uPointsI + toPointsI;
-        T = ringsLastGroup * 2 * (uPointsI - 1);
-        T += - (uPointsI - 1) + (toPointsI - 1);
-    }
+        int trianglesUntilSecondTriangleRing = fromPointsI - 1;
+        int trianglesUntilLastTriangleRing   = (trianglesUntilSecondTriangleRing + (uPointsI - 1) + 2 * (uPointsI - 1) * (vPointsI - 3));
+        int trianglesPerTriangleRing   = uPointsI - 1;
+        int numRings = vPointsI - 1;
 
-    if(isFirstGroup){
-        V += - uPointsI + fromPointsI;
-        T += - (uPointsI - 1) + (fromPointsI - 1);
-    }
+        int globalTriangleId = tessellation.globalTriangleOffset + id;
 
-    int globalRingOffset     = groupOfSegment * ringsPerGroup;
-    int globalVertexOffset   = isFirstGroup ? 0 : (fromPointsI                        + uPointsI * (globalRingOffset - 1));
-    int globalTriangleOffset = isFirstGroup ? 0 : ((fromPointsI - 1) + (uPointsI - 1) + 2 * (uPointsI - 1) * (globalRingOffset - 1));
+        bool inFirstRing = globalTriangleId < trianglesUntilSecondTriangleRing;
+        bool inLastRing  = globalTriangleId >= trianglesUntilLastTriangleRing;
 
-    SetMeshOutputCounts(V, T);
+        int triangleRing = inFirstRing ? 0 : 1 + (globalTriangleId - trianglesUntilSecondTriangleRing) / trianglesPerTriangleRing;
+        triangleRing = min(triangleRing, 2 * vPointsI - 3);
 
-    const SegmentInfo si = segmentRecord.si;
-    const TreeParameters params = GetTreeParameters();
+        bool down = triangleRing & 1;
 
-    const StemTubeCage cage     = segmentRecord.cage.Decompress();
+        int startVertex = inFirstRing ? 0 : max(0, fromPointsI + ((triangleRing-1) / 2) * uPointsI);
+        int offset = (triangleRing < 2) ? fromPointsI : uPointsI;
+        offset = down ? -offset : offset;
 
-    // make gtid signed...
-    int id = gtid;
+        int numTrianglesUntilRing = inFirstRing ? 0 : trianglesUntilSecondTriangleRing + (triangleRing - 1) * trianglesPerTriangleRing;
+        int inTriangleRing = globalTriangleId - numTrianglesUntilRing;
 
-    int lastRingVertexStart = fromPointsI + uPointsI * (vPointsI - 2);
+        int ring = triangleRing / 2;
 
-    float dist = distance(cage.from.pos, GetCameraPosition());
+        int2 ab = uPointsI.xx;
+        if(numRings == 1){
+            ab.x = fromPointsI - 1;
+            ab.y = toPointsI   - 1;
+        }else if(ring == 0 && numRings > 1){
+            ab.x = fromPointsI - 1;
+            ab.y = uPointsI    - 1;
+        }else if(ring == (numRings-1)){
+            ab.x = uPointsI  - 1;
+            ab.y = toPointsI - 1;
+        }
+        ab = down ? ab.yx : ab.xy;
 
-    // write vertices
-    if(id < V){
-        int globalVertexId = globalVertexOffset + id;
-        bool inFirstRing = (globalVertexId < fromPointsI);
-        bool inLastRing  = (globalVertexId >= lastRingVertexStart);
-        int ring = !inFirstRing + max(0, (globalVertexId - fromPointsI) / uPointsI);
-        ring = min(ring, vPointsI - 1);
+        float bias = down ? .5001 : .4999;
+        float t = saturate((inTriangleRing + bias) / (ab.x));
+        int third = offset + int((ab.y) * t + .5);
 
-        int vertsBeforeRing = !inFirstRing * (fromPointsI + (ring - 1) * uPointsI);
-        int inRing = globalVertexId - vertsBeforeRing;
+        uint3 tri = startVertex + uint3(inTriangleRing, inTriangleRing + 1, third);
 
-        int pointsInRing = inFirstRing ? fromPointsI : inLastRing ? toPointsI : uPointsI;
-        float pointsInRingf = inFirstRing ? segmentRecord.fromPoints : inLastRing ? segmentRecord.toPoints : uPoints;
-        float u = SmoothTessellation(inRing, pointsInRingf, pointsInRing);
+        tri.xy = down ? tri.yx : tri.xy;
+
+        tri -= tessellation.globalVertexOffset;
+
+        return tri;
+    }
+
+    // Spline frame of a vertex ring, shared by all vertices of the ring.
+    // Theta is the angle of the view (camera or light direction) around the stem, see ComputeStemRingFrame.
+    struct StemRingFrame {
+        float3 splineCenter;
+        float4 rot;
+        float2 inPlane;
+        float  theta;
+        float  openingAngle;
+        float  z;
+        // Tapered radius without lobes and bark bumps, which vary around the ring
+        float  radius;
+    };
+
+    StemRingFrame ComputeStemRingFrame(
+        in const DrawSegmentRecord segmentRecord,
+        in const StemTubeCage      cage,
+        in const TreeParameters    params,
+        in const float             v,
+        in const bool              isShadow
+    ){
+        const SegmentInfo si = segmentRecord.si;
+
+        StemRingFrame frame;
+
+        frame.splineCenter = StemSpline(cage.from.pos, qGetZ(cage.from.rot), cage.to.pos, qGetZ(cage.to.rot), v);
+        frame.rot          = qSlerp(cage.from.rot, cage.to.rot, v);
 
-        float v = SmoothTessellation(ring, segmentRecord.vPoints, vPointsI);
+        // Opening angles of shadow records are centered on the light direction
+        float3 toView = GetCameraPosition() - frame.splineCenter;
+        if (isShadow) {
+            toView = LightDirection;
+        }
+
+        frame.inPlane = qTransform(qConj(frame.rot), toView).xy;
+        frame.theta   = atan2(frame.inPlane.y, frame.inPlane.x);
 
-        float3 splineCenter = StemSpline(cage.from.pos, qGetZ(cage.from.rot), cage.to.pos, qGetZ(cage.to.rot), v);
+        frame.openingAngle = lerp(UnpackOpeningAngle(segmentRecord.fromOpeningAngle), UnpackOpeningAngle(segmentRecord.toOpeningAngle), v);
+        frame.z            = lerp(si.GetFromZ(), si.GetToZ(), v);
+        frame.radius       = GetTaperedRadius(si, params, frame.z);
 
-        float4 rot     = qSlerp(cage.from.rot, cage.to.rot, v);
+        return frame;
+    }
+
+    // Radius of r() from the tapered radius of the ring
+    float GetRingVertexRadius(in const StemRingFrame frame, in const SegmentInfo si, in const TreeParameters params, in const float angle, in const float v)
+    {
+        float radius = frame.radius;
+
+        if(si.level == 0 && si.fromZ == 0){
+            radius *= GetLobeFactor(si, params, frame.theta + angle, v);
+        }
 
-        float3 toCam = GetCameraPosition() - splineCenter;
+        return radius;
+    }
 
-        float2 inPlane = qTransform(qConj(rot), toCam).xy;
-        float  theta   = atan2(inPlane.y, inPlane.x);
+    // Vertex at u of the ring frame at v; dist is the distance of the segment to the camera
+    StemVertex ComputeStemRingVertex(
+        in const DrawSegmentRecord segmentRecord,
+        in const TreeParameters    params,
+        in const StemRingFrame     frame,
+        in const float             dist,
+        in const float             u,
+        in const float             v
+    ){
+        const SegmentInfo si = segmentRecord.si;
 
-        float openingAngle = lerp(segmentRecord.fromOpeningAngle, segmentRecord.toOpeningAngle, v);
-        float angle = lerp(-openingAngle, openingAngle, u);
+        float angle = lerp(-frame.openingAngle, frame.openingAngle, u);
 
-        float z = lerp(si.GetFromZ(), si.GetToZ(), v);
-        float radius = r(segmentRecord.si, params, theta + angle, z, v);
+        float z = frame.z;
+        float radius = GetRingVertexRadius(frame, si, params, angle, v);
 
-        float3 offset = qGetX(qMul(rot, qRotateZ(theta + angle)));
+        float theta = frame.theta;
+        float3 offset = qGetX(qMul(frame.rot, qRotateZ(theta + angle)));
 
         StemVertex vertex;
         {
@@ -274,16 +476,14 @@ void StemMeshShader(
             float2 uvWorld = si.radius * PI * uvu;
             float2 uv = scale * uvu;
 
-            float2 cloudPos = uv * float2(8, 2);
-            float cloud = CloudNoiseWrapX(cloudPos, scale * 8, 2);
+            const BarkSample bark = SampleBarkTexture(uv);
 
-            float o = WrappingXPerlinNoise(uv * 2, scale * 2);
+            float cloud = bark.cloudVertex;
 
             float voronoi = 0;
             static const float voronoiStart = 16;
             if(si.level < 2 && dist < voronoiStart){
-                float v = VoronoiDistanceWrapX((uv + 0.03 * o) * float2(8, 1), scale * 8);
-                v = min(v, params.StemBumpGapSize) * 4;
+                float v = min(bark.voronoi, params.StemBumpGapSize) * 4;
                 voronoi = LerpIn(v, voronoiStart, voronoiStart * .8, dist);
             }
             float bump = lerp(cloud, voronoi, params.StemBumpVoronoiWeight);
@@ -298,77 +498,151 @@ void StemMeshShader(
             radius *= 1 + bump * 0.12 * params.StemBumpStrength;
         }
 
-        vertex.openingAngle_u_v_z = float4(angle, inPlane.yx, z);
+        vertex.openingAngle_u_v_z = float4(angle, frame.inPlane.yx, z);
 
-        vertex.fromTrafo = segmentRecord.cage.from.trafo;
-        vertex.toTrafo   = segmentRecord.cage.to.trafo;
-
-        float3 worldSpacePosition = splineCenter + radius * offset;
+        float3 worldSpacePosition = frame.splineCenter + radius * offset;
 
         vertex.clipSpacePosition = mul(GetViewProjectionMatrix(), float4(worldSpacePosition, 1));
 
-        float distance = segmentRecord.aoDistance + ((1-v) * si.length) / params.nCurveRes[si.level];
+        float distance = GetSegmentAoDistance(segmentRecord) + ((1-v) * si.length) / params.nCurveRes[si.level];
         vertex.ao = fakeAOfromDistance(distance);
-        verts[id] = vertex;
+
+        return vertex;
     }
 
-    int trianglesUntilSecondTriangleRing = fromPointsI - 1;
-    int trianglesUntilLastTriangleRing   = (trianglesUntilSecondTriangleRing + (uPointsI - 1) + 2 * (uPointsI - 1) * (vPointsI - 3));
-    int trianglesPerTriangleRing   = uPointsI - 1;
-    int numRings = vPointsI - 1;
+    // Vertex id of a thread group of segmentRecord without cached ring frames, see StemBundleMeshShader
+    StemVertex ComputeStemVertex(in const DrawSegmentRecord segmentRecord, in const SegmentGroupTessellation tessellation, in const int id)
+    {
+        const TreeParameters params = GetTreeParameters();
 
-    if(id < T){
-        int globalTriangleId = globalTriangleOffset + id;
+        const StemTubeCage cage = segmentRecord.cage.Decompress();
 
-        bool inFirstRing = globalTriangleId < trianglesUntilSecondTriangleRing;
-        bool inLastRing  = globalTriangleId >= trianglesUntilLastTriangleRing;
+        const float dist = distance(cage.from.pos, GetCameraPosition());
 
-        int triangleRing = inFirstRing ? 0 : 1 + (globalTriangleId - trianglesUntilSecondTriangleRing) / trianglesPerTriangleRing;
-        triangleRing = min(triangleRing, 2 * vPointsI - 3);
+        const float2 tessellationUV = GetSegmentVertexUV(segmentRecord, tessellation, id);
 
-        bool down = triangleRing & 1;
+        const StemRingFrame frame = ComputeStemRingFrame(segmentRecord, cage, params, tessellationUV.y, false);
 
-        int startVertex = inFirstRing ? 0 : max(0, fromPointsI + ((triangleRing-1) / 2) * uPointsI);
-        int offset = (triangleRing < 2) ? fromPointsI : uPointsI;
-        offset = down ? -offset : offset;
+        return ComputeStemRingVertex(segmentRecord, params, frame, dist, tessellationUV.x, tessellationUV.y);
+    }
 
-        int numTrianglesUntilRing = inFirstRing ? 0 : trianglesUntilSecondTriangleRing + (triangleRing - 1) * trianglesPerTriangleRing;
-        int inTriangleRing = globalTriangleId - numTrianglesUntilRing;
+    // Depth-only vertex at u of the ring frame at v
+    ShadowVertex ComputeStemShadowRingVertex(
+        in const DrawSegmentRecord segmentRecord,
+        in const TreeParameters    params,
+        in const StemRingFrame     frame,
+        in const float             u,
+        in const float             v
+    ){
+        float angle = lerp(-frame.openingAngle, frame.openingAngle, u);
 
-        int ring = triangleRing / 2;
+        float radius = GetRingVertexRadius(frame, segmentRecord.si, params, angle, v);
 
-        int2 ab = uPointsI.xx;
-        if(numRings == 1){
-            ab.x = fromPointsI - 1;
-            ab.y = toPointsI   - 1;
-        }else if(ring == 0 && numRings > 1){
-            ab.x = fromPointsI - 1;
-            ab.y = uPointsI    - 1;
-        }else if(ring == (numRings-1)){
-            ab.x = uPointsI  - 1;
-            ab.y = toPointsI - 1;
-        }
-        ab = down ? ab.yx : ab.xy;
+        float3 offset = qGetX(qMul(frame.rot, qRotateZ(frame.theta + angle)));
 
-        float bias = down ? .5001 : .4999;
-        float t = saturate((inTriangleRing + bias) / (ab.x));
-        int third = offset + int((ab.y) * t + .5);
+        return GetShadowVertex(frame.splineCenter + radius * offset);
+    }
 
-        uint3 tri = startVertex + uint3(inTriangleRing, inTriangleRing + 1, third);
+    // Depth-only vertex id of a thread group of segmentRecord without cached ring frames, see StemShadowBundleMeshShader
+    ShadowVertex ComputeStemShadowVertex(in const DrawSegmentRecord segmentRecord, in const SegmentGroupTessellation tessellation, in const int id)
+    {
+        const TreeParameters params = GetTreeParameters();
 
-        tri.xy = down ? tri.yx : tri.xy;
+        const StemTubeCage cage = segmentRecord.cage.Decompress();
+
+        const float2 tessellationUV = GetSegmentVertexUV(segmentRecord, tessellation, id);
+
+        const StemRingFrame frame = ComputeStemRingFrame(segmentRecord, cage, params, tessellationUV.y, true);
+
+        return ComputeStemShadowRingVertex(segmentRecord, params, frame, tessellationUV.x, tessellationUV.y);
+    }
+
+}
+
+// Ring frames of the thread group, computed once per ring instead of once per vertex.
+// Shared by StemMeshShader and StemShadowMeshShader.
+groupshared splineSegment::StemRingFrame groupStemRingFrames[maxNumRingsPerGroup];
+
+// Fills groupStemRingFrames with the rings of the thread group
+void ComputeGroupStemRingFrames(
+    in const int                      id,
+    in const DrawSegmentRecord        segmentRecord,
+    in const SegmentGroupTessellation tessellation,
+    in const StemTubeCage             cage,
+    in const TreeParameters           params,
+    in const bool                     isShadow
+){
+    using namespace splineSegment;
 
-        tri -= globalVertexOffset;
+    if(id < tessellation.ringCount){
+        const int ring = tessellation.globalRingOffset + id;
+        const float v = SmoothTessellation(ring, tessellation.vPoints, tessellation.vPointsI);
 
-        tris[id]       = tri;
-        prims[id].sip = PackSegmentInfo(si);
+        groupStemRingFrames[id] = ComputeStemRingFrame(segmentRecord, cage, params, v, isShadow);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+}
+
+[Shader("node")]
+[NodeLaunch("mesh")]
+[NodeId("DrawSegment", 0)]
+[NodeMaxDispatchGrid(maxNumTriangleRingsPerSegment, 1, 1)]
+[NumThreads(128, 1, 1)]
+[OutputTopology("triangle")]
+void StemMeshShader(
+    uint gtid : SV_GroupThreadID,
+    uint groupOfSegment : SV_GroupID,
+    DispatchNodeInputRecord<DrawSegmentRecord> ir,
+    out vertices splineSegment::StemVertex verts[maxNumVerticesPerGroup],
+    out indices uint3 tris[maxNumTrianglesPerGroup],
+    out primitives splineSegment::StemPrimitive prims[maxNumTrianglesPerGroup]
+)
+{
+    using namespace splineSegment;
+
+    const DrawSegmentRecord segmentRecord = ir.Get();
+
+    const SegmentGroupTessellation tessellation = GetSegmentGroupTessellation(segmentRecord, groupOfSegment);
+
+    const int V = tessellation.V;
+    const int T = tessellation.T;
+
+    SetMeshOutputCounts(V, T);
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::STEM_MESH_GROUPS, 1);
+        AddStatistic(StatisticsCounter::STEM_MESH_VERTICES, V);
+        AddStatistic(StatisticsCounter::STEM_MESH_TRIANGLES, T);
+    }
+
+    // make gtid signed...
+    int id = gtid;
+
+    const TreeParameters params = GetTreeParameters();
+    const StemTubeCage   cage   = segmentRecord.cage.Decompress();
+
+    ComputeGroupStemRingFrames(id, segmentRecord, tessellation, cage, params, false);
+
+    if(id < V){
+        const float dist = distance(cage.from.pos, GetCameraPosition());
+
+        int ring;
+        const float2 tessellationUV = GetSegmentVertexUV(segmentRecord, tessellation, id, ring);
+        const StemRingFrame frame = groupStemRingFrames[ring - tessellation.globalRingOffset];
+
+        verts[id] = ComputeStemRingVertex(segmentRecord, params, frame, dist, tessellationUV.x, tessellationUV.y);
+    }
+
+    if(id < T){
+        tris[id]  = GetSegmentTriangle(tessellation, id);
+        prims[id] = GetStemPrimitive(segmentRecord);
     }
 }
 
 float4 StemPixelShader(
     const in splineSegment::StemVertex vertex,
     const in splineSegment::StemPrimitive primitive,
-    float3 barycentrics : SV_Barycentrics,
     bool isFrontFace : SV_IsFrontFace
 ) : SV_Target0
 {
@@ -390,10 +664,10 @@ float4 StemPixelShader(
     float theta = (2 * PI + centerAngle + openingAngle) % (2*PI);
 
     TreeTransformCompressedq32 fromTrafo;
-    fromTrafo.trafo = GetAttributeAtVertex(vertex.fromTrafo, 2);
+    fromTrafo.trafo = primitive.fromTrafo;
 
     TreeTransformCompressedq32 toTrafo;
-    toTrafo.trafo = GetAttributeAtVertex(vertex.toTrafo, 2);
+    toTrafo.trafo = primitive.toTrafo;
 
     StemTubeCage cage;
     cage.from.pos = fromTrafo.GetPos();
@@ -402,6 +676,7 @@ float4 StemPixelShader(
     cage.to.rot   = toTrafo.GetRot();
     float z = vertex.openingAngle_u_v_z.w;
 
+    float3 worldSpacePosition;
     {
         float dist = distance(cage.from.pos, GetCameraPosition());
         const float t = (z - si.GetFromZ()) / (si.GetToZ() - si.GetFromZ());
@@ -415,18 +690,17 @@ float4 StemPixelShader(
         int scale = max(1, int(PI * si.radius + 1.3));
         float2 uv = scale * float2(theta / PI, (si.length * z * 2)/(4 * si.radius));
 
+        const BarkSample bark = SampleBarkTexture(uv);
 
+        // fade in the octaves above the vertex displacement with the pixel footprint
         float2 cloudPos = uv * float2(8, 2);
-        float cloud = CloudNoiseWrapX(cloudPos, scale * 8, -log2(length(ddx(cloudPos) + ddy(cloudPos))) + bumpLevelBias);
-
-        float o = WrappingXPerlinNoise(uv * 2, scale * 2);
-
+        float cloudLevels = -log2(length(ddx(cloudPos) + ddy(cloudPos))) + bumpLevelBias;
+        float cloud = lerp(bark.cloudVertex, bark.cloud, saturate((cloudLevels - barkVertexCloudLevels) / (barkCloudLevels - barkVertexCloudLevels)));
 
         float voronoi = 0;
         static const float voronoiStart = 32;
         if(si.level < 2 && dist < voronoiStart){
-            float v = VoronoiDistanceWrapX((uv + 0.03 * o) * float2(8, 1), scale * 8);
-            v = min(v, params.StemBumpGapSize) * 4;
+            float v = min(bark.voronoi, params.StemBumpGapSize) * 4;
             voronoi = LerpIn(v, voronoiStart, voronoiStart * .8, dist);
         }
 
@@ -448,14 +722,13 @@ float4 StemPixelShader(
             surface.baseColor.rgb = lerp(smallColor, bigColor, l);
 
             // spots
-            if(dist < 32 && (Voronoi(uv * params.StemLichenFrequency) + 0.6 * cloud) < (params.StemLichenSize - .5) && bump > 0.3){
+            if(dist < 32 && (bark.lichen + 0.6 * cloud) < (params.StemLichenSize - .5) && bump > 0.3){
                 surface.baseColor.rgb *= float3(1.5, 1.65, 1.5);
             }
         }
 
         if(params.StemBirchTexture && !isSnow){
-            float2 pos = uv * float2(4, 1.25);
-            float birch = CloudNoiseWrapX(pos, scale * 4, -log2(length(ddx(pos) + ddy(pos))) + bumpLevelBias);
+            float birch = bark.birch;
             float thresh = (si.level == 0) ? (1-z - .6) : -.1;
             bool smooth = birch > thresh;
 
@@ -466,7 +739,8 @@ float4 StemPixelShader(
         }
 
         radius *= 1 + bump * 0.12 * params.StemBumpStrength;
-        surface.normal.xyz = Normal(splinePos + offset * radius);
+        worldSpacePosition = splinePos + offset * radius;
+        surface.normal.xyz = Normal(worldSpacePosition);
 
         // roughness
         surface.roughness = (bump >= params.StemBumpGapSize) ? 0.6 : .9;
@@ -478,5 +752,243 @@ float4 StemPixelShader(
     //    surface.baseColor.rgb = float3(1,0,0);
     //}
 
-    return ShadeSurface(surface);
+    StoreOcclusionDepth(vertex.clipSpacePosition);
+
+    return ShadeSurface(surface, GetLightVisibility(worldSpacePosition));
+}
+
+// Depth-only variant of StemMeshShader for the shadow map. Segments are tessellated towards the light
+// (see ComputeVisibilityAndTessellationData with the shadow view); bark bumps are omitted.
+[Shader("node")]
+[NodeLaunch("mesh")]
+[NodeId("DrawSegmentShadow", 0)]
+[NodeMaxDispatchGrid(maxNumTriangleRingsPerSegment, 1, 1)]
+[NumThreads(128, 1, 1)]
+[OutputTopology("triangle")]
+void StemShadowMeshShader(
+    uint gtid : SV_GroupThreadID,
+    uint groupOfSegment : SV_GroupID,
+    DispatchNodeInputRecord<DrawSegmentRecord> ir,
+    out vertices ShadowVertex verts[maxNumVerticesPerGroup],
+    out indices uint3 tris[maxNumTrianglesPerGroup]
+)
+{
+    using namespace splineSegment;
+
+    const DrawSegmentRecord segmentRecord = ir.Get();
+
+    const SegmentGroupTessellation tessellation = GetSegmentGroupTessellation(segmentRecord, groupOfSegment);
+
+    const int V = tessellation.V;
+    const int T = tessellation.T;
+
+    SetMeshOutputCounts(V, T);
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::STEM_SHADOW_MESH_GROUPS, 1);
+        AddStatistic(StatisticsCounter::STEM_SHADOW_MESH_VERTICES, V);
+        AddStatistic(StatisticsCounter::STEM_SHADOW_MESH_TRIANGLES, T);
+    }
+
+    int id = gtid;
+
+    const TreeParameters params = GetTreeParameters();
+    const StemTubeCage   cage   = segmentRecord.cage.Decompress();
+
+    ComputeGroupStemRingFrames(id, segmentRecord, tessellation, cage, params, true);
+
+    if(id < V){
+        int ring;
+        const float2 tessellationUV = GetSegmentVertexUV(segmentRecord, tessellation, id, ring);
+        const StemRingFrame frame = groupStemRingFrames[ring - tessellation.globalRingOffset];
+
+        verts[id] = ComputeStemShadowRingVertex(segmentRecord, params, frame, tessellationUV.x, tessellationUV.y);
+    }
+
+    if(id < T){
+        tris[id] = GetSegmentTriangle(tessellation, id);
+    }
+}
+
+float4 StemShadowPixelShader(const in ShadowVertex vertex) : SV_Target0
+{
+    StoreShadowDepth(vertex.lightPosition, vertex.depth);
+    discard;
+
+    return 0;
+}
+
+// ============================ Segment Coalescing ====================
+// Stem sends segments that need less than half a mesh thread group (see IsCoalescedSegment) to CoalesceDrawSegments,
+// which packs them into the thread groups of one DrawSegmentBundleRecord. The bundle mesh nodes map every vertex and
+// triangle of their thread group back to its segment and share the tessellation and vertex code with DrawSegment.
+
+[Shader("node")]
+[NodeLaunch("coalescing")]
+[NodeId("CoalesceDrawSegments", 0)]
+[NumThreads(maxCoalescedDrawSegmentRecords, 1, 1)]
+void CoalesceDrawSegments(
+    uint gtid : SV_GroupThreadID,
+
+    [MaxRecords(maxCoalescedDrawSegmentRecords)]
+    GroupNodeInputRecords<DrawSegmentRecord> irs,
+
+    [MaxRecords(1)]
+    [NodeId("DrawSegmentBundle")]
+    NodeOutput<DrawSegmentBundleRecord> output
+)
+{
+    CoalesceDrawSegmentRecords(gtid, irs, output);
+}
+
+[Shader("node")]
+[NodeLaunch("coalescing")]
+[NodeId("CoalesceDrawSegments", 1)]
+[NumThreads(maxCoalescedDrawSegmentRecords, 1, 1)]
+void CoalesceDrawSegmentsShadow(
+    uint gtid : SV_GroupThreadID,
+
+    [MaxRecords(maxCoalescedDrawSegmentRecords)]
+    GroupNodeInputRecords<DrawSegmentRecord> irs,
+
+    [MaxRecords(1)]
+    [NodeId("DrawSegmentBundleShadow")]
+    NodeOutput<DrawSegmentBundleRecord> output
+)
+{
+    CoalesceDrawSegmentRecords(gtid, irs, output);
+}
+
+// Segment of every vertex and triangle of a DrawSegmentBundle(Shadow) thread group, relative to group.firstSegment
+groupshared uint groupBundleVertexSegment[maxNumVerticesPerGroup];
+groupshared uint groupBundleTriangleSegment[maxNumTrianglesPerGroup];
+
+// Every segment thread marks the vertices and triangles of its segment
+void MapSegmentBundleGroup(in const uint gtid, in const DrawSegmentBundleRecord bundle, in const SegmentBundleGroup group)
+{
+    if (gtid < group.segmentCount) {
+        const CoalescedSegment         segment      = bundle.segments[group.firstSegment + gtid];
+        const SegmentGroupTessellation tessellation = GetSegmentGroupTessellation(GetDrawSegmentRecord(segment), 0);
+
+        for (int v = 0; v < tessellation.V; ++v) {
+            groupBundleVertexSegment[segment.vertexOffset + v] = gtid;
+        }
+        for (int t = 0; t < tessellation.T; ++t) {
+            groupBundleTriangleSegment[segment.triangleOffset + t] = gtid;
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+}
+
+[Shader("node")]
+[NodeLaunch("mesh")]
+[NodeId("DrawSegmentBundle", 0)]
+[NodeMaxDispatchGrid(maxCoalescedDrawSegmentRecords, 1, 1)]
+[NumThreads(128, 1, 1)]
+[OutputTopology("triangle")]
+void StemBundleMeshShader(
+    uint gtid : SV_GroupThreadID,
+    uint gid : SV_GroupID,
+    DispatchNodeInputRecord<DrawSegmentBundleRecord> ir,
+    out vertices splineSegment::StemVertex verts[maxNumVerticesPerGroup],
+    out indices uint3 tris[maxNumTrianglesPerGroup],
+    out primitives splineSegment::StemPrimitive prims[maxNumTrianglesPerGroup]
+)
+{
+    using namespace splineSegment;
+
+    const SegmentBundleGroup group = ir.Get().groups[gid];
+
+    const int V = group.vertexCount;
+    const int T = group.triangleCount;
+
+    SetMeshOutputCounts(V, T);
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::STEM_MESH_GROUPS, 1);
+        AddStatistic(StatisticsCounter::STEM_MESH_VERTICES, V);
+        AddStatistic(StatisticsCounter::STEM_MESH_TRIANGLES, T);
+    }
+
+    MapSegmentBundleGroup(gtid, ir.Get(), group);
+
+    int id = gtid;
+
+    if(id < V){
+        const CoalescedSegment  segment       = ir.Get().segments[group.firstSegment + groupBundleVertexSegment[id]];
+        const DrawSegmentRecord segmentRecord = GetDrawSegmentRecord(segment);
+
+        verts[id] = ComputeStemVertex(segmentRecord, GetSegmentGroupTessellation(segmentRecord, 0), id - segment.vertexOffset);
+    }
+
+    if(id < T){
+        const CoalescedSegment  segment       = ir.Get().segments[group.firstSegment + groupBundleTriangleSegment[id]];
+        const DrawSegmentRecord segmentRecord = GetDrawSegmentRecord(segment);
+
+        tris[id]  = segment.vertexOffset + GetSegmentTriangle(GetSegmentGroupTessellation(segmentRecord, 0), id - segment.triangleOffset);
+        prims[id] = GetStemPrimitive(segmentRecord);
+    }
+}
+
+float4 StemBundlePixelShader(
+    const in splineSegment::StemVertex vertex,
+    const in splineSegment::StemPrimitive primitive,
+    bool isFrontFace : SV_IsFrontFace
+) : SV_Target0
+{
+    return StemPixelShader(vertex, primitive, isFrontFace);
+}
+
+[Shader("node")]
+[NodeLaunch("mesh")]
+[NodeId("DrawSegmentBundleShadow", 0)]
+[NodeMaxDispatchGrid(maxCoalescedDrawSegmentRecords, 1, 1)]
+[NumThreads(128, 1, 1)]
+[OutputTopology("triangle")]
+void StemShadowBundleMeshShader(
+    uint gtid : SV_GroupThreadID,
+    uint gid : SV_GroupID,
+    DispatchNodeInputRecord<DrawSegmentBundleRecord> ir,
+    out vertices ShadowVertex verts[maxNumVerticesPerGroup],
+    out indices uint3 tris[maxNumTrianglesPerGroup]
+)
+{
+    using namespace splineSegment;
+
+    const SegmentBundleGroup group = ir.Get().groups[gid];
+
+    const int V = group.vertexCount;
+    const int T = group.triangleCount;
+
+    SetMeshOutputCounts(V, T);
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::STEM_SHADOW_MESH_GROUPS, 1);
+        AddStatistic(StatisticsCounter::STEM_SHADOW_MESH_VERTICES, V);
+        AddStatistic(StatisticsCounter::STEM_SHADOW_MESH_TRIANGLES, T);
+    }
+
+    MapSegmentBundleGroup(gtid, ir.Get(), group);
+
+    int id = gtid;
+
+    if(id < V){
+        const CoalescedSegment  segment       = ir.Get().segments[group.firstSegment + groupBundleVertexSegment[id]];
+        const DrawSegmentRecord segmentRecord = GetDrawSegmentRecord(segment);
+
+        verts[id] = ComputeStemShadowVertex(segmentRecord, GetSegmentGroupTessellation(segmentRecord, 0), id - segment.vertexOffset);
+    }
+
+    if(id < T){
+        const CoalescedSegment  segment       = ir.Get().segments[group.firstSegment + groupBundleTriangleSegment[id]];
+        const DrawSegmentRecord segmentRecord = GetDrawSegmentRecord(segment);
+
+        tris[id] = segment.vertexOffset + GetSegmentTriangle(GetSegmentGroupTessellation(segmentRecord, 0), id - segment.triangleOffset);
+    }
+}
+
+float4 StemShadowBundlePixelShader(const in ShadowVertex vertex) : SV_Target0
+{
+    return StemShadowPixelShader(vertex);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Camera.h"
+#include "Occlusion.h"
 
 /*
     *----t----*
@@ -42,6 +43,37 @@ float3 PosToPixel(in const float4x4 viewProjectionMatrix, in const float3 pos){
     return PosToClip(viewProjectionMatrix, pos) * float3(RenderSize * .5, 1);
 }
 
+float3 PosToPixel(in const ViewParameters view, in const float3 pos){
+    return PosToClip(view.viewProjectionMatrix, pos) * float3(view.viewportSize * .5, 1);
+}
+
+// ============================ Record Packing ====================
+// DrawSegmentRecord stores the tessellation in 16 bits per value: points as 8.8 fixed point, which is exact
+// as ComputeVisibilityAndTessellationData rounds them to that grid, opening angles in [0, PI] as unorm16,
+// and the ao distance as half.
+
+static const float segmentPointsScale = 256;
+
+float QuantizeSegmentPoints(in float points){
+    return round(points * segmentPointsScale) / segmentPointsScale;
+}
+
+uint PackSegmentPoints(in float points){
+    return uint(round(points * segmentPointsScale));
+}
+
+float UnpackSegmentPoints(in uint packedPoints){
+    return packedPoints / segmentPointsScale;
+}
+
+uint PackOpeningAngle(in float openingAngle){
+    return uint(round(saturate(openingAngle / PI) * 65535));
+}
+
+float UnpackOpeningAngle(in uint packedOpeningAngle){
+    return (packedOpeningAngle / 65535.f) * PI;
+}
+
 float GetOpeningAngle(in const float3 toCam, float3 up, float z, float radius_){
     if(z >= 0.95) return PI;
     float d = dot(toCam, up);
@@ -57,33 +89,38 @@ SegmentTessellationData ComputeVisibilityAndTessellationData(
     in  const TreeParameters params,
     in  const TreeTransform  cageFrom,
     in  const TreeTransform  cageTo,
-    in  const float          pixelsPerTriangle
+    in  const float          pixelsPerTriangle,
+    in  const ViewParameters view,
+    in  const OcclusionView  occlusion
 )
 {
-    SegmentTessellationData result = (SegmentTessellationData)0;
-    result.threadGroupCount        = 0;
-
-    const float3   cameraPosition       = GetCameraPosition();
-    const float4x4 viewProjectionMatrix = GetViewProjectionMatrix();
+    SegmentTessellationData result;
+    result.threadGroupCount  = 0;
+    result.fromPoints        = 0;
+    result.toPoints          = 0;
+    result.vPoints           = 0;
+    result.faceRingsPerGroup = 0;
+    result.fromOpeningAngle  = 0;
+    result.toOpeningAngle    = 0;
 
     // Estimate resolution of stem segment
-    const float3 fromPos2cam = normalize(cameraPosition - cageFrom.pos);
-    const float3 toPos2cam   = normalize(cameraPosition - cageTo.pos);
+    const float3 fromPos2cam = normalize(GetToViewer(view, cageFrom.pos));
+    const float3 toPos2cam   = normalize(GetToViewer(view, cageTo.pos));
 
     const float3 fromPerpVector = normalize(ArbitraryOrthonormal(fromPos2cam));
     const float3 toPerpVector   = normalize(ArbitraryOrthonormal(toPos2cam));
 
-    const float2 fromPixel = PosToPixel(viewProjectionMatrix, cageFrom.pos).xy;
-    const float2 toPixel   = PosToPixel(viewProjectionMatrix, cageTo.pos).xy;
+    const float2 fromPixel = PosToPixel(view, cageFrom.pos).xy;
+    const float2 toPixel   = PosToPixel(view, cageTo.pos).xy;
 
-    float fromZ = si.GetFromZ();
-    float toZ   = si.GetToZ();
+    float fromZ = SegmentInfo::DecodeZ(si.fromZ);
+    float toZ   = SegmentInfo::DecodeZ(si.toZ);
 
     float fromRingRadius = GetTaperedRadius(si, params, fromZ);
     float toRingRadius   = GetTaperedRadius(si, params, toZ);
 
-    const float2 fromPixelB = PosToPixel(viewProjectionMatrix, cageFrom.pos + fromPerpVector * fromRingRadius).xy;
-    const float2 toPixelB   = PosToPixel(viewProjectionMatrix, cageTo.pos   + toPerpVector   * toRingRadius).xy;
+    const float2 fromPixelB = PosToPixel(view, cageFrom.pos + fromPerpVector * fromRingRadius).xy;
+    const float2 toPixelB   = PosToPixel(view, cageTo.pos   + toPerpVector   * toRingRadius).xy;
 
     float fromPixelDiameter = 2 * distance(fromPixel, fromPixelB);
     float toPixelDiameter   = 2 * distance(toPixel  , toPixelB);
@@ -101,10 +138,10 @@ SegmentTessellationData ComputeVisibilityAndTessellationData(
     const float maxRadius = max(fromRingRadius, toRingRadius);
     const float boundingSphereRadius = sqrt(maxRadius * maxRadius + (segmentLength * 0.5) * (segmentLength * 0.5));
 
-    const Frustum frustum = GetViewFrustum();
-    const bool inFrustum = SphereInFrustum(frustum, segmentCenter, boundingSphereRadius);
+    const bool inFrustum = SphereInFrustum(view.frustum, segmentCenter, boundingSphereRadius);
 
-    if (!draw || !inFrustum) {
+    // Occlusion culling using the same bounding sphere, see Occlusion.h
+    if (!draw || !inFrustum || IsSphereOccluded(occlusion, segmentCenter, boundingSphereRadius)) {
         return result;
     }
 
@@ -123,6 +160,11 @@ SegmentTessellationData ComputeVisibilityAndTessellationData(
     result.toPoints   = clamp(result.toPoints,   minPoints, maxPointsU);
     result.vPoints    = clamp(result.vPoints,    minPoints, maxPointsV);
 
+    // Points must survive PackSegmentPoints unchanged, as they determine the vertex count of every thread group
+    result.fromPoints = QuantizeSegmentPoints(result.fromPoints);
+    result.toPoints   = QuantizeSegmentPoints(result.toPoints);
+    result.vPoints    = QuantizeSegmentPoints(result.vPoints);
+
     int fromPointsI = RoundUpMultiple2(result.fromPoints);
     int toPointsI   = RoundUpMultiple2(result.toPoints);
     float uPoints   = lerp(result.fromPoints, result.toPoints, .5);
@@ -145,4 +187,313 @@ SegmentTessellationData ComputeVisibilityAndTessellationData(
     result.toOpeningAngle   = (toPointsI < 5)   ? .5 * PI : toOpeningAngle;
 
     return result;
-}
\ No newline at end of file
+}
+
+DrawSegmentRecord CreateDrawSegmentRecord(
+    in  const TreeTransform           cageFrom,
+    in  const TreeTransform           cageTo,
+    in  const SegmentInfo             si,
+    in  const float                   aoDistance,
+    in  const SegmentTessellationData tessellationData
+)
+{
+    DrawSegmentRecord record;
+
+    record.cage.from.SetPos(cageFrom.pos);
+    record.cage.from.SetRot(cageFrom.rot);
+
+    record.cage.to.SetPos(cageTo.pos);
+    record.cage.to.SetRot(cageTo.rot);
+
+    record.si         = si;
+    record.aoDistance = f32tof16(aoDistance);
+
+    record.fromPoints        = PackSegmentPoints(tessellationData.fromPoints);
+    record.toPoints          = PackSegmentPoints(tessellationData.toPoints);
+    record.vPoints           = PackSegmentPoints(tessellationData.vPoints);
+    record.faceRingsPerGroup = tessellationData.faceRingsPerGroup;
+    record.fromOpeningAngle  = PackOpeningAngle(tessellationData.fromOpeningAngle);
+    record.toOpeningAngle    = PackOpeningAngle(tessellationData.toOpeningAngle);
+    record.dispatchGrid      = tessellationData.threadGroupCount;
+
+    return record;
+}
+
+SegmentTessellationData GetSegmentTessellationData(in const DrawSegmentRecord segmentRecord)
+{
+    SegmentTessellationData result;
+    result.threadGroupCount  = segmentRecord.dispatchGrid;
+    result.fromPoints        = UnpackSegmentPoints(segmentRecord.fromPoints);
+    result.toPoints          = UnpackSegmentPoints(segmentRecord.toPoints);
+    result.vPoints           = UnpackSegmentPoints(segmentRecord.vPoints);
+    result.faceRingsPerGroup = segmentRecord.faceRingsPerGroup;
+    result.fromOpeningAngle  = UnpackOpeningAngle(segmentRecord.fromOpeningAngle);
+    result.toOpeningAngle    = UnpackOpeningAngle(segmentRecord.toOpeningAngle);
+
+    return result;
+}
+
+float GetSegmentAoDistance(in const DrawSegmentRecord segmentRecord)
+{
+    return f16tof32(segmentRecord.aoDistance);
+}
+
+// ============================ Segment Thread Groups ====================
+
+// Vertex and triangle ranges of one thread group of a segment
+struct SegmentGroupTessellation {
+    float fromPoints;
+    float toPoints;
+    float uPoints;
+    float vPoints;
+
+    int fromPointsI;
+    int toPointsI;
+    int uPointsI;
+    int vPointsI;
+
+    int V;
+    int T;
+
+    int globalVertexOffset;
+    int globalTriangleOffset;
+
+    // Rings [globalRingOffset, globalRingOffset + ringCount) of the segment have vertices in this group
+    int globalRingOffset;
+    int ringCount;
+};
+
+// Every ring has at least minPoints vertices
+static const int maxNumRingsPerGroup = maxNumVerticesPerGroup / minPoints;
+
+SegmentGroupTessellation GetSegmentGroupTessellation(in const DrawSegmentRecord segmentRecord, in const uint groupOfSegment)
+{
+    SegmentGroupTessellation tessellation;
+
+    const SegmentTessellationData tessellationData = GetSegmentTessellationData(segmentRecord);
+
+    const int ringsPerGroup = tessellationData.faceRingsPerGroup;
+
+    float uPoints = lerp(tessellationData.fromPoints, tessellationData.toPoints, .5);
+
+    int fromPointsI = RoundUpMultiple2(tessellationData.fromPoints);
+    int toPointsI   = RoundUpMultiple2(tessellationData.toPoints);
+    int uPointsI    = RoundUpMultiple2(uPoints);
+    int vPointsI    = RoundUpMultiple2(tessellationData.vPoints);
+
+    bool isFirstGroup = groupOfSegment == 0;
+    bool isLastGroup  = groupOfSegment == (segmentRecord.dispatchGrid - 1);
+
+
+    int V = (ringsPerGroup + 1) * uPointsI;
+    int T = ringsPerGroup * 2 * (uPointsI - 1);
+    int ringCount = ringsPerGroup + 1;
+
+    if(isLastGroup){
+        int globalRings = vPointsI - 1;
+        int ringsLastGroup = globalRings - (ringsPerGroup * (segmentRecord.dispatchGrid - 1));
+
+        ringCount = ringsLastGroup + 1;
+        V = (ringsLastGroup + 1) * uPointsI;
+        V += - uPointsI + toPointsI;
+        T = ringsLastGroup * 2 * (uPointsI - 1);
+        T += - (uPointsI - 1) + (toPointsI - 1);
+    }
+
+    if(isFirstGroup){
+        V += - uPointsI + fromPointsI;
+        T += - (uPointsI - 1) + (fromPointsI - 1);
+    }
+
+    int globalRingOffset     = groupOfSegment * ringsPerGroup;
+    int globalVertexOffset   = isFirstGroup ? 0 : (fromPointsI                        + uPointsI * (globalRingOffset - 1));
+    int globalTriangleOffset = isFirstGroup ? 0 : ((fromPointsI - 1) + (uPointsI - 1) + 2 * (uPointsI - 1) * (globalRingOffset - 1));
+
+    tessellation.fromPoints           = tessellationData.fromPoints;
+    tessellation.toPoints             = tessellationData.toPoints;
+    tessellation.uPoints              = uPoints;
+    tessellation.vPoints              = tessellationData.vPoints;
+    tessellation.fromPointsI          = fromPointsI;
+    tessellation.toPointsI            = toPointsI;
+    tessellation.uPointsI             = uPointsI;
+    tessellation.vPointsI             = vPointsI;
+    tessellation.V                    = V;
+    tessellation.T                    = T;
+    tessellation.globalVertexOffset   = globalVertexOffset;
+    tessellation.globalTriangleOffset = globalTriangleOffset;
+    tessellation.globalRingOffset     = globalRingOffset;
+    tessellation.ringCount            = ringCount;
+
+    return tessellation;
+}
+
+// ============================ Segment Coalescing ====================
+// Segments drawn by a single, mostly empty mesh thread group (thin or distant branches, most shadow segments)
+// are sent to CoalesceDrawSegments, which packs several of them into one thread group of DrawSegmentBundle.
+
+static const int maxCoalescedSegmentVertices    = maxNumVerticesPerGroup / 2;
+static const int maxCoalescedSegmentTriangles   = maxNumTrianglesPerGroup / 2;
+static const int maxCoalescedDrawSegmentRecords = 64;
+
+bool IsCoalescedSegment(in const DrawSegmentRecord segmentRecord)
+{
+    if (segmentRecord.dispatchGrid != 1) {
+        return false;
+    }
+
+    const SegmentGroupTessellation tessellation = GetSegmentGroupTessellation(segmentRecord, 0);
+
+    return (tessellation.V <= maxCoalescedSegmentVertices) && (tessellation.T <= maxCoalescedSegmentTriangles);
+}
+
+// DrawSegmentRecord of a coalesced segment; the dispatch grid is always one thread group
+struct CoalescedSegment {
+    StemTubeCageCompressed cage;
+    SegmentInfo  si;
+    // Packed as in DrawSegmentRecord
+    uint  fromPoints        : 16;
+    uint  toPoints          : 16;
+    uint  vPoints           : 16;
+    uint  faceRingsPerGroup : 16;
+    uint  fromOpeningAngle  : 16;
+    uint  toOpeningAngle    : 16;
+    uint  aoDistance        : 16;
+    // First vertex and triangle of the segment in its thread group
+    uint  vertexOffset   : 16;
+    uint  triangleOffset : 16;
+};
+
+// Segments [firstSegment, firstSegment + segmentCount) of a DrawSegmentBundleRecord drawn by one thread group
+struct SegmentBundleGroup {
+    uint firstSegment  : 8;
+    uint segmentCount  : 8;
+    uint vertexCount   : 8;
+    uint triangleCount : 8;
+};
+
+struct DrawSegmentBundleRecord {
+    uint dispatchGrid : SV_DispatchGrid;
+    SegmentBundleGroup groups[maxCoalescedDrawSegmentRecords];
+    CoalescedSegment   segments[maxCoalescedDrawSegmentRecords];
+};
+
+CoalescedSegment CreateCoalescedSegment(
+    in const DrawSegmentRecord segmentRecord,
+    in const uint              vertexOffset,
+    in const uint              triangleOffset
+)
+{
+    CoalescedSegment segment;
+
+    segment.cage              = segmentRecord.cage;
+    segment.si                = segmentRecord.si;
+    segment.aoDistance        = segmentRecord.aoDistance;
+    segment.fromPoints        = segmentRecord.fromPoints;
+    segment.toPoints          = segmentRecord.toPoints;
+    segment.vPoints           = segmentRecord.vPoints;
+    segment.faceRingsPerGroup = segmentRecord.faceRingsPerGroup;
+    segment.fromOpeningAngle  = segmentRecord.fromOpeningAngle;
+    segment.toOpeningAngle    = segmentRecord.toOpeningAngle;
+    segment.vertexOffset      = vertexOffset;
+    segment.triangleOffset    = triangleOffset;
+
+    return segment;
+}
+
+DrawSegmentRecord GetDrawSegmentRecord(in const CoalescedSegment segment)
+{
+    DrawSegmentRecord segmentRecord;
+
+    segmentRecord.cage              = segment.cage;
+    segmentRecord.si                = segment.si;
+    segmentRecord.aoDistance        = segment.aoDistance;
+    segmentRecord.fromPoints        = segment.fromPoints;
+    segmentRecord.toPoints          = segment.toPoints;
+    segmentRecord.vPoints           = segment.vPoints;
+    segmentRecord.faceRingsPerGroup = segment.faceRingsPerGroup;
+    segmentRecord.fromOpeningAngle  = segment.fromOpeningAngle;
+    segmentRecord.toOpeningAngle    = segment.toOpeningAngle;
+    segmentRecord.dispatchGrid      = 1;
+
+    return segmentRecord;
+}
+
+// Packing of the coalesced records, see CoalesceDrawSegmentRecords
+groupshared uint               groupSegmentVertexCount[maxCoalescedDrawSegmentRecords];
+groupshared uint               groupSegmentTriangleCount[maxCoalescedDrawSegmentRecords];
+groupshared uint               groupSegmentVertexOffset[maxCoalescedDrawSegmentRecords];
+groupshared uint               groupSegmentTriangleOffset[maxCoalescedDrawSegmentRecords];
+groupshared SegmentBundleGroup groupSegmentBundleGroups[maxCoalescedDrawSegmentRecords];
+groupshared uint               groupSegmentBundleGroupCount;
+
+// Body of CoalesceDrawSegments[0] and [1]
+void CoalesceDrawSegmentRecords(
+    in const uint gtid,
+    GroupNodeInputRecords<DrawSegmentRecord> irs,
+    NodeOutput<DrawSegmentBundleRecord> output
+)
+{
+    const uint recordCount = irs.Count();
+    const bool hasRecord   = gtid < recordCount;
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::COALESCE_SEGMENT_GROUPS, 1);
+        AddStatistic(StatisticsCounter::COALESCE_SEGMENT_RECORDS, recordCount);
+    }
+
+    if (hasRecord) {
+        const SegmentGroupTessellation tessellation = GetSegmentGroupTessellation(irs.Get(gtid), 0);
+
+        groupSegmentVertexCount[gtid]   = tessellation.V;
+        groupSegmentTriangleCount[gtid] = tessellation.T;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Greedily fill mesh thread groups in record order
+    if (gtid == 0) {
+        SegmentBundleGroup group = (SegmentBundleGroup)0;
+        uint groupCount = 0;
+
+        for (uint i = 0; i < recordCount; ++i) {
+            const uint V = groupSegmentVertexCount[i];
+            const uint T = groupSegmentTriangleCount[i];
+
+            if ((group.vertexCount + V > maxNumVerticesPerGroup) || (group.triangleCount + T > maxNumTrianglesPerGroup)) {
+                groupSegmentBundleGroups[groupCount++] = group;
+
+                group               = (SegmentBundleGroup)0;
+                group.firstSegment  = i;
+            }
+
+            groupSegmentVertexOffset[i]   = group.vertexCount;
+            groupSegmentTriangleOffset[i] = group.triangleCount;
+
+            group.segmentCount  += 1;
+            group.vertexCount   += V;
+            group.triangleCount += T;
+        }
+
+        groupSegmentBundleGroups[groupCount++] = group;
+        groupSegmentBundleGroupCount           = groupCount;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    GroupNodeOutputRecords<DrawSegmentBundleRecord> outputRecord = output.GetGroupNodeOutputRecords(1);
+
+    if (gtid == 0) {
+        outputRecord.Get().dispatchGrid = groupSegmentBundleGroupCount;
+    }
+
+    if (gtid < groupSegmentBundleGroupCount) {
+        outputRecord.Get().groups[gtid] = groupSegmentBundleGroups[gtid];
+    }
+
+    if (hasRecord) {
+        outputRecord.Get().segments[gtid] =
+            CreateCoalescedSegment(irs.Get(gtid), groupSegmentVertexOffset[gtid], groupSegmentTriangleOffset[gtid]);
+    }
+
+    outputRecord.OutputComplete();
+}
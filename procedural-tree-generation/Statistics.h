@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Config.h"
+#include "TreeRoots.h"
+
+// ============================ Statistics ====================
+// Per-node counters in PersistentScratchBuffer, placed after the tree root table.
+// Nodes add to the counters of the current frame; EntryFunction moves them to the previous frame
+// at the start of every frame, which is what the UserInterface_Statistics_* nodes print.
+
+enum class StatisticsCounter : uint {
+    // TreeRoots: thread groups (one per visible chunk) and emitted trees
+    TREE_ROOTS_GROUPS = 0,
+    TREE_ROOTS_RECORDS,
+    // Trees dropped by occlusion culling
+    TREE_ROOTS_OCCLUDED_RECORDS,
+    // Trees occluded in the camera view, but inside the light frustum, that only emit their shadow records
+    TREE_ROOTS_SHADOW_ONLY_RECORDS,
+
+    // TreeInstance: thread groups and replayed template segment and leaf records
+    TREE_INSTANCE_GROUPS,
+    TREE_INSTANCE_RECORDS,
+
+    // Stem: thread groups and emitted records per output
+    STEM_GROUPS,
+    STEM_BRANCH_RECORDS,
+    STEM_SEGMENT_RECORDS,
+    STEM_SHADOW_SEGMENT_RECORDS,
+    STEM_LEAF_RECORDS,
+    // Records that continue a stem whose children or segments exceed the output budget of one group
+    STEM_CONTINUATION_RECORDS,
+    // Stem groups that exceeded a budget, but had no recursion level left for the continuation record,
+    // i.e. whose remaining children or segments are missing
+    STEM_DROPPED_CONTINUATION,
+    // Branch and leaf records dropped by subtree frustum culling
+    STEM_CULLED_RECORDS,
+    // Branch records dropped by occlusion culling, see Occlusion.h
+    STEM_OCCLUDED_RECORDS,
+    // Branch records occluded in the camera view, but inside the light frustum, whose subtree only emits its
+    // shadow records, see GenerateTreeRecord::isCameraOccluded
+    STEM_SHADOW_ONLY_RECORDS,
+
+    // Twig: thread groups and twig records; the segment, leaf and culled records of Twig count as Stem records
+    TWIG_GROUPS,
+    TWIG_RECORDS,
+
+    // CoalesceDrawLeaves[0..2]: thread groups and coalesced input records
+    COALESCE_LEAF_GROUPS,
+    COALESCE_LEAF_RECORDS,
+    // Leaf records drawn as cards in the camera view and in the shadow map, see IsLeafCard
+    COALESCE_LEAF_CAMERA_CARD_RECORDS,
+    COALESCE_LEAF_SHADOW_CARD_RECORDS,
+    COALESCE_BLOSSOM_GROUPS,
+    COALESCE_BLOSSOM_RECORDS,
+    COALESCE_FRUIT_GROUPS,
+    COALESCE_FRUIT_RECORDS,
+    // CoalesceDrawSegments[0..1] (camera and shadow): thread groups and coalesced input records
+    COALESCE_SEGMENT_GROUPS,
+    COALESCE_SEGMENT_RECORDS,
+
+    // Mesh nodes: thread groups and SetMeshOutputCounts; DrawSegmentBundle(Shadow) count as DrawSegment(Shadow)
+    STEM_MESH_GROUPS,
+    STEM_MESH_VERTICES,
+    STEM_MESH_TRIANGLES,
+    LEAF_MESH_GROUPS,
+    LEAF_MESH_VERTICES,
+    LEAF_MESH_TRIANGLES,
+    FRUIT_MESH_GROUPS,
+    FRUIT_MESH_VERTICES,
+    FRUIT_MESH_TRIANGLES,
+
+    // Depth-only shadow mesh nodes
+    STEM_SHADOW_MESH_GROUPS,
+    STEM_SHADOW_MESH_VERTICES,
+    STEM_SHADOW_MESH_TRIANGLES,
+    LEAF_SHADOW_MESH_GROUPS,
+    LEAF_SHADOW_MESH_VERTICES,
+    LEAF_SHADOW_MESH_TRIANGLES,
+
+    COUNT,
+};
+
+static const uint StatisticsCurrentFrameOffset  = TreeRootTableEnd;
+static const uint StatisticsPreviousFrameOffset = StatisticsCurrentFrameOffset + ((uint)StatisticsCounter::COUNT) * sizeof(uint);
+
+uint GetStatisticAddress(in uint frameOffset, in StatisticsCounter counter) {
+    return frameOffset + ((uint)counter) * sizeof(uint);
+}
+
+// Callers aggregate per wave/group before adding, i.e. one atomic per counter and thread group.
+void AddStatistic(in StatisticsCounter counter, in uint value) {
+    if (value > 0) {
+        PersistentScratchBuffer.InterlockedAdd(GetStatisticAddress(StatisticsCurrentFrameOffset, counter), value);
+    }
+}
+
+uint LoadStatistic(in StatisticsCounter counter) {
+    return PersistentScratchBuffer.Load<uint>(GetStatisticAddress(StatisticsCurrentFrameOffset, counter));
+}
+
+uint LoadPreviousStatistic(in StatisticsCounter counter) {
+    return PersistentScratchBuffer.Load<uint>(GetStatisticAddress(StatisticsPreviousFrameOffset, counter));
+}
+
+// Moves the counters of the last frame to the previous frame and resets the current frame.
+// Must run before any other node of the frame, i.e. in EntryFunction.
+void BeginStatisticsFrame() {
+    for (uint i = 0; i < (uint)StatisticsCounter::COUNT; ++i) {
+        const StatisticsCounter counter = (StatisticsCounter)i;
+
+        PersistentScratchBuffer.Store<uint>(GetStatisticAddress(StatisticsPreviousFrameOffset, counter), LoadStatistic(counter));
+        PersistentScratchBuffer.Store<uint>(GetStatisticAddress(StatisticsCurrentFrameOffset, counter), 0);
+    }
+}
@@ -0,0 +1,459 @@
+#pragma once
+
+#include "Config.h"
+#include "Records.h"
+#include "TreeModel.h"
+#include "LeafDensity.h"
+#include "TriangleBudget.h"
+
+// ============================ Stem Limits ======================
+
+// Output budget of a Stem thread group; broadcasting nodes may declare at most 256 records across all outputs.
+// Children (branches and leaves) share their budget with one continuation record, segments are limited
+// per view (camera and shadow map), including the small segments sent to CoalesceDrawSegments.
+// A group that exceeds a budget leaves the rest to a continuation record.
+static const int  maxChildRecords      = 128;
+static const int  maxChildrenPerGroup  = maxChildRecords - 1;
+static const int  maxSegmentRecords    = 64;
+
+// Stem recurses once per tree level below the trunk and once per continuation record. Continuations beyond
+// this depth are dropped (STEM_DROPPED_CONTINUATION).
+static const uint maxStemContinuations  = 4;
+static const uint stemMaxRecursionDepth = (TREE_MAX_LEVELS - 1) + maxStemContinuations;
+#if USING_SOFTWARE_ADAPTER
+// WARP is optimized for WaveSize(4), thus as we need wave intrinsics for the splitting/cloning of branches
+// we limit the number of clones to this lower wave size.
+static const uint maxClones = 4;
+#else
+static const uint maxClones = 32;
+#endif
+
+static const uint StemThreadGroupSize = maxClones;
+
+// ============================ Subtree Bounds ======================
+
+// Upper bound of the extent of leaves, blossoms and fruits, measured from the axis of their parent stem.
+float GetMaxLeafReach(in const TreeParameters params, in const float parentRadius){
+    // Leaves sit at up to radiusParent / sqrt(1 - 0.95^2) from the axis (see Stem); the flare widens the trunk base
+    const float maxOffset    = parentRadius * (1 + params.Flare) * 3.21;
+    const float maxStemLen   = max(params.Leaf.StemLen, params.Blossom.StemLen);
+    // Leaves grow by up to ComputeChildScale() <= 5 with distance; leaf and fruit meshes stay within twice their scale
+    const float maxLeafScale = 5 * max(max(params.Leaf.Scale, params.Blossom.Scale), params.Fruit.Size);
+
+    return maxOffset + maxStemLen + 2 * maxLeafScale;
+}
+
+// Radius of a sphere around the base of a stem that contains the stem and everything generated from it.
+// Every point of a stem is at most its length away from its base, no matter how curvature, splits,
+// vertical attraction and wind bend it. Child stems are at most nLength + nLengthV times as long as their parent.
+float GetMaxSubtreeReach(in const TreeParameters params, in const int level, in const float length, in const float radius){
+    float reach       = length;
+    float levelLength = length;
+
+    for (int childLevel = level + 1; childLevel < params.Levels; ++childLevel) {
+        levelLength *= params.nLength[childLevel] + abs(params.nLengthV[childLevel]);
+        reach       += levelLength;
+    }
+
+    return reach + GetMaxLeafReach(params, radius);
+}
+
+// ============================ Tree LOD ======================
+// Stems of distant trees (GenerateTreeRecord::lod > 0) take fewer curve steps per branch and are tessellated
+// coarser; GetTreeLodBranchCount also drops branches. The trunk keeps its curve resolution, as it dominates
+// the silhouette of the tree.
+
+float GetTreeLodCurveResolution(in const TreeParameters params, in const uint level, in const uint lod){
+    const float curveResolution = clamp(params.nCurveRes[level], 1, 32);
+
+    return (level == 0) ? curveResolution : max(1, ceil(curveResolution / (1u << lod)));
+}
+
+// Splits per curve step that keep the expected number of splits of the full curve resolution
+float GetTreeLodSegmentSplits(in const TreeParameters params, in const uint level, in const float curveResolution){
+    return params.nSegSplits[level] * clamp(params.nCurveRes[level], 1, 32) / curveResolution;
+}
+
+float GetTreeLodPixelsPerTriangleScale(in const uint lod){
+    return 1u << lod;
+}
+
+// Target triangle size of the stem segments of a tree; increases with distance, tree LOD and the triangle budget
+float GetStemPixelsPerTriangle(in const float distanceToCamera, in const uint lod){
+#if USING_SOFTWARE_ADAPTER
+    const float pixelsPerTriangle = 16.f;
+#else
+    const float pixelsPerTriangle = 4.f;
+#endif
+
+    return pixelsPerTriangle * MapRange(distanceToCamera, 30.f, 60.f, 1.f, 4.f) * GetTreeLodPixelsPerTriangleScale(lod) *
+           GetTriangleBudgetPixelsPerTriangleScale();
+}
+
+// ============================ Generation Functions ======================
+
+// Weber-Penn Section 4.1
+float GetStemCurve(in const TreeParameters params, in const uint level, in const float curveResolution, in const uint segmentSeed, in const float z){
+    // NOT IMPLEMENTED: Helix
+
+    float rotateX = (params.nCurveV[level] / curveResolution) * random::SignedRandom(segmentSeed, 6);
+    if(params.nCurveBack[level] == 0){
+        rotateX += params.nCurve[level] / curveResolution;
+    }else{
+        const float resh = curveResolution / 2;
+        const float alpha = MapRange(z, 0.4f, 0.6f, 0.f, 1.f);
+        const float curve = lerp(params.nCurve[level], params.nCurveBack[level], alpha);
+        rotateX += curve/resh;
+    }
+    return rotateX;
+}
+
+// Weber-Penn Section 4.2
+void AddSplitSpread(in const SegmentInfo si, in const TreeParameters params, in const uint segmentSeed, in const int step, inout float4 rot, inout float splitCorrection){
+    float declination = degrees(acos(qGetZ(rot).y));
+    float splitAngle = params.nSplitAngle[si.level] + params.nSplitAngleV[si.level] * random::SignedRandom(segmentSeed, 0xFA) - declination;
+    splitAngle = max(0, splitAngle);
+
+    int remainingSegments = params.nCurveRes[si.level] - step - 1;
+    splitCorrection -= splitAngle / remainingSegments;
+
+    rot = qMul(rot, qRotateX(radians(splitAngle)));
+
+    declination = degrees(acos(qGetZ(rot).y));
+    float spreadAngle = 20 + 0.75 * (30 + abs(declination - 90));
+    float r = random::Random(segmentSeed, 900);
+    spreadAngle *= r * r;
+    if(random::Random(segmentSeed, step, 2) < .5) spreadAngle = -spreadAngle;
+
+    rot = qMul(qRotateY(radians(spreadAngle)), rot);
+}
+
+// Weber-Penn Section 4.8; attraction of the stems of a level, 0 leaves them unchanged
+float GetVerticalAttractionUp(in const int level, in const TreeParameters params){
+    float attractionUp = 0;
+
+    if(level > 1) attractionUp += LoadPersistentConfigFloat(PersistentConfig::TREE_ATTRACTION_UP);
+
+    static const float t = 0.2;
+
+    const float d = 2 - abs(GetSeason() - 2);
+    attractionUp += min(0, d*d/t-t);
+
+    if(level > 0 && params.Fruit.Chance > 0){
+        float level_factor = 1. / pow(4., params.Levels - level - 1);
+        float fruitProgress = GetGeneralSeasonFruitProgress(GetSeason());
+        if(GetSeason() > 3.2){
+            fruitProgress = MapRange<float>(GetSeason(), 3.2, 3.3, 1, 0);
+        }
+        const float fruitScale = GetFruitScale(fruitProgress);
+        float size = 15 * params.Fruit.Size * fruitScale;
+        float volume = size * size * size;
+        // weight should grow cubic with the size
+        attractionUp -= level_factor * params.Blossom.Count * params.Fruit.Chance * volume;
+    }
+
+    return attractionUp;
+}
+
+// Weber-Penn Section 4.8
+void AddVerticalAttraction(in const int level, in const TreeParameters params, in float curveResolution, inout float4 rot){
+    const float attractionUp = GetVerticalAttractionUp(level, params);
+
+    float3 axis = qGetZ(rot);
+    float declination = acos(axis.y);
+
+    if(attractionUp != 0 && axis.y < .9999){
+        float c = saturate(MapRange<float>(axis.y, 1, .95, 0, 1)); // -1 dot problem correction
+        float curveUpSegment = attractionUp * abs(declination * sin(declination)) / curveResolution;
+        axis = normalize(float3(-axis.z, 0, axis.x));
+        if(any(axis != 0)){
+            rot = qMul(qRotateAxisAngle(axis, curveUpSegment*c), rot);
+        }
+    }
+}
+
+// Weber-Penn Section 4.1; rotation of curve step "step", right-multiplied to the rotation of the previous step
+float4 GetStemStepRotation(
+    in const TreeParameters params,
+    in const uint           level,
+    in const float          curveResolution,
+    in const uint           segmentSeed,
+    in const float          fromZ,
+    in const float          splitCorrection)
+{
+    if(params.nCurveV[level] >= 0){
+        const float stemCurve = GetStemCurve(params, level, curveResolution, segmentSeed, fromZ);
+        return qRotateX(radians(stemCurve + splitCorrection));
+    }else{ // helix
+        return qMul(qRotateX(radians(abs(params.nCurveV[level])) / curveResolution), qRotateZ(radians(360) / curveResolution));
+    }
+}
+
+// Quantized z at the start of curve step "step", like SegmentInfo::fromZ of that step
+float GetStemStepZ(in const uint step, in const float curveResolution){
+    return SegmentInfo::DecodeZ(SegmentInfo::EncodeZ(step / curveResolution));
+}
+
+// ============================ Stem Curve Scan ======================
+// Splits, vertical attraction and wind sway rotate a stem depending on its current direction; without them,
+// the rotation of every curve step only depends on the step (GetStemStepRotation). Step i of such a stem then
+// ends at rot * r_0 * ... * r_i, and Stem computes all steps at once instead of one after the other: lane i
+// builds r_i, a wave prefix product composes the rotations in log2(steps) rounds, and a wave prefix sum adds up
+// the segment vectors to the positions (see GenerateStem).
+
+// Whether a stem never splits. With no segment splits, the split error keeps its initial value.
+bool IsStemSplitFree(
+    in const TreeParameters params,
+    in const uint           level,
+    in const float          segmentSplits,
+    in const float          splitError)
+{
+    return (segmentSplits == 0) && (params.nBaseSplits[level] == 0) && (round(splitError) <= 0);
+}
+
+// Whether the stem has no splits (see the split error in GenerateStem), no vertical attraction and no wind sway,
+// and fits one step per lane
+bool IsStemCurveScannable(
+    in const TreeParameters params,
+    in const uint           level,
+    in const float          curveResolution,
+    in const float          segmentSplits,
+    in const float          splitError,
+    in const bool           isWindFree)
+{
+    return IsStemSplitFree(params, level, segmentSplits, splitError) && isWindFree &&
+           (GetVerticalAttractionUp(level, params) == 0) && (curveResolution <= StemThreadGroupSize);
+}
+
+// ============================ Twigs ======================
+// Stems of the last branch level (twigs) only emit their segments and leaves. Most of them are short and
+// split-free, so a Stem group of StemThreadGroupSize lanes leaves most of its lanes idle, and Apple alone grows
+// up to 100 twigs per branch. Stem sends such twigs to the coalescing Twig node instead, which packs
+// TwigThreadGroupSize of them into one group and grows one twig per lane (see GenerateTwig).
+// Twigs with more curve steps or leaves than the budget of a lane stay with Stem.
+
+// Twig groups run in one wave like Stem groups
+static const uint TwigThreadGroupSize   = min(8u, StemThreadGroupSize);
+static const uint maxTwigSegments       = 5;
+static const uint maxTwigLeaves         = 20;
+// Per view, like maxSegmentRecords; together with the leaves 240 records per group at most
+static const uint maxTwigSegmentRecords = TwigThreadGroupSize * maxTwigSegments;
+static const uint maxTwigLeafRecords    = TwigThreadGroupSize * maxTwigLeaves;
+
+// Whether the Twig node grows a stem with the given level, LOD and number of children at the given
+// distance to the camera (0 for templates). Leaves are thinned out like in Stem, see GetNthChildIndexAndScale.
+bool IsTwig(
+    in const TreeParameters params,
+    in const uint           level,
+    in const uint           lod,
+    in const uint           children,
+    in const float          distanceToCamera,
+    in const bool           isTemplate)
+{
+    const float curveResolution = GetTreeLodCurveResolution(params, level, lod);
+    const float segmentSplits   = GetTreeLodSegmentSplits(params, level, curveResolution);
+    const uint  leaves          = ceil(children * ComputeChildDensity(distanceToCamera, isTemplate));
+
+    return (level == uint(params.Levels - 1)) && (level > 0) &&
+           IsStemSplitFree(params, level, segmentSplits, -params.nSegSplitBaseOffset[level]) &&
+           (curveResolution <= maxTwigSegments) && (leaves <= maxTwigLeaves);
+}
+
+float2 GetWindBend(in const SegmentInfo si, in const TreeParameters params, in const int step){
+    static const float wind_speed = .5;
+    static const float wind_gust = .25;
+
+    const float z = float(step) / params.nCurveRes[si.level];
+
+    float a0 = 4 * si.length * (1-z) / GetTaperedRadius(si, params, z);
+    float a1 = wind_speed / 50 * a0;
+    float a2 = wind_gust  / 50 * a0 + a1 * .5;
+    a1 = radians(a1);
+    a2 = radians(a2);
+
+    return float2(a1, a2);
+}
+
+float3 GetWindVector(){
+    float dir = GetWindDirection();
+    return float3(-cos(dir),0,sin(dir));
+}
+
+// Gust noise at position for a stem of the given length; moves along the wind direction over time
+float GetWindForcePhase(in const float3 position, in const float length){
+    float3 windDir = GetWindVector();
+
+    float frequency = 2 / sqrt(length);
+    frequency = min(frequency, 5);
+    return 0.4 + random::PerlinNoise2D(position.xz * .75 - Time * frequency * windDir.xz * max(.8, GetWindStrength() * .06) );
+}
+
+// Weber-Penn Section 4.7
+void AddWindSway(in const float radius, in const float length, in const int curveRes, in const float3 position, inout float4 rot){
+    float3 windDir = GetWindVector();
+
+    float3 zAxis = qGetZ(rot);
+    float d = dot(zAxis, windDir);
+    float fullAngle = acos(d);
+    float3 rotAxis = normalize(cross(zAxis, windDir));
+
+    float c = saturate(MapRange<float>(d, -1, -.95, 0, 1)); // -1 dot problem correction
+
+    float angle = fullAngle * GetWindStrength() * 0.003 / max(radius, 0.03) * c / curveRes;
+
+    float forcePhase = GetWindForcePhase(position, length);
+
+    float4 r = qRotateAxisAngle(rotAxis, angle * forcePhase);
+    rot = qMul(r, rot);
+}
+
+// ============================ Tree Wind ====================
+// Template trees (see TreeTemplates.h) are generated without AddWindSway, so they do not depend on Time and are
+// only regenerated when the generation settings change. TreeInstance bends every instance instead: points move
+// along the wind direction with the square of their height above the root, which keeps segments and leaves that
+// share a point connected, and stem frames tilt with the slope of that offset. The gust noise is sampled at the
+// root, so neighboring instances of a template sway out of phase.
+
+static const float treeWindBendScale = 0.006;
+// Bound of |GetWindForcePhase|
+static const float maxWindForcePhase = 1.4;
+
+struct TreeWind {
+    float3 root;
+    float  radius;
+    float3 direction;
+    // Offset at the top of the bounding sphere, relative to its radius
+    float  bend;
+};
+
+TreeWind GetTreeWind(in const float3 root, in const float radius){
+    TreeWind wind;
+    wind.root      = root;
+    wind.radius    = radius;
+    wind.direction = GetWindVector();
+    wind.bend      = GetWindStrength() * treeWindBendScale * GetWindForcePhase(root, radius);
+    return wind;
+}
+
+// Bound of the offset of ApplyTreeWind for a tree with the given bounding sphere radius
+float GetMaxTreeWindOffset(in const float radius){
+    return abs(GetWindStrength()) * treeWindBendScale * maxWindForcePhase * radius;
+}
+
+TreeTransform ApplyTreeWind(in const TreeWind wind, in const TreeTransform trafo){
+    const float  height = saturate((trafo.pos.y - wind.root.y) / wind.radius);
+    const float3 axis   = normalize(cross(float3(0, 1, 0), wind.direction));
+
+    TreeTransform result;
+    result.pos = trafo.pos + wind.direction * (wind.bend * height * height * wind.radius);
+    // Slope of the offset over the height
+    result.rot = qMul(qRotateAxisAngle(axis, atan(2 * wind.bend * height)), trafo.rot);
+    return result;
+}
+
+// Weber-Penn Section 4.3
+float4 GetChildDownRotation(in const SegmentInfo si, in const TreeParameters params, in const uint seed, in const float ratio){
+    const int nextLevelClamped = min(si.level + 1, 3);
+
+    float downAngleV = params.nDownAngleV[nextLevelClamped];
+    float downAngle = downAngleV * random::Random(seed, 1998);
+    if(asuint(downAngleV) & 0x80000000U) {
+        downAngle *= (1 - 2 * ShapeRatio(0, ratio));
+    }
+    downAngle += params.nDownAngle[nextLevelClamped];
+    return qRotateX(radians(downAngle));
+}
+
+// Weber-Penn Section 4.3
+float GetChildparentZAngle(in const SegmentInfo si, in const TreeParameters params, in const uint seed, in const int branchIdx){
+    const int nextLevelClamped = min(si.level + 1, 3);
+
+    const float rotate = params.nRotate[nextLevelClamped];
+    const float rotateV = params.nRotateV[nextLevelClamped];
+    if(!(asuint(rotate) & 0x80000000U)) {
+        float angle = rotateV * random::SignedRandom(seed, 50);
+        // FIXME - this is does not account for the random rotation of the previous branches, do we care?
+        float angleSum = branchIdx * rotate + angle;
+        return radians(angleSum);
+    }
+    return BitSign(branchIdx, 0) * radians(180 - rotate + rotateV * random::SignedRandom(seed, 50));
+}
+
+void AddFruitWeight(inout float4 childRotation, in const float p){
+    float3 childZ = qGetZ(childRotation);
+    if(childZ.y != -1){
+        float3 axis = float3(childZ.z, 0, -childZ.x); // equivalent to cross(childZ, float3(0, -1, 0))
+        float angle = acos(clamp(-childZ.y, -1, 1));  // equivalent to acos(clamp(dot(childZ, float3(0, -1, 0)), ...
+        float4 r = qRotateAxisAngle(axis, angle * p);
+        childRotation = qMul(r, childRotation);
+    }
+}
+
+// Leaf, blossom or fruit of a last-level stem, see GetStemLeaf
+struct StemLeaf {
+    float3 position;
+    float4 rotation;
+    float  scale;
+    bool   isFruit;
+    // Node of the CoalesceDrawLeaves node array: 0 = leaf, 1 = blossom, 2 = fruit
+    uint   outputArrayIndex;
+};
+
+// Weber-Penn Section 4.4; child "stemChildIndex" of a last-level stem at z, on the stem axis at position with rotation
+// rotParent. scale is the density compensation of the leaf, see ComputeChildDensityAndScale and GetNthChildIndexAndScale.
+StemLeaf GetStemLeaf(
+    in const SegmentInfo    si,
+    in const TreeParameters params,
+    in const uint           childSeed,
+    in const uint           stemChildIndex,
+    in const float          z,
+    in const float          ratio,
+    in const float          scale,
+    in const float3         position,
+    in const float4         rotParent,
+    in const bool           isTemplate)
+{
+    const bool  isLeafBlossom = IsLeafBlossom(params, childSeed);
+    const float fruitProgress = GetSeasonFruitProgress(childSeed);
+    const float fruitScale    = GetFruitScale(fruitProgress);
+
+    StemLeaf leaf;
+    leaf.isFruit = isLeafBlossom && (random::Random(childSeed, stemChildIndex) < params.Fruit.Chance) && fruitProgress > 0;
+
+    const LeafParameters leafParams = GetLeafParameters(params, isLeafBlossom);
+
+    // Compute scale based on child index
+    const float baseScale = leafParams.Scale * ShapeRatio(leafParams.ScaleShape, 1.f - z) * scale;
+    leaf.scale = leafParams.IsNeedle ?
+        // Needles are not scaled by season
+        baseScale :
+        (
+            leaf.isFruit ?
+                scale * params.Fruit.Size * fruitScale :
+                baseScale * GetSeasonLeafScale(childSeed, isLeafBlossom)
+        );
+
+    const float3 parentZ = qGetZ(rotParent);
+
+    leaf.rotation = qMul(qRotateAxisAngle(parentZ, GetChildparentZAngle(si, params, childSeed, stemChildIndex)),
+                         qMul(rotParent, GetChildDownRotation(si, params, childSeed, ratio)));
+
+    // Apply gravity to fruit
+    if (leaf.isFruit) {
+        AddFruitWeight(leaf.rotation, params.Fruit.DownForce * fruitScale);
+    }
+
+    // Compute child position on surface of spline segment
+    const float3 childZ = qGetZ(leaf.rotation);
+    const float  d      = clamp(dot(childZ, parentZ), .05, .95);
+    leaf.position = position + childZ * (GetTaperedRadius(si, params, z) / sqrt(1 - d * d) + leafParams.StemLen);
+
+    // Apply wind animation to leaves; TreeInstance sways template leaves
+    if (!leaf.isFruit && !isTemplate) {
+        AddWindSway(0.03, leafParams.Scale, 1, leaf.position, leaf.rotation);
+    }
+
+    leaf.outputArrayIndex = isLeafBlossom ? (leaf.isFruit ? 2 : 1) : 0;
+
+    return leaf;
+}
@@ -5,204 +5,104 @@
 #include "Camera.h"
 #include "LeafDensity.h"
 #include "SplineTessellation.h"
+#include "StemGrowth.h"
+#include "Statistics.h"
+#include "Shadow.h"
+#include "TreeTemplates.h"
 
 
-// ============================ Generation Functions ======================
-
-// Weber-Penn Section 4.1
-float GetStemCurve(in const TreeParameters params, in const uint level, in const float curveResolution, in const uint segmentSeed, in const float z){
-    // NOT IMPLEMENTED: Helix
-
-    float rotateX = (params.nCurveV[level] / curveResolution) * random::SignedRandom(segmentSeed, 6);
-    if(params.nCurveBack[level] == 0){
-        rotateX += params.nCurve[level] / curveResolution;
-    }else{
-        const float resh = curveResolution / 2;
-        const float alpha = MapRange(z, 0.4f, 0.6f, 0.f, 1.f);
-        const float curve = lerp(params.nCurve[level], params.nCurveBack[level], alpha);
-        rotateX += curve/resh;
-    }
-    return rotateX;
-}
-
-// Weber-Penn Section 4.2
-void AddSplitSpread(in const SegmentInfo si, in const TreeParameters params, in const uint segmentSeed, in const int step, inout float4 rot, inout float splitCorrection){
-    float declination = degrees(acos(qGetZ(rot).y));
-    float splitAngle = params.nSplitAngle[si.level] + params.nSplitAngleV[si.level] * random::SignedRandom(segmentSeed, 0xFA) - declination;
-    splitAngle = max(0, splitAngle);
-
-    int remainingSegments = params.nCurveRes[si.level] - step - 1;
-    splitCorrection -= splitAngle / remainingSegments;
+groupshared TreeTransform groupCloneTrafo[maxClones];
+groupshared TreeTransform groupClonePreTrafo[maxClones];
 
-    rot = qMul(rot, qRotateX(radians(splitAngle)));
+// Sends a stem segment to the camera and the shadow mesh nodes; segments that fill only a fraction of a mesh thread
+// group are packed by CoalesceDrawSegments. Used by the Stem and the TreeInstance nodes.
+void OutputDrawSegment(
+    in const bool hasVisibleDrawOutput,
+    in const DrawSegmentRecord segmentRecord,
+    in const bool hasShadowDrawOutput,
+    in const DrawSegmentRecord shadowSegmentRecord,
+    NodeOutput<DrawSegmentRecord> drawSegmentOutput,
+    NodeOutput<DrawSegmentRecord> drawSegmentShadowOutput,
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentOutput,
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentShadowOutput
+)
+{
+    const bool isCoalescedSegment       = hasVisibleDrawOutput && IsCoalescedSegment(segmentRecord);
+    const bool isCoalescedShadowSegment = hasShadowDrawOutput && IsCoalescedSegment(shadowSegmentRecord);
 
-    declination = degrees(acos(qGetZ(rot).y));
-    float spreadAngle = 20 + 0.75 * (30 + abs(declination - 90));
-    float r = random::Random(segmentSeed, 900);
-    spreadAngle *= r * r;
-    if(random::Random(segmentSeed, step, 2) < .5) spreadAngle = -spreadAngle;
+    ThreadNodeOutputRecords<DrawSegmentRecord> drawSegmentOutputRecord =
+        drawSegmentOutput.GetThreadNodeOutputRecords(hasVisibleDrawOutput && !isCoalescedSegment);
 
-    rot = qMul(qRotateY(radians(spreadAngle)), rot);
-}
+    if (hasVisibleDrawOutput && !isCoalescedSegment) {
+        drawSegmentOutputRecord.Get() = segmentRecord;
+    }
 
-// Weber-Penn Section 4.8
-void AddVerticalAttraction(in const int level, in const TreeParameters params, in float curveResolution, inout float4 rot){
-    float attractionUp = 0;
+    drawSegmentOutputRecord.OutputComplete();
 
-    if(level > 1) attractionUp += LoadPersistentConfigFloat(PersistentConfig::TREE_ATTRACTION_UP);
+    ThreadNodeOutputRecords<DrawSegmentRecord> coalesceDrawSegmentOutputRecord =
+        coalesceDrawSegmentOutput.GetThreadNodeOutputRecords(isCoalescedSegment);
 
-    float3 axis = qGetZ(rot);
-    float declination = acos(axis.y);
+    if (isCoalescedSegment) {
+        coalesceDrawSegmentOutputRecord.Get() = segmentRecord;
+    }
 
-    static const float t = 0.2;
+    coalesceDrawSegmentOutputRecord.OutputComplete();
 
-    const float d = 2 - abs(GetSeason() - 2);
-    attractionUp += min(0, d*d/t-t);
+    ThreadNodeOutputRecords<DrawSegmentRecord> drawSegmentShadowOutputRecord =
+        drawSegmentShadowOutput.GetThreadNodeOutputRecords(hasShadowDrawOutput && !isCoalescedShadowSegment);
 
-    if(level > 0 && params.Fruit.Chance > 0){
-        float level_factor = 1. / pow(4., params.Levels - level - 1);
-        float fruitProgress = GetGeneralSeasonFruitProgress(GetSeason());
-        if(GetSeason() > 3.2){
-            fruitProgress = MapRange<float>(GetSeason(), 3.2, 3.3, 1, 0);
-        }
-        const float fruitScale = GetFruitScale(fruitProgress);
-        float size = 15 * params.Fruit.Size * fruitScale;
-        float volume = size * size * size;
-        // weight should grow cubic with the size
-        attractionUp -= level_factor * params.Blossom.Count * params.Fruit.Chance * volume;
+    if (hasShadowDrawOutput && !isCoalescedShadowSegment) {
+        drawSegmentShadowOutputRecord.Get() = shadowSegmentRecord;
     }
 
-    if(attractionUp != 0 && axis.y < .9999){
-        float c = saturate(MapRange<float>(axis.y, 1, .95, 0, 1)); // -1 dot problem correction
-        float curveUpSegment = attractionUp * abs(declination * sin(declination)) / curveResolution;
-        axis = normalize(float3(-axis.z, 0, axis.x));
-        if(any(axis != 0)){
-            rot = qMul(qRotateAxisAngle(axis, curveUpSegment*c), rot);
-        }
-    }
-}
-
-float2 GetWindBend(in const SegmentInfo si, in const TreeParameters params, in const int step){
-    static const float wind_speed = .5;
-    static const float wind_gust = .25;
+    drawSegmentShadowOutputRecord.OutputComplete();
 
-    const float z = float(step) / params.nCurveRes[si.level];
+    ThreadNodeOutputRecords<DrawSegmentRecord> coalesceDrawSegmentShadowOutputRecord =
+        coalesceDrawSegmentShadowOutput.GetThreadNodeOutputRecords(isCoalescedShadowSegment);
 
-    float a0 = 4 * si.length * (1-z) / GetTaperedRadius(si, params, z);
-    float a1 = wind_speed / 50 * a0;
-    float a2 = wind_gust  / 50 * a0 + a1 * .5;
-    a1 = radians(a1);
-    a2 = radians(a2);
+    if (isCoalescedShadowSegment) {
+        coalesceDrawSegmentShadowOutputRecord.Get() = shadowSegmentRecord;
+    }
 
-    return float2(a1, a2);
+    coalesceDrawSegmentShadowOutputRecord.OutputComplete();
 }
 
-// Weber-Penn Section 4.7
-void AddWindSway(in const float radius, in const float length, in const int curveRes, in const float3 position, inout float4 rot){
-    float dir = GetWindDirection();
-    float3 windDir = float3(-cos(dir),0,sin(dir));
-
-    float3 zAxis = qGetZ(rot);
-    float d = dot(zAxis, windDir);
-    float fullAngle = acos(d);
-    float3 rotAxis = normalize(cross(zAxis, windDir));
-
-    float c = saturate(MapRange<float>(d, -1, -.95, 0, 1)); // -1 dot problem correction
+// Inclusive prefix product q_0 * ... * q_lane of the quaternions of the Stem wave, in log2(StemThreadGroupSize) rounds
+float4 WavePrefixProductq(in float4 q) {
+    const uint lane = WaveGetLaneIndex();
 
-    float angle = fullAngle * GetWindStrength() * 0.003 / max(radius, 0.03) * c / curveRes;
+    for (uint offset = 1; offset < StemThreadGroupSize; offset *= 2) {
+        const float4 previous = WaveReadLaneAt(q, (lane >= offset) ? (lane - offset) : lane);
 
-    float frequency = 2 / sqrt(length);
-    frequency = min(frequency, 5);
-    float forcePhase = 0.4 + random::PerlinNoise2D(position.xz * .75 - Time * frequency * windDir.xz * max(.8, GetWindStrength() * .06) );
-
-    float4 r = qRotateAxisAngle(rotAxis, angle * forcePhase);
-    rot = qMul(r, rot);
-}
-
-// Weber-Penn Section 4.3
-float4 GetChildDownRotation(in const SegmentInfo si, in const TreeParameters params, in const uint seed, in const float ratio){
-    const int nextLevelClamped = min(si.level + 1, 3);
-
-    float downAngleV = params.nDownAngleV[nextLevelClamped];
-    float downAngle = downAngleV * random::Random(seed, 1998);
-    if(asuint(downAngleV) & 0x80000000U) {
-        downAngle *= (1 - 2 * ShapeRatio(0, ratio));
-    }
-    downAngle += params.nDownAngle[nextLevelClamped];
-    return qRotateX(radians(downAngle));
-}
-
-// Weber-Penn Section 4.3
-float GetChildparentZAngle(in const SegmentInfo si, in const TreeParameters params, in const uint seed, in const int branchIdx){
-    const int nextLevelClamped = min(si.level + 1, 3);
-
-    const float rotate = params.nRotate[nextLevelClamped];
-    const float rotateV = params.nRotateV[nextLevelClamped];
-    float theta = 0;
-    if(!(asuint(rotate) & 0x80000000U)) {
-        float angle = rotateV * random::SignedRandom(seed, 50);
-        // FIXME - this is does not account for the random rotation of the previous branches, do we care?
-        float angleSum = branchIdx * rotate + angle;
-        return radians(angleSum);
+        if (lane >= offset) {
+            q = qMul(previous, q);
+        }
     }
-    return BitSign(branchIdx, 0) * radians(180 - rotate + rotateV * random::SignedRandom(seed, 50));
-}
 
-void AddFruitWeight(inout float4 childRotation, in const float p){
-    float3 childZ = qGetZ(childRotation);
-    if(childZ.y != -1){
-        float3 axis = float3(childZ.z, 0, -childZ.x); // equivalent to cross(childZ, float3(0, -1, 0))
-        float angle = acos(clamp(-childZ.y, -1, 1));  // equivalent to acos(clamp(dot(childZ, float3(0, -1, 0)), ...
-        float4 r = qRotateAxisAngle(axis, angle * p);
-        childRotation = qMul(r, childRotation);
-    }
+    return q;
 }
 
-
-
-static const int  maxChildRecords = 128;
-static const int  maxSegmentRecords = 128;
-#if USING_SOFTWARE_ADAPTER
-// WARP is optimized for WaveSize(4), thus as we need wave intrinsics for the splitting/cloning of branches
-// we limit the number of clones to this lower wave size.
-static const uint maxClones = 4;
-#else
-static const uint maxClones = 32;
-#endif
-
-static const uint StemThreadGroupSize = maxClones;
-
-groupshared TreeTransform groupCloneTrafo[maxClones];
-groupshared TreeTransform groupClonePreTrafo[maxClones];
-
-[Shader("node")]
-[NodeLaunch("broadcasting")]
-[NodeMaxRecursionDepth(3)]
-[NodeDispatchGrid(1, 1, 1)]
-[NumThreads(StemThreadGroupSize, 1, 1)]
-void Stem(
-    uint gtid : SV_GroupThreadId,
-    DispatchNodeInputRecord<GenerateTreeRecord> ir,
-
-    [MaxRecords(maxChildRecords)]
-    [NodeId("Stem")]
+// Body of the Stem nodes. Every tree type has its own Stem node in the "Stem" node array (see STEM_NODE in
+// ProceduralTreeGeneration.hlsl), which calls this function with a literal tree type, such that
+// GetTreeParameters(treeType) folds to constants and loops over e.g. curveResolution and nBranches are specialized
+// per tree type.
+void GenerateStem(
+    in const uint treeType,
+    in const uint gtid,
+    in GenerateTreeRecord inputRecord,
     NodeOutput<GenerateTreeRecord> generateTreeOutput,
-
-    [MaxRecordsSharedWith(generateTreeOutput)]
-    [NodeId("CoalesceDrawLeaves")]
-    [NodeArraySize(3)]
+    NodeOutput<GenerateTreeRecord> twigOutput,
     NodeOutputArray<DrawLeafRecord> drawLeafOutput,
-
-    [MaxRecords(maxSegmentRecords)]
-    [NodeId("DrawSegment")]
-    NodeOutput<DrawSegmentRecord> drawSegmentOutput
+    NodeOutput<DrawSegmentRecord> drawSegmentOutput,
+    NodeOutput<DrawSegmentRecord> drawSegmentShadowOutput,
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentOutput,
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentShadowOutput
 )
 {
-    const GenerateTreeRecord inputRecord = ir.Get();
-    const TreeParameters     params      = GetTreeParameters();
+    const TreeParameters params = GetTreeParameters(treeType);
 
     SegmentInfo si;
-    si.level        = 3 - GetRemainingRecursionLevels();
+    si.level        = inputRecord.level;
     si.length       = inputRecord.length;
     si.radius       = inputRecord.radius;
     si.fromZ        = 0;
@@ -212,30 +112,50 @@ void Stem(
     const int   nextLevel        = si.level + 1;
     const int   nextLevelClamped = min(nextLevel, params.Levels - 1);
 
-    const float distanceToCamera = distance(GetCameraPosition(), inputRecord.trafo.GetPos());
+    // Child records are positioned relative to the root of the same tree
+    const uint     treeIndex = inputRecord.trafo.GetTreeIndex();
+    const TreeRoot root      = LoadTreeRoot(treeIndex);
+
+    // Template trees are not culled and generated at full detail, their instances are culled by TreeInstance
+    const bool isTemplate = inputRecord.isTemplate;
+
+    const float distanceToCamera = isTemplate ? 0.f : distance(GetCameraPosition(), inputRecord.trafo.GetPos(root));
+
+    // Segments and leaves are culled against both views; records inside the light frustum
+    // are sent to the shadow mesh nodes as well
+    const ViewParameters cameraView    = GetCameraView();
+    const ViewParameters shadowView    = GetShadowView();
+    // Segments and branches are culled against the depth of an earlier frame as well, in the camera view only
+    const OcclusionView  occlusionView = GetOcclusionView();
+
+    // Stems of subtrees occluded in the camera view, but inside the light frustum, only emit their shadow records
+    const bool isCameraOccluded = inputRecord.isCameraOccluded;
 
     // Constants
-    const float  curveResolution = clamp(params.nCurveRes[si.level], 1, 32);
+    const float  curveResolution = GetTreeLodCurveResolution(params, si.level, inputRecord.lod);
     const uint   stemSeed        = inputRecord.seed;
-    const float  segmentSplits   = params.nSegSplits[si.level];
-    // random angles in radians for wind sway
-    const float2 swayOffset      = float2(random::SignedRandom(inputRecord.seed, 'x'), random::SignedRandom(inputRecord.seed, 'y')) * PI;
-
-    const uint children = min(inputRecord.children, maxChildRecords);
+    const float  segmentSplits   = GetTreeLodSegmentSplits(params, si.level, curveResolution);
+
+    // This group handles children [firstChild, childEnd) and segments [firstSegment, segmentEnd);
+    // the remaining ones are continued by another Stem group.
+    const uint children     = inputRecord.children;
+    const uint childEnd     = min(children, inputRecord.firstChild + maxChildrenPerGroup);
+    const uint firstSegment = inputRecord.firstSegment;
+    const uint segmentEnd   = firstSegment + maxSegmentRecords;
     float childDensity  = 1.f;
     float childScale    = 1.f;
 
     if (si.level == (params.Levels - 1)) {
         // We reduce the childDensity, i.e., number of leaves (children in last level) based on the distance to camera.
         // To compensate, we increase the size of the leaves.
-        ComputeChildDensityAndScale(distanceToCamera, childDensity, childScale);
+        ComputeChildDensityAndScale(distanceToCamera, isTemplate, childDensity, childScale);
     }
 
     const float zoffset         = params.nBaseSize[si.level];
     const float childStepfDelta = (curveResolution * (1. - zoffset)) / float(children);
     const float firstChildStepf = curveResolution * zoffset + childStepfDelta * .5;
 
-    const float3 startPos = inputRecord.trafo.GetPos();
+    const float3 startPos = inputRecord.trafo.GetPos(root);
 
     // State of current clone
     TreeTransform trafo;
@@ -249,8 +169,39 @@ void Stem(
 
     // Global state
     float splitError       = -params.nSegSplitBaseOffset[si.level];
-    uint  drawOutputCount  = 0;
-    uint  childOutputCount = 0;
+    uint  segmentCount     = 0;
+    uint  childOutputCount = inputRecord.firstChild;
+
+    // Split-free stems with orientation-independent curve steps compute the transforms of all steps up front,
+    // one step per lane (see IsStemCurveScannable); the step loop then only reads them
+    const bool isCurveScan = IsStemCurveScannable(
+        params, si.level, curveResolution, segmentSplits, splitError, isTemplate || (GetWindStrength() == 0));
+
+    TreeTransform scanTrafo = trafo;
+
+    if (isCurveScan) {
+        const uint  scanStep    = gtid;
+        const bool  isScanStep  = scanStep < curveResolution;
+        const float scanFromZ   = GetStemStepZ(scanStep, curveResolution);
+        const uint  segmentSeed = random::CombineSeed(random::CombineSeed(stemSeed, scanStep), 0);
+
+        const float4 stepRotation = isScanStep ?
+            GetStemStepRotation(params, si.level, curveResolution, segmentSeed, scanFromZ, 0) : qId();
+        scanTrafo.rot = qMul(trafo.rot, WavePrefixProductq(stepRotation));
+
+        const float3 segment = isScanStep ?
+            qGetZ(scanTrafo.rot) * ((GetStemStepZ(scanStep + 1, curveResolution) - scanFromZ) * si.length) : float3(0, 0, 0);
+        scanTrafo.pos = startPos + WavePrefixSum(segment) + segment;
+    }
+
+    // Wave-uniform record counts for the statistics counters
+    uint  branchRecordCount        = 0;
+    uint  segmentRecordCount       = 0;
+    uint  shadowSegmentRecordCount = 0;
+    uint  leafRecordCount          = 0;
+    uint  culledRecordCount        = 0;
+    uint  occludedRecordCount      = 0;
+    uint  shadowOnlyRecordCount    = 0;
 
     for (int step = 0; step < curveResolution; ++step) {
         // update from with encoded value
@@ -287,7 +238,7 @@ void Stem(
             // number of threads that cannot be evenly distributed; all remain with original branch
             const uint threadSurplus   = max(int(threadCountInClone) - int(numSplits * threadsPerSplit), 0);
 
-            isOriginalClone = threadIndexInClone < (threadsPerSplit + threadSurplus);
+            isOriginalClone = threadIndexInClone < int(threadsPerSplit + threadSurplus);
 
             // Update thread in index and thread count per clone
             if (isOriginalClone) {
@@ -310,93 +261,128 @@ void Stem(
             groupClonePreTrafo[cloneIndex] = trafo;
         }
 
-        // Weber-Penn Section 4.1
-        if(params.nCurveV[si.level] >= 0){
-            const float stemCurve = GetStemCurve(params, si.level, curveResolution, segmentSeed, si.GetFromZ());
-            trafo.rot     = qMul(trafo.rot, qRotateX(radians(stemCurve + splitCorrection)));
-        }else{ // helix
-            trafo.rot     = qMul(trafo.rot, qRotateX(radians(abs(params.nCurveV[si.level])) / curveResolution));
-            trafo.rot     = qMul(trafo.rot, qRotateZ(radians(360) / curveResolution));
-        }
+        const float segmentLength = (si.GetToZ() - si.GetFromZ()) * si.length;
 
-        // Weber-Penn Section 4.2: Stage 2: apply splits/clones
-        if (hasSplits && !isOriginalClone) {
-            // update transform
-            AddSplitSpread(si, params, segmentSeed, step, /* inout */ trafo.rot, /* inout */ splitCorrection);
-        }
+        if (isCurveScan) {
+            trafo.rot = WaveReadLaneAt(scanTrafo.rot, step);
+            trafo.pos = WaveReadLaneAt(scanTrafo.pos, step);
+        } else {
+            // Weber-Penn Section 4.1
+            trafo.rot = qMul(trafo.rot, GetStemStepRotation(params, si.level, curveResolution, segmentSeed, si.GetFromZ(), splitCorrection));
+
+            // Weber-Penn Section 4.2: Stage 2: apply splits/clones
+            if (hasSplits && !isOriginalClone) {
+                // update transform
+                AddSplitSpread(si, params, segmentSeed, step, /* inout */ trafo.rot, /* inout */ splitCorrection);
+            }
 
-        // Weber-Penn Section 4.8
-        {
-            AddVerticalAttraction(si.level, params, curveResolution, trafo.rot);
-        }
+            // Weber-Penn Section 4.8
+            {
+                AddVerticalAttraction(si.level, params, curveResolution, trafo.rot);
+            }
 
-        // Weber-Penn Section 4.7
-        if(!hasSplits){
-            AddWindSway(si.radius, si.length, curveResolution, startPos, trafo.rot);
-        }
+            // Weber-Penn Section 4.7; templates are wind-free, TreeInstance bends them (see ApplyTreeWind)
+            if(!hasSplits && !isTemplate){
+                AddWindSway(si.radius, si.length, curveResolution, startPos, trafo.rot);
+            }
 
-        const float segmentLength = (si.GetToZ() - si.GetFromZ()) * si.length;
-        trafo.pos += qGetZ(trafo.rot) * segmentLength;
+            trafo.pos += qGetZ(trafo.rot) * segmentLength;
+        }
 
         if (threadIndexInClone == 0) {
             groupCloneTrafo[cloneIndex] = trafo;
         }
 
+        // One segment per clone; segments before firstSegment were drawn by a previous group
         const bool threadActive  = threadIndexInClone == 0;
-        const bool hasDrawOutput = threadActive && ((drawOutputCount + WavePrefixCountBits(threadActive)) < maxSegmentRecords);
+        const uint segmentIndex  = segmentCount + WavePrefixCountBits(threadActive);
+        const bool hasDrawOutput = threadActive && (segmentIndex >= firstSegment) && (segmentIndex < segmentEnd);
 
-        // Count all outputs
-        drawOutputCount += WaveActiveCountBits(hasDrawOutput);
+        const uint activeClones  = WaveActiveCountBits(threadActive);
+        segmentCount += activeClones;
 
         {
-            SegmentTessellationData tessellationData = (SegmentTessellationData)0;
-            tessellationData.threadGroupCount        = 0;
-
-            if (hasDrawOutput) {
-                // Increase pixels per triangle with distance
-                const float resolutionScale = MapRange(distanceToCamera, 30.f, 60.f, 1.f, 4.f);
-#if USING_SOFTWARE_ADAPTER
-                const float pixelsPerTriangle = 16.f;
-#else
-                const float pixelsPerTriangle = 4.f;
-#endif
+            SegmentTessellationData tessellationData       = (SegmentTessellationData)0;
+            tessellationData.threadGroupCount              = 0;
+            SegmentTessellationData shadowTessellationData = (SegmentTessellationData)0;
+            shadowTessellationData.threadGroupCount        = 0;
+
+            if (hasDrawOutput && !isTemplate) {
+                if (!isCameraOccluded) {
+                    tessellationData = ComputeVisibilityAndTessellationData(
+                        si,
+                        params,
+                        groupClonePreTrafo[cloneIndex],
+                        groupCloneTrafo[cloneIndex],
+                        GetStemPixelsPerTriangle(distanceToCamera, inputRecord.lod),
+                        cameraView,
+                        occlusionView);
+                }
 
-                tessellationData = ComputeVisibilityAndTessellationData(
+                shadowTessellationData = ComputeVisibilityAndTessellationData(
                     si,
                     params,
                     groupClonePreTrafo[cloneIndex],
                     groupCloneTrafo[cloneIndex],
-                    pixelsPerTriangle * resolutionScale);
+                    GetShadowPixelsPerTriangle(),
+                    shadowView,
+                    GetNoOcclusionView());
             }
 
-            const bool hasVisibleDrawOutput = hasDrawOutput && (tessellationData.threadGroupCount > 0);
+            const float aoDistance = inputRecord.aoDistance + si.length - segmentLength * step;
 
-            ThreadNodeOutputRecords<DrawSegmentRecord> drawSegmentOutputRecord =
-                drawSegmentOutput.GetThreadNodeOutputRecords(hasVisibleDrawOutput);
+            // Template stems store their segments for the TreeInstance node instead of drawing them
+            if (isTemplate) {
+                const uint templateSegmentCount = WaveActiveCountBits(hasDrawOutput);
 
-            if (hasVisibleDrawOutput) {
-                drawSegmentOutputRecord.Get().cage.from.SetPos(groupClonePreTrafo[cloneIndex].GetPos());
-                drawSegmentOutputRecord.Get().cage.from.SetRot(groupClonePreTrafo[cloneIndex].GetRot());
+                uint firstTemplateSegment = 0;
+                if (WaveIsFirstLane() && (templateSegmentCount > 0)) {
+                    firstTemplateSegment = AllocateTreeTemplateSegments(treeIndex, templateSegmentCount);
+                }
 
-                drawSegmentOutputRecord.Get().cage.to.SetPos(trafo.GetPos());
-                drawSegmentOutputRecord.Get().cage.to.SetRot(trafo.GetRot());
+                // Outside of the branch below, such that the first lane is the one that allocated
+                const uint templateSegmentIndex = WaveReadLaneFirst(firstTemplateSegment) + WavePrefixCountBits(hasDrawOutput);
 
-                drawSegmentOutputRecord.Get().si            = si;
-                drawSegmentOutputRecord.Get().aoDistance    = inputRecord.aoDistance + si.length - segmentLength * step;
+                if (hasDrawOutput) {
+                    StoreTreeTemplateSegment(
+                        treeIndex,
+                        templateSegmentIndex,
+                        CreateTreeTemplateSegment(groupClonePreTrafo[cloneIndex], trafo, si, aoDistance));
+                }
 
-                drawSegmentOutputRecord.Get().fromPoints        = tessellationData.fromPoints;
-                drawSegmentOutputRecord.Get().toPoints          = tessellationData.toPoints;
-                drawSegmentOutputRecord.Get().vPoints           = tessellationData.vPoints;
-                drawSegmentOutputRecord.Get().faceRingsPerGroup = tessellationData.faceRingsPerGroup;
-                drawSegmentOutputRecord.Get().fromOpeningAngle  = tessellationData.fromOpeningAngle;
-                drawSegmentOutputRecord.Get().toOpeningAngle    = tessellationData.toOpeningAngle;
-                drawSegmentOutputRecord.Get().dispatchGrid      = tessellationData.threadGroupCount;
+                segmentRecordCount += templateSegmentCount;
             }
 
-            drawSegmentOutputRecord.OutputComplete();
+            const DrawSegmentRecord segmentRecord = CreateDrawSegmentRecord(
+                groupClonePreTrafo[cloneIndex],
+                trafo,
+                si,
+                aoDistance,
+                tessellationData);
+
+            const DrawSegmentRecord shadowSegmentRecord = CreateDrawSegmentRecord(
+                groupClonePreTrafo[cloneIndex],
+                trafo,
+                si,
+                aoDistance,
+                shadowTessellationData);
+
+            const bool hasVisibleDrawOutput = hasDrawOutput && (tessellationData.threadGroupCount > 0);
+            const bool hasShadowDrawOutput  = hasDrawOutput && (shadowTessellationData.threadGroupCount > 0);
+            segmentRecordCount       += WaveActiveCountBits(hasVisibleDrawOutput);
+            shadowSegmentRecordCount += WaveActiveCountBits(hasShadowDrawOutput);
+
+            OutputDrawSegment(
+                hasVisibleDrawOutput,
+                segmentRecord,
+                hasShadowDrawOutput,
+                shadowSegmentRecord,
+                drawSegmentOutput,
+                drawSegmentShadowOutput,
+                coalesceDrawSegmentOutput,
+                coalesceDrawSegmentShadowOutput);
         }
 
-        const uint activeClones    = WaveActiveCountBits(hasDrawOutput);
 #if USING_SOFTWARE_ADAPTER
         // Up to 128 children, computed by 4 threads on WARP => max 32 iterations
         const uint childIterations = 32;
@@ -424,8 +410,8 @@ void Stem(
                 (stemChildScale != 0.f) && 
                 // ... and the child is in the current step
                 (floor(localChildStepf) == step) && 
-                // ... and we have not exceeded the maximum number of children
-                ((childOutputCount + gtid) < children);
+                // ... and the child is in the child range of this group
+                ((childOutputCount + gtid) < childEnd);
             bool       hasChildOutput = hasChildInStep;
 
             // End loop if no more children are generated
@@ -454,68 +440,59 @@ void Stem(
                                                     t);
             // Compute rotation along current spline segment
             const float4 rotParent = qSlerp(groupClonePreTrafo[childCloneIndex].rot, groupCloneTrafo[childCloneIndex].rot, t);
-            const float3 parentZ   = qGetZ(rotParent);
 
             if (si.level == (params.Levels - 1)) {
                 // Last level, output leaves
+                const StemLeaf leaf = GetStemLeaf(
+                    si, params, childSeed, stemChildIndex, z, ratio, childScale * stemChildScale, childPosition, rotParent, isTemplate);
 
-                const bool  isLeafBlossom = IsLeafBlossom(params, childSeed);
-                const float fruitProgress = GetSeasonFruitProgress(childSeed);
-                const float fruitScale    = GetFruitScale(fruitProgress);
-                const bool  isFruit       = isLeafBlossom && (random::Random(childSeed, stemChildIndex) < params.Fruit.Chance) && fruitProgress > 0;
-
-                const LeafParameters leafParams = GetLeafParameters(params, isLeafBlossom);
+                // Skip output if scale is zero
+                hasChildOutput = hasChildOutput && (leaf.scale > 0.f);
+
+                // Skip output if the leaf is outside the camera and the light frustum.
+                // Fruits are not drawn into the shadow map.
+                const uint viewMask =
+                    ((!isCameraOccluded && SphereInFrustum(cameraView.frustum, leaf.position, 2 * leaf.scale)) ? ViewMaskCamera : 0) |
+                    ((!leaf.isFruit && SphereInFrustum(shadowView.frustum, leaf.position, 2 * leaf.scale)) ? ViewMaskShadow : 0);
+                const bool isChildVisible = isTemplate || (viewMask != 0);
+                culledRecordCount += WaveActiveCountBits(hasChildOutput && !isChildVisible);
+                hasChildOutput = hasChildOutput && isChildVisible;
+
+                leafRecordCount += WaveActiveCountBits(hasChildOutput);
+
+                // Template stems store their leaves for the TreeInstance node instead of drawing them
+                if (isTemplate) {
+                    const uint templateLeafCount = WaveActiveCountBits(hasChildOutput);
+
+                    uint firstTemplateLeaf = 0;
+                    if (WaveIsFirstLane() && (templateLeafCount > 0)) {
+                        firstTemplateLeaf = AllocateTreeTemplateLeaves(treeIndex, templateLeafCount);
+                    }
 
-                // Compute scale based on child index
-                const float baseScale = leafParams.Scale * ShapeRatio(leafParams.ScaleShape, 1.f - z) * childScale * stemChildScale;
-                const float scale = leafParams.IsNeedle ? 
-                    // Needles are not scaled by season
-                    baseScale :
-                    (
-                        isFruit ? 
-                            childScale * stemChildScale * params.Fruit.Size * fruitScale :
-                            baseScale * GetSeasonLeafScale(childSeed, isLeafBlossom)
-                    );
+                    const uint templateLeafIndex = WaveReadLaneFirst(firstTemplateLeaf) + WavePrefixCountBits(hasChildOutput);
+
+                    if (hasChildOutput) {
+                        StoreTreeTemplateLeaf(
+                            treeIndex,
+                            templateLeafIndex,
+                            CreateTreeTemplateLeaf(CreateTreeLocalTransformq32(treeIndex, root, leaf.position, leaf.rotation),
+                                                   childSeed,
+                                                   leaf.outputArrayIndex,
+                                                   leaf.scale,
+                                                   inputRecord.aoDistance + si.length * (1-z)));
+                    }
 
-                // Compute child transform
-                TreeTransformCompressedq32 childTransform;
-                
-                float4 childRotation = qMul(qRotateAxisAngle(parentZ, parentZRotAngle), qMul(rotParent, downAngleRot));
-                
-                // Apply gravity to fruit
-                if (isFruit) {
-                    AddFruitWeight(childRotation, params.Fruit.DownForce * fruitScale);
-                }
-                
-                // Compute child position on surface of spline segment
-                const float3 childZ = qGetZ(childRotation);
-                const float  d      = clamp(dot(childZ, parentZ), .05, .95);
-                const float3 offset = childZ * (radiusParent / sqrt(1 - d * d) + leafParams.StemLen);
-                childTransform.SetPos(childPosition + offset);
-
-                // Apply wind animation to leaves
-                if (!isFruit) {
-                    AddWindSway(0.03, leafParams.Scale, 1, childTransform.GetPos(), childRotation);
+                    hasChildOutput = false;
                 }
 
-                childTransform.SetRot(childRotation);
-                
-                // drawLeafOutput is node array with 3 nodes:
-                // 0 = leaf
-                // 1 = blossom
-                // 2 = fruit
-                uint childOutputArrayIndex = isLeafBlossom? (isFruit? 2 : 1) : 0;
-
-                // Skip output if scale is zero
-                hasChildOutput = hasChildOutput && (scale > 0.f);
-
                 ThreadNodeOutputRecords<DrawLeafRecord> childOutputRecord = 
-                    drawLeafOutput[childOutputArrayIndex].GetThreadNodeOutputRecords(hasChildOutput);
+                    drawLeafOutput[leaf.outputArrayIndex].GetThreadNodeOutputRecords(hasChildOutput);
 
                 if(hasChildOutput) {
-                    childOutputRecord.Get().trafo      = childTransform;
+                    childOutputRecord.Get().trafo      = CreateTreeLocalTransformq32(treeIndex, root, leaf.position, leaf.rotation);
                     childOutputRecord.Get().seed       = childSeed;
-                    childOutputRecord.Get().scale      = scale;
+                    childOutputRecord.Get().viewMask   = viewMask;
+                    childOutputRecord.Get().scale      = leaf.scale;
                     childOutputRecord.Get().aoDistance = inputRecord.aoDistance + si.length * (1-z);
                 }
 
@@ -524,51 +501,97 @@ void Stem(
                 // Not last level, output recursive stems (branches)
 
                 // Compute child transform
-                TreeTransformCompressedq64 childTransform;
-                childTransform.SetPos(childPosition);
-                childTransform.SetRot(qMul(qRotateAxisAngle(qGetZ(rotParent), parentZRotAngle),
-                                           qMul(rotParent, downAngleRot)));
+                const float4 childRotation = qMul(qRotateAxisAngle(qGetZ(rotParent), parentZRotAngle),
+                                                  qMul(rotParent, downAngleRot));
 
                 // compute child length
                 const float childLengthMax = params.nLength[nextLevelClamped] + random::SignedRandom(childSeed, 89) * params.nLengthV[nextLevelClamped];
                 const float shapeRatio     = ShapeRatio(params.nShape[si.level], si.level == 0? ratio : (1 - 0.6 * z));
                 const float childLength    = childLengthMax * (si.length * shapeRatio);
+                const float childRadius    = min(radiusParent * .9, inputRecord.radius * pow(childLength / si.length, params.RatioPower));
+
+                // Subtree culling: skip the child if the bounding sphere of the child stem and all stems and leaves
+                // generated from it is outside the camera and the light frustum, or only inside the camera frustum
+                // and occluded. Occluded children inside the light frustum only emit their shadow records.
+                const float childReach            = GetMaxSubtreeReach(params, nextLevel, max(0, childLength), childRadius);
+                const bool  isChildInCamera       = !isCameraOccluded && SphereInFrustum(cameraView.frustum, childPosition, childReach);
+                const bool  isChildInShadow       = SphereInFrustum(shadowView.frustum, childPosition, childReach);
+                const bool  isChildCameraOccluded = !isTemplate && isChildInCamera &&
+                                                    IsSphereOccluded(occlusionView, childPosition, childReach);
+                const bool  isChildOccluded       = isChildCameraOccluded && !isChildInShadow;
+                const bool  isChildVisible        = isTemplate || ((isChildInCamera || isChildInShadow) && !isChildOccluded);
+                culledRecordCount     += WaveActiveCountBits(hasChildOutput && !isChildVisible && !isChildOccluded);
+                occludedRecordCount   += WaveActiveCountBits(hasChildOutput && isChildOccluded);
+                shadowOnlyRecordCount += WaveActiveCountBits(hasChildOutput && isChildCameraOccluded && isChildInShadow);
+                hasChildOutput = hasChildOutput && isChildVisible;
+
+                branchRecordCount += WaveActiveCountBits(hasChildOutput);
+
+                GenerateTreeRecord childRecord;
+
+                // copy constants to record
+                childRecord.scale = inputRecord.scale;
+                childRecord.seed  = childSeed;
+
+                childRecord.level            = nextLevel;
+                childRecord.lod              = inputRecord.lod;
+                childRecord.isTemplate       = inputRecord.isTemplate;
+                childRecord.isCameraOccluded = isCameraOccluded || isChildCameraOccluded;
+                childRecord.firstChild       = 0;
+                childRecord.firstSegment     = 0;
+
+                // AO
+                childRecord.aoDistance = inputRecord.aoDistance + si.length * (1-z);
+
+                // Set transform an length
+                childRecord.trafo  = CreateTreeLocalTransformq64(treeIndex, root, childPosition, childRotation);
+                childRecord.length = max(0, childLength);
+
+                // Radius
+                childRecord.radius = childRadius;
+
+                // Compute number of children in next level
+                if ((si.level + 2) == params.Levels) {
+                    // If next level is last level (leaves), we use the leaf and blossom count
+                    childRecord.children = int((abs(params.Leaf.Count) + abs(params.Blossom.Count)) * ShapeRatio(params.nShape[nextLevelClamped], 1.f - z)); // is instead leaves
+                } else {
+                    // If next level is not last level, we use the number of branches, scaled by the child length
+                    float grandchildren = params.nBranches[min(si.level + 2, params.Levels - 1)];
+                    childRecord.children = GetTreeLodBranchCount(
+                        si.level == 0?
+                            int(grandchildren * (0.2 + 0.8 * childLength / si.length / childLengthMax)) :
+                            int(grandchildren * (1.0 - 0.5 * z)),
+                        inputRecord.lod);
+                }
+
+                // Small twigs are grown by the Twig node, several per thread group. The child computes its leaf density
+                // from the distance of its packed position, so the same distance is used here.
+                const bool isTwigChild = IsTwig(
+                    params,
+                    nextLevel,
+                    inputRecord.lod,
+                    childRecord.children,
+                    isTemplate ? 0.f : distance(GetCameraPosition(), childRecord.trafo.GetPos(root)),
+                    isTemplate);
 
                 ThreadNodeOutputRecords<GenerateTreeRecord> childOutputRecord =
-                    generateTreeOutput.GetThreadNodeOutputRecords(hasChildOutput);
+                    generateTreeOutput.GetThreadNodeOutputRecords(hasChildOutput && !isTwigChild);
 
                 // write child output record
-                if (hasChildOutput) {
-                    // copy constants to record
-                    childOutputRecord.Get().scale = inputRecord.scale;
-                    childOutputRecord.Get().seed  = childSeed;
+                if (hasChildOutput && !isTwigChild) {
+                    childOutputRecord.Get() = childRecord;
+                }
 
-                    // AO
-                    childOutputRecord.Get().aoDistance = inputRecord.aoDistance + si.length * (1-z);
+                childOutputRecord.OutputComplete();
 
-                    // Set transform an length
-                    childOutputRecord.Get().trafo  = childTransform;
-                    childOutputRecord.Get().length = max(0, childLength);
-
-                    // Radius
-                    const float radiusParent = GetTaperedRadius(si, params, z);
-                    childOutputRecord.Get().radius = min(radiusParent * .9, inputRecord.radius * pow(childLength / si.length, params.RatioPower));
-
-                    // Compute number of children in next level
-                    if ((si.level + 2) == params.Levels) {
-                        // If next level is last level (leaves), we use the leaf and blossom count
-                        childOutputRecord.Get().children = int((abs(params.Leaf.Count) + abs(params.Blossom.Count)) * ShapeRatio(params.nShape[nextLevelClamped], 1.f - z)); // is instead leaves
-                    } else {
-                        // If next level is not last level, we use the number of branches, scaled by the child length
-                        float grandchildren = params.nBranches[min(si.level + 2, params.Levels - 1)];
-                        childOutputRecord.Get().children =
-                            si.level == 0?
-                                int(grandchildren * (0.2 + 0.8 * childLength / si.length / childLengthMax)) :
-                                int(grandchildren * (1.0 - 0.5 * z));
-                    }
+                ThreadNodeOutputRecords<GenerateTreeRecord> twigOutputRecord =
+                    twigOutput.GetThreadNodeOutputRecords(hasChildOutput && isTwigChild);
+
+                if (hasChildOutput && isTwigChild) {
+                    twigOutputRecord.Get() = childRecord;
                 }
 
-                childOutputRecord.OutputComplete();
+                twigOutputRecord.OutputComplete();
             }
 
             if (childrenInStep < StemThreadGroupSize) {
@@ -576,4 +599,399 @@ void Stem(
             }
         }
     }
-}
\ No newline at end of file
+
+    // Continue the stem in another group if this group ran out of child or segment records.
+    // Continuations recurse into Stem, so they are only emitted while the remaining recursion levels
+    // still allow the child stems of all lower tree levels.
+    const bool hasChildContinuation   = (childOutputCount >= childEnd) && (childEnd < children);
+    const bool hasSegmentContinuation = segmentCount > segmentEnd;
+    const bool hasContinuation        = (gtid == 0) && (hasChildContinuation || hasSegmentContinuation) &&
+                                        (GetRemainingRecursionLevels() > uint(params.Levels - 1 - si.level));
+    const bool isContinuationDropped  = (gtid == 0) && (hasChildContinuation || hasSegmentContinuation) && !hasContinuation;
+
+    ThreadNodeOutputRecords<GenerateTreeRecord> continuationRecord =
+        generateTreeOutput.GetThreadNodeOutputRecords(hasContinuation);
+
+    if (hasContinuation) {
+        continuationRecord.Get()              = inputRecord;
+        continuationRecord.Get().firstChild   = hasChildContinuation ? childEnd : children;
+        continuationRecord.Get().firstSegment = hasSegmentContinuation ? segmentEnd : segmentCount;
+    }
+
+    continuationRecord.OutputComplete();
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::STEM_GROUPS, 1);
+        AddStatistic(StatisticsCounter::STEM_BRANCH_RECORDS, branchRecordCount);
+        AddStatistic(StatisticsCounter::STEM_SEGMENT_RECORDS, segmentRecordCount);
+        AddStatistic(StatisticsCounter::STEM_SHADOW_SEGMENT_RECORDS, shadowSegmentRecordCount);
+        AddStatistic(StatisticsCounter::STEM_LEAF_RECORDS, leafRecordCount);
+        AddStatistic(StatisticsCounter::STEM_CONTINUATION_RECORDS, hasContinuation ? 1 : 0);
+        AddStatistic(StatisticsCounter::STEM_DROPPED_CONTINUATION, isContinuationDropped ? 1 : 0);
+        AddStatistic(StatisticsCounter::STEM_CULLED_RECORDS, culledRecordCount);
+        AddStatistic(StatisticsCounter::STEM_OCCLUDED_RECORDS, occludedRecordCount);
+        AddStatistic(StatisticsCounter::STEM_SHADOW_ONLY_RECORDS, shadowOnlyRecordCount);
+    }
+}
+
+// Body of the Twig nodes. Every lane grows one twig (see IsTwig): the steps of the Stem loop for a stem without
+// splits, each followed by the leaves on that step. Output calls have to be group uniform, so all lanes run
+// maxTwigSegments steps, and per step as many leaf iterations as the lane with the most leaves on that step.
+void GenerateTwig(
+    in const uint treeType,
+    in const uint gtid,
+    in const uint twigCount,
+    in GenerateTreeRecord inputRecord,
+    NodeOutputArray<DrawLeafRecord> drawLeafOutput,
+    NodeOutput<DrawSegmentRecord> drawSegmentOutput,
+    NodeOutput<DrawSegmentRecord> drawSegmentShadowOutput,
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentOutput,
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentShadowOutput
+)
+{
+    const TreeParameters params = GetTreeParameters(treeType);
+
+    // Lanes without an input record run along with the others without output
+    const bool isTwig = gtid < twigCount;
+
+    SegmentInfo si;
+    si.level        = inputRecord.level;
+    si.length       = inputRecord.length;
+    si.radius       = inputRecord.radius;
+    si.fromZ        = 0;
+    si.toZ          = 0;
+
+    const float lengthBase = params.nBaseSize[0] * inputRecord.scale;
+
+    // The twigs of a group may belong to different trees
+    const uint     treeIndex = inputRecord.trafo.GetTreeIndex();
+    const TreeRoot root      = LoadTreeRoot(treeIndex);
+
+    const bool isTemplate = inputRecord.isTemplate;
+
+    const float distanceToCamera = isTemplate ? 0.f : distance(GetCameraPosition(), inputRecord.trafo.GetPos(root));
+
+    const ViewParameters cameraView    = GetCameraView();
+    const ViewParameters shadowView    = GetShadowView();
+    const OcclusionView  occlusionView = GetOcclusionView();
+
+    const bool isCameraOccluded = inputRecord.isCameraOccluded;
+
+    // Constants
+    const float curveResolution = GetTreeLodCurveResolution(params, si.level, inputRecord.lod);
+    const uint  stemSeed        = inputRecord.seed;
+    const uint  children        = inputRecord.children;
+
+    float childDensity;
+    float childScale;
+    ComputeChildDensityAndScale(distanceToCamera, isTemplate, childDensity, childScale);
+
+    // Children with an index of at least leafCount are scaled to zero, see GetNthChildIndexAndScale
+    const uint leafCount           = ceil(children * childDensity);
+    const bool isLeafOrderReversed = IsNthChildOrderReversed(children, childDensity);
+
+    const float zoffset         = params.nBaseSize[si.level];
+    const float childStepfDelta = (curveResolution * (1. - zoffset)) / float(children);
+    const float firstChildStepf = curveResolution * zoffset + childStepfDelta * .5;
+
+    const float3 startPos = inputRecord.trafo.GetPos(root);
+
+    TreeTransform trafo;
+    trafo.SetPos(startPos);
+    trafo.SetRot(inputRecord.trafo.GetRot());
+
+    // Children are visited in the order of their step, so every lane carries one cursor across all steps
+    uint nextChild = 0;
+
+    // Wave-uniform record counts for the statistics counters
+    uint segmentRecordCount       = 0;
+    uint shadowSegmentRecordCount = 0;
+    uint leafRecordCount          = 0;
+    uint culledRecordCount        = 0;
+
+    for (uint step = 0; step < maxTwigSegments; ++step) {
+        const bool hasStep = isTwig && (step < curveResolution);
+
+        si.fromZ = si.toZ;
+        si.SetToZ(min(step + 1, curveResolution) / curveResolution);
+
+        const float stepTSize     = (si.GetToZ() - si.GetFromZ()) * curveResolution;
+        const float segmentLength = (si.GetToZ() - si.GetFromZ()) * si.length;
+        const uint  segmentSeed   = random::CombineSeed(random::CombineSeed(stemSeed, step), 0);
+
+        const TreeTransform preTrafo = trafo;
+
+        if (hasStep) {
+            // Weber-Penn Section 4.1
+            trafo.rot = qMul(trafo.rot, GetStemStepRotation(params, si.level, curveResolution, segmentSeed, si.GetFromZ(), 0));
+
+            // Weber-Penn Section 4.8
+            AddVerticalAttraction(si.level, params, curveResolution, trafo.rot);
+
+            // Weber-Penn Section 4.7; templates are wind-free, TreeInstance bends them (see ApplyTreeWind)
+            if (!isTemplate) {
+                AddWindSway(si.radius, si.length, curveResolution, startPos, trafo.rot);
+            }
+
+            trafo.pos += qGetZ(trafo.rot) * segmentLength;
+        }
+
+        {
+            SegmentTessellationData tessellationData       = (SegmentTessellationData)0;
+            tessellationData.threadGroupCount              = 0;
+            SegmentTessellationData shadowTessellationData = (SegmentTessellationData)0;
+            shadowTessellationData.threadGroupCount        = 0;
+
+            if (hasStep && !isTemplate) {
+                if (!isCameraOccluded) {
+                    tessellationData = ComputeVisibilityAndTessellationData(
+                        si,
+                        params,
+                        preTrafo,
+                        trafo,
+                        GetStemPixelsPerTriangle(distanceToCamera, inputRecord.lod),
+                        cameraView,
+                        occlusionView);
+                }
+
+                shadowTessellationData = ComputeVisibilityAndTessellationData(
+                    si,
+                    params,
+                    preTrafo,
+                    trafo,
+                    GetShadowPixelsPerTriangle(),
+                    shadowView,
+                    GetNoOcclusionView());
+            }
+
+            const float aoDistance = inputRecord.aoDistance + si.length - segmentLength * step;
+
+            // Template twigs store their segments for the TreeInstance node instead of drawing them
+            if (hasStep && isTemplate) {
+                StoreTreeTemplateSegment(
+                    treeIndex,
+                    AllocateTreeTemplateSegments(treeIndex, 1),
+                    CreateTreeTemplateSegment(preTrafo, trafo, si, aoDistance));
+            }
+
+            segmentRecordCount += WaveActiveCountBits(hasStep && isTemplate);
+
+            const DrawSegmentRecord segmentRecord       = CreateDrawSegmentRecord(preTrafo, trafo, si, aoDistance, tessellationData);
+            const DrawSegmentRecord shadowSegmentRecord = CreateDrawSegmentRecord(preTrafo, trafo, si, aoDistance, shadowTessellationData);
+
+            const bool hasVisibleDrawOutput = hasStep && (tessellationData.threadGroupCount > 0);
+            const bool hasShadowDrawOutput  = hasStep && (shadowTessellationData.threadGroupCount > 0);
+            segmentRecordCount       += WaveActiveCountBits(hasVisibleDrawOutput);
+            shadowSegmentRecordCount += WaveActiveCountBits(hasShadowDrawOutput);
+
+            OutputDrawSegment(
+                hasVisibleDrawOutput,
+                segmentRecord,
+                hasShadowDrawOutput,
+                shadowSegmentRecord,
+                drawSegmentOutput,
+                drawSegmentShadowOutput,
+                coalesceDrawSegmentOutput,
+                coalesceDrawSegmentShadowOutput);
+        }
+
+        for (uint leafIteration = 0; leafIteration < maxTwigLeaves; ++leafIteration) {
+            uint  stemChildIndex  = 0;
+            float stemChildScale  = 0.f;
+            float localChildStepf = 0.f;
+
+            // Find the next child of this lane on the current step; the cursor stops at the first child of a later step
+            bool hasChildInStep = false;
+            while (hasStep && !hasChildInStep && (nextChild < leafCount)) {
+                const uint n = isLeafOrderReversed ? (leafCount - 1 - nextChild) : nextChild;
+                GetNthChildIndexAndScale(n, children, childDensity, stemChildIndex, stemChildScale);
+
+                localChildStepf = firstChildStepf + stemChildIndex * childStepfDelta;
+                if (floor(localChildStepf) > step) {
+                    break;
+                }
+
+                hasChildInStep = (stemChildScale != 0.f) && (floor(localChildStepf) == step);
+
+                ++nextChild;
+            }
+
+            // End loop if no lane has another child on this step
+            if (WaveActiveAllTrue(!hasChildInStep)) {
+                break;
+            }
+
+            const float t = frac(localChildStepf) / stepTSize;
+            // Quantize z as an easy fix to floating point errors when scaling curve res
+            const float z = SegmentInfo::DecodeZ(SegmentInfo::EncodeZ(localChildStepf / curveResolution));
+
+            const uint  childSeed = random::CombineSeed(stemChildIndex, inputRecord.seed) & 0x7FFFFF;
+            const float ratio     = (si.length * (1-z))/(si.length - lengthBase);
+
+            // Compute child position and rotation along current spline segment
+            const float3 childPosition = StemSpline(preTrafo.pos, qGetZ(preTrafo.rot), trafo.pos, qGetZ(trafo.rot), t);
+            const float4 rotParent     = qSlerp(preTrafo.rot, trafo.rot, t);
+
+            const StemLeaf leaf = GetStemLeaf(
+                si, params, childSeed, stemChildIndex, z, ratio, childScale * stemChildScale, childPosition, rotParent, isTemplate);
+
+            bool hasChildOutput = hasChildInStep && (leaf.scale > 0.f);
+
+            // Skip output if the leaf is outside the camera and the light frustum.
+            // Fruits are not drawn into the shadow map.
+            const uint viewMask =
+                ((!isCameraOccluded && SphereInFrustum(cameraView.frustum, leaf.position, 2 * leaf.scale)) ? ViewMaskCamera : 0) |
+                ((!leaf.isFruit && SphereInFrustum(shadowView.frustum, leaf.position, 2 * leaf.scale)) ? ViewMaskShadow : 0);
+            const bool isChildVisible = isTemplate || (viewMask != 0);
+            culledRecordCount += WaveActiveCountBits(hasChildOutput && !isChildVisible);
+            hasChildOutput = hasChildOutput && isChildVisible;
+
+            leafRecordCount += WaveActiveCountBits(hasChildOutput);
+
+            const float aoDistance = inputRecord.aoDistance + si.length * (1-z);
+
+            // Template twigs store their leaves for the TreeInstance node instead of drawing them
+            if (isTemplate) {
+                if (hasChildOutput) {
+                    StoreTreeTemplateLeaf(
+                        treeIndex,
+                        AllocateTreeTemplateLeaves(treeIndex, 1),
+                        CreateTreeTemplateLeaf(CreateTreeLocalTransformq32(treeIndex, root, leaf.position, leaf.rotation),
+                                               childSeed,
+                                               leaf.outputArrayIndex,
+                                               leaf.scale,
+                                               aoDistance));
+                }
+
+                hasChildOutput = false;
+            }
+
+            ThreadNodeOutputRecords<DrawLeafRecord> childOutputRecord =
+                drawLeafOutput[leaf.outputArrayIndex].GetThreadNodeOutputRecords(hasChildOutput);
+
+            if (hasChildOutput) {
+                childOutputRecord.Get().trafo      = CreateTreeLocalTransformq32(treeIndex, root, leaf.position, leaf.rotation);
+                childOutputRecord.Get().seed       = childSeed;
+                childOutputRecord.Get().viewMask   = viewMask;
+                childOutputRecord.Get().scale      = leaf.scale;
+                childOutputRecord.Get().aoDistance = aoDistance;
+            }
+
+            childOutputRecord.OutputComplete();
+        }
+    }
+
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::TWIG_GROUPS, 1);
+        AddStatistic(StatisticsCounter::TWIG_RECORDS, twigCount);
+        AddStatistic(StatisticsCounter::STEM_SEGMENT_RECORDS, segmentRecordCount);
+        AddStatistic(StatisticsCounter::STEM_SHADOW_SEGMENT_RECORDS, shadowSegmentRecordCount);
+        AddStatistic(StatisticsCounter::STEM_LEAF_RECORDS, leafRecordCount);
+        AddStatistic(StatisticsCounter::STEM_CULLED_RECORDS, culledRecordCount);
+    }
+}
+
+// Body of the TreeInstance node: each thread replays one segment and one leaf of the template at the root of the
+// instance
+void GenerateTreeInstance(
+    in const uint gtid,
+    in const uint dispatchThreadID,
+    in const TreeInstanceRecord instance,
+    NodeOutputArray<DrawLeafRecord> drawLeafOutput,
+    NodeOutput<DrawSegmentRecord> drawSegmentOutput,
+    NodeOutput<DrawSegmentRecord> drawSegmentShadowOutput,
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentOutput,
+    NodeOutput<DrawSegmentRecord> coalesceDrawSegmentShadowOutput
+)
+{
+    const TreeTemplateHeader treeTemplate = LoadTreeTemplateHeader(instance.templateIndex);
+    const TreeRoot           root         = LoadTreeRoot(instance.treeIndex);
+    const TreeParameters     params       = GetTreeParameters();
+    const ViewParameters     cameraView   = GetCameraView();
+    const ViewParameters     shadowView   = GetShadowView();
+    const OcclusionView      occlusion    = GetOcclusionView();
+    const TreeWind           wind         = GetTreeWind(root.pos, treeTemplate.radius);
+
+    const float distanceToCamera = distance(GetCameraPosition(), root.pos);
+
+    const bool hasSegment = dispatchThreadID < treeTemplate.segmentCount;
+    const bool hasLeaf    = dispatchThreadID < treeTemplate.leafCount;
+
+    SegmentTessellationData tessellationData       = (SegmentTessellationData)0;
+    SegmentTessellationData shadowTessellationData = (SegmentTessellationData)0;
+    DrawSegmentRecord       segmentRecord          = (DrawSegmentRecord)0;
+    DrawSegmentRecord       shadowSegmentRecord    = (DrawSegmentRecord)0;
+
+    if (hasSegment) {
+        TreeTemplateSegment       segment = LoadTreeTemplateSegment(instance.templateIndex, dispatchThreadID);
+        const SegmentInfo         si      = UnpackSegmentInfo(segment.si);
+
+        StemTubeCage cage = segment.cage.Decompress();
+        cage.from.pos += root.pos;
+        cage.to.pos   += root.pos;
+        cage.from      = ApplyTreeWind(wind, cage.from);
+        cage.to        = ApplyTreeWind(wind, cage.to);
+
+        // Instances occluded in the camera view only replay their shadow records, see TreeRoots
+        if (!instance.isCameraOccluded) {
+            tessellationData = ComputeVisibilityAndTessellationData(
+                si, params, cage.from, cage.to, GetStemPixelsPerTriangle(distanceToCamera, instance.lod), cameraView, occlusion);
+        }
+        shadowTessellationData = ComputeVisibilityAndTessellationData(
+            si, params, cage.from, cage.to, GetShadowPixelsPerTriangle(), shadowView, GetNoOcclusionView());
+
+        segmentRecord       = CreateDrawSegmentRecord(cage.from, cage.to, si, segment.aoDistance, tessellationData);
+        shadowSegmentRecord = CreateDrawSegmentRecord(cage.from, cage.to, si, segment.aoDistance, shadowTessellationData);
+    }
+
+    const bool hasVisibleDrawOutput = hasSegment && (tessellationData.threadGroupCount > 0);
+    const bool hasShadowDrawOutput  = hasSegment && (shadowTessellationData.threadGroupCount > 0);
+
+    OutputDrawSegment(
+        hasVisibleDrawOutput,
+        segmentRecord,
+        hasShadowDrawOutput,
+        shadowSegmentRecord,
+        drawSegmentOutput,
+        drawSegmentShadowOutput,
+        coalesceDrawSegmentOutput,
+        coalesceDrawSegmentShadowOutput);
+
+    DrawLeafRecord leafRecord      = (DrawLeafRecord)0;
+    uint           leafOutputIndex = 0;
+
+    if (hasLeaf) {
+        const TreeTemplateLeaf leaf = LoadTreeTemplateLeaf(instance.templateIndex, dispatchThreadID);
+
+        leafOutputIndex       = GetTreeTemplateLeafOutputIndex(leaf);
+        leafRecord.trafo      = GetTreeInstanceLeafTransform(leaf, treeTemplate.radius, params, wind, instance.treeIndex, root);
+        leafRecord.seed       = GetTreeTemplateLeafSeed(leaf);
+        leafRecord.scale      = GetTreeInstanceLeafScale(leaf, distanceToCamera);
+        leafRecord.aoDistance = leaf.aoDistance;
+
+        // Fruits are not drawn into the shadow map
+        const float3 position = leafRecord.trafo.GetPos(root);
+        leafRecord.viewMask =
+            ((!instance.isCameraOccluded && SphereInFrustum(cameraView.frustum, position, 2 * leafRecord.scale)) ? ViewMaskCamera : 0) |
+            (((leafOutputIndex != 2) && SphereInFrustum(shadowView.frustum, position, 2 * leafRecord.scale)) ? ViewMaskShadow : 0);
+    }
+
+    const bool hasLeafOutput = hasLeaf && (leafRecord.scale > 0.f) && (leafRecord.viewMask != 0);
+
+    ThreadNodeOutputRecords<DrawLeafRecord> leafOutputRecord = drawLeafOutput[leafOutputIndex].GetThreadNodeOutputRecords(hasLeafOutput);
+
+    if (hasLeafOutput) {
+        leafOutputRecord.Get() = leafRecord;
+    }
+
+    leafOutputRecord.OutputComplete();
+
+    const uint recordCount = WaveActiveCountBits(hasVisibleDrawOutput) + WaveActiveCountBits(hasShadowDrawOutput) +
+                             WaveActiveCountBits(hasLeafOutput);
+    if (WaveIsFirstLane()) {
+        AddStatistic(StatisticsCounter::TREE_INSTANCE_RECORDS, recordCount);
+    }
+    if (gtid == 0) {
+        AddStatistic(StatisticsCounter::TREE_INSTANCE_GROUPS, 1);
+    }
+}
@@ -94,10 +94,13 @@ struct TreeParameters {
 #define TREE_TYPE_TAMARACK 3
 #define TREE_TYPE_COUNT 4
 
-TreeParameters GetTreeParameters() {
-    TreeParameters parameters;
+// Upper bound of TreeParameters::Levels of all tree types; sizes the recursion of the Stem nodes (see StemGrowth.h)
+#define TREE_MAX_LEVELS 4
 
-    const uint treeType = LoadPersistentConfigUint(PersistentConfig::TREE_TYPE);
+// Parameters of the given tree type. Called with a literal tree type, e.g. by the specialized Stem nodes,
+// all parameters fold to compile-time constants.
+TreeParameters GetTreeParameters(in const uint treeType) {
+    TreeParameters parameters;
 
     if (treeType == TREE_TYPE_APPLE) {
         parameters.Levels                    = 3;
@@ -594,6 +597,11 @@ TreeParameters GetTreeParameters() {
     return parameters;
 }
 
+// Parameters of the tree type selected in the persistent config
+TreeParameters GetTreeParameters() {
+    return GetTreeParameters(LoadPersistentConfigUint(PersistentConfig::TREE_TYPE));
+}
+
 LeafParameters GetLeafParameters(in const TreeParameters treeParameters, in const bool isBlossom) {
     if (isBlossom) {
         return treeParameters.Blossom;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Config.h"
+
+// ============================ Tree Roots ====================
+// Stem, leaf and fruit records store positions relative to the root of their tree (TreeTransformLocalq32/q64),
+// quantized to snorm16 over the bounding sphere of the tree. TreeRootsNode writes the root position and the
+// radius of the bounding sphere (see GetMaxSubtreeReach) of every tree of the frame into a table placed
+// after the PersistentConfig block, before it launches the tree.
+// Tree indices are allocated per frame from a counter in front of the table, see ChunksNode.
+
+// Tree indices are stored in 16 bits, see PackTreeLocalPosition
+static const uint MaxTreeCount = 1 << 16;
+
+static const uint TreeRootCountOffset = PersistentConfigOffset + ((uint)PersistentConfig::COUNT) * sizeof(uint);
+static const uint TreeRootTableOffset = (TreeRootCountOffset + sizeof(uint) + 15) & ~15u;
+static const uint TreeRootTableEnd    = TreeRootTableOffset + MaxTreeCount * sizeof(float4);
+
+static const float treeLocalPositionScale = 32767;
+
+struct TreeRoot {
+    float3 pos;
+    float  radius;
+};
+
+// Tree indices below reservedTreeCount are not allocated, see TreeTemplates.h.
+// Must run before the Chunks node of the frame, i.e. in EntryFunction.
+void ResetTreeRootCount(in uint reservedTreeCount) {
+    PersistentScratchBuffer.Store<uint>(TreeRootCountOffset, reservedTreeCount);
+}
+
+uint GetTreeRootAddress(in uint treeIndex) {
+    return TreeRootTableOffset + (treeIndex % MaxTreeCount) * sizeof(float4);
+}
+
+void StoreTreeRoot(in uint treeIndex, in const TreeRoot root) {
+    PersistentScratchBuffer.Store<float4>(GetTreeRootAddress(treeIndex), float4(root.pos, root.radius));
+}
+
+TreeRoot LoadTreeRoot(in uint treeIndex) {
+    const float4 data = PersistentScratchBuffer.Load<float4>(GetTreeRootAddress(treeIndex));
+
+    TreeRoot root;
+    root.pos    = data.xyz;
+    root.radius = data.w;
+    return root;
+}
+
+// Packs pos relative to root, the root of tree treeIndex: x and y in the first uint, z and the tree index in the second.
+// Positions take 8 instead of 12 bytes, a third less.
+uint2 PackTreeLocalPosition(in const float3 pos, in const uint treeIndex, in const TreeRoot root) {
+    const float3 local = clamp((pos - root.pos) / root.radius, -1, 1);
+    const int3   q     = int3(round(local * treeLocalPositionScale));
+
+    return uint2((uint(q.x) & 0xFFFF) | (uint(q.y) << 16), (uint(q.z) & 0xFFFF) | (treeIndex << 16));
+}
+
+uint GetPackedTreeIndex(in const uint2 packedPos) {
+    return packedPos.y >> 16;
+}
+
+// Position relative to the root, in units of the root radius
+float3 UnpackTreeLocalOffset(in const uint2 packedPos) {
+    // sign-extend the snorm16 values
+    const int3 q = int3(int(packedPos.x << 16) >> 16, int(packedPos.x) >> 16, int(packedPos.y << 16) >> 16);
+
+    return float3(q) / treeLocalPositionScale;
+}
+
+// root is the root of tree GetPackedTreeIndex(packedPos)
+float3 UnpackTreeLocalPosition(in const uint2 packedPos, in const TreeRoot root) {
+    return root.pos + UnpackTreeLocalOffset(packedPos) * root.radius;
+}
@@ -0,0 +1,356 @@
+#pragma once
+
+#include "Config.h"
+#include "LeafDensity.h"
+#include "Occlusion.h"
+#include "Records.h"
+#include "Shadow.h"
+#include "SplineTessellation.h"
+#include "StemGrowth.h"
+#include "TreeRoots.h"
+
+// ============================ Tree Templates ====================
+// With PersistentConfig::TREE_TEMPLATE_COUNT > 0, the forest is instanced: only the template trees run through
+// the Stem nodes. Template stems do not draw, they store their segments and leaves in a template bank instead.
+// Every tree of the chunks then picks a template by its seed, and the TreeInstance node replays the records of
+// the template at the root of the tree, with the culling, tessellation and leaf density of the instance.
+// Generation cost thus grows with the template count instead of the tree count; instances of a template only
+// differ by their position and the phase of their wind (see ApplyTreeWind).
+// Templates are the static skeleton of the forest: they are generated without wind, TreeInstance applies the
+// wind of every frame on top. Each template keeps the hash of its inputs (see GetTreeTemplateKey) for both of
+// its banks and is only regenerated when its hash matches neither bank; e.g. raising the template count only
+// generates the new template, and toggling a slider back replays the bank generated before.
+// The work graph cannot wait for the template stems, so a regenerated template is written to its other bank
+// and only replayed from the next frame on; until then, instances keep replaying the previous bank. Trees of a
+// template without any complete bank, i.e. in the frame that generates it first, grow through the Stem nodes
+// like trees without instancing (see IsTreeTemplateComplete). Templates reserve the tree indices
+// [0, TREE_TEMPLATE_COUNT) and are generated at the origin without culling, at full leaf density and LOD 0.
+// Only templates are cached. Without instancing, every tree runs through the Stem nodes in every frame: the
+// records of one tree take TreeTemplateSize (4.5 MB), so the trees of the chunk window would not fit into the
+// scratch buffer, and their tree indices are reallocated every frame (see ChunksNode).
+
+static const uint MaxTreeTemplateCount        = 4;
+static const uint TreeTemplateSegmentCapacity = 1 << 15;
+static const uint TreeTemplateLeafCapacity    = 1 << 17;
+
+// Replayed template records per TreeInstance thread group (one segment and one leaf per thread)
+static const uint TreeInstanceGroupSize = 64;
+static const uint TreeInstanceMaxGroups = TreeTemplateLeafCapacity / TreeInstanceGroupSize;
+
+struct TreeTemplateHeader {
+    // Bounding sphere radius of the template tree; instances use it as their root radius
+    float radius;
+    uint  segmentCount;
+    uint  leafCount;
+    uint  padding;
+};
+
+// Persistent across frames, one per template in front of the banks
+struct TreeTemplateState {
+    // Bank that TreeInstance replays
+    uint  readBank;
+    // GetTreeTemplateKey of the template generated into the other bank in this frame; 0 if none
+    uint  pendingKey;
+    // GetTreeTemplateKey of the complete template in each bank; 0 if none
+    uint2 bankKeys;
+};
+
+// Byte offsets of the record counters in TreeTemplateHeader
+static const uint TreeTemplateSegmentCountOffset = 4;
+static const uint TreeTemplateLeafCountOffset    = 8;
+
+// Segment positions are relative to the template root at the origin
+struct TreeTemplateSegment {
+    StemTubeCageCompressed cage;
+    PackedSegmentInfo      si;
+    float                  aoDistance;
+};
+
+struct TreeTemplateLeaf {
+    TreeTransformLocalq32 trafo;
+    // Leaf seed (30 bits) and CoalesceDrawLeaves array index (2 bits)
+    uint  seedAndKind;
+    float scale;
+    float aoDistance;
+};
+
+struct TreeInstanceRecord {
+    uint treeIndex;
+    uint templateIndex;
+    uint lod;
+    // Occluded in the camera view, but inside the light frustum: only the shadow records are replayed
+    uint isCameraOccluded;
+    uint dispatchGrid : SV_DispatchGrid;
+};
+
+// Placed after the occlusion culling banks, before the bark textures (see SplineSegment.h)
+static const uint TreeTemplateStateOffset  = OcclusionEnd;
+static const uint TreeTemplateOffset       = TreeTemplateStateOffset + MaxTreeTemplateCount * sizeof(TreeTemplateState);
+static const uint TreeTemplateSegmentsSize = TreeTemplateSegmentCapacity * sizeof(TreeTemplateSegment);
+static const uint TreeTemplateLeavesSize   = TreeTemplateLeafCapacity * sizeof(TreeTemplateLeaf);
+static const uint TreeTemplateSize         = TreeTemplateSegmentsSize + TreeTemplateLeavesSize;
+static const uint TreeTemplateBankSize     = MaxTreeTemplateCount * (sizeof(TreeTemplateHeader) + TreeTemplateSize);
+static const uint TreeTemplateBankCount    = 2;
+static const uint TreeTemplateEnd          = TreeTemplateOffset + TreeTemplateBankCount * TreeTemplateBankSize;
+
+uint GetTreeTemplateCount() {
+    return min(LoadPersistentConfigUint(PersistentConfig::TREE_TEMPLATE_COUNT), MaxTreeTemplateCount);
+}
+
+uint GetTreeTemplateSeed(in uint templateIndex) {
+    return random::CombineSeed(LoadPersistentConfigUint(PersistentConfig::SEED), 't', templateIndex);
+}
+
+// Hash of the settings template templateIndex depends on. Wind, time and the camera are applied per instance,
+// and the template count only selects the templates of the instances; neither regenerates a template.
+uint GetTreeTemplateKey(in uint templateIndex) {
+    uint key = 1;
+    key = random::CombineSeed(key, LoadPersistentConfigUint(PersistentConfig::TREE_TYPE));
+    key = random::CombineSeed(key, LoadPersistentConfigUint(PersistentConfig::TREE_ATTRACTION_UP));
+    key = random::CombineSeed(key, LoadPersistentConfigUint(PersistentConfig::SEASON));
+    key = random::CombineSeed(key, GetTreeTemplateSeed(templateIndex));
+    // 0 marks banks that were never generated
+    return max(key, 1u);
+}
+
+uint GetTreeTemplateStateAddress(in uint templateIndex) {
+    return TreeTemplateStateOffset + (templateIndex % MaxTreeTemplateCount) * sizeof(TreeTemplateState);
+}
+
+TreeTemplateState LoadTreeTemplateState(in uint templateIndex) {
+    return PersistentScratchBuffer.Load<TreeTemplateState>(GetTreeTemplateStateAddress(templateIndex));
+}
+
+// Template bank replayed in this frame
+uint GetTreeTemplateReadBank(in uint templateIndex) {
+    return LoadTreeTemplateState(templateIndex).readBank;
+}
+
+// Template bank written in this frame, if the template is regenerated
+uint GetTreeTemplateWriteBank(in uint templateIndex) {
+    return GetTreeTemplateReadBank(templateIndex) + 1;
+}
+
+// Whether template templateIndex is generated in this frame, see BeginTreeTemplateFrame
+bool IsTreeTemplatePending(in uint templateIndex) {
+    return LoadTreeTemplateState(templateIndex).pendingKey != 0;
+}
+
+// Whether the bank replayed in this frame holds a complete template, of the current or of earlier settings
+bool IsTreeTemplateComplete(in uint templateIndex) {
+    const TreeTemplateState state = LoadTreeTemplateState(templateIndex);
+    return state.bankKeys[state.readBank % TreeTemplateBankCount] != 0;
+}
+
+uint GetTreeTemplateHeaderAddress(in uint bank, in uint templateIndex) {
+    return TreeTemplateOffset + (bank % TreeTemplateBankCount) * TreeTemplateBankSize +
+           (templateIndex % MaxTreeTemplateCount) * sizeof(TreeTemplateHeader);
+}
+
+uint GetTreeTemplateAddress(in uint bank, in uint templateIndex) {
+    return TreeTemplateOffset + (bank % TreeTemplateBankCount) * TreeTemplateBankSize +
+           MaxTreeTemplateCount * sizeof(TreeTemplateHeader) + (templateIndex % MaxTreeTemplateCount) * TreeTemplateSize;
+}
+
+uint GetTreeTemplateSegmentAddress(in uint bank, in uint templateIndex, in uint segmentIndex) {
+    return GetTreeTemplateAddress(bank, templateIndex) + segmentIndex * sizeof(TreeTemplateSegment);
+}
+
+uint GetTreeTemplateLeafAddress(in uint bank, in uint templateIndex, in uint leafIndex) {
+    return GetTreeTemplateAddress(bank, templateIndex) + TreeTemplateSegmentsSize + leafIndex * sizeof(TreeTemplateLeaf);
+}
+
+// Replays the templates generated in the last frame from now on, and selects the templates to regenerate in
+// this frame; their write bank is cleared. Returns the number of templates to regenerate. Must run in
+// EntryFunction, before any other node accesses the templates.
+uint BeginTreeTemplateFrame() {
+    uint regenerateCount = 0;
+
+    for (uint templateIndex = 0; templateIndex < MaxTreeTemplateCount; ++templateIndex) {
+        TreeTemplateState state = LoadTreeTemplateState(templateIndex);
+
+        if (state.pendingKey != 0) {
+            state.readBank                 = (state.readBank + 1) % TreeTemplateBankCount;
+            state.bankKeys[state.readBank] = state.pendingKey;
+            state.pendingKey               = 0;
+        }
+
+        const uint key       = GetTreeTemplateKey(templateIndex);
+        const uint otherBank = (state.readBank + 1) % TreeTemplateBankCount;
+
+        if ((templateIndex < GetTreeTemplateCount()) && (key != state.bankKeys[state.readBank])) {
+            if (key == state.bankKeys[otherBank]) {
+                // Generated before, e.g. a slider was moved back
+                state.readBank = otherBank;
+            } else {
+                state.pendingKey          = key;
+                state.bankKeys[otherBank] = 0;
+                PersistentScratchBuffer.Store<uint4>(GetTreeTemplateHeaderAddress(otherBank, templateIndex), uint4(0, 0, 0, 0));
+                ++regenerateCount;
+            }
+        }
+
+        PersistentScratchBuffer.Store<TreeTemplateState>(GetTreeTemplateStateAddress(templateIndex), state);
+    }
+
+    return regenerateCount;
+}
+
+void StoreTreeTemplateRadius(in uint templateIndex, in float radius) {
+    PersistentScratchBuffer.Store<float>(GetTreeTemplateHeaderAddress(GetTreeTemplateWriteBank(templateIndex), templateIndex), radius);
+}
+
+// Allocates count records of the template; callers aggregate per wave. Records beyond the capacity are dropped.
+uint AllocateTreeTemplateSegments(in uint templateIndex, in uint count) {
+    uint firstSegment = 0;
+    PersistentScratchBuffer.InterlockedAdd(GetTreeTemplateHeaderAddress(GetTreeTemplateWriteBank(templateIndex), templateIndex) + TreeTemplateSegmentCountOffset,
+                                            count, firstSegment);
+    return firstSegment;
+}
+
+uint AllocateTreeTemplateLeaves(in uint templateIndex, in uint count) {
+    uint firstLeaf = 0;
+    PersistentScratchBuffer.InterlockedAdd(GetTreeTemplateHeaderAddress(GetTreeTemplateWriteBank(templateIndex), templateIndex) + TreeTemplateLeafCountOffset,
+                                            count, firstLeaf);
+    return firstLeaf;
+}
+
+void StoreTreeTemplateSegment(in uint templateIndex, in uint segmentIndex, in const TreeTemplateSegment segment) {
+    if (segmentIndex < TreeTemplateSegmentCapacity) {
+        PersistentScratchBuffer.Store<TreeTemplateSegment>(GetTreeTemplateSegmentAddress(GetTreeTemplateWriteBank(templateIndex), templateIndex, segmentIndex), segment);
+    }
+}
+
+void StoreTreeTemplateLeaf(in uint templateIndex, in uint leafIndex, in const TreeTemplateLeaf leaf) {
+    if (leafIndex < TreeTemplateLeafCapacity) {
+        PersistentScratchBuffer.Store<TreeTemplateLeaf>(GetTreeTemplateLeafAddress(GetTreeTemplateWriteBank(templateIndex), templateIndex, leafIndex), leaf);
+    }
+}
+
+// Header of a replayed template, with the record counts clamped to the capacity
+TreeTemplateHeader LoadTreeTemplateHeader(in uint templateIndex) {
+    TreeTemplateHeader header = PersistentScratchBuffer.Load<TreeTemplateHeader>(GetTreeTemplateHeaderAddress(GetTreeTemplateReadBank(templateIndex), templateIndex));
+    header.segmentCount = min(header.segmentCount, TreeTemplateSegmentCapacity);
+    header.leafCount    = min(header.leafCount, TreeTemplateLeafCapacity);
+    return header;
+}
+
+TreeTemplateSegment LoadTreeTemplateSegment(in uint templateIndex, in uint segmentIndex) {
+    return PersistentScratchBuffer.Load<TreeTemplateSegment>(GetTreeTemplateSegmentAddress(GetTreeTemplateReadBank(templateIndex), templateIndex, segmentIndex));
+}
+
+TreeTemplateLeaf LoadTreeTemplateLeaf(in uint templateIndex, in uint leafIndex) {
+    return PersistentScratchBuffer.Load<TreeTemplateLeaf>(GetTreeTemplateLeafAddress(GetTreeTemplateReadBank(templateIndex), templateIndex, leafIndex));
+}
+
+TreeTemplateSegment CreateTreeTemplateSegment(
+    in const TreeTransform from,
+    in const TreeTransform to,
+    in const SegmentInfo   si,
+    in const float         aoDistance)
+{
+    TreeTemplateSegment segment;
+    segment.cage.from.SetPos(from.pos);
+    segment.cage.from.SetRot(from.rot);
+    segment.cage.to.SetPos(to.pos);
+    segment.cage.to.SetRot(to.rot);
+    segment.si         = PackSegmentInfo(si);
+    segment.aoDistance = aoDistance;
+    return segment;
+}
+
+TreeTemplateLeaf CreateTreeTemplateLeaf(
+    in const TreeTransformLocalq32 trafo,
+    in const uint                  seed,
+    in const uint                  leafOutputIndex,
+    in const float                 scale,
+    in const float                 aoDistance)
+{
+    TreeTemplateLeaf leaf;
+    leaf.trafo       = trafo;
+    leaf.seedAndKind = (seed & 0x3FFFFFFF) | (leafOutputIndex << 30);
+    leaf.scale       = scale;
+    leaf.aoDistance  = aoDistance;
+    return leaf;
+}
+
+uint GetTreeTemplateLeafSeed(in const TreeTemplateLeaf leaf) {
+    return leaf.seedAndKind & 0x3FFFFFFF;
+}
+
+uint GetTreeTemplateLeafOutputIndex(in const TreeTemplateLeaf leaf) {
+    return leaf.seedAndKind >> 30;
+}
+
+// Number of TreeInstance thread groups that replay all records of a template
+uint GetTreeInstanceGroupCount(in const TreeTemplateHeader header) {
+    return (max(header.segmentCount, header.leafCount) + TreeInstanceGroupSize - 1) / TreeInstanceGroupSize;
+}
+
+// Moves a template leaf to tree treeIndex with the given root and applies the wind of the instance. Template leaves are quantized to
+// the template radius; the root radius of the instance is larger by the wind offset.
+TreeTransformLocalq32 GetTreeInstanceLeafTransform(
+    in const TreeTemplateLeaf leaf,
+    in const float            templateRadius,
+    in const TreeParameters   params,
+    in const TreeWind         wind,
+    in uint                   treeIndex,
+    in const TreeRoot         root)
+{
+    TreeTransformLocalq32 templateTrafo = leaf.trafo;
+
+    TreeTransform trafo;
+    trafo.pos = wind.root + UnpackTreeLocalOffset(templateTrafo.pos) * templateRadius;
+    trafo.rot = templateTrafo.GetRot();
+    trafo     = ApplyTreeWind(wind, trafo);
+
+    // Fruits hang still, like in the Stem node
+    const uint leafOutputIndex = GetTreeTemplateLeafOutputIndex(leaf);
+    if (leafOutputIndex != 2) {
+        AddWindSway(0.03, GetLeafParameters(params, leafOutputIndex == 1).Scale, 1, trafo.pos, trafo.rot);
+    }
+
+    return CreateTreeLocalTransformq32(treeIndex, root, trafo.pos, trafo.rot);
+}
+
+// Template leaves are generated at full density. Instances thin them out with the leaf density of their distance
+// and scale the remaining leaves up, like the Stem node does per child (see ComputeChildDensityAndScale).
+float GetTreeInstanceLeafScale(in const TreeTemplateLeaf leaf, in const float distanceToCamera) {
+    float childDensity;
+    float childScale;
+    ComputeChildDensityAndScale(distanceToCamera, false, childDensity, childScale);
+
+    return (random::Random(GetTreeTemplateLeafSeed(leaf), 'd') < childDensity) ? leaf.scale * childScale : 0.f;
+}
+
+// Body of the TreeTemplates node: each thread regenerates one template tree at the origin; its tree index is
+// reserved by EntryFunction (see BeginTreeFrame)
+void GenerateTreeTemplates(
+    in const uint gtid,
+    NodeOutputArray<GenerateTreeRecord> treeOutput
+)
+{
+    const uint templateIndex = gtid;
+    const bool hasOutput     = (templateIndex < GetTreeTemplateCount()) && IsTreeTemplatePending(templateIndex);
+    const uint treeType      = LoadPersistentConfigUint(PersistentConfig::TREE_TYPE);
+
+    GenerateTreeRecord treeRecord = CreateTreeRecord(templateIndex, qRotateX(PI * -0.5), GetTreeTemplateSeed(templateIndex), 0);
+    treeRecord.isTemplate = 1;
+
+    if (hasOutput) {
+        TreeRoot root;
+        root.pos    = float3(0, 0, 0);
+        root.radius = GetMaxSubtreeReach(GetTreeParameters(treeType), 0, treeRecord.length, treeRecord.radius);
+        StoreTreeRoot(templateIndex, root);
+        StoreTreeTemplateRadius(templateIndex, root.radius);
+    }
+    Barrier(UAV_MEMORY, DEVICE_SCOPE);
+
+    ThreadNodeOutputRecords<GenerateTreeRecord> outputRecord = treeOutput[treeType].GetThreadNodeOutputRecords(hasOutput);
+
+    if (hasOutput) {
+        outputRecord.Get() = treeRecord;
+    }
+
+    outputRecord.OutputComplete();
+}
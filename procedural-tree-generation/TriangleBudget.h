@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Config.h"
+#include "Statistics.h"
+
+// ============================ Triangle Budget ====================
+// With PersistentConfig::TRIANGLE_BUDGET > 0, EntryFunction steers a global detail factor in (0, 1] so that the
+// triangles of all mesh nodes (camera and shadow map) stay within the budget, e.g. while the camera zooms
+// through the CAMERA_DISTANCE range. The detail factor scales the stem tessellation (see GetStemPixelsPerTriangle)
+// and the leaf density (see ComputeChildDensity); both keep their triangle counts about proportional to it.
+// The work graph cannot wait for its own mesh nodes, so the controller reads the counters of the last frame.
+// Detail only changes when the last frame left the band [TriangleBudgetLowerLoad, TriangleBudgetUpperLoad]
+// of the budget, and then steps towards the middle of the band; counts within the band keep the detail of the last
+// frame, so small changes of the view do not make it oscillate.
+
+// PersistentConfig::TRIANGLE_BUDGET is in millions of triangles
+static const float TriangleBudgetUnit      = 1000000.f;
+static const float TriangleBudgetUpperLoad = 1.f;
+static const float TriangleBudgetLowerLoad = .8f;
+static const float TriangleBudgetMinDetail = 1.f / 64;
+// Bound of the detail change per frame
+static const float TriangleBudgetMaxStep   = 2.f;
+// Exponent of the correction per frame; leaf density and tessellation change in steps, so triangle counts react
+// more than proportionally to small detail changes, and a full correction would overshoot the band
+static const float TriangleBudgetDamping   = .5f;
+
+struct TriangleBudgetState {
+    // 0 until the first frame initialized the controller
+    float detail;
+    // Triangles of the last frame, which detail was computed from
+    uint  triangles;
+    uint2 padding;
+};
+
+// Placed after the statistics counters, which it reads
+static const uint TriangleBudgetOffset = ((StatisticsPreviousFrameOffset + ((uint)StatisticsCounter::COUNT) * sizeof(uint)) + 15) & ~15u;
+static const uint TriangleBudgetEnd    = TriangleBudgetOffset + sizeof(TriangleBudgetState);
+
+TriangleBudgetState LoadTriangleBudgetState() {
+    return PersistentScratchBuffer.Load<TriangleBudgetState>(TriangleBudgetOffset);
+}
+
+float GetTriangleBudget() {
+    return max(LoadPersistentConfigFloat(PersistentConfig::TRIANGLE_BUDGET), 0.f) * TriangleBudgetUnit;
+}
+
+// Triangles of all mesh nodes in the last frame. Must run after BeginStatisticsFrame.
+uint GetPreviousFrameTriangles() {
+    return LoadPreviousStatistic(StatisticsCounter::STEM_MESH_TRIANGLES) +
+           LoadPreviousStatistic(StatisticsCounter::LEAF_MESH_TRIANGLES) +
+           LoadPreviousStatistic(StatisticsCounter::FRUIT_MESH_TRIANGLES) +
+           LoadPreviousStatistic(StatisticsCounter::STEM_SHADOW_MESH_TRIANGLES) +
+           LoadPreviousStatistic(StatisticsCounter::LEAF_SHADOW_MESH_TRIANGLES);
+}
+
+// Computes the detail factor of this frame. Must run in EntryFunction, after BeginStatisticsFrame.
+void UpdateTriangleBudget() {
+    TriangleBudgetState state = LoadTriangleBudgetState();
+
+    const float budget = GetTriangleBudget();
+    state.triangles    = GetPreviousFrameTriangles();
+
+    if ((budget <= 0) || (state.detail <= 0)) {
+        state.detail = 1;
+    } else {
+        const float load = state.triangles / budget;
+
+        if ((load > TriangleBudgetUpperLoad) || ((load < TriangleBudgetLowerLoad) && (state.detail < 1))) {
+            const float targetLoad = (TriangleBudgetLowerLoad + TriangleBudgetUpperLoad) * .5f;
+            const float step       = clamp(pow(targetLoad / max(load, 1e-3), TriangleBudgetDamping), 1 / TriangleBudgetMaxStep, TriangleBudgetMaxStep);
+
+            state.detail = clamp(state.detail * step, TriangleBudgetMinDetail, 1.f);
+        }
+    }
+
+    PersistentScratchBuffer.Store<TriangleBudgetState>(TriangleBudgetOffset, state);
+}
+
+// Detail factor of this frame; 1 draws at full detail
+float GetTriangleBudgetDetail() {
+    return LoadTriangleBudgetState().detail;
+}
+
+// Segment triangles scale with the inverse square of their size, see ComputeVisibilityAndTessellationData
+float GetTriangleBudgetPixelsPerTriangleScale() {
+    return rsqrt(clamp(GetTriangleBudgetDetail(), TriangleBudgetMinDetail, 1.f));
+}